@@ -2,6 +2,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <stack>
 #include <unordered_set>
 
@@ -11,16 +12,23 @@ namespace glint {
 
 class Logger {
  public:
+  // Worker threads log too, lines are serialized and every thread indents by its own call stack
   static void logFunctionEntry(const char* functionName) {
-    if (instance().enabled_) instance().logFunctionEntryImpl(functionName);
+    if (!instance().enabled_) return;
+    std::lock_guard<std::mutex> lock(instance().mutex_);
+    instance().logFunctionEntryImpl(functionName);
   }
   static void logFunctionExit() {
-    if (instance().enabled_) instance().logFunctionExitImpl();
+    if (!instance().enabled_) return;
+    std::lock_guard<std::mutex> lock(instance().mutex_);
+    instance().logFunctionExitImpl();
   }
 
   template <typename... Args>
   static void log(Args... args) {
-    if (instance().enabled_) instance().logImpl(args...);
+    if (!instance().enabled_) return;
+    std::lock_guard<std::mutex> lock(instance().mutex_);
+    instance().logImpl(args...);
   }
 
   static void enabled(bool enable) { instance().enabled_ = enable; }
@@ -94,8 +102,9 @@ class Logger {
     logImplRec(args...);
   }
 
-  std::stack<const char*> callStack;
+  static inline thread_local std::stack<const char*> callStack;
   std::ofstream logFile;
+  std::mutex mutex_;
   bool enabled_ = false;
 };
 
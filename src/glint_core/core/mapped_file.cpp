@@ -0,0 +1,82 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace glint {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) {
+  m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                       nullptr);
+  if (m_File == INVALID_HANDLE_VALUE) {
+    m_File = nullptr;
+    throw std::runtime_error("Failed to open file for mapping: " + path);
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+    CloseHandle(m_File);
+    throw std::runtime_error("Failed to map empty file: " + path);
+  }
+  m_Size = static_cast<size_t>(size.QuadPart);
+
+  m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m_Mapping) {
+    m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (!m_Data) {
+    if (m_Mapping) {
+      CloseHandle(m_Mapping);
+    }
+    CloseHandle(m_File);
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  UnmapViewOfFile(m_Data);
+  CloseHandle(m_Mapping);
+  CloseHandle(m_File);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+  m_File = open(path.c_str(), O_RDONLY);
+  if (m_File < 0) {
+    throw std::runtime_error("Failed to open file for mapping: " + path);
+  }
+
+  struct stat info;
+  if (fstat(m_File, &info) != 0 || info.st_size == 0) {
+    close(m_File);
+    throw std::runtime_error("Failed to map empty file: " + path);
+  }
+  m_Size = static_cast<size_t>(info.st_size);
+
+  void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+  if (data == MAP_FAILED) {
+    close(m_File);
+    throw std::runtime_error("Failed to map file: " + path);
+  }
+  m_Data = static_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<uint8_t*>(m_Data), m_Size);
+  close(m_File);
+}
+
+#endif
+
+}  // namespace glint
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace glint {
+
+// Read only memory mapping of a whole file. The pages are loaded by the OS on first touch, so reading a mapped file
+// needs no intermediate copy in process memory.
+class MappedFile {
+ public:
+  // Throws if the file can't be opened or mapped
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  // Prevent copying
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* getData() const { return m_Data; }
+  size_t getSize() const { return m_Size; }
+
+ private:
+  const uint8_t* m_Data = nullptr;
+  size_t m_Size = 0;
+
+#if defined(_WIN32)
+  void* m_File = nullptr;
+  void* m_Mapping = nullptr;
+#else
+  int m_File = -1;
+#endif
+};
+
+}  // namespace glint
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace glint {
+
+// Lock-free multi producer, single consumer queue.
+// Producers push onto an intrusive stack with a CAS loop, the consumer takes the whole stack with a single exchange
+// and reverses it, so neither side ever blocks the other and items come out in push order.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() = default;
+  ~MpscQueue() { clear(); }
+
+  // Prevent copying
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // Any thread
+  void push(T value) {
+    Node* node = new Node{std::move(value), m_Head.load(std::memory_order_relaxed)};
+    while (!m_Head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Consumer thread only. Calls consume for every item pushed so far, oldest first, returns the item count.
+  template <typename Fn>
+  size_t consumeAll(Fn&& consume) {
+    Node* node = m_Head.exchange(nullptr, std::memory_order_acquire);
+
+    Node* oldest = nullptr;
+    while (node) {
+      Node* next = node->next;
+      node->next = oldest;
+      oldest = node;
+      node = next;
+    }
+
+    size_t count = 0;
+    while (oldest) {
+      std::unique_ptr<Node> current(oldest);
+      oldest = oldest->next;
+      consume(current->value);
+      count++;
+    }
+    return count;
+  }
+
+  bool empty() const { return m_Head.load(std::memory_order_acquire) == nullptr; }
+
+  void clear() {
+    consumeAll([](T&) {});
+  }
+
+ private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+
+  std::atomic<Node*> m_Head{nullptr};
+};
+
+}  // namespace glint
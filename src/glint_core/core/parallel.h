@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace glint {
+
+// Runs fn(0) .. fn(threadCount - 1) on threads of their own, fn(0) on the calling thread
+template <typename Fn>
+void parallelFor(uint32_t threadCount, Fn&& fn) {
+  std::vector<std::thread> threads;
+  for (uint32_t t = 1; t < threadCount; t++) {
+    threads.emplace_back(fn, t);
+  }
+  fn(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace glint
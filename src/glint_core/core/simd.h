@@ -0,0 +1,25 @@
+#pragma once
+
+// SSE is part of every x86-64 target, GLINT_SSE marks code paths that use it. Other targets take the scalar paths.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GLINT_SSE
+#endif
+
+namespace glint {
+
+#ifdef GLINT_SSE
+inline float horizontalMin(__m128 value) {
+  value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+  value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(value);
+}
+
+inline float horizontalMax(__m128 value) {
+  value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+  value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(value);
+}
+#endif
+
+}  // namespace glint
@@ -0,0 +1,274 @@
+#include "asset_loader.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "core/logger.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "obj_parser.h"
+#include "texture.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+AssetLoader::AssetLoader(VkContext* context, uint32_t threadCount) : m_Context(context) {
+  LOGFN;
+  if (threadCount == 0) {
+    // Leave a hardware thread for the render loop
+    threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+
+  LOG("Starting", threadCount, "asset loader threads");
+  for (uint32_t i = 0; i < threadCount; i++) {
+    m_Workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+AssetLoader::~AssetLoader() {
+  LOGFN;
+  {
+    std::lock_guard<std::mutex> lock(m_JobMutex);
+    m_Stopping = true;
+    m_Jobs.clear();
+  }
+  m_JobAvailable.notify_all();
+  m_ShapeCreated.notify_all();
+
+  for (auto& worker : m_Workers) {
+    worker.join();
+  }
+
+  // Decoded assets that never reached update() are dropped with the queue
+}
+
+template <typename T, typename DecodeFn>
+bool AssetLoader::decode(const std::weak_ptr<AssetSlot<T>>& weakSlot, DecodeFn&& decodeFn) {
+  // Cancelled, every handle was dropped before a worker got to it
+  if (weakSlot.expired()) {
+    m_LoadingCount--;
+    return false;
+  }
+
+  try {
+    decodeFn();
+    return true;
+  } catch (const std::exception& e) {
+    if (auto slot = weakSlot.lock()) {
+      LOG("[ERROR] Failed to load asset", slot->path, ":", e.what());
+      slot->error = e.what();
+      slot->state.store(AssetState::Failed, std::memory_order_release);
+    }
+    m_LoadingCount--;
+    m_FailedCount++;
+    return false;
+  }
+}
+
+template <typename T, typename CreateFn>
+bool AssetLoader::create(const std::weak_ptr<AssetSlot<T>>& weakSlot, CreateFn&& createFn,
+                         const ReadyCallback& onReady) {
+  m_LoadingCount--;
+  auto slot = weakSlot.lock();
+  if (!slot) {
+    return false;
+  }
+
+  try {
+    slot->asset = createFn();
+  } catch (const std::exception& e) {
+    LOG("[ERROR] Failed to create asset", slot->path, ":", e.what());
+    slot->error = e.what();
+    slot->state.store(AssetState::Failed, std::memory_order_release);
+    m_FailedCount++;
+    return false;
+  }
+
+  slot->state.store(AssetState::Ready, std::memory_order_release);
+  m_LoadedCount++;
+
+  if (onReady) {
+    onReady();
+  }
+  return true;
+}
+
+TextureHandle AssetLoader::loadTexture(const std::string& path, ReadyCallback onReady) {
+  auto slot = std::make_shared<AssetSlot<Texture>>();
+  slot->path = path;
+  std::weak_ptr<AssetSlot<Texture>> weakSlot = slot;
+
+  submitJob([this, weakSlot, path, onReady = std::move(onReady)]() {
+    auto image = std::make_shared<ImageData>();
+    // Mips are built here too so the texture can stream them in, smallest first. KTX2 files bring their own. Each
+    // worker builds its mips on its own thread, there is already about one worker per core.
+    auto decodeImage = [&]() {
+      *image = Texture::loadImage(path);
+      if (!image->hasMips() && !image->isCompressed()) {
+        image->generateMips(MipFilter::Box, 1);
+      }
+    };
+    if (!decode(weakSlot, decodeImage)) {
+      return;
+    }
+
+    m_Decoded.push([this, weakSlot, image, onReady]() {
+      return create(
+          weakSlot, [&]() { return std::make_unique<Texture>(m_Context, std::shared_ptr<const ImageData>(image)); },
+          onReady);
+    });
+  });
+
+  return TextureHandle(slot);
+}
+
+MeshHandle AssetLoader::loadMesh(const std::string& path, ReadyCallback onReady, VertexAttributeFlags flags) {
+  auto slot = std::make_shared<AssetSlot<Mesh>>();
+  slot->path = path;
+  std::weak_ptr<AssetSlot<Mesh>> weakSlot = slot;
+
+  submitJob([this, weakSlot, path, flags, onReady = std::move(onReady)]() {
+    // Usually a mapped MeshCache file, the parse only runs the first time a model is seen. Like the mips, it runs on
+    // this worker's thread only.
+    std::shared_ptr<LoadedMesh> geometry;
+    if (!decode(weakSlot, [&]() { geometry = Mesh::loadGeometry(path, 1); })) {
+      return;
+    }
+
+    // The mesh only reads the geometry in its constructor
+    m_Decoded.push([this, weakSlot, geometry, flags, onReady]() {
+      return create(
+          weakSlot,
+          [&]() {
+            return std::make_unique<Mesh>(m_Context, geometry->vertices, geometry->indices, flags, geometry->lods,
+                                          &geometry->bounds);
+          },
+          onReady);
+    });
+  });
+
+  return MeshHandle(slot);
+}
+
+ModelStreamHandle AssetLoader::streamModel(const std::string& path, ShapeCallback onShape, VertexAttributeFlags flags) {
+  auto stream = std::make_shared<ModelStream>();
+  stream->path = path;
+  std::weak_ptr<ModelStream> weakStream = stream;
+
+  submitJob([this, weakStream, path, flags, onShape = std::move(onShape)]() {
+    auto createShape = [this, weakStream, flags, onShape](MeshData&& shape, const std::string& name) {
+      // Bounds the parsed geometry held in the queue
+      {
+        std::unique_lock<std::mutex> lock(m_JobMutex);
+        m_ShapeCreated.wait(lock, [this]() { return m_Stopping || m_PendingShapes < kMaxPendingShapes; });
+        if (m_Stopping) {
+          return false;
+        }
+        m_PendingShapes++;
+      }
+
+      auto geometry = std::make_shared<MeshData>(std::move(shape));
+      MeshBounds bounds = Bounds::compute(geometry->vertices);
+      m_Decoded.push([this, weakStream, geometry, bounds, name, flags, onShape]() {
+        {
+          std::lock_guard<std::mutex> lock(m_JobMutex);
+          m_PendingShapes--;
+        }
+        m_ShapeCreated.notify_one();
+
+        auto stream = weakStream.lock();
+        if (!stream) {
+          return false;
+        }
+        try {
+          onShape(std::make_unique<Mesh>(m_Context, geometry->vertices, geometry->indices, flags,
+                                         std::span<const MeshLod>(), &bounds),
+                  name);
+        } catch (const std::exception& e) {
+          LOG("[ERROR] Failed to create shape", name, "of", stream->path, ":", e.what());
+          return false;
+        }
+        stream->shapeCount++;
+        return true;
+      });
+
+      // Cancelled, every handle was dropped
+      return !weakStream.expired();
+    };
+
+    // Parsed and deduplicated on this worker's thread only, there is already about one worker per core
+    try {
+      ObjParser::parseShapes(path, createShape, 1);
+    } catch (const std::exception& e) {
+      if (auto stream = weakStream.lock()) {
+        LOG("[ERROR] Failed to load asset", path, ":", e.what());
+        stream->error = e.what();
+        stream->state.store(AssetState::Failed, std::memory_order_release);
+      }
+      m_LoadingCount--;
+      m_FailedCount++;
+      return;
+    }
+
+    // Queued behind the last shape
+    m_Decoded.push([this, weakStream]() {
+      m_LoadingCount--;
+      if (auto stream = weakStream.lock()) {
+        stream->state.store(AssetState::Ready, std::memory_order_release);
+        m_LoadedCount++;
+      }
+      return false;
+    });
+  });
+
+  return stream;
+}
+
+bool AssetLoader::update() {
+  if (m_Decoded.empty()) {
+    return false;
+  }
+
+  // Everything decoded since the last frame shares one upload submission
+  bool ready = false;
+  UploadBatch uploads(m_Context);
+  m_Decoded.consumeAll([&ready](CreateCallback& createAsset) { ready |= createAsset(); });
+  return ready;
+}
+
+AssetLoader::Stats AssetLoader::getStats() const {
+  Stats stats;
+  stats.loadingCount = m_LoadingCount.load(std::memory_order_relaxed);
+  stats.loadedCount = m_LoadedCount.load(std::memory_order_relaxed);
+  stats.failedCount = m_FailedCount.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void AssetLoader::submitJob(std::function<void()> job) {
+  m_LoadingCount++;
+  {
+    std::lock_guard<std::mutex> lock(m_JobMutex);
+    m_Jobs.push_back(std::move(job));
+  }
+  m_JobAvailable.notify_one();
+}
+
+void AssetLoader::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_JobMutex);
+      m_JobAvailable.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+      if (m_Stopping) {
+        return;
+      }
+      job = std::move(m_Jobs.front());
+      m_Jobs.pop_front();
+    }
+
+    job();
+  }
+}
+
+}  // namespace glint
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/mpsc_queue.h"
+#include "vertex.h"
+
+namespace glint {
+
+class VkContext;
+class Texture;
+class Mesh;
+
+enum class AssetState { Loading, Ready, Failed };
+
+// Shared by the loader and all handles to one asset
+template <typename T>
+struct AssetSlot {
+  std::string path;
+  std::atomic<AssetState> state{AssetState::Loading};
+  // Set before state becomes Ready (render thread) or Failed (worker)
+  std::unique_ptr<T> asset;
+  std::string error;
+};
+
+// Handle to an asset that is loaded in the background. Copies share the asset, which is destroyed with the last
+// handle. Dropping every handle while the asset is still loading cancels it.
+template <typename T>
+class AssetHandle {
+ public:
+  AssetHandle() = default;
+  explicit AssetHandle(std::shared_ptr<AssetSlot<T>> slot) : m_Slot(std::move(slot)) {}
+
+  bool isValid() const { return m_Slot != nullptr; }
+  bool isReady() const { return m_Slot && m_Slot->state.load(std::memory_order_acquire) == AssetState::Ready; }
+  bool hasFailed() const { return m_Slot && m_Slot->state.load(std::memory_order_acquire) == AssetState::Failed; }
+
+  // Null until the asset is ready
+  T* get() const { return isReady() ? m_Slot->asset.get() : nullptr; }
+  T* operator->() const { return get(); }
+
+  const std::string& getPath() const { return m_Slot->path; }
+  const std::string& getError() const { return m_Slot->error; }
+
+  void reset() { m_Slot.reset(); }
+
+ private:
+  std::shared_ptr<AssetSlot<T>> m_Slot;
+};
+
+using TextureHandle = AssetHandle<Texture>;
+using MeshHandle = AssetHandle<Mesh>;
+
+// Progress of a model streamed shape by shape. Dropping every handle stops the parse, shapes parsed by then are
+// dropped without being created.
+struct ModelStream {
+  std::string path;
+  // Ready once every shape has been handed out
+  std::atomic<AssetState> state{AssetState::Loading};
+  std::atomic<uint32_t> shapeCount{0};
+  // Set before state becomes Failed
+  std::string error;
+};
+
+using ModelStreamHandle = std::shared_ptr<ModelStream>;
+
+// Decodes images and parses models on a pool of worker threads so loading never blocks the render loop.
+// Decoded data is handed back through a lock-free queue, update() then creates the Vulkan resources on the render
+// thread, recording all uploads of a frame into one UploadBatch. Handles become ready once their resources exist,
+// the uploads themselves are ordered before the frame by the TransferManager.
+class AssetLoader {
+ public:
+  // Called on the render thread once the asset is ready, not called for failed or cancelled assets
+  using ReadyCallback = std::function<void()>;
+  // Called on the render thread with every shape of a streamed model, in file order
+  using ShapeCallback = std::function<void(std::unique_ptr<Mesh> mesh, const std::string& name)>;
+
+  struct Stats {
+    uint32_t loadingCount = 0;
+    uint32_t loadedCount = 0;
+    uint32_t failedCount = 0;
+  };
+
+  // threadCount 0 uses one worker per spare hardware thread
+  AssetLoader(VkContext* context, uint32_t threadCount = 0);
+  ~AssetLoader();
+
+  // Prevent copying
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  TextureHandle loadTexture(const std::string& path, ReadyCallback onReady = nullptr);
+  MeshHandle loadMesh(const std::string& path, ReadyCallback onReady = nullptr,
+                      VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+
+  // Parse an OBJ model with ObjParser::parseShapes and create a mesh for each shape as soon as it is parsed, so the
+  // model's faces are never all in memory. Large shapes arrive as several meshes of the same name. Bypasses the
+  // MeshCache and the LOD chain. The parse waits while kMaxPendingShapes parsed shapes are queued for update().
+  ModelStreamHandle streamModel(const std::string& path, ShapeCallback onShape,
+                                VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+
+  // Create the resources of decoded assets, render thread only. Returns true if any asset became ready.
+  bool update();
+
+  uint32_t getThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+  Stats getStats() const;
+
+  static constexpr uint32_t kMaxPendingShapes = 8;
+
+ private:
+  // Runs on the render thread, returns true if the asset became ready
+  using CreateCallback = std::function<bool()>;
+
+  void submitJob(std::function<void()> job);
+  void workerLoop();
+
+  template <typename T, typename DecodeFn>
+  bool decode(const std::weak_ptr<AssetSlot<T>>& weakSlot, DecodeFn&& decodeFn);
+  template <typename T, typename CreateFn>
+  bool create(const std::weak_ptr<AssetSlot<T>>& weakSlot, CreateFn&& createFn, const ReadyCallback& onReady);
+
+ private:
+  VkContext* m_Context;
+
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Jobs;
+  std::mutex m_JobMutex;
+  std::condition_variable m_JobAvailable;
+  bool m_Stopping = false;
+  // Streamed shapes waiting for update(), guarded by m_JobMutex
+  uint32_t m_PendingShapes = 0;
+  std::condition_variable m_ShapeCreated;
+
+  // Pushed by the workers, drained by update()
+  MpscQueue<CreateCallback> m_Decoded;
+
+  std::atomic<uint32_t> m_LoadingCount{0};
+  std::atomic<uint32_t> m_LoadedCount{0};
+  std::atomic<uint32_t> m_FailedCount{0};
+};
+
+}  // namespace glint
@@ -0,0 +1,506 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "core/logger.h"
+#include "core/parallel.h"
+#include "core/simd.h"
+
+namespace glint {
+
+namespace {
+
+constexpr uint32_t kMaxPalette = 16;
+
+// Weight of the second endpoint of every index
+constexpr float kBc1Weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+constexpr float kBc4Weights[8] = {0.0f,        1.0f,        1.0f / 7.0f, 2.0f / 7.0f,
+                                  3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f};
+constexpr uint32_t kBc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// The 4x4 texels of a block, channel by channel, edge texels repeated for partial blocks
+struct Block {
+  alignas(16) float channels[4][16];
+};
+
+struct Endpoints {
+  float first[4] = {};
+  float second[4] = {};
+};
+
+struct Palette {
+  float values[kMaxPalette][4] = {};
+  uint32_t size = 0;
+};
+
+// Little endian bit stream of a BC7 block
+class BitWriter {
+ public:
+  explicit BitWriter(uint8_t* data) : m_Data(data) { std::memset(m_Data, 0, 16); }
+
+  void write(uint32_t value, uint32_t bitCount) {
+    for (uint32_t i = 0; i < bitCount; i++, m_Position++) {
+      m_Data[m_Position / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (m_Position % 8));
+    }
+  }
+
+ private:
+  uint8_t* m_Data;
+  uint32_t m_Position = 0;
+};
+
+void loadBlock(const ImageData& image, uint32_t level, uint32_t blockX, uint32_t blockY, Block& block) {
+  uint32_t width = image.getMipWidth(level);
+  uint32_t height = image.getMipHeight(level);
+  const uint8_t* pixels = image.getMipPixels(level);
+  for (uint32_t i = 0; i < 16; i++) {
+    uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+    uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+    const uint8_t* texel = pixels + (static_cast<size_t>(y) * width + x) * 4;
+    for (uint32_t c = 0; c < 4; c++) {
+      block.channels[c][i] = texel[c];
+    }
+  }
+}
+
+// Nearest palette entry of every texel over channels [first, first + count), returns the summed squared error
+float findIndices(const Block& block, const Palette& palette, uint32_t first, uint32_t count, uint8_t indices[16]) {
+  float error = 0.0f;
+#ifdef GLINT_SSE
+  for (uint32_t group = 0; group < 16; group += 4) {
+    __m128 texels[4];
+    for (uint32_t c = 0; c < count; c++) {
+      texels[c] = _mm_load_ps(&block.channels[first + c][group]);
+    }
+    __m128 bestError = _mm_set1_ps(INFINITY);
+    __m128 bestIndex = _mm_setzero_ps();
+    for (uint32_t p = 0; p < palette.size; p++) {
+      __m128 distance = _mm_setzero_ps();
+      for (uint32_t c = 0; c < count; c++) {
+        __m128 delta = _mm_sub_ps(texels[c], _mm_set1_ps(palette.values[p][c]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+      }
+      __m128 closer = _mm_cmplt_ps(distance, bestError);
+      bestError = _mm_min_ps(distance, bestError);
+      bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(closer, bestIndex));
+    }
+    alignas(16) float lanes[4];
+    alignas(16) float errors[4];
+    _mm_store_ps(lanes, bestIndex);
+    _mm_store_ps(errors, bestError);
+    for (uint32_t i = 0; i < 4; i++) {
+      indices[group + i] = static_cast<uint8_t>(lanes[i]);
+      error += errors[i];
+    }
+  }
+#else
+  for (uint32_t i = 0; i < 16; i++) {
+    float bestError = INFINITY;
+    for (uint32_t p = 0; p < palette.size; p++) {
+      float distance = 0.0f;
+      for (uint32_t c = 0; c < count; c++) {
+        float delta = block.channels[first + c][i] - palette.values[p][c];
+        distance += delta * delta;
+      }
+      if (distance < bestError) {
+        bestError = distance;
+        indices[i] = static_cast<uint8_t>(p);
+      }
+    }
+    error += bestError;
+  }
+#endif
+  return error;
+}
+
+// Endpoints at the extremes of the texels projected onto their principal axis, found by power iteration
+Endpoints fitPrincipalAxis(const Block& block, uint32_t first, uint32_t count) {
+  float mean[4] = {};
+  float minimum[4];
+  float maximum[4];
+  for (uint32_t c = 0; c < count; c++) {
+    const float* values = block.channels[first + c];
+    minimum[c] = *std::min_element(values, values + 16);
+    maximum[c] = *std::max_element(values, values + 16);
+    for (uint32_t i = 0; i < 16; i++) {
+      mean[c] += values[i];
+    }
+    mean[c] /= 16.0f;
+  }
+
+  float covariance[4][4] = {};
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t a = 0; a < count; a++) {
+      for (uint32_t b = a; b < count; b++) {
+        covariance[a][b] += (block.channels[first + a][i] - mean[a]) * (block.channels[first + b][i] - mean[b]);
+      }
+    }
+  }
+
+  float axis[4];
+  for (uint32_t c = 0; c < count; c++) {
+    axis[c] = maximum[c] - minimum[c];
+  }
+  for (uint32_t iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {};
+    float length = 0.0f;
+    for (uint32_t a = 0; a < count; a++) {
+      for (uint32_t b = 0; b < count; b++) {
+        next[a] += covariance[std::min(a, b)][std::max(a, b)] * axis[b];
+      }
+      length = std::max(length, std::abs(next[a]));
+    }
+    if (length == 0.0f) {
+      break;
+    }
+    for (uint32_t c = 0; c < count; c++) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  float lowest = 0.0f;
+  float highest = 0.0f;
+  float lengthSquared = 0.0f;
+  for (uint32_t c = 0; c < count; c++) {
+    lengthSquared += axis[c] * axis[c];
+  }
+  if (lengthSquared > 0.0f) {
+    lowest = INFINITY;
+    highest = -INFINITY;
+    for (uint32_t i = 0; i < 16; i++) {
+      float t = 0.0f;
+      for (uint32_t c = 0; c < count; c++) {
+        t += (block.channels[first + c][i] - mean[c]) * axis[c];
+      }
+      lowest = std::min(lowest, t / lengthSquared);
+      highest = std::max(highest, t / lengthSquared);
+    }
+  }
+
+  Endpoints endpoints;
+  for (uint32_t c = 0; c < count; c++) {
+    endpoints.first[c] = std::clamp(mean[c] + axis[c] * highest, 0.0f, 255.0f);
+    endpoints.second[c] = std::clamp(mean[c] + axis[c] * lowest, 0.0f, 255.0f);
+  }
+  return endpoints;
+}
+
+// Least squares endpoints for the chosen indices, false when the indices don't determine them
+bool refineEndpoints(const Block& block, uint32_t first, uint32_t count, const uint8_t indices[16],
+                     const float* weights, Endpoints& endpoints) {
+  float aa = 0.0f;
+  float bb = 0.0f;
+  float ab = 0.0f;
+  float ax[4] = {};
+  float bx[4] = {};
+  for (uint32_t i = 0; i < 16; i++) {
+    float b = weights[indices[i]];
+    float a = 1.0f - b;
+    aa += a * a;
+    bb += b * b;
+    ab += a * b;
+    for (uint32_t c = 0; c < count; c++) {
+      ax[c] += a * block.channels[first + c][i];
+      bx[c] += b * block.channels[first + c][i];
+    }
+  }
+
+  float determinant = aa * bb - ab * ab;
+  if (std::abs(determinant) < 1e-6f) {
+    return false;
+  }
+  for (uint32_t c = 0; c < count; c++) {
+    endpoints.first[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+    endpoints.second[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BC1 color
+
+uint16_t toRgb565(const float* color) {
+  auto r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+  auto g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+  auto b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void fromRgb565(uint16_t packed, float* color) {
+  uint32_t r = packed >> 11;
+  uint32_t g = (packed >> 5) & 63;
+  uint32_t b = packed & 31;
+  color[0] = static_cast<float>((r << 3) | (r >> 2));
+  color[1] = static_cast<float>((g << 2) | (g >> 4));
+  color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// Always in the four color mode, the first endpoint being the larger
+void encodeBc1(const Block& block, uint8_t* out) {
+  Endpoints endpoints = fitPrincipalAxis(block, 0, 3);
+  float bestError = INFINITY;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    uint16_t color0 = toRgb565(endpoints.first);
+    uint16_t color1 = toRgb565(endpoints.second);
+    if (color0 < color1) {
+      std::swap(color0, color1);
+    }
+
+    // Equal endpoints select the three color mode, where only index 0 is the endpoint color
+    Palette palette;
+    palette.size = color0 == color1 ? 1 : 4;
+    fromRgb565(color0, palette.values[0]);
+    fromRgb565(color1, palette.values[1]);
+    for (uint32_t c = 0; c < 3; c++) {
+      palette.values[2][c] = (2.0f * palette.values[0][c] + palette.values[1][c]) / 3.0f;
+      palette.values[3][c] = (palette.values[0][c] + 2.0f * palette.values[1][c]) / 3.0f;
+    }
+
+    uint8_t indices[16];
+    float error = findIndices(block, palette, 0, 3, indices);
+    if (error < bestError) {
+      bestError = error;
+      uint32_t bits = 0;
+      for (uint32_t i = 0; i < 16; i++) {
+        bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+      }
+      std::memcpy(out, &color0, 2);
+      std::memcpy(out + 2, &color1, 2);
+      std::memcpy(out + 4, &bits, 4);
+    }
+    if (palette.size == 1 || !refineEndpoints(block, 0, 3, indices, kBc1Weights, endpoints)) {
+      break;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BC4 single channel
+
+// Always in the eight value mode, the first endpoint being the larger
+void encodeBc4(const Block& block, uint32_t channel, uint8_t* out) {
+  const float* values = block.channels[channel];
+  Endpoints endpoints;
+  endpoints.first[0] = *std::max_element(values, values + 16);
+  endpoints.second[0] = *std::min_element(values, values + 16);
+
+  float bestError = INFINITY;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    auto value0 = static_cast<uint32_t>(std::lround(endpoints.first[0]));
+    auto value1 = static_cast<uint32_t>(std::lround(endpoints.second[0]));
+    if (value0 < value1) {
+      std::swap(value0, value1);
+    }
+
+    // Equal endpoints select the six value mode, where only index 0 is the endpoint value
+    Palette palette;
+    palette.size = value0 == value1 ? 1 : 8;
+    palette.values[0][0] = static_cast<float>(value0);
+    palette.values[1][0] = static_cast<float>(value1);
+    for (uint32_t i = 2; i < 8; i++) {
+      palette.values[i][0] = static_cast<float>(((8 - i) * value0 + (i - 1) * value1) / 7);
+    }
+
+    uint8_t indices[16];
+    float error = findIndices(block, palette, channel, 1, indices);
+    if (error < bestError) {
+      bestError = error;
+      uint64_t bits = 0;
+      for (uint32_t i = 0; i < 16; i++) {
+        bits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+      }
+      out[0] = static_cast<uint8_t>(value0);
+      out[1] = static_cast<uint8_t>(value1);
+      std::memcpy(out + 2, &bits, 6);
+    }
+    if (palette.size == 1 || !refineEndpoints(block, channel, 1, indices, kBc4Weights, endpoints)) {
+      break;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BC7 mode 6, a single subset with 7 bit RGBA endpoints, a p-bit each and 4 bit indices
+
+// Quantize to 7 bits and the p-bit that fits the endpoint best
+void quantizeBc7(const float* endpoint, uint32_t* values, uint32_t& pBit) {
+  float bestError = INFINITY;
+  for (uint32_t p = 0; p < 2; p++) {
+    uint32_t candidate[4];
+    float error = 0.0f;
+    for (uint32_t c = 0; c < 4; c++) {
+      candidate[c] = static_cast<uint32_t>(std::clamp<long>(std::lround((endpoint[c] - p) / 2.0f), 0, 127));
+      float delta = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+      error += delta * delta;
+    }
+    if (error < bestError) {
+      bestError = error;
+      pBit = p;
+      std::copy(candidate, candidate + 4, values);
+    }
+  }
+}
+
+void encodeBc7(const Block& block, uint8_t* out) {
+  float weights[16];
+  for (uint32_t i = 0; i < 16; i++) {
+    weights[i] = kBc7Weights[i] / 64.0f;
+  }
+
+  Endpoints endpoints = fitPrincipalAxis(block, 0, 4);
+  float bestError = INFINITY;
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    uint32_t values[2][4];
+    uint32_t pBits[2];
+    quantizeBc7(endpoints.first, values[0], pBits[0]);
+    quantizeBc7(endpoints.second, values[1], pBits[1]);
+
+    Palette palette;
+    palette.size = 16;
+    for (uint32_t c = 0; c < 4; c++) {
+      uint32_t value0 = (values[0][c] << 1) | pBits[0];
+      uint32_t value1 = (values[1][c] << 1) | pBits[1];
+      for (uint32_t i = 0; i < 16; i++) {
+        palette.values[i][c] =
+            static_cast<float>((value0 * (64 - kBc7Weights[i]) + value1 * kBc7Weights[i] + 32) >> 6);
+      }
+    }
+
+    uint8_t indices[16];
+    float error = findIndices(block, palette, 0, 4, indices);
+    if (error < bestError) {
+      bestError = error;
+      // The first index is stored without its top bit, swapping the endpoints clears it
+      uint32_t order[2] = {0, 1};
+      uint32_t flip = 0;
+      if (indices[0] >= 8) {
+        std::swap(order[0], order[1]);
+        flip = 15;
+      }
+
+      BitWriter writer(out);
+      writer.write(1 << 6, 7);
+      for (uint32_t c = 0; c < 4; c++) {
+        writer.write(values[order[0]][c], 7);
+        writer.write(values[order[1]][c], 7);
+      }
+      writer.write(pBits[order[0]], 1);
+      writer.write(pBits[order[1]], 1);
+      for (uint32_t i = 0; i < 16; i++) {
+        writer.write(indices[i] ^ flip, i == 0 ? 3 : 4);
+      }
+    }
+    if (!refineEndpoints(block, 0, 4, indices, weights, endpoints)) {
+      break;
+    }
+  }
+}
+
+void encodeBlock(const Block& block, VkFormat format, uint8_t* out) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      encodeBc1(block, out);
+      break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      encodeBc4(block, 3, out);
+      encodeBc1(block, out + 8);
+      break;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+      encodeBc4(block, 0, out);
+      break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      encodeBc4(block, 0, out);
+      encodeBc4(block, 1, out + 8);
+      break;
+    default:
+      encodeBc7(block, out);
+      break;
+  }
+}
+
+bool isEncodable(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+struct BlockRow {
+  uint32_t level;
+  uint32_t row;
+};
+
+}  // namespace
+
+ImageData BcEncoder::encode(const ImageData& image, VkFormat format, uint32_t threadCount) {
+  LOGFN;
+  if (image.format != VK_FORMAT_R8G8B8A8_SRGB && image.format != VK_FORMAT_R8G8B8A8_UNORM) {
+    throw std::runtime_error("Only RGBA8 images can be block compressed");
+  }
+  if (!isEncodable(format)) {
+    throw std::runtime_error("Can't block compress to format " + std::to_string(format));
+  }
+
+  ImageData result;
+  result.width = image.width;
+  result.height = image.height;
+  result.format = format;
+
+  uint32_t levels = image.getMipLevels();
+  std::vector<BlockRow> rows;
+  size_t mipBytes = 0;
+  for (uint32_t level = 0; level < levels; level++) {
+    for (uint32_t row = 0; row < (image.getMipHeight(level) + 3) / 4; row++) {
+      rows.push_back({level, row});
+    }
+    if (level > 0) {
+      result.mipOffsets.push_back(mipBytes);
+      mipBytes += result.getMipSize(level);
+    }
+  }
+  result.pixels = {static_cast<uint8_t*>(std::malloc(result.getMipSize(0))), std::free};
+  result.mipPixels.resize(mipBytes);
+
+  // Rows are handed out one at a time, the small mips' rows are cheaper
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::min<uint32_t>(threadCount, static_cast<uint32_t>(rows.size()));
+  uint32_t blockBytes = ImageData::getBlockBytes(format);
+  std::atomic<size_t> nextRow = 0;
+  parallelFor(threadCount, [&](uint32_t) {
+    Block block;
+    for (size_t i = nextRow++; i < rows.size(); i = nextRow++) {
+      auto [level, row] = rows[i];
+      uint32_t columns = (image.getMipWidth(level) + 3) / 4;
+      uint8_t* out = level == 0 ? result.pixels.get() : result.mipPixels.data() + result.mipOffsets[level - 1];
+      out += static_cast<size_t>(row) * columns * blockBytes;
+      for (uint32_t column = 0; column < columns; column++) {
+        loadBlock(image, level, column, row, block);
+        encodeBlock(block, format, out + column * blockBytes);
+      }
+    }
+  });
+
+  LOG("Block compressed", image.width, "x", image.height, "image with", levels, "mips to format", format);
+  return result;
+}
+
+}  // namespace glint
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "texture.h"
+
+namespace glint {
+
+// Block compression of RGBA8 images for offline conversion, see the texture_encoder tool. Endpoints are fit along the
+// principal axis of each block and refined once by least squares, the index search is vectorized with SSE. Thread
+// safe, no Vulkan calls.
+//  - BC1 (opaque, alpha is dropped) and BC7 (mode 6) for color
+//  - BC3 for color with alpha
+//  - BC4 of the red channel and BC5 of red and green, for masks and normal maps
+class BcEncoder {
+ public:
+  // Compress every mip of image into format, splitting the block rows over threadCount threads, 0 for one per core.
+  // Texel values are encoded as stored, the caller picks the sRGB or UNORM variant of format. Throws for source images
+  // that aren't R8G8B8A8 and for other formats, including BC1 with alpha.
+  static ImageData encode(const ImageData& image, VkFormat format, uint32_t threadCount = 0);
+};
+
+}  // namespace glint
@@ -0,0 +1,175 @@
+#include "bounds.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "core/simd.h"
+
+namespace glint {
+
+namespace {
+
+#ifdef GLINT_SSE
+// The position and, in the last lane, the first float after it
+__m128 loadPosition(const Vertex& vertex) { return _mm_loadu_ps(&vertex.position.x); }
+
+glm::vec3 toVec3(__m128 value) {
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, value);
+  return {lanes[0], lanes[1], lanes[2]};
+}
+#endif
+
+glm::vec3 transformPoint(const glm::vec3& point, const glm::mat4& model) {
+#ifdef GLINT_SSE
+  __m128 result = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&model[0][0]), _mm_set1_ps(point.x)),
+                             _mm_mul_ps(_mm_loadu_ps(&model[1][0]), _mm_set1_ps(point.y)));
+  result = _mm_add_ps(result, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&model[2][0]), _mm_set1_ps(point.z)),
+                                         _mm_loadu_ps(&model[3][0])));
+  return toVec3(result);
+#else
+  return glm::vec3(model * glm::vec4(point, 1.0f));
+#endif
+}
+
+// Half size of the box around a transformed box of half size extent, summing each axis' contribution as in Arvo's
+// "Transforming Axis-Aligned Bounding Boxes"
+glm::vec3 transformExtent(const glm::vec3& extent, const glm::mat4& model) {
+#ifdef GLINT_SSE
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  __m128 result = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signBit, _mm_loadu_ps(&model[0][0])), _mm_set1_ps(extent.x)),
+                             _mm_mul_ps(_mm_andnot_ps(signBit, _mm_loadu_ps(&model[1][0])), _mm_set1_ps(extent.y)));
+  result = _mm_add_ps(result, _mm_mul_ps(_mm_andnot_ps(signBit, _mm_loadu_ps(&model[2][0])), _mm_set1_ps(extent.z)));
+  return toVec3(result);
+#else
+  return glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y +
+         glm::abs(glm::vec3(model[2])) * extent.z;
+#endif
+}
+
+float getMaxScale(const glm::mat4& model) {
+#ifdef GLINT_SSE
+  __m128 x = _mm_loadu_ps(&model[0][0]);
+  __m128 y = _mm_loadu_ps(&model[1][0]);
+  __m128 z = _mm_loadu_ps(&model[2][0]);
+  __m128 w = _mm_setzero_ps();
+  x = _mm_mul_ps(x, x);
+  y = _mm_mul_ps(y, y);
+  z = _mm_mul_ps(z, z);
+  // Rows of the squared columns, summing three of them gives the squared length of each column
+  _MM_TRANSPOSE4_PS(x, y, z, w);
+  return std::sqrt(horizontalMax(_mm_add_ps(_mm_add_ps(x, y), z)));
+#else
+  return std::sqrt(std::max({glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                             glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                             glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))}));
+#endif
+}
+
+}  // namespace
+
+MeshBounds Bounds::compute(std::span<const Vertex> vertices) {
+  MeshBounds bounds;
+  bounds.box = computeBox(vertices);
+  bounds.sphere = computeSphere(vertices, bounds.box.getCenter());
+  return bounds;
+}
+
+BoundingBox Bounds::computeBox(std::span<const Vertex> vertices) {
+  BoundingBox box;
+  if (vertices.empty()) {
+    return box;
+  }
+
+#ifdef GLINT_SSE
+  // Two pairs of accumulators, the last lane collects the color's red and is dropped
+  __m128 minimum0 = loadPosition(vertices[0]);
+  __m128 maximum0 = minimum0;
+  __m128 minimum1 = minimum0;
+  __m128 maximum1 = minimum0;
+  size_t i = 1;
+  for (; i + 2 <= vertices.size(); i += 2) {
+    __m128 p0 = loadPosition(vertices[i]);
+    __m128 p1 = loadPosition(vertices[i + 1]);
+    minimum0 = _mm_min_ps(minimum0, p0);
+    maximum0 = _mm_max_ps(maximum0, p0);
+    minimum1 = _mm_min_ps(minimum1, p1);
+    maximum1 = _mm_max_ps(maximum1, p1);
+  }
+  if (i < vertices.size()) {
+    __m128 p = loadPosition(vertices[i]);
+    minimum0 = _mm_min_ps(minimum0, p);
+    maximum0 = _mm_max_ps(maximum0, p);
+  }
+  box.min = toVec3(_mm_min_ps(minimum0, minimum1));
+  box.max = toVec3(_mm_max_ps(maximum0, maximum1));
+#else
+  box.min = box.max = vertices[0].position;
+  for (const auto& vertex : vertices) {
+    box.min = glm::min(box.min, vertex.position);
+    box.max = glm::max(box.max, vertex.position);
+  }
+#endif
+  return box;
+}
+
+BoundingSphere Bounds::computeSphere(std::span<const Vertex> vertices, const glm::vec3& center) {
+  float maxDistanceSquared = 0.0f;
+  size_t i = 0;
+#ifdef GLINT_SSE
+  // Four positions at a time, transposed into x, y and z of each
+  __m128 centerX = _mm_set1_ps(center.x);
+  __m128 centerY = _mm_set1_ps(center.y);
+  __m128 centerZ = _mm_set1_ps(center.z);
+  __m128 maximum = _mm_setzero_ps();
+  for (; i + 4 <= vertices.size(); i += 4) {
+    __m128 x = loadPosition(vertices[i]);
+    __m128 y = loadPosition(vertices[i + 1]);
+    __m128 z = loadPosition(vertices[i + 2]);
+    __m128 w = loadPosition(vertices[i + 3]);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    x = _mm_sub_ps(x, centerX);
+    y = _mm_sub_ps(y, centerY);
+    z = _mm_sub_ps(z, centerZ);
+    maximum = _mm_max_ps(maximum, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+  }
+  maxDistanceSquared = horizontalMax(maximum);
+#endif
+  for (; i < vertices.size(); i++) {
+    glm::vec3 delta = vertices[i].position - center;
+    maxDistanceSquared = std::max(maxDistanceSquared, glm::dot(delta, delta));
+  }
+  return {center, std::sqrt(maxDistanceSquared)};
+}
+
+BoundingBox Bounds::transform(const BoundingBox& box, const glm::mat4& model) {
+  glm::vec3 center = transformPoint(box.getCenter(), model);
+  glm::vec3 extent = transformExtent(box.getExtent(), model);
+  return {center - extent, center + extent};
+}
+
+BoundingSphere Bounds::transform(const BoundingSphere& sphere, const glm::mat4& model) {
+  return {transformPoint(sphere.center, model), sphere.radius * getMaxScale(model)};
+}
+
+MeshBounds Bounds::transform(const MeshBounds& bounds, const glm::mat4& model) {
+  return {transform(bounds.box, model), transform(bounds.sphere, model)};
+}
+
+void Bounds::transform(std::span<const MeshBounds> bounds, std::span<const glm::mat4> models,
+                       std::span<MeshBounds> out) {
+  assert(bounds.size() == models.size() && out.size() == models.size());
+  for (size_t i = 0; i < models.size(); i++) {
+    out[i] = transform(bounds[i], models[i]);
+  }
+}
+
+void Bounds::transform(const MeshBounds& bounds, std::span<const glm::mat4> models, std::span<MeshBounds> out) {
+  assert(out.size() == models.size());
+  for (size_t i = 0; i < models.size(); i++) {
+    out[i] = transform(bounds, models[i]);
+  }
+}
+
+}  // namespace glint
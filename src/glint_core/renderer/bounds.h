@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+
+#include "vertex.h"
+
+namespace glint {
+
+struct BoundingBox {
+  glm::vec3 min{0.0f};
+  glm::vec3 max{0.0f};
+
+  glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+  // Half the size on every axis
+  glm::vec3 getExtent() const { return (max - min) * 0.5f; }
+};
+
+struct BoundingSphere {
+  glm::vec3 center{0.0f};
+  float radius = 0.0f;
+};
+
+// Model space bounds of a mesh. The box is the tighter fit for long and flat meshes, the sphere is the cheaper test
+// and its radius doesn't change under rotation.
+struct MeshBounds {
+  BoundingBox box;
+  BoundingSphere sphere;
+};
+
+// Bounding volumes of vertex data and their world space transforms, using SSE where available. Thread safe, no
+// Vulkan calls.
+class Bounds {
+ public:
+  // Box of the positions and the smallest sphere around its center holding them, zero bounds without vertices
+  static MeshBounds compute(std::span<const Vertex> vertices);
+
+  static BoundingBox computeBox(std::span<const Vertex> vertices);
+  static BoundingSphere computeSphere(std::span<const Vertex> vertices, const glm::vec3& center);
+
+  // The box enclosing the transformed box. The sphere's radius is scaled by the largest axis scale of model, so it
+  // stays conservative under non uniform scale.
+  static BoundingBox transform(const BoundingBox& box, const glm::mat4& model);
+  static BoundingSphere transform(const BoundingSphere& sphere, const glm::mat4& model);
+  static MeshBounds transform(const MeshBounds& bounds, const glm::mat4& model);
+
+  // World bounds of many objects per frame, out[i] being bounds[i] transformed by models[i]. The spans must have the
+  // same size.
+  static void transform(std::span<const MeshBounds> bounds, std::span<const glm::mat4> models,
+                        std::span<MeshBounds> out);
+  // Every instance of one mesh, out[i] being bounds transformed by models[i]
+  static void transform(const MeshBounds& bounds, std::span<const glm::mat4> models, std::span<MeshBounds> out);
+};
+
+}  // namespace glint
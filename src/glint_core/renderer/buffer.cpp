@@ -0,0 +1,144 @@
+#include "buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "defragmenter.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+Buffer::Buffer(VkContext* context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+               MemoryTag tag)
+    : m_Context(context), m_Size(size), m_Usage(usage) {
+  VK_CHECK_RESULT(VkUtils::createBuffer(size, usage, properties, m_Buffer, m_Allocation, tag));
+}
+
+Buffer::Buffer(VkContext* context, BufferUsage preset, VkDeviceSize size, MemoryTag tag)
+    : Buffer(context, size, getPresetUsage(preset), getPresetProperties(preset), tag) {}
+
+Buffer::~Buffer() { destroy(); }
+
+Buffer::Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  destroy();
+
+  // The defragmenter holds pointers to our members, register again at the new address
+  bool defragment = other.m_DefragId != 0;
+  if (defragment) {
+    other.m_Context->getDefragmenter()->unregister(other.m_DefragId);
+    other.m_DefragId = 0;
+  }
+
+  m_Context = other.m_Context;
+  m_Buffer = std::exchange(other.m_Buffer, VK_NULL_HANDLE);
+  m_Allocation = std::exchange(other.m_Allocation, {});
+  m_Size = std::exchange(other.m_Size, 0);
+  m_Usage = std::exchange(other.m_Usage, 0);
+  m_DirtyBegin = std::exchange(other.m_DirtyBegin, 0);
+  m_DirtyEnd = std::exchange(other.m_DirtyEnd, 0);
+
+  if (defragment) {
+    registerDefragmentation();
+  }
+  return *this;
+}
+
+void Buffer::write(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+  if (!isMapped()) {
+    throw std::runtime_error("Writing to a buffer that is not host visible!");
+  }
+  if (offset + size > m_Size) {
+    throw std::runtime_error("Buffer write out of range!");
+  }
+
+  memcpy(static_cast<char*>(m_Allocation.mappedData) + offset, data, static_cast<size_t>(size));
+  markDirty(offset, size);
+}
+
+void Buffer::markDirty(VkDeviceSize offset, VkDeviceSize size) {
+  if (size == VK_WHOLE_SIZE) {
+    size = m_Size - offset;
+  }
+
+  if (m_DirtyBegin >= m_DirtyEnd) {
+    m_DirtyBegin = offset;
+    m_DirtyEnd = offset + size;
+  } else {
+    m_DirtyBegin = std::min(m_DirtyBegin, offset);
+    m_DirtyEnd = std::max(m_DirtyEnd, offset + size);
+  }
+}
+
+void Buffer::flush() {
+  if (m_DirtyBegin >= m_DirtyEnd) {
+    return;
+  }
+
+  m_Context->getAllocator()->flush(m_Allocation, m_DirtyBegin, m_DirtyEnd - m_DirtyBegin);
+  m_DirtyBegin = m_DirtyEnd = 0;
+}
+
+void Buffer::enableDefragmentation() {
+  if (m_DefragId == 0 && isValid()) {
+    registerDefragmentation();
+  }
+}
+
+void Buffer::disableDefragmentation() {
+  if (m_DefragId != 0) {
+    m_Context->getDefragmenter()->unregister(m_DefragId);
+    m_DefragId = 0;
+  }
+}
+
+VkBufferUsageFlags Buffer::getPresetUsage(BufferUsage preset) {
+  // Device local buffers are also transfer sources so the defragmenter can copy them
+  switch (preset) {
+    case BufferUsage::Vertex:
+      return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    case BufferUsage::Index:
+      return VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    case BufferUsage::Uniform:
+      return VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    case BufferUsage::Storage:
+      return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    case BufferUsage::Staging:
+      return VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  }
+  return 0;
+}
+
+VkMemoryPropertyFlags Buffer::getPresetProperties(BufferUsage preset) {
+  switch (preset) {
+    case BufferUsage::Vertex:
+    case BufferUsage::Index:
+    case BufferUsage::Storage:
+      return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    case BufferUsage::Uniform:
+    case BufferUsage::Staging:
+      return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  }
+  return 0;
+}
+
+void Buffer::destroy() {
+  disableDefragmentation();
+  if (m_Buffer != VK_NULL_HANDLE) {
+    VkUtils::destroyBuffer(m_Buffer, m_Allocation);
+  }
+}
+
+void Buffer::registerDefragmentation() {
+  m_DefragId = m_Context->getDefragmenter()->registerBuffer(&m_Buffer, &m_Allocation, m_Size, m_Usage);
+}
+
+}  // namespace glint
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "memory_allocator.h"
+
+namespace glint {
+
+class VkContext;
+
+// Common buffer configurations, see Buffer::getPresetUsage / getPresetProperties
+enum class BufferUsage { Vertex, Index, Uniform, Storage, Staging };
+
+// RAII wrapper around a VkBuffer and its sub-allocation.
+// Host visible buffers stay mapped for their whole lifetime. Writes mark a dirty range which flush() hands to the
+// allocator, so only the bytes that changed are flushed (expanded to nonCoherentAtomSize, no-op for coherent memory).
+class Buffer {
+ public:
+  Buffer() = default;
+  Buffer(VkContext* context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+         MemoryTag tag = MemoryTag::Unknown);
+  Buffer(VkContext* context, BufferUsage preset, VkDeviceSize size, MemoryTag tag = MemoryTag::Unknown);
+  ~Buffer();
+
+  // Prevent copying
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  Buffer(Buffer&& other) noexcept;
+  Buffer& operator=(Buffer&& other) noexcept;
+
+  // Copy into the mapped memory and mark the range dirty
+  void write(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+  // Mark a range written through getMappedData() as dirty
+  void markDirty(VkDeviceSize offset, VkDeviceSize size);
+
+  // Flush the dirty range and reset it
+  void flush();
+
+  // Let the defragmenter move this buffer, only for device local buffers bound at record time. Disable it while
+  // uploads write the buffer, they would be lost if they landed after a pending move copied it.
+  void enableDefragmentation();
+  void disableDefragmentation();
+
+  VkBuffer getBuffer() const { return m_Buffer; }
+  VkDeviceSize getSize() const { return m_Size; }
+  VkBufferUsageFlags getUsage() const { return m_Usage; }
+  const Allocation& getAllocation() const { return m_Allocation; }
+  void* getMappedData() const { return m_Allocation.mappedData; }
+  bool isMapped() const { return m_Allocation.mappedData != nullptr; }
+  bool isValid() const { return m_Buffer != VK_NULL_HANDLE; }
+
+  VkDescriptorBufferInfo getDescriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const {
+    return {m_Buffer, offset, size};
+  }
+
+  static VkBufferUsageFlags getPresetUsage(BufferUsage preset);
+  static VkMemoryPropertyFlags getPresetProperties(BufferUsage preset);
+
+ private:
+  void destroy();
+  void registerDefragmentation();
+
+ private:
+  VkContext* m_Context = nullptr;
+
+  VkBuffer m_Buffer = VK_NULL_HANDLE;
+  Allocation m_Allocation;
+  VkDeviceSize m_Size = 0;
+  VkBufferUsageFlags m_Usage = 0;
+
+  // Dirty byte range [m_DirtyBegin, m_DirtyEnd), empty when begin >= end
+  VkDeviceSize m_DirtyBegin = 0;
+  VkDeviceSize m_DirtyEnd = 0;
+
+  uint32_t m_DefragId = 0;
+};
+
+}  // namespace glint
@@ -0,0 +1,453 @@
+#include "defragmenter.h"
+
+#include <algorithm>
+
+#include "core/config.h"
+#include "core/logger.h"
+#include "deletion_queue.h"
+#include "vk_context.h"
+#include "vk_tools.h"
+
+namespace glint {
+
+namespace {
+
+// Frames between looking for a block to empty
+constexpr uint64_t kCheckInterval = 120;
+
+// Only blocks used below this ratio are emptied
+constexpr float kMaxSourceUsage = 0.5f;
+
+VkImageMemoryBarrier imageBarrier(VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels,
+                                  VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask,
+                                  VkAccessFlags dstAccessMask) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = aspectMask;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  return barrier;
+}
+
+VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkDeviceSize size, VkAccessFlags srcAccessMask,
+                                    VkAccessFlags dstAccessMask) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = size;
+  return barrier;
+}
+
+// Reads of a moved buffer by the frames recorded after the commit
+void getBufferReads(VkBufferUsageFlags usage, VkPipelineStageFlags& stages, VkAccessFlags& access) {
+  if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+    stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    access |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  }
+  if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+    stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    access |= VK_ACCESS_INDEX_READ_BIT;
+  }
+  if (usage & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)) {
+    stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    access |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) {
+    stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    access |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  }
+}
+
+}  // namespace
+
+Defragmenter::Defragmenter(VkContext* context, VkDeviceSize bytesPerFrame)
+    : m_Context(context), m_BytesPerFrame(bytesPerFrame) {
+  LOGFN;
+  m_Enabled = !Config::isOptionSet("disable_defrag");
+  LOG("Defragmentation", m_Enabled ? "enabled," : "disabled,", m_BytesPerFrame, "bytes per frame");
+
+  auto device = m_Context->getDevice();
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = m_Context->getQueueFamilyIndices().graphicsFamily.value();
+  VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &m_CommandPool));
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = m_CommandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &m_CommandBuffer));
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &m_Fence));
+}
+
+Defragmenter::~Defragmenter() {
+  LOGFN;
+  auto device = m_Context->getDevice();
+
+  if (!m_Moves.empty()) {
+    vkWaitForFences(device, 1, &m_Fence, VK_TRUE, UINT64_MAX);
+    for (auto& move : m_Moves) {
+      destroyMoveTarget(move);
+    }
+    m_Moves.clear();
+  }
+
+  if (!m_Resources.empty()) {
+    LOG("[WARNING] Defragmenter destroyed with", m_Resources.size(), "registered resources");
+  }
+
+  vkDestroyFence(device, m_Fence, nullptr);
+  vkDestroyCommandPool(device, m_CommandPool, nullptr);
+
+  LOG("Defragmentation moved", m_Stats.movedResources, "resources,", m_Stats.movedBytes, "bytes, released",
+      m_Stats.releasedBlocks, "blocks");
+}
+
+uint32_t Defragmenter::registerBuffer(VkBuffer* buffer, Allocation* allocation, VkDeviceSize size,
+                                      VkBufferUsageFlags usage, MovedCallback onMoved) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Resource resource;
+  resource.buffer = buffer;
+  resource.allocation = allocation;
+  resource.size = size;
+  resource.usage = usage;
+  resource.onMoved = std::move(onMoved);
+
+  uint32_t id = m_NextId++;
+  m_Resources.emplace(id, std::move(resource));
+  return id;
+}
+
+uint32_t Defragmenter::registerImage(VkImage* image, Allocation* allocation, const VkImageCreateInfo& imageInfo,
+                                     VkImageLayout layout, VkImageAspectFlags aspectMask, MovedCallback onMoved) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Resource resource;
+  resource.image = image;
+  resource.allocation = allocation;
+  resource.imageInfo = imageInfo;
+  resource.layout = layout;
+  resource.aspectMask = aspectMask;
+  resource.onMoved = std::move(onMoved);
+
+  uint32_t id = m_NextId++;
+  m_Resources.emplace(id, std::move(resource));
+  return id;
+}
+
+void Defragmenter::unregister(uint32_t id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Resources.erase(id);
+
+  // The owner is about to destroy the resource, a pending copy may still be reading from it
+  bool pending = std::any_of(m_Moves.begin(), m_Moves.end(), [id](const Move& move) { return move.id == id; });
+  if (pending) {
+    vkWaitForFences(m_Context->getDevice(), 1, &m_Fence, VK_TRUE, UINT64_MAX);
+  }
+}
+
+bool Defragmenter::update() {
+  if (!m_Enabled) {
+    return false;
+  }
+  m_FrameCounter++;
+
+  if (!m_Moves.empty()) {
+    if (vkGetFenceStatus(m_Context->getDevice(), m_Fence) != VK_SUCCESS) {
+      return false;
+    }
+    commitMoves();
+    return true;
+  }
+
+  {
+    // The source block still holds the resources of the last batch until frames in flight are done with them
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_ReleasePending) {
+      return false;
+    }
+  }
+
+  auto allocator = m_Context->getAllocator();
+  if (!allocator->getMoveSource()) {
+    if (m_FrameCounter % kCheckInterval != 0 || !allocator->beginDefragmentation(kMaxSourceUsage)) {
+      return false;
+    }
+  }
+
+  startMoves();
+  return false;
+}
+
+Defragmenter::Stats Defragmenter::getStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Stats;
+}
+
+bool Defragmenter::startMoves() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto allocator = m_Context->getAllocator();
+  MemoryBlock* source = allocator->getMoveSource();
+
+  std::vector<uint32_t> candidates;
+  for (const auto& [id, resource] : m_Resources) {
+    if (resource.allocation->block == source) {
+      candidates.push_back(id);
+    }
+  }
+
+  // The block also holds resources nobody registered, it can never be emptied
+  if (candidates.size() < allocator->getMoveSourceAllocationCount()) {
+    allocator->endDefragmentation(true);
+    return false;
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkResetCommandBuffer(m_CommandBuffer, 0));
+  VK_CHECK_RESULT(vkBeginCommandBuffer(m_CommandBuffer, &beginInfo));
+
+  VkDeviceSize batchBytes = 0;
+  for (uint32_t id : candidates) {
+    const Resource& resource = m_Resources[id];
+    if (batchBytes > 0 && batchBytes + resource.allocation->size > m_BytesPerFrame) {
+      break;
+    }
+
+    Move move;
+    move.id = id;
+    bool created = resource.buffer ? createBufferCopy(resource, move) : createImageCopy(resource, move);
+    if (!created) {
+      break;
+    }
+
+    if (resource.buffer) {
+      recordBufferCopy(resource, move);
+    } else {
+      recordImageCopy(resource, move);
+    }
+
+    batchBytes += resource.allocation->size;
+    m_Moves.push_back(move);
+  }
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(m_CommandBuffer));
+
+  // Nothing fits in the other blocks anymore, try again later
+  if (m_Moves.empty()) {
+    allocator->endDefragmentation(false);
+    return false;
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &m_CommandBuffer;
+
+  VK_CHECK_RESULT(vkResetFences(m_Context->getDevice(), 1, &m_Fence));
+  VK_CHECK_RESULT(vkQueueSubmit(m_Context->getGraphicsQueue(), 1, &submitInfo, m_Fence));
+  return true;
+}
+
+void Defragmenter::commitMoves() {
+  LOGFN;
+  auto device = m_Context->getDevice();
+  auto allocator = m_Context->getAllocator();
+  std::vector<MovedCallback> callbacks;
+
+  // Frames in flight may still reference the old resources, they are released once those frames have completed
+  std::vector<VkBuffer> oldBuffers;
+  std::vector<VkImage> oldImages;
+  std::vector<Allocation> oldAllocations;
+
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto& move : m_Moves) {
+      auto it = m_Resources.find(move.id);
+      if (it == m_Resources.end()) {
+        // Destroyed by its owner while the copy was in flight
+        destroyMoveTarget(move);
+        continue;
+      }
+
+      Resource& resource = it->second;
+      m_Stats.movedResources++;
+      m_Stats.movedBytes += resource.allocation->size;
+
+      if (resource.buffer) {
+        oldBuffers.push_back(*resource.buffer);
+        *resource.buffer = move.buffer;
+      } else {
+        oldImages.push_back(*resource.image);
+        *resource.image = move.image;
+      }
+      oldAllocations.push_back(*resource.allocation);
+      *resource.allocation = move.allocation;
+
+      if (resource.onMoved) {
+        callbacks.push_back(resource.onMoved);
+      }
+    }
+    m_Moves.clear();
+    m_ReleasePending = true;
+  }
+
+  m_Context->getDeletionQueue()->retire([this, device, allocator, oldBuffers, oldImages, oldAllocations]() mutable {
+    for (VkBuffer buffer : oldBuffers) {
+      vkDestroyBuffer(device, buffer, nullptr);
+    }
+    for (VkImage image : oldImages) {
+      vkDestroyImage(device, image, nullptr);
+    }
+    for (auto& allocation : oldAllocations) {
+      allocator->free(allocation);
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_ReleasePending = false;
+    if (!allocator->getMoveSource()) {
+      m_Stats.releasedBlocks++;
+      LOG("Defragmentation released a memory block");
+    }
+  });
+
+  // Owners rebuild views and descriptors for the frames recorded from now on. They may call back into the
+  // defragmenter, so notify them outside the lock.
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
+bool Defragmenter::createBufferCopy(const Resource& resource, Move& move) {
+  auto device = m_Context->getDevice();
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = resource.size;
+  bufferInfo.usage = resource.usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  VK_CHECK_RESULT(vkCreateBuffer(device, &bufferInfo, nullptr, &move.buffer));
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, move.buffer, &memRequirements);
+
+  if (!m_Context->getAllocator()->allocateForMove(memRequirements, *resource.allocation, move.allocation)) {
+    vkDestroyBuffer(device, move.buffer, nullptr);
+    return false;
+  }
+
+  VK_CHECK_RESULT(vkBindBufferMemory(device, move.buffer, move.allocation.memory, move.allocation.offset));
+  return true;
+}
+
+bool Defragmenter::createImageCopy(const Resource& resource, Move& move) {
+  auto device = m_Context->getDevice();
+
+  VkImageCreateInfo imageInfo = resource.imageInfo;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &move.image));
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, move.image, &memRequirements);
+
+  if (!m_Context->getAllocator()->allocateForMove(memRequirements, *resource.allocation, move.allocation)) {
+    vkDestroyImage(device, move.image, nullptr);
+    return false;
+  }
+
+  VK_CHECK_RESULT(vkBindImageMemory(device, move.image, move.allocation.memory, move.allocation.offset));
+  return true;
+}
+
+void Defragmenter::recordBufferCopy(const Resource& resource, const Move& move) {
+  // Earlier submissions, e.g. uploads, may have written the source
+  auto toTransfer = bufferBarrier(*resource.buffer, resource.size, VK_ACCESS_MEMORY_WRITE_BIT,
+                                  VK_ACCESS_TRANSFER_READ_BIT);
+  vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                       nullptr, 1, &toTransfer, 0, nullptr);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.size = resource.size;
+  vkCmdCopyBuffer(m_CommandBuffer, *resource.buffer, move.buffer, 1, &copyRegion);
+
+  // Make the copy visible to the frames that read the new buffer once the moves are committed
+  VkPipelineStageFlags dstStages = 0;
+  VkAccessFlags dstAccess = 0;
+  getBufferReads(resource.usage, dstStages, dstAccess);
+  if (dstStages == 0) {
+    dstStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    dstAccess = VK_ACCESS_MEMORY_READ_BIT;
+  }
+  auto toRead = bufferBarrier(move.buffer, resource.size, VK_ACCESS_TRANSFER_WRITE_BIT, dstAccess);
+  vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 0, nullptr, 1, &toRead, 0,
+                       nullptr);
+}
+
+void Defragmenter::recordImageCopy(const Resource& resource, const Move& move) {
+  uint32_t mipLevels = resource.imageInfo.mipLevels;
+  VkImage source = *resource.image;
+
+  VkImageMemoryBarrier toTransfer[2] = {
+      imageBarrier(source, resource.aspectMask, mipLevels, resource.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+      imageBarrier(move.image, resource.aspectMask, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT)};
+  vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                       nullptr, 0, nullptr, 2, toTransfer);
+
+  std::vector<VkImageCopy> regions(mipLevels);
+  for (uint32_t mip = 0; mip < mipLevels; mip++) {
+    VkImageCopy& region = regions[mip];
+    region.srcSubresource = {resource.aspectMask, mip, 0, 1};
+    region.dstSubresource = {resource.aspectMask, mip, 0, 1};
+    region.extent.width = std::max(1u, resource.imageInfo.extent.width >> mip);
+    region.extent.height = std::max(1u, resource.imageInfo.extent.height >> mip);
+    region.extent.depth = 1;
+  }
+  vkCmdCopyImage(m_CommandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.image,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+
+  // Frames recorded before the commit still use the old image, put it back as well
+  VkImageMemoryBarrier toShader[2] = {
+      imageBarrier(source, resource.aspectMask, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resource.layout,
+                   VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT),
+      imageBarrier(move.image, resource.aspectMask, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, resource.layout,
+                   VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT)};
+  vkCmdPipelineBarrier(m_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+                       nullptr, 0, nullptr, 2, toShader);
+}
+
+void Defragmenter::destroyMoveTarget(Move& move) {
+  if (move.buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(m_Context->getDevice(), move.buffer, nullptr);
+  }
+  if (move.image != VK_NULL_HANDLE) {
+    vkDestroyImage(m_Context->getDevice(), move.image, nullptr);
+  }
+  m_Context->getAllocator()->free(move.allocation);
+}
+
+}  // namespace glint
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "memory_allocator.h"
+
+namespace glint {
+
+class VkContext;
+
+// Incremental device memory defragmenter. Resources that can be relocated register their handle and allocation, the
+// defragmenter then empties sparse blocks by copying those resources into other blocks on the GPU, a bounded number
+// of bytes per frame. Once a batch of copies has completed the resources are swapped to their new handles at a frame
+// boundary and their owners are notified so views and descriptors can be rebuilt. The old handles and memory are
+// retired to the DeletionQueue and released after the frames in flight that may still use them.
+class Defragmenter {
+ public:
+  using MovedCallback = std::function<void()>;
+
+  struct Stats {
+    uint32_t movedResources = 0;
+    VkDeviceSize movedBytes = 0;
+    uint32_t releasedBlocks = 0;
+  };
+
+  Defragmenter(VkContext* context, VkDeviceSize bytesPerFrame);
+  ~Defragmenter();
+
+  // Prevent copying
+  Defragmenter(const Defragmenter&) = delete;
+  Defragmenter& operator=(const Defragmenter&) = delete;
+
+  // Register a resource that may be moved. The handle and allocation are updated in place when it moves, so they
+  // must stay at the same address until unregistered. Buffers need VK_BUFFER_USAGE_TRANSFER_SRC_BIT and images
+  // VK_IMAGE_USAGE_TRANSFER_SRC_BIT, images are expected in layout for all mip levels.
+  uint32_t registerBuffer(VkBuffer* buffer, Allocation* allocation, VkDeviceSize size, VkBufferUsageFlags usage,
+                          MovedCallback onMoved = nullptr);
+  uint32_t registerImage(VkImage* image, Allocation* allocation, const VkImageCreateInfo& imageInfo,
+                         VkImageLayout layout, VkImageAspectFlags aspectMask, MovedCallback onMoved = nullptr);
+  void unregister(uint32_t id);
+
+  // Advance defragmentation by one step, called once per frame after the frame fence wait.
+  // Returns true if resources were moved, recorded command buffers referencing them are stale then.
+  bool update();
+
+  Stats getStats() const;
+
+ private:
+  struct Resource {
+    VkBuffer* buffer = nullptr;
+    VkImage* image = nullptr;
+    Allocation* allocation = nullptr;
+    VkDeviceSize size = 0;
+    VkBufferUsageFlags usage = 0;
+    VkImageCreateInfo imageInfo{};
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageAspectFlags aspectMask = 0;
+    MovedCallback onMoved;
+  };
+
+  struct Move {
+    uint32_t id = 0;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    Allocation allocation;
+  };
+
+  bool startMoves();
+  void commitMoves();
+
+  bool createBufferCopy(const Resource& resource, Move& move);
+  bool createImageCopy(const Resource& resource, Move& move);
+  void recordBufferCopy(const Resource& resource, const Move& move);
+  void recordImageCopy(const Resource& resource, const Move& move);
+  void destroyMoveTarget(Move& move);
+
+ private:
+  VkContext* m_Context;
+  VkDeviceSize m_BytesPerFrame;
+  bool m_Enabled = true;
+  uint64_t m_FrameCounter = 0;
+
+  VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+  VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+  VkFence m_Fence = VK_NULL_HANDLE;
+
+  std::unordered_map<uint32_t, Resource> m_Resources;
+  uint32_t m_NextId = 1;
+
+  // Copies submitted and waiting on m_Fence
+  std::vector<Move> m_Moves;
+  // The last committed batch's old resources are not released yet, no new batch starts until they are
+  bool m_ReleasePending = false;
+
+  Stats m_Stats;
+  mutable std::mutex m_Mutex;
+};
+
+}  // namespace glint
@@ -0,0 +1,39 @@
+#include "deletion_queue.h"
+
+#include <algorithm>
+
+namespace glint {
+
+DeletionQueue::~DeletionQueue() {
+  for (auto& retired : m_Retired) {
+    retired.deleter();
+  }
+}
+
+void DeletionQueue::retire(Deleter deleter) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Retired.push_back({std::move(deleter), m_FrameCounter});
+}
+
+void DeletionQueue::update(uint32_t framesInFlight) {
+  std::vector<Deleter> deleters;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_FrameCounter++;
+    auto pending = [this, framesInFlight](const Retired& retired) {
+      return retired.frame + framesInFlight >= m_FrameCounter;
+    };
+    auto it = std::stable_partition(m_Retired.begin(), m_Retired.end(), pending);
+    for (auto completed = it; completed != m_Retired.end(); ++completed) {
+      deleters.push_back(std::move(completed->deleter));
+    }
+    m_Retired.erase(it, m_Retired.end());
+  }
+
+  // Deleters may retire more resources, so run them outside the lock
+  for (auto& deleter : deleters) {
+    deleter();
+  }
+}
+
+}  // namespace glint
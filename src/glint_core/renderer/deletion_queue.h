@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace glint {
+
+// Defers destroying resources that frames in flight may still use. A retired resource's deleter runs once the frames
+// submitted up to the retirement have completed, instead of waiting for the queue to go idle. Owned by the VkContext,
+// remaining deleters run when it is destroyed, after the device went idle.
+class DeletionQueue {
+ public:
+  using Deleter = std::function<void()>;
+
+  DeletionQueue() = default;
+  ~DeletionQueue();
+
+  // Prevent copying
+  DeletionQueue(const DeletionQueue&) = delete;
+  DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+  void retire(Deleter deleter);
+
+  // Run the deleters no frame in flight can reference anymore, called once per frame after the frame fence wait
+  void update(uint32_t framesInFlight);
+
+ private:
+  struct Retired {
+    Deleter deleter;
+    uint64_t frame = 0;
+  };
+
+  std::vector<Retired> m_Retired;
+  uint64_t m_FrameCounter = 0;
+  std::mutex m_Mutex;
+};
+
+}  // namespace glint
@@ -0,0 +1,154 @@
+#include "depth_pyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/logger.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+namespace {
+
+uint32_t nextPowerOfTwo(uint32_t value) {
+  uint32_t power = 1;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+VkExtent2D getPyramidExtent(VkExtent2D depthExtent) {
+  return {std::max(1u, nextPowerOfTwo(depthExtent.width) / 2), std::max(1u, nextPowerOfTwo(depthExtent.height) / 2)};
+}
+
+uint32_t getPyramidLevels(VkExtent2D extent) {
+  uint32_t mipLevels = 1;
+  while ((std::max(extent.width, extent.height) >> mipLevels) > 0) {
+    mipLevels++;
+  }
+  return mipLevels;
+}
+
+}  // namespace
+
+DepthPyramid::DepthPyramid(VkContext* context, VkImage depthImage, VkFormat depthFormat, VkExtent2D depthExtent,
+                           VkSampleCountFlagBits depthSamples, MipReduction reduction, VkImage image)
+    : m_Context(context) {
+  LOGFN;
+  if (reduction == MipReduction::Average) {
+    throw std::runtime_error("A depth pyramid keeps the min or max depth!");
+  }
+
+  m_Extent = getPyramidExtent(depthExtent);
+  m_MipLevels = getPyramidLevels(m_Extent);
+
+  MipDownsampler* downsampler = m_Context->getMipDownsampler();
+  if (!downsampler->isSupported(VK_FORMAT_R32_SFLOAT, m_Extent, m_MipLevels)) {
+    throw std::runtime_error("Depth pyramid of " + std::to_string(depthExtent.width) + "x" +
+                             std::to_string(depthExtent.height) + " is not supported!");
+  }
+
+  m_Image = image;
+  if (m_Image == VK_NULL_HANDLE) {
+    VkImageCreateInfo imageInfo = getImageInfo(depthExtent);
+    VkUtils::createImage(m_Extent.width, m_Extent.height, m_MipLevels, imageInfo.samples, imageInfo.format,
+                         imageInfo.tiling, imageInfo.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Image,
+                         m_ImageAllocation, MemoryTag::Texture);
+    VkUtils::setObjectName(m_Image, VK_OBJECT_TYPE_IMAGE, "Depth Pyramid");
+  }
+  m_ImageView = VkUtils::createImageView(m_Image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, m_MipLevels);
+
+  // Texels are looked up at an explicit level
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = static_cast<float>(m_MipLevels);
+  if (vkCreateSampler(m_Context->getDevice(), &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create depth pyramid sampler!");
+  }
+
+  // Texels past the depth buffer never hold the farthest (or nearest) depth
+  MipDownsampleConfig config;
+  config.source = depthImage;
+  config.sourceFormat = depthFormat;
+  config.sourceAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  config.sourceExtent = depthExtent;
+  config.sourceSamples = depthSamples;
+  config.destination = m_Image;
+  config.destinationFormat = VK_FORMAT_R32_SFLOAT;
+  config.destinationExtent = m_Extent;
+  config.levelCount = m_MipLevels;
+  config.reduction = reduction;
+  config.padded = true;
+  config.fill.float32[0] = reduction == MipReduction::Max ? 0.0f : 1.0f;
+  m_Target = std::make_unique<MipDownsampler::Target>(downsampler, config);
+
+  LOG("Depth pyramid created:", m_Extent.width, "x", m_Extent.height, ",", m_MipLevels, "levels");
+}
+
+DepthPyramid::~DepthPyramid() {
+  LOGFN;
+  m_Target.reset();
+  vkDestroySampler(m_Context->getDevice(), m_Sampler, nullptr);
+  vkDestroyImageView(m_Context->getDevice(), m_ImageView, nullptr);
+  if (m_ImageAllocation.isValid()) {
+    VkUtils::destroyImage(m_Image, m_ImageAllocation);
+  }
+}
+
+VkImageCreateInfo DepthPyramid::getImageInfo(VkExtent2D depthExtent) {
+  VkExtent2D extent = getPyramidExtent(depthExtent);
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = getPyramidLevels(extent);
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return imageInfo;
+}
+
+void DepthPyramid::build(VkCommandBuffer commandBuffer) {
+  LOGFN_ONCE;
+  // Every level is rewritten, the previous contents are dropped once last frame's readers are done. An attachment
+  // aliasing the image was written by the render pass just before.
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.image = m_Image;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, m_MipLevels, 0, 1};
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  m_Target->record(commandBuffer);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+}  // namespace glint
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+#include "memory_allocator.h"
+#include "mip_downsampler.h"
+
+namespace glint {
+
+class VkContext;
+
+// Hierarchical depth buffer for occlusion culling. Level 0 is half the depth buffer rounded up to a power of two, so
+// every texel covers exactly the 2x2 texels below it, and holds their farthest depth (Max, for a LESS depth test) or
+// nearest one (Min, reversed depth). Texels past the depth buffer's edge are neutral. Rebuilt every frame by a single
+// MipDownsampler dispatch.
+class DepthPyramid {
+ public:
+  // depthImage has VK_IMAGE_USAGE_SAMPLED_BIT and is at most 4096 texels a side, the samples of a multisampled one
+  // are reduced with the texels. Recreate the pyramid when it is resized.
+  // image holds the levels when given, created from getImageInfo() by the caller, e.g. aliased with an attachment
+  // that is only live inside the render pass, see SwapChain. The pyramid then only lasts until that pass begins.
+  // Otherwise the pyramid allocates its own image.
+  DepthPyramid(VkContext* context, VkImage depthImage, VkFormat depthFormat, VkExtent2D depthExtent,
+               VkSampleCountFlagBits depthSamples, MipReduction reduction = MipReduction::Max,
+               VkImage image = VK_NULL_HANDLE);
+  ~DepthPyramid();
+
+  // Prevent copying
+  DepthPyramid(const DepthPyramid&) = delete;
+  DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+  // Record the rebuild after the depth pass, outside of a render pass, with the depth image in
+  // SHADER_READ_ONLY_OPTIMAL layout. Leaves every level in SHADER_READ_ONLY_OPTIMAL for compute and fragment shaders.
+  void build(VkCommandBuffer commandBuffer);
+
+  // All levels, sample with getSampler() and textureLod or fetch with texelFetch
+  VkImageView getImageView() const { return m_ImageView; }
+  VkSampler getSampler() const { return m_Sampler; }
+  VkExtent2D getExtent() const { return m_Extent; }
+  uint32_t getMipLevels() const { return m_MipLevels; }
+
+  // The image holding the pyramid of a depth buffer of depthExtent
+  static VkImageCreateInfo getImageInfo(VkExtent2D depthExtent);
+
+ private:
+  VkContext* m_Context;
+
+  VkExtent2D m_Extent = {0, 0};
+  uint32_t m_MipLevels = 0;
+
+  VkImage m_Image = VK_NULL_HANDLE;
+  // Invalid when the image is owned by the caller
+  Allocation m_ImageAllocation;
+  VkImageView m_ImageView = VK_NULL_HANDLE;
+  VkSampler m_Sampler = VK_NULL_HANDLE;
+
+  std::unique_ptr<MipDownsampler::Target> m_Target;
+};
+
+}  // namespace glint
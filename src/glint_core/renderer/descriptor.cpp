@@ -1,5 +1,7 @@
 #include "descriptor.h"
 
+#include <algorithm>
+#include <cassert>
 #include <stdexcept>
 
 #include "core/logger.h"
@@ -156,6 +158,23 @@ Descriptor::~Descriptor() {
 void Descriptor::updateUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset,
                                      uint32_t setIndex) {
   LOGFN_ONCE;
+  writeBuffer(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer, size, offset, setIndex);
+}
+
+void Descriptor::updateDynamicUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range,
+                                            uint32_t setIndex) {
+  LOGFN_ONCE;
+  writeBuffer(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, buffer, range, 0, setIndex);
+}
+
+void Descriptor::updateStorageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset,
+                                     uint32_t setIndex) {
+  LOGFN_ONCE;
+  writeBuffer(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer, size, offset, setIndex);
+}
+
+void Descriptor::writeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize size,
+                             VkDeviceSize offset, uint32_t setIndex) {
   if (setIndex >= m_DescriptorSets.size()) {
     throw std::runtime_error("Descriptor set index out of bounds!");
   }
@@ -173,7 +192,7 @@ void Descriptor::updateUniformBuffer(uint32_t binding, VkBuffer buffer, VkDevice
   descriptorWrite.dstSet = m_DescriptorSets[setIndex];
   descriptorWrite.dstBinding = binding;  // Binding point in the shader
   descriptorWrite.dstArrayElement = 0;
-  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorWrite.descriptorType = type;
   descriptorWrite.descriptorCount = 1;
   descriptorWrite.pBufferInfo = &bufferInfo;
 
@@ -207,14 +226,39 @@ void Descriptor::updateTextureSampler(uint32_t binding, VkImageView imageView, V
   vkUpdateDescriptorSets(m_Context->getDevice(), 1, &descriptorWrite, 0, nullptr);
 }
 
+void Descriptor::updateStorageImages(uint32_t binding, const std::vector<VkImageView>& imageViews,
+                                     uint32_t setIndex) {
+  LOGFN_ONCE;
+  if (setIndex >= m_DescriptorSets.size()) {
+    throw std::runtime_error("Descriptor set index out of bounds!");
+  }
+
+  std::vector<VkDescriptorImageInfo> imageInfos(imageViews.size());
+  for (size_t i = 0; i < imageViews.size(); i++) {
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfos[i].imageView = imageViews[i];
+  }
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = m_DescriptorSets[setIndex];
+  descriptorWrite.dstBinding = binding;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+  descriptorWrite.pImageInfo = imageInfos.data();
+
+  vkUpdateDescriptorSets(m_Context->getDevice(), 1, &descriptorWrite, 0, nullptr);
+}
+
 void Descriptor::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex,
-                      uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets) {
+                      uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets, VkPipelineBindPoint bindPoint) {
   LOGFN_ONCE;
   if (setIndex >= m_DescriptorSets.size()) {
     throw std::runtime_error("Descriptor set index out of bounds!");
   }
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+  vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout,
                           0,  // First set
                           1,  // Set count
                           &m_DescriptorSets[setIndex], dynamicOffsetCount, pDynamicOffsets);
@@ -224,42 +268,70 @@ void Descriptor::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLa
 // UniformBuffer
 
 UniformBuffer::UniformBuffer(VkContext* context, size_t size, VkMemoryPropertyFlags properties)
-    : m_Context(context), m_MappedData(nullptr) {
+    : m_Buffer(context, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, properties, MemoryTag::Uniform) {
   LOGFN;
+  m_Descriptor = m_Buffer.getDescriptorInfo(size);
+  LOG("Created uniform buffer of size", size, "bytes");
+}
 
-  VK_CHECK_RESULT(VkUtils::createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, properties, m_Buffer, m_Memory));
-
-  // Map memory persistently for the lifetime of the buffer
-  // TODO: Find out if this is good practice, or should i bind and unbind memory when updating
-  VK_CHECK_RESULT(vkMapMemory(m_Context->getDevice(), m_Memory, 0, size, 0, &m_MappedData));
+UniformBuffer::~UniformBuffer() { LOGFN; }
 
-  m_Descriptor.buffer = m_Buffer;
-  m_Descriptor.offset = 0;
-  m_Descriptor.range = size;
+void UniformBuffer::update(const void* data) { update(data, m_Buffer.getSize()); }
 
-  m_BufferSize = size;
-  LOG("Created uniform buffer of size", size, "bytes");
+void UniformBuffer::update(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+  if (m_Buffer.isMapped()) {
+    m_Buffer.write(data, size, offset);
+    m_Buffer.flush();
+  }
 }
 
-UniformBuffer::~UniformBuffer() {
+///////////////////////////////////////////////////////////////////////////
+// UniformRingBuffer
+
+UniformRingBuffer::UniformRingBuffer(VkContext* context, VkDeviceSize frameSize, uint32_t framesInFlight)
+    : m_FramesInFlight(framesInFlight) {
   LOGFN;
-  if (m_MappedData) {
-    vkUnmapMemory(m_Context->getDevice(), m_Memory);
-  }
 
-  if (m_Buffer != VK_NULL_HANDLE) {
-    vkDestroyBuffer(m_Context->getDevice(), m_Buffer, nullptr);
-  }
+  // Offsets have to satisfy the dynamic offset alignment, and flushes the atom size
+  auto limits = context->getPhysicalDeviceProperties().limits;
+  m_Alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+  m_Alignment = std::max<VkDeviceSize>(m_Alignment, 1);
+  m_FrameSize = (frameSize + m_Alignment - 1) / m_Alignment * m_Alignment;
 
-  if (m_Memory != VK_NULL_HANDLE) {
-    vkFreeMemory(m_Context->getDevice(), m_Memory, nullptr);
-  }
+  m_Buffer = Buffer(context, BufferUsage::Uniform, m_FrameSize * m_FramesInFlight, MemoryTag::Uniform);
+  VkUtils::setObjectName(m_Buffer.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Uniform Ring Buffer");
+
+  LOG("Created uniform ring buffer with", m_FramesInFlight, "segments of", m_FrameSize, "bytes, alignment",
+      m_Alignment);
+}
+
+UniformRingBuffer::~UniformRingBuffer() { LOGFN; }
+
+void UniformRingBuffer::beginFrame(uint32_t frameIndex) {
+  assert(frameIndex < m_FramesInFlight);
+  m_FrameBegin = frameIndex * m_FrameSize;
+  m_Head = m_FrameBegin;
+}
+
+uint32_t UniformRingBuffer::push(const void* data, VkDeviceSize size) {
+  uint32_t dynamicOffset = 0;
+  void* dst = allocate(size, dynamicOffset);
+  memcpy(dst, data, static_cast<size_t>(size));
+  return dynamicOffset;
 }
 
-void UniformBuffer::update(const void* data) {
-  if (m_MappedData) {
-    memcpy(m_MappedData, data, m_BufferSize);
+void* UniformRingBuffer::allocate(VkDeviceSize size, uint32_t& dynamicOffset) {
+  VkDeviceSize offset = (m_Head + m_Alignment - 1) / m_Alignment * m_Alignment;
+  if (offset + size > m_FrameBegin + m_FrameSize) {
+    throw std::runtime_error("Uniform ring buffer segment overflow, increase uniform_ring_kb!");
   }
+
+  m_Head = offset + size;
+  m_Buffer.markDirty(offset, size);
+  dynamicOffset = static_cast<uint32_t>(offset);
+  return static_cast<char*>(m_Buffer.getMappedData()) + offset;
 }
 
-}  // namespace glint
\ No newline at end of file
+void UniformRingBuffer::flush() { m_Buffer.flush(); }
+
+}  // namespace glint
@@ -5,6 +5,8 @@
 #include <memory>
 #include <vector>
 
+#include "buffer.h"
+
 namespace glint {
 
 class VkContext;
@@ -24,11 +26,26 @@ class DescriptorSetLayout {
       return addBinding(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stageFlags);
     }
 
+    // Add dynamic uniform buffer binding convenience method, used with UniformRingBuffer offsets
+    Builder& addDynamicUniformBuffer(uint32_t binding, VkShaderStageFlags stageFlags) {
+      return addBinding(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, stageFlags);
+    }
+
+    // Add storage buffer binding convenience method
+    Builder& addStorageBuffer(uint32_t binding, VkShaderStageFlags stageFlags) {
+      return addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stageFlags);
+    }
+
     // Add texture sampler binding convenience method
     Builder& addTextureSampler(uint32_t binding, VkShaderStageFlags stageFlags, uint32_t count = 1) {
       return addBinding(binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, stageFlags, count);
     }
 
+    // Add storage image binding convenience method, e.g. one element per mip level written by a compute pass
+    Builder& addStorageImage(uint32_t binding, VkShaderStageFlags stageFlags, uint32_t count = 1) {
+      return addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, stageFlags, count);
+    }
+
     // Build and return the descriptor set layout
     std::unique_ptr<DescriptorSetLayout> build() {
       return std::make_unique<DescriptorSetLayout>(m_Context, m_Bindings);
@@ -92,14 +109,28 @@ class Descriptor {
   void updateUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset = 0,
                            uint32_t setIndex = 0);
 
+  // Point a dynamic uniform buffer binding at a buffer, the offset is supplied at bind time
+  void updateDynamicUniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range, uint32_t setIndex = 0);
+
+  void updateStorageBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize size = VK_WHOLE_SIZE,
+                           VkDeviceSize offset = 0, uint32_t setIndex = 0);
+
   void updateTextureSampler(uint32_t binding, VkImageView imageView, VkSampler sampler, uint32_t setIndex = 0);
 
+  // Point the elements of a storage image binding at imageViews, the images are accessed in GENERAL layout
+  void updateStorageImages(uint32_t binding, const std::vector<VkImageView>& imageViews, uint32_t setIndex = 0);
+
   // void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex);
   void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex = 0,
-            uint32_t dynamicOffsetCount = 0, const uint32_t* pDynamicOffsets = nullptr);
+            uint32_t dynamicOffsetCount = 0, const uint32_t* pDynamicOffsets = nullptr,
+            VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 
   const std::vector<VkDescriptorSet>& getDescriptorSets() const { return m_DescriptorSets; }
 
+ private:
+  void writeBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize size, VkDeviceSize offset,
+                   uint32_t setIndex);
+
  private:
   VkContext* m_Context;
 
@@ -122,21 +153,61 @@ class UniformBuffer {
   UniformBuffer(const UniformBuffer&) = delete;
   UniformBuffer& operator=(const UniformBuffer&) = delete;
 
+  // Write the whole buffer, or only a range of it. Only the written bytes are flushed.
   void update(const void* data);
-  VkBuffer getBuffer() const { return m_Buffer; }
-  VkDeviceMemory getMemory() const { return m_Memory; }
+  void update(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+  VkBuffer getBuffer() const { return m_Buffer.getBuffer(); }
+  const Allocation& getAllocation() const { return m_Buffer.getAllocation(); }
   VkDescriptorBufferInfo& descriptor() { return m_Descriptor; }
-  VkDeviceSize getSize() const { return m_BufferSize; }
+  VkDeviceSize getSize() const { return m_Buffer.getSize(); }
 
  private:
-  VkContext* m_Context;
+  Buffer m_Buffer;
+  VkDescriptorBufferInfo m_Descriptor{};
+};
 
-  VkBuffer m_Buffer = VK_NULL_HANDLE;
-  VkDeviceMemory m_Memory = VK_NULL_HANDLE;
-  VkDeviceSize m_BufferSize = 0;
+// Persistently mapped uniform buffer split into one segment per frame in flight.
+// Per-draw data is pushed into the current frame's segment and bound with a dynamic offset. A segment is only
+// rewritten after the fence of the frame that last used it has signalled, see Renderer::beginFrame.
+// Offsets change every frame, so command buffers binding ring data can't be cached across frames. Renderer::drawFrame
+// re-records cached command buffers in every frame that pushed into the ring.
+class UniformRingBuffer {
+ public:
+  UniformRingBuffer(VkContext* context, VkDeviceSize frameSize, uint32_t framesInFlight);
+  ~UniformRingBuffer();
 
-  void* m_MappedData = nullptr;
-  VkDescriptorBufferInfo m_Descriptor{};
+  // Prevent copying
+  UniformRingBuffer(const UniformRingBuffer&) = delete;
+  UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+  // Start writing into the segment of frameIndex, discarding what was pushed there last time
+  void beginFrame(uint32_t frameIndex);
+
+  // Copy data into the current segment, returns the dynamic offset to bind it with
+  uint32_t push(const void* data, VkDeviceSize size);
+
+  // Reserve an aligned range in the current segment to be written in place
+  void* allocate(VkDeviceSize size, uint32_t& dynamicOffset);
+
+  // Make this frame's writes visible to the device, only needed for non-coherent memory
+  void flush();
+
+  VkBuffer getBuffer() const { return m_Buffer.getBuffer(); }
+  VkDeviceSize getAlignment() const { return m_Alignment; }
+  VkDeviceSize getFrameSize() const { return m_FrameSize; }
+  VkDeviceSize getFrameUsage() const { return m_Head - m_FrameBegin; }
+
+ private:
+  Buffer m_Buffer;
+
+  VkDeviceSize m_Alignment = 1;
+  VkDeviceSize m_FrameSize = 0;
+  uint32_t m_FramesInFlight = 0;
+
+  // Write head and start of the current frame's segment
+  VkDeviceSize m_FrameBegin = 0;
+  VkDeviceSize m_Head = 0;
 };
 
-}  // namespace glint
\ No newline at end of file
+}  // namespace glint
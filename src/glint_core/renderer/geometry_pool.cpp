@@ -0,0 +1,348 @@
+#include "geometry_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "core/logger.h"
+#include "staging_pool.h"
+#include "transfer_manager.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+namespace {
+
+// Storage usage so compute passes can read the geometry too, transfer source so the defragmenter can move the blocks
+constexpr VkBufferUsageFlags kVertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+constexpr VkBufferUsageFlags kIndexUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+// Allocation granularity, a unit holds a whole number of vertices / indices of every supported stride and type
+constexpr uint32_t kVertexUnit = sizeof(Vertex);
+constexpr uint32_t kIndexUnit = sizeof(uint32_t);
+
+uint32_t getIndexSize(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4; }
+
+}  // namespace
+
+GeometryPool::GeometryPool(VkContext* context, VkDeviceSize vertexBlockSize, VkDeviceSize indexBlockSize)
+    : m_Context(context),
+      m_VertexBlockCapacity(static_cast<uint32_t>(vertexBlockSize / kVertexUnit)),
+      m_IndexBlockCapacity(static_cast<uint32_t>(indexBlockSize / kIndexUnit)) {
+  LOGFN;
+  LOG("Geometry pool blocks hold", m_VertexBlockCapacity, "vertices and", m_IndexBlockCapacity, "32-bit indices");
+}
+
+GeometryPool::~GeometryPool() {
+  LOGFN;
+  if (m_Stats.rangeCount > 0) {
+    LOG("[WARNING] GeometryPool destroyed with", m_Stats.rangeCount, "live ranges");
+  }
+}
+
+GeometryPool::Range GeometryPool::add(std::span<const std::byte> vertexData, uint32_t vertexStride,
+                                      std::span<const std::byte> indexData, VkIndexType indexType,
+                                      uint64_t* uploadId) {
+  if (vertexStride == 0 || kVertexUnit % vertexStride != 0) {
+    throw std::runtime_error("Unsupported vertex stride for the geometry pool!");
+  }
+
+  Range range;
+  range.vertexStride = vertexStride;
+  range.indexType = indexType;
+  range.vertexCount = static_cast<uint32_t>(vertexData.size() / vertexStride);
+  range.indexCount = static_cast<uint32_t>(indexData.size() / getIndexSize(indexType));
+  auto write = [&](std::span<std::byte> vertexStaging, std::span<std::byte> indexStaging) {
+    std::memcpy(vertexStaging.data(), vertexData.data(), vertexData.size());
+    if (!indexData.empty()) {
+      std::memcpy(indexStaging.data(), indexData.data(), indexData.size());
+    }
+  };
+  return addRange(range, write, uploadId);
+}
+
+GeometryPool::Range GeometryPool::addSplit(std::span<const std::byte> positionData, uint32_t positionStride,
+                                           std::span<const std::byte> attributeData, uint32_t attributeStride,
+                                           std::span<const std::byte> indexData, VkIndexType indexType,
+                                           uint64_t* uploadId) {
+  if (positionStride == 0 || positionStride % 4 != 0 || attributeStride == 0) {
+    throw std::runtime_error("Unsupported vertex stride for the geometry pool!");
+  }
+
+  Range range;
+  range.vertexStride = positionStride;
+  range.attributeStride = attributeStride;
+  range.indexType = indexType;
+  range.vertexCount = static_cast<uint32_t>(positionData.size() / positionStride);
+  if (attributeData.size() != static_cast<size_t>(range.vertexCount) * attributeStride) {
+    throw std::runtime_error("Vertex streams of different length!");
+  }
+  range.indexCount = static_cast<uint32_t>(indexData.size() / getIndexSize(indexType));
+
+  // The attribute stream follows the positions in the same range
+  auto write = [&](std::span<std::byte> vertexStaging, std::span<std::byte> indexStaging) {
+    std::memcpy(vertexStaging.data(), positionData.data(), positionData.size());
+    std::memcpy(vertexStaging.data() + positionData.size(), attributeData.data(), attributeData.size());
+    if (!indexData.empty()) {
+      std::memcpy(indexStaging.data(), indexData.data(), indexData.size());
+    }
+  };
+  return addRange(range, write, uploadId);
+}
+
+GeometryPool::Range GeometryPool::addGenerated(uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount,
+                                               VkIndexType indexType, const WriteCallback& write,
+                                               uint64_t* uploadId) {
+  if (vertexStride == 0 || kVertexUnit % vertexStride != 0) {
+    throw std::runtime_error("Unsupported vertex stride for the geometry pool!");
+  }
+
+  Range range;
+  range.vertexStride = vertexStride;
+  range.indexType = indexType;
+  range.vertexCount = vertexCount;
+  range.indexCount = indexCount;
+  return addRange(range, write, uploadId);
+}
+
+GeometryPool::Range GeometryPool::addRange(Range range, const WriteCallback& write, uint64_t* uploadId) {
+  if (range.vertexCount == 0) {
+    throw std::runtime_error("Adding empty geometry to the pool!");
+  }
+
+  Block* block = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    bool allocated = false;
+    for (uint32_t i = 0; i < m_Blocks.size() && !allocated; i++) {
+      allocated = allocateFromBlock(i, range);
+    }
+
+    if (!allocated) {
+      // Meshes larger than a block get a block of their own
+      createBlock(std::max(m_VertexBlockCapacity, getVertexUnits(range)),
+                  std::max(m_IndexBlockCapacity, getIndexUnits(range)));
+      allocateFromBlock(static_cast<uint32_t>(m_Blocks.size() - 1), range);
+    }
+    block = m_Blocks[range.block].get();
+
+    // Waits for a pending move of the block, which is then dropped, so the upload writes the buffers that are drawn
+    if (block->pendingUploads++ == 0) {
+      block->vertices.disableDefragmentation();
+      block->indices.disableDefragmentation();
+    }
+  }
+
+  auto stagingPool = m_Context->getStagingPool();
+  auto transferManager = m_Context->getTransferManager();
+
+  // One batch so a single id covers all uploads
+  transferManager->beginBatch();
+
+  // Both vertex streams go in one copy, they are back to back in the range
+  VkDeviceSize vertexSize = VkDeviceSize(range.vertexStride + range.attributeStride) * range.vertexCount;
+  VkDeviceSize indexSize = VkDeviceSize(getIndexSize(range.indexType)) * range.indexCount;
+  Buffer* vertexStaging = stagingPool->acquire(vertexSize);
+  Buffer* indexStaging = range.indexCount > 0 ? stagingPool->acquire(indexSize) : nullptr;
+  write(std::span<std::byte>(static_cast<std::byte*>(vertexStaging->getMappedData()), vertexSize),
+        indexStaging ? std::span<std::byte>(static_cast<std::byte*>(indexStaging->getMappedData()), indexSize)
+                     : std::span<std::byte>());
+
+  vertexStaging->markDirty(0, vertexSize);
+  // The index upload is in the same batch and completes with it
+  uint32_t blockIndex = range.block;
+  transferManager->uploadBuffer(vertexStaging, block->vertices.getBuffer(), vertexSize,
+                                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                                [this, blockIndex]() { onUploadComplete(blockIndex); },
+                                VkDeviceSize(kVertexUnit) * range.vertexUnitOffset);
+
+  if (indexStaging) {
+    indexStaging->markDirty(0, indexSize);
+    transferManager->uploadBuffer(indexStaging, block->indices.getBuffer(), indexSize,
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, nullptr,
+                                  static_cast<VkDeviceSize>(range.firstIndex) * getIndexSize(range.indexType));
+  }
+
+  uint64_t id = transferManager->endBatch();
+  if (uploadId) {
+    *uploadId = id;
+  }
+  return range;
+}
+
+void GeometryPool::free(const Range& range) {
+  if (!range.isValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Retired.push_back({range, m_FrameCounter});
+}
+
+void GeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t block, VkIndexType indexType) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  VkBuffer buffers[] = {m_Blocks[block]->vertices.getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, m_Blocks[block]->indices.getBuffer(), 0, indexType);
+}
+
+void GeometryPool::bind(VkCommandBuffer commandBuffer, const Range& range) const {
+  if (range.attributeStride == 0) {
+    bind(commandBuffer, range.block, range.indexType);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  VkBuffer vertexBuffer = m_Blocks[range.block]->vertices.getBuffer();
+  VkDeviceSize positionOffset = VkDeviceSize(kVertexUnit) * range.vertexUnitOffset;
+  VkBuffer buffers[] = {vertexBuffer, vertexBuffer};
+  VkDeviceSize offsets[] = {positionOffset, positionOffset + VkDeviceSize(range.vertexStride) * range.vertexCount};
+  vkCmdBindVertexBuffers(commandBuffer, Vertex::kPositionBinding, 2, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, m_Blocks[range.block]->indices.getBuffer(), 0, range.indexType);
+}
+
+void GeometryPool::update(uint32_t framesInFlight) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_FrameCounter++;
+
+  auto reusable = [this, framesInFlight](const RetiredRange& retired) {
+    return retired.frame + framesInFlight < m_FrameCounter;
+  };
+  for (const auto& retired : m_Retired) {
+    if (reusable(retired)) {
+      reclaim(retired.range);
+    }
+  }
+  m_Retired.erase(std::remove_if(m_Retired.begin(), m_Retired.end(), reusable), m_Retired.end());
+}
+
+GeometryPool::Stats GeometryPool::getStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Stats;
+}
+
+GeometryPool::Block* GeometryPool::createBlock(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  auto block = std::make_unique<Block>();
+
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  block->vertices = Buffer(m_Context, VkDeviceSize(kVertexUnit) * vertexCapacity, kVertexUsage, properties,
+                           MemoryTag::Mesh);
+  block->indices = Buffer(m_Context, VkDeviceSize(kIndexUnit) * indexCapacity, kIndexUsage, properties,
+                          MemoryTag::Mesh);
+  VkUtils::setObjectName((uint64_t)block->vertices.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Geometry Pool Vertices");
+  VkUtils::setObjectName((uint64_t)block->indices.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Geometry Pool Indices");
+  block->freeVertices.emplace(0, vertexCapacity);
+  block->freeIndices.emplace(0, indexCapacity);
+
+  m_Stats.blockCount++;
+  m_Stats.capacityBytes += block->vertices.getSize() + block->indices.getSize();
+  LOG("Geometry pool block", m_Blocks.size(), "created,", vertexCapacity, "vertices,", indexCapacity, "indices");
+
+  m_Blocks.push_back(std::move(block));
+  return m_Blocks.back().get();
+}
+
+void GeometryPool::onUploadComplete(uint32_t blockIndex) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Block* block = m_Blocks[blockIndex].get();
+  if (--block->pendingUploads == 0) {
+    block->vertices.enableDefragmentation();
+    block->indices.enableDefragmentation();
+  }
+}
+
+bool GeometryPool::allocateFromBlock(uint32_t blockIndex, Range& range) {
+  Block* block = m_Blocks[blockIndex].get();
+  uint32_t vertexUnits = getVertexUnits(range);
+  uint32_t indexUnits = getIndexUnits(range);
+
+  uint32_t vertexUnitOffset = 0;
+  if (!allocateRange(block->freeVertices, vertexUnits, vertexUnitOffset)) {
+    return false;
+  }
+
+  uint32_t indexUnitOffset = 0;
+  if (indexUnits > 0 && !allocateRange(block->freeIndices, indexUnits, indexUnitOffset)) {
+    releaseRange(block->freeVertices, vertexUnitOffset, vertexUnits);
+    return false;
+  }
+
+  range.block = blockIndex;
+  range.vertexUnitOffset = vertexUnitOffset;
+  // Split streams are bound at the range itself
+  range.vertexOffset = range.attributeStride == 0 ? vertexUnitOffset * (kVertexUnit / range.vertexStride) : 0;
+  range.firstIndex = indexUnitOffset * (kIndexUnit / getIndexSize(range.indexType));
+
+  m_Stats.rangeCount++;
+  m_Stats.usedVertexBytes += VkDeviceSize(kVertexUnit) * vertexUnits;
+  m_Stats.usedIndexBytes += VkDeviceSize(kIndexUnit) * indexUnits;
+  return true;
+}
+
+void GeometryPool::reclaim(const Range& range) {
+  Block* block = m_Blocks[range.block].get();
+  uint32_t vertexUnits = getVertexUnits(range);
+  uint32_t indexUnits = getIndexUnits(range);
+
+  releaseRange(block->freeVertices, range.vertexUnitOffset, vertexUnits);
+  if (indexUnits > 0) {
+    releaseRange(block->freeIndices, range.firstIndex / (kIndexUnit / getIndexSize(range.indexType)), indexUnits);
+  }
+
+  m_Stats.rangeCount--;
+  m_Stats.usedVertexBytes -= VkDeviceSize(kVertexUnit) * vertexUnits;
+  m_Stats.usedIndexBytes -= VkDeviceSize(kIndexUnit) * indexUnits;
+}
+
+uint32_t GeometryPool::getVertexUnits(const Range& range) {
+  uint64_t bytes = static_cast<uint64_t>(range.vertexCount) * (range.vertexStride + range.attributeStride);
+  return static_cast<uint32_t>((bytes + kVertexUnit - 1) / kVertexUnit);
+}
+
+uint32_t GeometryPool::getIndexUnits(const Range& range) {
+  uint32_t indicesPerUnit = kIndexUnit / getIndexSize(range.indexType);
+  return (range.indexCount + indicesPerUnit - 1) / indicesPerUnit;
+}
+
+bool GeometryPool::allocateRange(FreeList& freeList, uint32_t count, uint32_t& offset) {
+  for (auto it = freeList.begin(); it != freeList.end(); ++it) {
+    if (it->second < count) {
+      continue;
+    }
+
+    offset = it->first;
+    uint32_t remaining = it->second - count;
+    freeList.erase(it);
+    if (remaining > 0) {
+      freeList.emplace(offset + count, remaining);
+    }
+    return true;
+  }
+  return false;
+}
+
+void GeometryPool::releaseRange(FreeList& freeList, uint32_t offset, uint32_t count) {
+  auto it = freeList.emplace(offset, count).first;
+
+  // Merge with the following range
+  auto next = std::next(it);
+  if (next != freeList.end() && it->first + it->second == next->first) {
+    it->second += next->second;
+    freeList.erase(next);
+  }
+
+  // Merge with the preceding range
+  if (it != freeList.begin()) {
+    auto prev = std::prev(it);
+    if (prev->first + prev->second == it->first) {
+      prev->second += it->second;
+      freeList.erase(it);
+    }
+  }
+}
+
+}  // namespace glint
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "buffer.h"
+#include "vertex.h"
+
+namespace glint {
+
+class VkContext;
+
+// Shared vertex and index storage for all meshes. Ranges are sub-allocated with a first-fit free list out of a few
+// large device local buffers, so every mesh in a block draws with the same vertex / index buffer binding and only the
+// offsets in the draw change. That is what multi-draw indirect needs, and it saves the rebinds between meshes.
+// Freed ranges are reused only after the frames that may still read them have completed.
+// Blocks are sub-allocated in units of sizeof(Vertex) bytes and 4 byte index units, so meshes with QuantizedVertex
+// vertices and 16-bit indices share the blocks with full precision meshes.
+// Split stream ranges keep their position and attribute streams back to back and are bound at their own offsets, so
+// they draw with vertexOffset 0 and need a rebind per mesh.
+// Blocks are registered with the Defragmenter while no upload is writing them, draws bind the current buffers.
+class GeometryPool {
+ public:
+  // A mesh's place in the pool. Offsets and counts are in the mesh's own vertex stride and index type, so they go
+  // straight into the draw.
+  struct Range {
+    uint32_t block = 0;
+    uint32_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    uint32_t vertexStride = sizeof(Vertex);
+    // Non zero for split streams, then vertexStride is the stride of the positions and attributeStride the stride of
+    // the attribute stream that follows them
+    uint32_t attributeStride = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    // Start of the vertex data in the block, in pool units
+    uint32_t vertexUnitOffset = 0;
+
+    bool isValid() const { return vertexCount != 0; }
+  };
+
+  // Fills the mapped staging memory of a new range, vertexData holds every stream of the range back to back and
+  // indexData its indices in the range's index type
+  using WriteCallback = std::function<void(std::span<std::byte> vertexData, std::span<std::byte> indexData)>;
+
+  struct Stats {
+    uint32_t blockCount = 0;
+    uint32_t rangeCount = 0;
+    VkDeviceSize usedVertexBytes = 0;
+    VkDeviceSize usedIndexBytes = 0;
+    VkDeviceSize capacityBytes = 0;
+  };
+
+  GeometryPool(VkContext* context, VkDeviceSize vertexBlockSize, VkDeviceSize indexBlockSize);
+  ~GeometryPool();
+
+  // Prevent copying
+  GeometryPool(const GeometryPool&) = delete;
+  GeometryPool& operator=(const GeometryPool&) = delete;
+
+  // Allocate a range and upload the geometry into it through the TransferManager. sizeof(Vertex) must be a multiple
+  // of vertexStride, indices are VK_INDEX_TYPE_UINT16 or VK_INDEX_TYPE_UINT32. uploadId receives the id of the
+  // upload, the range must not be freed before it completes.
+  Range add(std::span<const std::byte> vertexData, uint32_t vertexStride, std::span<const std::byte> indexData,
+            VkIndexType indexType, uint64_t* uploadId = nullptr);
+
+  // Like add, for vertices split into a position stream and an attribute stream of the same vertex count. The
+  // position stride must be a multiple of 4 bytes so the attribute stream stays aligned.
+  Range addSplit(std::span<const std::byte> positionData, uint32_t positionStride,
+                 std::span<const std::byte> attributeData, uint32_t attributeStride,
+                 std::span<const std::byte> indexData, VkIndexType indexType, uint64_t* uploadId = nullptr);
+
+  // Like add, but the geometry is written by write straight into the staging memory, skipping the copy from the
+  // caller's arrays. Runs on the calling thread before returning.
+  Range addGenerated(uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount, VkIndexType indexType,
+                     const WriteCallback& write, uint64_t* uploadId = nullptr);
+
+  // The range is reused once the frames in flight have finished with it
+  void free(const Range& range);
+
+  // Bind the vertex and index buffer of a block, once for all meshes drawn from it with the same index type
+  void bind(VkCommandBuffer commandBuffer, uint32_t block = 0, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+
+  // Bind the buffers a range draws from, split streams go to Vertex::kPositionBinding and Vertex::kAttributeBinding
+  void bind(VkCommandBuffer commandBuffer, const Range& range) const;
+
+  // Called once per frame after the frame fence wait, ranges freed framesInFlight frames ago become available
+  void update(uint32_t framesInFlight);
+
+  VkBuffer getVertexBuffer(uint32_t block) const { return m_Blocks[block]->vertices.getBuffer(); }
+  VkBuffer getIndexBuffer(uint32_t block) const { return m_Blocks[block]->indices.getBuffer(); }
+  uint32_t getBlockCount() const { return static_cast<uint32_t>(m_Blocks.size()); }
+
+  Stats getStats() const;
+
+ private:
+  // Free ranges keyed by offset, value is the range size. Adjacent ranges are merged on release.
+  using FreeList = std::map<uint32_t, uint32_t>;
+
+  struct Block {
+    Buffer vertices;
+    Buffer indices;
+    FreeList freeVertices;
+    FreeList freeIndices;
+    // Uploads in flight, the buffers can only be moved without any
+    uint32_t pendingUploads = 0;
+  };
+
+  struct RetiredRange {
+    Range range;
+    uint64_t frame = 0;
+  };
+
+  // Allocate the range, fill its staging memory and upload it
+  Range addRange(Range range, const WriteCallback& write, uint64_t* uploadId);
+
+  Block* createBlock(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void onUploadComplete(uint32_t blockIndex);
+  bool allocateFromBlock(uint32_t blockIndex, Range& range);
+  void reclaim(const Range& range);
+
+  // Pool units covered by a range
+  static uint32_t getVertexUnits(const Range& range);
+  static uint32_t getIndexUnits(const Range& range);
+
+  static bool allocateRange(FreeList& freeList, uint32_t count, uint32_t& offset);
+  static void releaseRange(FreeList& freeList, uint32_t offset, uint32_t count);
+
+ private:
+  VkContext* m_Context;
+  // In pool units
+  uint32_t m_VertexBlockCapacity;
+  uint32_t m_IndexBlockCapacity;
+
+  std::vector<std::unique_ptr<Block>> m_Blocks;
+  std::vector<RetiredRange> m_Retired;
+  uint64_t m_FrameCounter = 0;
+
+  Stats m_Stats;
+  mutable std::mutex m_Mutex;
+};
+
+}  // namespace glint
@@ -0,0 +1,76 @@
+#include "gpu_timer.h"
+
+#include <vector>
+
+#include "core/logger.h"
+#include "vk_context.h"
+#include "vk_tools.h"
+
+namespace glint {
+
+namespace {
+
+uint32_t getTimestampValidBits(VkContext* context) {
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(context->getPhysicalDevice(), &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(context->getPhysicalDevice(), &familyCount, families.data());
+  return families[context->getQueueFamilyIndices().graphicsFamily.value()].timestampValidBits;
+}
+
+}  // namespace
+
+GpuTimer::GpuTimer(VkContext* context, uint32_t rangeCount) : m_Context(context), m_RangeCount(rangeCount) {
+  uint32_t validBits = getTimestampValidBits(m_Context);
+  if (validBits == 0) {
+    LOG("[WARNING] The graphics queue doesn't support timestamps, GPU times are unavailable");
+    return;
+  }
+  m_ValidMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+  m_Period = m_Context->getPhysicalDeviceProperties().limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = 2 * m_RangeCount;
+  VK_CHECK_RESULT(vkCreateQueryPool(m_Context->getDevice(), &poolInfo, nullptr, &m_QueryPool));
+}
+
+GpuTimer::~GpuTimer() {
+  if (m_QueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_Context->getDevice(), m_QueryPool, nullptr);
+  }
+}
+
+bool GpuTimer::isSupported(VkContext* context) { return getTimestampValidBits(context) != 0; }
+
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t range) {
+  if (m_QueryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, m_QueryPool, 2 * range, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_QueryPool, 2 * range);
+}
+
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t range) {
+  if (m_QueryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_QueryPool, 2 * range + 1);
+}
+
+double GpuTimer::getMilliseconds(uint32_t range) const {
+  if (m_QueryPool == VK_NULL_HANDLE) {
+    return -1.0;
+  }
+  uint64_t timestamps[2];
+  VkResult result = vkGetQueryPoolResults(m_Context->getDevice(), m_QueryPool, 2 * range, 2, sizeof(timestamps),
+                                          timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return -1.0;
+  }
+  uint64_t ticks = ((timestamps[1] & m_ValidMask) - (timestamps[0] & m_ValidMask)) & m_ValidMask;
+  return static_cast<double>(ticks) * m_Period * 1e-6;
+}
+
+}  // namespace glint
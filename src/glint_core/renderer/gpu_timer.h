@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+namespace glint {
+
+class VkContext;
+
+// GPU time of command buffer ranges on the graphics queue, measured with a pair of timestamp queries per range.
+// Results are read once the commands have completed, e.g. from a TransferManager completion callback or after the
+// frame's fence, reading earlier reports them as unavailable.
+class GpuTimer {
+ public:
+  GpuTimer(VkContext* context, uint32_t rangeCount = 1);
+  ~GpuTimer();
+
+  // Prevent copying
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+
+  // Whether the graphics queue family writes timestamps, begin / end record nothing otherwise
+  static bool isSupported(VkContext* context);
+
+  // Record around the commands to measure, outside of a render pass
+  void begin(VkCommandBuffer commandBuffer, uint32_t range = 0);
+  void end(VkCommandBuffer commandBuffer, uint32_t range = 0);
+
+  // Milliseconds between begin and end of range, negative when the results aren't available
+  double getMilliseconds(uint32_t range = 0) const;
+
+ private:
+  VkContext* m_Context;
+  VkQueryPool m_QueryPool = VK_NULL_HANDLE;
+  uint32_t m_RangeCount = 0;
+
+  // Nanoseconds per timestamp tick and the mask of the bits the queue writes
+  double m_Period = 0.0;
+  uint64_t m_ValidMask = 0;
+};
+
+}  // namespace glint
@@ -0,0 +1,267 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include "core/logger.h"
+#include "core/mapped_file.h"
+
+namespace glint {
+
+namespace {
+
+constexpr uint8_t kIdentifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2Level {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// Khronos Data Format values of the basic data format descriptor
+constexpr uint32_t kDfdModelRgbsda = 1;
+constexpr uint32_t kDfdModelBc1a = 128;
+constexpr uint32_t kDfdModelBc3 = 130;
+constexpr uint32_t kDfdModelBc4 = 131;
+constexpr uint32_t kDfdModelBc5 = 132;
+constexpr uint32_t kDfdModelBc7 = 134;
+constexpr uint32_t kDfdPrimariesBt709 = 1;
+constexpr uint32_t kDfdTransferLinear = 1;
+constexpr uint32_t kDfdTransferSrgb = 2;
+constexpr uint32_t kDfdChannelAlpha = 15;
+// Sample qualifier of the alpha of sRGB formats, which is never sRGB encoded
+constexpr uint32_t kDfdSampleLinear = 0x80;
+
+struct DfdSample {
+  uint32_t channel;
+  uint32_t bitOffset;
+  uint32_t bitLength;
+};
+
+struct FormatDescription {
+  uint32_t colorModel;
+  uint32_t blockSize;
+  uint32_t blockBytes;
+  bool srgb;
+  std::vector<DfdSample> samples;
+};
+
+bool describeFormat(VkFormat format, FormatDescription& description) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      description = {kDfdModelRgbsda, 1, 4, format == VK_FORMAT_R8G8B8A8_SRGB,
+                     {{0, 0, 8}, {1, 8, 8}, {2, 16, 8}, {kDfdChannelAlpha, 24, 8}}};
+      return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      description = {kDfdModelBc1a, 4, 8, format == VK_FORMAT_BC1_RGB_SRGB_BLOCK, {{0, 0, 64}}};
+      return true;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      description = {kDfdModelBc1a, 4, 8, format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK, {{1, 0, 64}}};
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      description = {kDfdModelBc3, 4, 16, format == VK_FORMAT_BC3_SRGB_BLOCK,
+                     {{kDfdChannelAlpha, 0, 64}, {0, 64, 64}}};
+      return true;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+      description = {kDfdModelBc4, 4, 8, false, {{0, 0, 64}}};
+      return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      description = {kDfdModelBc5, 4, 16, false, {{0, 0, 64}, {1, 64, 64}}};
+      return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      description = {kDfdModelBc7, 4, 16, format == VK_FORMAT_BC7_SRGB_BLOCK, {{0, 0, 128}}};
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Total size followed by a single basic descriptor block
+std::vector<uint32_t> buildDfd(const FormatDescription& description) {
+  uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(description.samples.size());
+  uint32_t dimension = description.blockSize - 1;
+  uint32_t transfer = description.srgb ? kDfdTransferSrgb : kDfdTransferLinear;
+
+  std::vector<uint32_t> words = {4 + blockSize,
+                                 0,  // Khronos vendor, basic descriptor type
+                                 2 | (blockSize << 16),
+                                 description.colorModel | (kDfdPrimariesBt709 << 8) | (transfer << 16),
+                                 dimension | (dimension << 8),
+                                 description.blockBytes,
+                                 0};
+  // Compressed samples cover the whole channel range, uncompressed ones the byte range
+  uint32_t sampleUpper = description.blockSize == 1 ? 255 : UINT32_MAX;
+  for (const auto& sample : description.samples) {
+    uint32_t channel = sample.channel;
+    if (description.srgb && channel == kDfdChannelAlpha) {
+      channel |= kDfdSampleLinear;
+    }
+    words.insert(words.end(), {sample.bitOffset | ((sample.bitLength - 1) << 16) | (channel << 24), 0, 0,
+                               sampleUpper});
+  }
+  return words;
+}
+
+// A single key / value entry, padded to 4 bytes
+std::vector<uint8_t> buildKeyValue(const std::string& key, const std::string& value) {
+  uint32_t length = static_cast<uint32_t>(key.size() + value.size() + 2);
+  std::vector<uint8_t> data(sizeof(length));
+  std::memcpy(data.data(), &length, sizeof(length));
+  data.insert(data.end(), key.begin(), key.end());
+  data.push_back(0);
+  data.insert(data.end(), value.begin(), value.end());
+  data.push_back(0);
+  data.resize((data.size() + 3) & ~size_t(3), 0);
+  return data;
+}
+
+}  // namespace
+
+ImageData Ktx2::load(const std::string& path) {
+  LOGFN;
+  MappedFile file(path);
+  const uint8_t* data = file.getData();
+  size_t fileSize = file.getSize();
+
+  Ktx2Header header;
+  if (fileSize < sizeof(header) || std::memcmp(data, kIdentifier, sizeof(kIdentifier)) != 0) {
+    throw std::runtime_error(path + " is not a KTX2 file");
+  }
+  std::memcpy(&header, data, sizeof(header));
+
+  auto format = static_cast<VkFormat>(header.vkFormat);
+  FormatDescription description;
+  if (!describeFormat(format, description)) {
+    throw std::runtime_error(path + " has unsupported format " + std::to_string(header.vkFormat));
+  }
+  if (header.supercompressionScheme != 0) {
+    throw std::runtime_error(path + " is supercompressed, only plain KTX2 files are supported");
+  }
+  if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 ||
+      header.faceCount != 1) {
+    throw std::runtime_error(path + " is not a single 2D image");
+  }
+
+  ImageData image;
+  image.width = header.pixelWidth;
+  image.height = header.pixelHeight;
+  image.format = format;
+
+  // Level 0 means the mips are to be generated, which compressed data can't be
+  uint32_t levelCount = std::max(1u, header.levelCount);
+  if (levelCount > 32 || sizeof(header) + levelCount * sizeof(Ktx2Level) > fileSize) {
+    throw std::runtime_error(path + " is truncated");
+  }
+  std::vector<Ktx2Level> levels(levelCount);
+  std::memcpy(levels.data(), data + sizeof(header), levelCount * sizeof(Ktx2Level));
+
+  size_t mipBytes = 0;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    if (levels[level].byteLength != image.getMipSize(level) || levels[level].byteOffset > fileSize ||
+        levels[level].byteLength > fileSize - levels[level].byteOffset) {
+      throw std::runtime_error(path + " has a malformed mip " + std::to_string(level));
+    }
+    if (level > 0) {
+      image.mipOffsets.push_back(mipBytes);
+      mipBytes += levels[level].byteLength;
+    }
+  }
+
+  image.pixels = {static_cast<uint8_t*>(std::malloc(levels[0].byteLength)), std::free};
+  std::memcpy(image.pixels.get(), data + levels[0].byteOffset, levels[0].byteLength);
+  image.mipPixels.resize(mipBytes);
+  for (uint32_t level = 1; level < levelCount; level++) {
+    std::memcpy(image.mipPixels.data() + image.mipOffsets[level - 1], data + levels[level].byteOffset,
+                levels[level].byteLength);
+  }
+
+  LOG("KTX2 texture loaded:", image.width, "x", image.height, "format", header.vkFormat, ",", levelCount, "mips");
+  return image;
+}
+
+void Ktx2::write(const std::string& path, const ImageData& image) {
+  LOGFN;
+  FormatDescription description;
+  if (!describeFormat(image.format, description)) {
+    throw std::runtime_error("Can't write format " + std::to_string(image.format) + " to KTX2");
+  }
+
+  uint32_t levelCount = image.getMipLevels();
+  std::vector<uint32_t> dfd = buildDfd(description);
+  std::vector<uint8_t> keyValues = buildKeyValue("KTXwriter", "Glint");
+
+  Ktx2Header header{};
+  std::memcpy(header.identifier, kIdentifier, sizeof(kIdentifier));
+  header.vkFormat = static_cast<uint32_t>(image.format);
+  header.typeSize = 1;
+  header.pixelWidth = image.width;
+  header.pixelHeight = image.height;
+  header.faceCount = 1;
+  header.levelCount = levelCount;
+  header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + levelCount * sizeof(Ktx2Level));
+  header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+  header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+  header.kvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+  // Mips are stored smallest first, each aligned to the block size
+  uint64_t alignment = std::max(4u, description.blockBytes);
+  std::vector<Ktx2Level> levels(levelCount);
+  uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+  for (uint32_t level = levelCount; level-- > 0;) {
+    offset = (offset + alignment - 1) / alignment * alignment;
+    levels[level] = {offset, image.getMipSize(level), image.getMipSize(level)};
+    offset += image.getMipSize(level);
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  auto writeAt = [&file](uint64_t position, const void* bytes, size_t size) {
+    file.seekp(static_cast<std::streamoff>(position));
+    file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+  };
+  writeAt(0, &header, sizeof(header));
+  writeAt(sizeof(header), levels.data(), levels.size() * sizeof(Ktx2Level));
+  writeAt(header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+  writeAt(header.kvdByteOffset, keyValues.data(), keyValues.size());
+  for (uint32_t level = levelCount; level-- > 0;) {
+    // Zero the alignment padding before the mip
+    uint64_t previousEnd = level + 1 < levelCount ? levels[level + 1].byteOffset + levels[level + 1].byteLength
+                                                  : header.kvdByteOffset + header.kvdByteLength;
+    std::vector<uint8_t> padding(levels[level].byteOffset - previousEnd, 0);
+    writeAt(previousEnd, padding.data(), padding.size());
+    writeAt(levels[level].byteOffset, image.getMipPixels(level), levels[level].byteLength);
+  }
+  if (!file) {
+    throw std::runtime_error("Failed to write " + path);
+  }
+}
+
+}  // namespace glint
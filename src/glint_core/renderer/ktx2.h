@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "texture.h"
+
+namespace glint {
+
+// Reader and writer of KTX2 texture files holding a single 2D image and its mips, either block compressed (BC1 - BC7)
+// or R8G8B8A8. Supercompressed files (Basis Universal, zstd) and arrays, cubemaps and 3D textures are not supported.
+// Thread safe, no Vulkan calls.
+class Ktx2 {
+ public:
+  // The stored format and every stored mip, throws on failure
+  static ImageData load(const std::string& path);
+
+  // Write every mip of the image, throws on failure
+  static void write(const std::string& path, const ImageData& image);
+};
+
+}  // namespace glint
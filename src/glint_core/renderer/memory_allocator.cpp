@@ -0,0 +1,568 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/logger.h"
+#include "vk_context.h"
+#include "vk_tools.h"
+
+namespace glint {
+
+namespace {
+
+constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+constexpr VkDeviceSize kSmallHeapSize = 1024ull * 1024 * 1024;
+
+// Without VK_EXT_memory_budget assume the process can use this share of a heap
+constexpr VkDeviceSize kEstimatedBudgetPercent = 80;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? value / alignment * alignment : value;
+}
+
+}  // namespace
+
+const char* memoryTagName(MemoryTag tag) {
+  switch (tag) {
+    case MemoryTag::Mesh:
+      return "Mesh";
+    case MemoryTag::Texture:
+      return "Texture";
+    case MemoryTag::SwapChain:
+      return "SwapChain";
+    case MemoryTag::Uniform:
+      return "Uniform";
+    case MemoryTag::Staging:
+      return "Staging";
+    default:
+      return "Unknown";
+  }
+}
+
+MemoryAllocator::MemoryAllocator(VkContext* context) : m_Context(context) {
+  LOGFN;
+  vkGetPhysicalDeviceMemoryProperties(m_Context->getPhysicalDevice(), &m_MemoryProperties);
+
+  auto limits = m_Context->getPhysicalDeviceProperties().limits;
+  m_BufferImageGranularity = std::max<VkDeviceSize>(1, limits.bufferImageGranularity);
+  m_NonCoherentAtomSize = std::max<VkDeviceSize>(1, limits.nonCoherentAtomSize);
+
+  m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+  m_HeapCounters.resize(m_MemoryProperties.memoryHeapCount);
+  m_LazyAllocationSupported = hasMemoryType(~0u, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+  if (m_Context->isMemoryBudgetSupported()) {
+    m_GetMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+        vkGetInstanceProcAddr(m_Context->getInstance(), "vkGetPhysicalDeviceMemoryProperties2KHR"));
+  }
+  LOG("Memory budget source:", m_GetMemoryProperties2 ? "VK_EXT_memory_budget" : "estimated");
+
+  LOG("Memory types:", m_MemoryProperties.memoryTypeCount, "heaps:", m_MemoryProperties.memoryHeapCount,
+      "bufferImageGranularity:", m_BufferImageGranularity, "nonCoherentAtomSize:", m_NonCoherentAtomSize);
+  LOG("Lazily allocated memory:", m_LazyAllocationSupported ? "supported" : "not supported");
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  LOGFN;
+  if (m_Stats.allocationCount > 0) {
+    LOG("[WARNING] MemoryAllocator destroyed with", m_Stats.allocationCount, "live allocations");
+  }
+
+  for (auto& pool : m_Pools) {
+    for (auto& block : pool.blocks) {
+      destroyBlock(block.get());
+    }
+    pool.blocks.clear();
+  }
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                     ResourceKind kind, MemoryTag tag, bool preferDedicated) {
+  return allocateResource(requirements, properties, kind, tag, false, preferDedicated);
+}
+
+Allocation MemoryAllocator::allocateResource(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                             ResourceKind kind, MemoryTag tag, bool image, bool preferDedicated) {
+  // Transient attachments only need lazily allocated memory where it exists, and get their own memory when it does
+  if (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+    if (hasMemoryType(requirements.memoryTypeBits, properties)) {
+      preferDedicated = true;
+    } else {
+      properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+  }
+
+  uint32_t memoryTypeIndex = m_Context->findMemoryType(requirements.memoryTypeBits, properties);
+  VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Allocation allocation;
+
+  // Large resources would waste most of a block, give them their own memory
+  bool largeImage = kind == ResourceKind::Optimal && requirements.size >= blockSize / 4;
+  if (preferDedicated || largeImage || requirements.size > blockSize / 2) {
+    allocation = allocateDedicated(memoryTypeIndex, requirements.size);
+  } else {
+    auto& pool = getPool(memoryTypeIndex, kind);
+    bool allocated = false;
+    for (auto& block : pool.blocks) {
+      if (!block->moveSource && block->size - block->used >= requirements.size &&
+          allocateFromBlock(block.get(), requirements.size, requirements.alignment, allocation)) {
+        allocated = true;
+        break;
+      }
+    }
+
+    if (!allocated) {
+      auto block = createBlock(memoryTypeIndex, kind, blockSize);
+      if (!allocateFromBlock(block, requirements.size, requirements.alignment, allocation)) {
+        throw std::runtime_error("Failed to sub-allocate from a new memory block!");
+      }
+    }
+  }
+
+  trackAllocation(allocation, tag, image);
+  return allocation;
+}
+
+Allocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryTag tag) {
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(m_Context->getDevice(), buffer, &memRequirements);
+
+  Allocation allocation = allocateResource(memRequirements, properties, ResourceKind::Linear, tag, false, false);
+  VK_CHECK_RESULT(vkBindBufferMemory(m_Context->getDevice(), buffer, allocation.memory, allocation.offset));
+  return allocation;
+}
+
+Allocation MemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling,
+                                             MemoryTag tag) {
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(m_Context->getDevice(), image, &memRequirements);
+
+  ResourceKind kind = tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+
+  Allocation allocation = allocateResource(memRequirements, properties, kind, tag, true, false);
+  VK_CHECK_RESULT(vkBindImageMemory(m_Context->getDevice(), image, allocation.memory, allocation.offset));
+  return allocation;
+}
+
+Allocation MemoryAllocator::allocateAliased(const std::vector<VkImage>& images, VkMemoryPropertyFlags properties,
+                                            MemoryTag tag) {
+  if (images.empty()) {
+    return {};
+  }
+
+  // The shared memory has to satisfy every image
+  VkMemoryRequirements combined{0, 1, ~0u};
+  for (VkImage image : images) {
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_Context->getDevice(), image, &memRequirements);
+    combined.size = std::max(combined.size, memRequirements.size);
+    combined.alignment = std::max(combined.alignment, memRequirements.alignment);
+    combined.memoryTypeBits &= memRequirements.memoryTypeBits;
+  }
+  if (combined.memoryTypeBits == 0) {
+    throw std::runtime_error("Aliased images have no memory type in common!");
+  }
+
+  Allocation allocation = allocateResource(combined, properties, ResourceKind::Optimal, tag, true, false);
+  for (VkImage image : images) {
+    VK_CHECK_RESULT(vkBindImageMemory(m_Context->getDevice(), image, allocation.memory, allocation.offset));
+  }
+  LOG("Aliased", images.size(), "images in", allocation.size, "bytes");
+  return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+  if (!allocation.isValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  // Resource and tag counters
+  auto& heap = m_HeapCounters[getHeapIndex(allocation.memoryTypeIndex)];
+  (allocation.image ? heap.imageBytes : heap.bufferBytes) -= allocation.size;
+  m_Stats.tagCounts[static_cast<size_t>(allocation.tag)]--;
+  m_Stats.tagBytes[static_cast<size_t>(allocation.tag)] -= allocation.size;
+
+  if (allocation.dedicated) {
+    if (allocation.mappedData) {
+      vkUnmapMemory(m_Context->getDevice(), allocation.memory);
+    }
+    vkFreeMemory(m_Context->getDevice(), allocation.memory, nullptr);
+    heap.reservedBytes -= allocation.size;
+    m_Stats.dedicatedCount--;
+    m_Stats.dedicatedBytes -= allocation.size;
+    m_Stats.usedBytes -= allocation.size;
+    m_Stats.allocationCount--;
+    allocation = {};
+    return;
+  }
+
+  MemoryBlock* block = allocation.block;
+  auto it = block->freeRanges.emplace(allocation.offset, allocation.size).first;
+
+  // Merge with the following range
+  auto next = std::next(it);
+  if (next != block->freeRanges.end() && it->first + it->second == next->first) {
+    it->second += next->second;
+    block->freeRanges.erase(next);
+  }
+
+  // Merge with the preceding range
+  if (it != block->freeRanges.begin()) {
+    auto prev = std::prev(it);
+    if (prev->first + prev->second == it->first) {
+      prev->second += it->second;
+      block->freeRanges.erase(it);
+    }
+  }
+
+  block->used -= allocation.size;
+  block->allocationCount--;
+  m_Stats.usedBytes -= allocation.size;
+  m_Stats.allocationCount--;
+
+  // Keep one empty block around per pool so that load / unload cycles don't thrash vkAllocateMemory.
+  // A block emptied by the defragmenter is always released.
+  if (block->allocationCount == 0) {
+    auto& pool = getPool(block->memoryTypeIndex, block->kind);
+    auto emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                     [](const auto& b) { return b->allocationCount == 0; });
+    if (emptyBlocks > 1 || block->moveSource) {
+      if (block == m_MoveSource) {
+        m_MoveSource = nullptr;
+      }
+      destroyBlock(block);
+      pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(),
+                                     [block](const auto& b) { return b.get() == block; }));
+    }
+  }
+
+  allocation = {};
+}
+
+void MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+  if (!allocation.isValid() || isHostCoherent(allocation.memoryTypeIndex)) {
+    return;
+  }
+
+  VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+  VK_CHECK_RESULT(vkFlushMappedMemoryRanges(m_Context->getDevice(), 1, &range));
+}
+
+void MemoryAllocator::invalidate(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+  if (!allocation.isValid() || isHostCoherent(allocation.memoryTypeIndex)) {
+    return;
+  }
+
+  VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+  VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(m_Context->getDevice(), 1, &range));
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Stats;
+}
+
+void MemoryAllocator::logStats() const {
+  auto stats = getStats();
+  LOG("Device memory allocations:", stats.deviceMemoryCount(), "(blocks:", stats.blockCount,
+      "dedicated:", stats.dedicatedCount, ") resources:", stats.allocationCount);
+  LOG("Device memory used:", stats.usedBytes, "of", stats.blockBytes + stats.dedicatedBytes, "bytes");
+}
+
+std::vector<MemoryAllocator::HeapStats> MemoryAllocator::getHeapStats() const {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  if (m_GetMemoryProperties2) {
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    m_GetMemoryProperties2(m_Context->getPhysicalDevice(), &memoryProperties2);
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  std::vector<HeapStats> heaps(m_MemoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++) {
+    auto& heap = heaps[i];
+    heap.flags = m_MemoryProperties.memoryHeaps[i].flags;
+    heap.size = m_MemoryProperties.memoryHeaps[i].size;
+    heap.reservedBytes = m_HeapCounters[i].reservedBytes;
+    heap.bufferBytes = m_HeapCounters[i].bufferBytes;
+    heap.imageBytes = m_HeapCounters[i].imageBytes;
+
+    if (m_GetMemoryProperties2) {
+      heap.budget = budgetProperties.heapBudget[i];
+      heap.usage = budgetProperties.heapUsage[i];
+    } else {
+      heap.budget = heap.size * kEstimatedBudgetPercent / 100;
+      heap.usage = heap.reservedBytes;
+    }
+  }
+  return heaps;
+}
+
+VkDeviceSize MemoryAllocator::getHeadroom(VkMemoryPropertyFlags properties) const {
+  uint32_t memoryTypeIndex = m_Context->findMemoryType(~0u, properties);
+  auto heaps = getHeapStats();
+  const auto& heap = heaps[getHeapIndex(memoryTypeIndex)];
+  return heap.budget > heap.usage ? heap.budget - heap.usage : 0;
+}
+
+MemoryBlock* MemoryAllocator::beginDefragmentation(float maxUsage) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_MoveSource) {
+    return m_MoveSource;
+  }
+
+  MemoryBlock* source = nullptr;
+  for (auto& pool : m_Pools) {
+    if (pool.blocks.size() < 2) {
+      continue;
+    }
+
+    VkDeviceSize freeBytes = 0;
+    for (auto& block : pool.blocks) {
+      freeBytes += block->size - block->used;
+    }
+
+    for (auto& block : pool.blocks) {
+      if (block->pinned || block->allocationCount == 0 || block->used > block->size * maxUsage) {
+        continue;
+      }
+      // Everything in the block has to fit in the free space of the others
+      VkDeviceSize siblingFreeBytes = freeBytes - (block->size - block->used);
+      if (block->used > siblingFreeBytes) {
+        continue;
+      }
+      if (!source || block->used * source->size < source->used * block->size) {
+        source = block.get();
+      }
+    }
+  }
+
+  if (source) {
+    source->moveSource = true;
+    m_MoveSource = source;
+    LOG("Defragmenting memory block of type", source->memoryTypeIndex, "with", source->used, "of", source->size,
+        "bytes used");
+  }
+  return source;
+}
+
+void MemoryAllocator::endDefragmentation(bool pin) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_MoveSource) {
+    m_MoveSource->moveSource = false;
+    m_MoveSource->pinned = pin;
+    m_MoveSource = nullptr;
+  }
+}
+
+MemoryBlock* MemoryAllocator::getMoveSource() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MoveSource;
+}
+
+uint32_t MemoryAllocator::getMoveSourceAllocationCount() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MoveSource ? m_MoveSource->allocationCount : 0;
+}
+
+bool MemoryAllocator::allocateForMove(const VkMemoryRequirements& requirements, const Allocation& current,
+                                      Allocation& allocation) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!current.block || !(requirements.memoryTypeBits & (1u << current.memoryTypeIndex))) {
+    return false;
+  }
+
+  auto& pool = getPool(current.memoryTypeIndex, current.block->kind);
+  for (auto& block : pool.blocks) {
+    if (block->moveSource || block->size - block->used < requirements.size) {
+      continue;
+    }
+    if (allocateFromBlock(block.get(), requirements.size, requirements.alignment, allocation)) {
+      trackAllocation(allocation, current.tag, current.image);
+      return true;
+    }
+  }
+  return false;
+}
+
+MemoryAllocator::Pool& MemoryAllocator::getPool(uint32_t memoryTypeIndex, ResourceKind kind) {
+  // With a granularity of 1 linear and optimal resources can safely share blocks
+  if (m_BufferImageGranularity <= 1) {
+    kind = ResourceKind::Linear;
+  }
+  return m_Pools[memoryTypeIndex * 2 + static_cast<uint32_t>(kind)];
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+  uint32_t heapIndex = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[heapIndex].size;
+  return heapSize <= kSmallHeapSize ? alignUp(heapSize / 8, 32) : kDefaultBlockSize;
+}
+
+bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+  return m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+bool MemoryAllocator::isHostCoherent(uint32_t memoryTypeIndex) const {
+  return m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+bool MemoryAllocator::hasMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+    if ((memoryTypeBits & (1u << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize size) {
+  LOGFN;
+  auto block = std::make_unique<MemoryBlock>();
+  block->size = size;
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->kind = kind;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+  VK_CHECK_RESULT(vkAllocateMemory(m_Context->getDevice(), &allocInfo, nullptr, &block->memory));
+
+  // Host visible blocks stay mapped for their whole lifetime
+  if (isHostVisible(memoryTypeIndex)) {
+    VK_CHECK_RESULT(vkMapMemory(m_Context->getDevice(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mappedData));
+  }
+
+  block->freeRanges.emplace(0, size);
+
+  m_Stats.blockCount++;
+  m_Stats.blockBytes += size;
+  m_HeapCounters[getHeapIndex(memoryTypeIndex)].reservedBytes += size;
+  LOG("Allocated memory block of", size, "bytes for memory type", memoryTypeIndex);
+
+  auto& pool = getPool(memoryTypeIndex, kind);
+  pool.blocks.push_back(std::move(block));
+  return pool.blocks.back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block) {
+  if (block->mappedData) {
+    vkUnmapMemory(m_Context->getDevice(), block->memory);
+  }
+  vkFreeMemory(m_Context->getDevice(), block->memory, nullptr);
+
+  m_Stats.blockCount--;
+  m_Stats.blockBytes -= block->size;
+  m_HeapCounters[getHeapIndex(block->memoryTypeIndex)].reservedBytes -= block->size;
+}
+
+bool MemoryAllocator::allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment,
+                                        Allocation& allocation) {
+  for (auto it = block->freeRanges.begin(); it != block->freeRanges.end(); ++it) {
+    VkDeviceSize rangeOffset = it->first;
+    VkDeviceSize rangeSize = it->second;
+
+    VkDeviceSize alignedOffset = alignUp(rangeOffset, alignment);
+    VkDeviceSize padding = alignedOffset - rangeOffset;
+    if (padding + size > rangeSize) {
+      continue;
+    }
+
+    block->freeRanges.erase(it);
+    if (padding > 0) {
+      block->freeRanges.emplace(rangeOffset, padding);
+    }
+    if (padding + size < rangeSize) {
+      block->freeRanges.emplace(alignedOffset + size, rangeSize - padding - size);
+    }
+
+    block->used += size;
+    block->allocationCount++;
+    m_Stats.usedBytes += size;
+    m_Stats.allocationCount++;
+
+    allocation.memory = block->memory;
+    allocation.offset = alignedOffset;
+    allocation.size = size;
+    allocation.mappedData = block->mappedData ? static_cast<char*>(block->mappedData) + alignedOffset : nullptr;
+    allocation.memoryTypeIndex = block->memoryTypeIndex;
+    allocation.dedicated = false;
+    allocation.block = block;
+    return true;
+  }
+
+  return false;
+}
+
+Allocation MemoryAllocator::allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size) {
+  Allocation allocation;
+  allocation.size = size;
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.dedicated = true;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+  VK_CHECK_RESULT(vkAllocateMemory(m_Context->getDevice(), &allocInfo, nullptr, &allocation.memory));
+
+  if (isHostVisible(memoryTypeIndex)) {
+    VK_CHECK_RESULT(
+        vkMapMemory(m_Context->getDevice(), allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mappedData));
+  }
+
+  m_Stats.dedicatedCount++;
+  m_Stats.dedicatedBytes += size;
+  m_HeapCounters[getHeapIndex(memoryTypeIndex)].reservedBytes += size;
+  m_Stats.usedBytes += size;
+  m_Stats.allocationCount++;
+  LOG("Dedicated allocation of", size, "bytes for memory type", memoryTypeIndex);
+
+  return allocation;
+}
+
+void MemoryAllocator::trackAllocation(Allocation& allocation, MemoryTag tag, bool image) {
+  allocation.tag = tag;
+  allocation.image = image;
+  m_Stats.tagCounts[static_cast<size_t>(tag)]++;
+  m_Stats.tagBytes[static_cast<size_t>(tag)] += allocation.size;
+
+  auto& heap = m_HeapCounters[getHeapIndex(allocation.memoryTypeIndex)];
+  (image ? heap.imageBytes : heap.bufferBytes) += allocation.size;
+}
+
+VkMappedMemoryRange MemoryAllocator::getMappedRange(const Allocation& allocation, VkDeviceSize offset,
+                                                    VkDeviceSize size) const {
+  if (size == VK_WHOLE_SIZE) {
+    size = allocation.size - offset;
+  }
+
+  // Ranges have to be multiples of nonCoherentAtomSize, and may not exceed the memory object
+  VkDeviceSize memorySize = allocation.block ? allocation.block->size : allocation.size;
+  VkDeviceSize begin = alignDown(allocation.offset + offset, m_NonCoherentAtomSize);
+  VkDeviceSize end = alignUp(allocation.offset + offset + size, m_NonCoherentAtomSize);
+
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = allocation.memory;
+  range.offset = begin;
+  range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+  return range;
+}
+
+}  // namespace glint
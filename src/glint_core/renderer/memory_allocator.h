@@ -0,0 +1,208 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace glint {
+
+class VkContext;
+struct MemoryBlock;
+
+// Subsystem an allocation belongs to, used for the per subsystem memory counters
+enum class MemoryTag : uint8_t { Unknown, Mesh, Texture, SwapChain, Uniform, Staging, Count };
+constexpr size_t kMemoryTagCount = static_cast<size_t>(MemoryTag::Count);
+
+const char* memoryTagName(MemoryTag tag);
+
+// A sub-range of a VkDeviceMemory block handed out by the MemoryAllocator.
+// Resources bind at (memory, offset); mappedData is non-null for host visible memory.
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mappedData = nullptr;
+  uint32_t memoryTypeIndex = 0;
+  bool dedicated = false;
+  MemoryTag tag = MemoryTag::Unknown;
+  bool image = false;
+
+  // Owning block, null for dedicated allocations
+  MemoryBlock* block = nullptr;
+
+  bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// Kind of resource bound to an allocation. Linear (buffers, linear images) and optimal resources are kept in separate
+// pools so that neighbouring allocations never violate bufferImageGranularity.
+enum class ResourceKind { Linear, Optimal };
+
+struct MemoryBlock {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  VkDeviceSize used = 0;
+  void* mappedData = nullptr;
+  uint32_t memoryTypeIndex = 0;
+  ResourceKind kind = ResourceKind::Linear;
+  uint32_t allocationCount = 0;
+
+  // Being emptied by the defragmenter, no new allocations are placed in it
+  bool moveSource = false;
+  // Holds allocations the defragmenter can't move, don't pick it again
+  bool pinned = false;
+
+  // Free ranges keyed by offset, value is the range size. Adjacent ranges are merged on free.
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
+
+// Block based device memory allocator. Allocates large VkDeviceMemory blocks per memory type and sub-allocates from
+// them with a first-fit free list, so the number of vkAllocateMemory calls stays flat as resource count grows.
+// Large images (and anything that doesn't fit in a block) get a dedicated allocation.
+// Requests for VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT always get a dedicated allocation so the driver can back each
+// transient attachment on demand, and fall back to plain device local memory on devices that don't offer it.
+class MemoryAllocator {
+ public:
+  struct Stats {
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize blockBytes = 0;
+    VkDeviceSize dedicatedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+
+    // Live allocations and bytes per MemoryTag
+    uint32_t tagCounts[kMemoryTagCount]{};
+    VkDeviceSize tagBytes[kMemoryTagCount]{};
+
+    // Number of live vkAllocateMemory allocations
+    uint32_t deviceMemoryCount() const { return blockCount + dedicatedCount; }
+  };
+
+  // Usage of a memory heap. Budget and usage come from VK_EXT_memory_budget when available and cover the whole
+  // process, otherwise they are estimated from the heap size and this allocator's own allocations.
+  struct HeapStats {
+    VkMemoryHeapFlags flags = 0;
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+
+    // This allocator's device memory on the heap, and how much of it is bound to buffers / images
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize bufferBytes = 0;
+    VkDeviceSize imageBytes = 0;
+
+    bool isDeviceLocal() const { return flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT; }
+  };
+
+  MemoryAllocator(VkContext* context);
+  ~MemoryAllocator();
+
+  // Prevent copying
+  MemoryAllocator(const MemoryAllocator&) = delete;
+  MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+  // Raw allocations are counted as buffer memory in the heap stats
+  Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind,
+                      MemoryTag tag = MemoryTag::Unknown, bool preferDedicated = false);
+
+  // Allocate and bind memory for a resource
+  Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryTag tag = MemoryTag::Unknown);
+  Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling,
+                              MemoryTag tag = MemoryTag::Unknown);
+
+  // Bind several images to the start of one shared allocation sized for the largest of them. Only valid for images
+  // whose contents are never live at the same time, e.g. an attachment only used inside a render pass and an image
+  // only used outside of it. Free the allocation once, after all images are destroyed.
+  Allocation allocateAliased(const std::vector<VkImage>& images, VkMemoryPropertyFlags properties,
+                             MemoryTag tag = MemoryTag::Unknown);
+
+  void free(Allocation& allocation);
+
+  // Flush / invalidate a range of a host visible allocation. No-op for host coherent memory.
+  // Offset and size are relative to the allocation and get expanded to nonCoherentAtomSize.
+  void flush(const Allocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+  void invalidate(const Allocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+  Stats getStats() const;
+  void logStats() const;
+
+  // Per heap usage, queries the driver budget so it is cheap enough to call once per frame but not per allocation
+  std::vector<HeapStats> getHeapStats() const;
+
+  // Whether the device has memory types with VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, typically tiled GPUs
+  bool isLazyAllocationSupported() const { return m_LazyAllocationSupported; }
+
+  // Whether heap budgets come from VK_EXT_memory_budget rather than an estimate
+  bool hasDriverBudget() const { return m_GetMemoryProperties2 != nullptr; }
+
+  // Bytes that can still be allocated from the heap backing memory with these properties before going over budget.
+  // Samples can check this before loading more assets.
+  VkDeviceSize getHeadroom(VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) const;
+
+  // Defragmentation support, driven by the Defragmenter. One block at a time is picked as the move source and emptied
+  // by moving its resources into other blocks of the same pool, the block is released once its last allocation is
+  // freed. Picks the sparsest block used below maxUsage whose contents fit into its siblings, null if there is none.
+  MemoryBlock* beginDefragmentation(float maxUsage);
+  // Stop moving out of the current source, pin it if it holds allocations that can't be moved
+  void endDefragmentation(bool pin);
+  // Current move source, null once it has been released
+  MemoryBlock* getMoveSource() const;
+  uint32_t getMoveSourceAllocationCount() const;
+  // Allocate space for a resource moving out of the source block, only existing sibling blocks are considered
+  bool allocateForMove(const VkMemoryRequirements& requirements, const Allocation& current, Allocation& allocation);
+
+ private:
+  struct Pool {
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+  };
+
+  Pool& getPool(uint32_t memoryTypeIndex, ResourceKind kind);
+  VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+  bool isHostVisible(uint32_t memoryTypeIndex) const;
+  bool isHostCoherent(uint32_t memoryTypeIndex) const;
+  bool hasMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+
+  MemoryBlock* createBlock(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize size);
+  void destroyBlock(MemoryBlock* block);
+  bool allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+  Allocation allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size);
+  Allocation allocateResource(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                              ResourceKind kind, MemoryTag tag, bool image, bool preferDedicated);
+  void trackAllocation(Allocation& allocation, MemoryTag tag, bool image);
+
+  uint32_t getHeapIndex(uint32_t memoryTypeIndex) const {
+    return m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  }
+
+  VkMappedMemoryRange getMappedRange(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+ private:
+  VkContext* m_Context;
+
+  VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+  VkDeviceSize m_BufferImageGranularity = 1;
+  VkDeviceSize m_NonCoherentAtomSize = 1;
+  bool m_LazyAllocationSupported = false;
+
+  // Indexed by memoryTypeIndex * 2 + ResourceKind
+  std::vector<Pool> m_Pools;
+
+  // Set when VK_EXT_memory_budget is enabled
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_GetMemoryProperties2 = nullptr;
+
+  struct HeapCounters {
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize bufferBytes = 0;
+    VkDeviceSize imageBytes = 0;
+  };
+
+  Stats m_Stats;
+  std::vector<HeapCounters> m_HeapCounters;
+  MemoryBlock* m_MoveSource = nullptr;
+  mutable std::mutex m_Mutex;
+};
+
+}  // namespace glint
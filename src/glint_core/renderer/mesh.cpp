@@ -1,227 +1,212 @@
 #include "mesh.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
 
+#include "core/camera.h"
+#include "core/config.h"
 #include "core/logger.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+#include "transfer_manager.h"
+#include "vertex_dedup.h"
 #include "vk_context.h"
-#include "vk_utils.h"
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
-namespace std {
-template <>
-struct hash<glint::Vertex> {
-  size_t operator()(glint::Vertex const& vertex) const {
-    return ((hash<glm::vec3>()(vertex.position) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-           (hash<glm::vec2>()(vertex.texCoord) << 1);
-  }
-};
-}  // namespace std
 
 namespace glint {
 
-// TODO: Seperate the model loading and vulkan buffer creation
-std::unique_ptr<Mesh> loadModel(VkContext* context, const std::string modelPath) {
+MeshData Mesh::loadObj(const std::string& modelPath, uint32_t threadCount) {
   LOGFN;
 
   LOG("Load Model");
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string warn, err;
+  // One vertex per face corner, deduplicated below. obj_parser_threads 0 parses on every hardware thread.
+  uint32_t parseThreads =
+      threadCount > 0 ? threadCount : std::stoul(Config::getCustomeOption("obj_parser_threads", "0"));
+  std::vector<Vertex> stream = ObjParser::parse(modelPath, parseThreads);
 
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, modelPath.c_str())) {
-    throw std::runtime_error(warn + err);
+  if (Config::isOptionSet("benchmark_dedup")) {
+    VertexDeduplicator::benchmark(stream);
   }
 
-  std::vector<Vertex> vertices;
-  std::vector<uint32_t> indices;
+  // dedup_threads 0 shards large models over every hardware thread
+  if (threadCount == 0) {
+    threadCount = std::stoul(Config::getCustomeOption("dedup_threads", "0"));
+  }
+  if (threadCount == 0) {
+    threadCount = stream.size() >= VertexDeduplicator::kParallelThreshold
+                      ? std::max(1u, std::thread::hardware_concurrency())
+                      : 1;
+  }
 
-  LOG("Vertex Count in model: ", attrib.vertices.size() / 3);
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+  MeshData data;
+  VertexDeduplicator::deduplicate(stream, data.vertices, data.indices, threadCount);
 
-  for (const auto& shape : shapes) {
-    for (const auto& index : shape.mesh.indices) {
-      Vertex vertex{};
-      vertex.position = {attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1],
-                         attrib.vertices[3 * index.vertex_index + 2]};
+  LOG("Unique Vertex Count: ", data.vertices.size());
 
-      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
-                         1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+  return data;
+}
 
-      vertex.color = {1.0f, 1.0f, 1.0f};
+Mesh::Mesh(VkContext* context, std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+           VertexAttributeFlags flags, std::span<const MeshLod> lods, const MeshBounds* bounds)
+    : m_Context(context), m_FormatFlags(flags), m_Lods(lods.begin(), lods.end()) {
+  LOGFN;
+  if (m_Lods.empty() && !indices.empty()) {
+    m_Lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+  }
+
+  m_Bounds = bounds ? *bounds : Bounds::compute(vertices);
 
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-        vertices.push_back(vertex);
-      }
+  std::span<const std::byte> vertexData = std::as_bytes(vertices);
+  uint32_t vertexStride = sizeof(Vertex);
+  std::vector<QuantizedVertex> quantizedVertices;
+  if (hasAttribute(flags, VertexAttributeFlags::Quantized) && !vertices.empty()) {
+    m_Quantization = VertexQuantization::fromBounds(m_Bounds.box.min, m_Bounds.box.max);
 
-      indices.push_back(uniqueVertices[vertex]);
+    quantizedVertices.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+      quantizedVertices.push_back(m_Quantization.encode(vertex));
     }
+    vertexData = std::as_bytes(std::span<const QuantizedVertex>(quantizedVertices));
+    vertexStride = sizeof(QuantizedVertex);
+  }
+
+  // Indices are relative to the mesh's vertex offset, so 16 bits suffice whenever the mesh itself is small enough
+  std::span<const std::byte> indexData = std::as_bytes(indices);
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+  std::vector<uint16_t> shortIndices;
+  if (!indices.empty() && vertices.size() <= kMaxShortIndexVertices) {
+    shortIndices.assign(indices.begin(), indices.end());
+    indexData = std::as_bytes(std::span<const uint16_t>(shortIndices));
+    indexType = VK_INDEX_TYPE_UINT16;
   }
 
-  LOG("Unique Vertex Count: ", vertices.size());
+  if (hasAttribute(flags, VertexAttributeFlags::SplitStreams) && !vertices.empty()) {
+    // Cut every vertex after its position, depth only passes then read the positions alone
+    uint32_t positionStride = Vertex::getPositionStride(flags);
+    uint32_t attributeStride = vertexStride - positionStride;
+    std::vector<std::byte> positions(vertices.size() * positionStride);
+    std::vector<std::byte> attributes(vertices.size() * attributeStride);
+    for (size_t i = 0; i < vertices.size(); i++) {
+      const std::byte* vertex = vertexData.data() + i * vertexStride;
+      std::memcpy(positions.data() + i * positionStride, vertex, positionStride);
+      std::memcpy(attributes.data() + i * attributeStride, vertex + positionStride, attributeStride);
+    }
+    m_Range = m_Context->getGeometryPool()->addSplit(positions, positionStride, attributes, attributeStride, indexData,
+                                                     indexType, &m_UploadId);
+  } else {
+    m_Range = m_Context->getGeometryPool()->add(vertexData, vertexStride, indexData, indexType, &m_UploadId);
+  }
 
-  return std::make_unique<Mesh>(context, vertices, indices, VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+  LOG("Mesh created with", vertices.size(), "vertices and", indices.size(), "indices in", m_Lods.size(), "LODs,",
+      vertexData.size() / 1024, "KB of vertices and", indexData.size() / 1024, "KB of indices");
 }
 
-Mesh::Mesh(VkContext* context, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
-           VertexAttributeFlags flags)
-    : m_Context(context),
-      m_Vertices(vertices),
-      m_Indices(indices),
-      m_IndexCount(static_cast<uint32_t>(indices.size())),
-      m_VertexCount(static_cast<uint32_t>(vertices.size())),
-      m_HasIndices(!indices.empty()),
-      m_FormatFlags(flags) {
+Mesh::Mesh(VkContext* context, uint32_t vertexCount, uint32_t indexCount, const GenerateCallback& generate)
+    : m_Context(context), m_FormatFlags(VertexAttributeFlags::POSITION_COLOR_TEXCOORD) {
   LOGFN;
-  createVertexBuffer();
-  if (m_HasIndices) {
-    createIndexBuffer();
+  if (indexCount > 0) {
+    m_Lods.push_back({0, indexCount, 0.0f});
   }
 
-  LOG("Mesh created with", m_Vertices.size(), "vertices and", m_Indices.size(), "indices");
+  VkIndexType indexType =
+      indexCount > 0 && vertexCount <= kMaxShortIndexVertices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  auto write = [&](std::span<std::byte> vertexData, std::span<std::byte> indexData) {
+    m_Bounds =
+        generate(std::span<Vertex>(reinterpret_cast<Vertex*>(vertexData.data()), vertexCount), indexData, indexType);
+  };
+  m_Range = m_Context->getGeometryPool()->addGenerated(vertexCount, sizeof(Vertex), indexCount, indexType, write,
+                                                       &m_UploadId);
+
+  LOG("Generated mesh with", vertexCount, "vertices and", indexCount, "indices");
 }
 
 Mesh::~Mesh() {
   LOGFN;
-  VkDevice device = m_Context->getDevice();
-
-  LOGCALL(vkDestroyBuffer(device, m_VertexBuffer, nullptr));
-  LOGCALL(vkFreeMemory(device, m_VertexBufferMemory, nullptr));
-
-  if (m_HasIndices) {
-    LOGCALL(vkDestroyBuffer(device, m_IndexBuffer, nullptr));
-    LOGCALL(vkFreeMemory(device, m_IndexBufferMemory, nullptr));
-  }
+  // The range must not be reused while the upload is writing it
+  m_Context->getTransferManager()->wait(m_UploadId);
+  m_Context->getGeometryPool()->free(m_Range);
 }
 
-std::unique_ptr<Mesh> Mesh::loadModel(VkContext* context, const std::string modelPath) {
-  return glint::loadModel(context, modelPath);
+std::unique_ptr<Mesh> Mesh::loadModel(VkContext* context, const std::string modelPath, VertexAttributeFlags flags) {
+  // The mesh only reads the geometry while uploading in its constructor
+  auto geometry = loadGeometry(modelPath);
+  return std::make_unique<Mesh>(context, geometry->vertices, geometry->indices, flags, geometry->lods,
+                                &geometry->bounds);
 }
 
-void Mesh::createVertexBuffer() {
+std::unique_ptr<LoadedMesh> Mesh::loadGeometry(const std::string& modelPath, uint32_t threadCount) {
   LOGFN;
-  VkDeviceSize bufferSize = sizeof(m_Vertices[0]) * m_Vertices.size();
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-
-  VkUtils::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                        stagingBufferMemory);
-
-  void* data;
-  vkMapMemory(m_Context->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, m_Vertices.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(m_Context->getDevice(), stagingBufferMemory);
-
-  VkUtils::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
+  // Options that change the loaded geometry are part of the cache key
+  bool optimize = Config::isOptionSet("optimize_meshes");
+  float overdrawThreshold = std::stof(Config::getCustomeOption("overdraw_threshold", "1.05"));
+  uint32_t maxLods = Config::isOptionSet("disable_mesh_lods") ? 1 : MeshSimplifier::kMaxLods;
+  std::string loaderOptions = optimize ? "optimize overdraw=" + std::to_string(overdrawThreshold) : "";
+  loaderOptions += " lods=" + std::to_string(maxLods);
+
+  if (auto cached = MeshCache::load(modelPath, loaderOptions)) {
+    return cached;
+  }
 
-  copyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
+  auto geometry = std::make_unique<LoadedMesh>();
+  geometry->data = loadObj(modelPath, threadCount);
+  if (optimize) {
+    MeshOptimizer::optimize(geometry->data, overdrawThreshold);
+  }
+  if (maxLods > 1) {
+    MeshSimplifier::buildLods(geometry->data, optimize, maxLods);
+  }
+  geometry->vertices = geometry->data.vertices;
+  geometry->indices = geometry->data.indices;
+  geometry->lods = geometry->data.lods;
+  geometry->bounds = Bounds::compute(geometry->vertices);
 
-  vkDestroyBuffer(m_Context->getDevice(), stagingBuffer, nullptr);
-  vkFreeMemory(m_Context->getDevice(), stagingBufferMemory, nullptr);
+  MeshCache::store(modelPath, loaderOptions, *geometry);
+  return geometry;
 }
 
-void Mesh::createIndexBuffer() {
-  LOGFN;
-  VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-
-  VkUtils::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                        stagingBufferMemory);
+VkBuffer Mesh::getVertexBuffer() const { return m_Context->getGeometryPool()->getVertexBuffer(m_Range.block); }
 
-  void* data;
-  vkMapMemory(m_Context->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, m_Indices.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(m_Context->getDevice(), stagingBufferMemory);
-
-  VkUtils::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
-
-  copyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
-
-  vkDestroyBuffer(m_Context->getDevice(), stagingBuffer, nullptr);
-  vkFreeMemory(m_Context->getDevice(), stagingBufferMemory, nullptr);
+void Mesh::bind(VkCommandBuffer commandBuffer) {
+  LOGFN_ONCE;
+  m_Context->getGeometryPool()->bind(commandBuffer, m_Range);
 }
 
-// TODO: Remove this function
-void Mesh::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-  LOGFN;
-  // auto commandManager = m_Context->getCommandManager();
-  // VkCommandBuffer commandBuffer = m_Context->beginSingleTimeCommands();
-
-  // VkBufferCopy copyRegion{};
-  // copyRegion.size = size;
-  // vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  // m_Context->endSingleTimeCommands(commandBuffer);
-
-  auto commandPool = m_Context->getCommandPool();
-  auto device = m_Context->getDevice();
-
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-  VkCommandBufferBeginInfo beginInfo{};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-  VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-
-  auto graphicsQueue = m_Context->getGraphicsQueue();
-  vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue);
-
-  vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+void Mesh::draw(VkCommandBuffer commandBuffer, uint32_t lod) {
+  LOGFN_ONCE;
+  if (!m_Lods.empty()) {
+    const MeshLod& level = m_Lods[std::min<size_t>(lod, m_Lods.size() - 1)];
+    vkCmdDrawIndexed(commandBuffer, level.indexCount, 1, m_Range.firstIndex + level.firstIndex,
+                     static_cast<int32_t>(m_Range.vertexOffset), 0);
+  } else {
+    vkCmdDraw(commandBuffer, m_Range.vertexCount, 1, m_Range.vertexOffset, 0);
+  }
 }
 
-void Mesh::bind(VkCommandBuffer commandBuffer) {
-  LOGFN_ONCE;
-  VkBuffer buffers[] = {m_VertexBuffer};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+uint32_t Mesh::selectLod(const Camera& camera, const glm::mat4& model, float viewportHeight,
+                         float maxPixelError) const {
+  if (m_Lods.size() <= 1) {
+    return 0;
+  }
 
-  if (m_HasIndices) {
-    vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  // Errors grow with the largest axis scale of the model matrix, like the sphere's radius
+  BoundingSphere sphere = Bounds::transform(m_Bounds.sphere, model);
+  float scale = m_Bounds.sphere.radius > 0.0f ? sphere.radius / m_Bounds.sphere.radius : 1.0f;
+  float distance = glm::length(sphere.center - camera.getPosition()) - sphere.radius;
+  if (distance <= 0.0f) {
+    return 0;
   }
-}
 
-void Mesh::draw(VkCommandBuffer commandBuffer) {
-  LOGFN_ONCE;
-  if (m_HasIndices) {
-    vkCmdDrawIndexed(commandBuffer, m_IndexCount, 1, 0, 0, 0);
-  } else {
-    vkCmdDraw(commandBuffer, m_VertexCount, 1, 0, 0);
+  // Pixels covered by one model unit at that distance, projection[1][1] is 1 / tan(fovY / 2)
+  float pixelsPerUnit = std::abs(camera.getProjectionMatrix()[1][1]) * viewportHeight * 0.5f * scale / distance;
+
+  uint32_t lod = 0;
+  while (lod + 1 < m_Lods.size() && m_Lods[lod + 1].error * pixelsPerUnit <= maxPixelError) {
+    lod++;
   }
+  return lod;
 }
 
-}  // namespace glint
\ No newline at end of file
+}  // namespace glint
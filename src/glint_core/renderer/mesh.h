@@ -3,58 +3,122 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <functional>
 #include <glm/glm.hpp>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "bounds.h"
+#include "geometry_pool.h"
 #include "vertex.h"
 
 namespace glint {
 
 class VkContext;
 class CommandManager;
+class Camera;
+struct LoadedMesh;
+
+// A level of detail of a mesh, a range of its index data drawn with the same vertices. LOD 0 is the full mesh.
+struct MeshLod {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  // Largest deviation from the full mesh, in model units
+  float error = 0.0f;
+};
+
+// CPU side geometry, independent of Vulkan so models can be parsed on any thread
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  // Index ranges of the LOD chain, empty when the indices are a single level
+  std::vector<MeshLod> lods;
+};
 
+// Geometry stored in the context's GeometryPool. A Mesh only owns its range in the pool, meshes in the same pool
+// block share the vertex / index buffer binding.
+// With VertexAttributeFlags::Quantized the vertices are stored as QuantizedVertex, the pipeline must use the same
+// flags and the model matrix must include getDequantizeMatrix(). Meshes of up to 65536 vertices use 16-bit indices.
+// All LODs share the vertices and are stored back to back in the mesh's index range.
+// With VertexAttributeFlags::SplitStreams the positions are stored apart from the other attributes, so pipelines that
+// only declare VertexAttributeFlags::SPLIT_POSITION fetch 12 bytes per vertex, 8 when quantized.
 class Mesh {
  public:
-  Mesh(VkContext* context, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices = {},
-       VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+  // Copies the geometry into staging memory, the spans only need to stay valid for the constructor.
+  // Without lods the indices are drawn as a single level. Without bounds they are computed from the vertices.
+  Mesh(VkContext* context, std::span<const Vertex> vertices, std::span<const uint32_t> indices = {},
+       VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD, std::span<const MeshLod> lods = {},
+       const MeshBounds* bounds = nullptr);
+
+  // Fills the vertices and indices of a generated mesh, indexData holds the indices as indexType. Returns the bounds
+  // of the generated positions.
+  using GenerateCallback =
+      std::function<MeshBounds(std::span<Vertex> vertices, std::span<std::byte> indexData, VkIndexType indexType)>;
+
+  // Generates the geometry straight into staging memory instead of copying it there. Always full precision
+  // interleaved vertices and a single LOD.
+  Mesh(VkContext* context, uint32_t vertexCount, uint32_t indexCount, const GenerateCallback& generate);
   ~Mesh();
 
   // Prevent copying
   Mesh(const Mesh&) = delete;
   Mesh& operator=(const Mesh&) = delete;
 
+  // Binds the pool block, skip it between meshes of the same block and index type. Split stream meshes are bound at
+  // their own offsets and always need it.
   void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer);
+  void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
 
-  VkBuffer getVertexBuffer() const { return m_VertexBuffer; }
+  // Coarsest LOD whose error projects to at most maxPixelError pixels through the camera's projection, measured at
+  // the point of the bounding sphere closest to the camera. model is the object's world transform, without the
+  // dequantize matrix.
+  uint32_t selectLod(const Camera& camera, const glm::mat4& model, float viewportHeight,
+                     float maxPixelError = 1.0f) const;
 
-  static std::unique_ptr<Mesh> loadModel(VkContext* context, const std::string modelPath);
+  VkBuffer getVertexBuffer() const;
+  const GeometryPool::Range& getRange() const { return m_Range; }
+  uint32_t getVertexCount() const { return m_Range.vertexCount; }
+  uint32_t getIndexCount() const { return m_Range.indexCount; }
+  VertexAttributeFlags getFormat() const { return m_FormatFlags; }
+  uint32_t getLodCount() const { return static_cast<uint32_t>(m_Lods.size()); }
+  const MeshLod& getLod(uint32_t lod) const { return m_Lods[lod]; }
 
- private:
-  // void createVertexBuffer(const std::vector<Vertex>& vertices);
-  void createVertexBuffer();
-  // void createIndexBuffer(const std::vector<uint32_t>& indices);
-  void createIndexBuffer();
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  // Model space, without the dequantize matrix
+  const MeshBounds& getBounds() const { return m_Bounds; }
+
+  // Identity unless quantized
+  glm::mat4 getDequantizeMatrix() const { return m_Quantization.getMatrix(); }
+
+  static std::unique_ptr<Mesh> loadModel(VkContext* context, const std::string modelPath,
+                                         VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+
+  // Map the model's MeshCache file, or parse the OBJ, build its LOD chain and write the cache. threadCount is passed
+  // to loadObj. Throws on failure. Thread safe, no Vulkan calls.
+  static std::unique_ptr<LoadedMesh> loadGeometry(const std::string& modelPath, uint32_t threadCount = 0);
+
+  // Parse an OBJ file and deduplicate its vertices on threadCount threads, 0 for the obj_parser_threads and
+  // dedup_threads options. Throws on failure. Thread safe, no Vulkan calls.
+  static MeshData loadObj(const std::string& modelPath, uint32_t threadCount = 0);
+
+  // Bump when loadObj output changes, invalidates every mesh cache
+  static constexpr uint32_t kObjLoaderVersion = 2;
+
+  static constexpr size_t kMaxShortIndexVertices = 65536;
 
  private:
   VkContext* m_Context;
 
   VertexAttributeFlags m_FormatFlags;
-  const std::vector<Vertex>& m_Vertices;
-  const std::vector<uint32_t>& m_Indices;
-
-  VkBuffer m_VertexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory m_VertexBufferMemory = VK_NULL_HANDLE;
+  VertexQuantization m_Quantization;
+  GeometryPool::Range m_Range;
+  std::vector<MeshLod> m_Lods;
 
-  VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory m_IndexBufferMemory = VK_NULL_HANDLE;
+  MeshBounds m_Bounds;
 
-  uint32_t m_IndexCount = 0;
-  uint32_t m_VertexCount = 0;
-  bool m_HasIndices = false;
+  // Pending TransferManager upload of the vertices and indices
+  uint64_t m_UploadId = 0;
 };
 
 }  // namespace glint
\ No newline at end of file
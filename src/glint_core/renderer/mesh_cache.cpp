@@ -0,0 +1,218 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include "core/config.h"
+#include "core/logger.h"
+
+namespace glint {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x48534d47;  // "GMSH"
+constexpr uint32_t kFormatVersion = 3;
+constexpr uint64_t kPageSize = 4096;
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t vertexStride;
+  uint32_t attributeFlags;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t lodCount;
+  uint32_t lodOffset;
+  float boundsMin[3];
+  float boundsMax[3];
+  float sphereCenter[3];
+  float sphereRadius;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t fileSize;
+};
+
+// FNV-1a, stable across runs and platforms unlike std::hash
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint64_t alignToPage(uint64_t offset) { return (offset + kPageSize - 1) & ~(kPageSize - 1); }
+
+std::filesystem::path getSourcePath(const std::string& modelPath) {
+  std::error_code error;
+  auto path = std::filesystem::absolute(modelPath, error);
+  return error ? std::filesystem::path(modelPath) : path.lexically_normal();
+}
+
+// Changes whenever the source model, the loader or the cache format changes. 0 if the source can't be read.
+uint64_t computeKey(const std::filesystem::path& sourcePath, const std::string& loaderOptions) {
+  std::error_code error;
+  uint64_t size = std::filesystem::file_size(sourcePath, error);
+  if (error) {
+    return 0;
+  }
+  int64_t writeTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+  if (error) {
+    return 0;
+  }
+
+  std::string path = sourcePath.generic_string();
+  uint64_t key = hashBytes(path.data(), path.size());
+  key = hashBytes(&size, sizeof(size), key);
+  key = hashBytes(&writeTime, sizeof(writeTime), key);
+  key = hashBytes(&Mesh::kObjLoaderVersion, sizeof(Mesh::kObjLoaderVersion), key);
+  key = hashBytes(loaderOptions.data(), loaderOptions.size(), key);
+  key = hashBytes(&kFormatVersion, sizeof(kFormatVersion), key);
+  return key;
+}
+
+// Named after the source path only, so a stale cache is overwritten rather than left behind
+std::filesystem::path getCachePath(const std::filesystem::path& sourcePath) {
+  std::string path = sourcePath.generic_string();
+  std::ostringstream name;
+  name << sourcePath.stem().string() << "_" << std::hex << hashBytes(path.data(), path.size()) << ".glintmesh";
+  return std::filesystem::path(Config::getCustomeOption("mesh_cache_dir", "mesh_cache")) / name.str();
+}
+
+bool isValid(const MeshCacheHeader& header, uint64_t key, size_t fileSize) {
+  if (fileSize < sizeof(MeshCacheHeader) || header.magic != kMagic || header.version != kFormatVersion ||
+      header.key != key || header.vertexStride != sizeof(Vertex) || header.fileSize != fileSize) {
+    return false;
+  }
+
+  uint64_t vertexEnd = header.vertexOffset + static_cast<uint64_t>(header.vertexCount) * sizeof(Vertex);
+  uint64_t indexEnd = header.indexOffset + static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+  uint64_t lodEnd = header.lodOffset + static_cast<uint64_t>(header.lodCount) * sizeof(MeshLod);
+  return header.vertexCount > 0 && header.vertexOffset % kPageSize == 0 && header.indexOffset % kPageSize == 0 &&
+         header.lodOffset % alignof(MeshLod) == 0 && vertexEnd <= fileSize && indexEnd <= fileSize &&
+         lodEnd <= header.vertexOffset;
+}
+
+}  // namespace
+
+bool MeshCache::isEnabled() { return !Config::isOptionSet("disable_mesh_cache"); }
+
+std::unique_ptr<LoadedMesh> MeshCache::load(const std::string& modelPath, const std::string& loaderOptions) {
+  if (!isEnabled()) {
+    return nullptr;
+  }
+
+  auto sourcePath = getSourcePath(modelPath);
+  uint64_t key = computeKey(sourcePath, loaderOptions);
+  auto cachePath = getCachePath(sourcePath);
+  std::error_code error;
+  if (key == 0 || !std::filesystem::exists(cachePath, error)) {
+    return nullptr;
+  }
+
+  auto mesh = std::make_unique<LoadedMesh>();
+  try {
+    mesh->file = std::make_unique<MappedFile>(cachePath.string());
+  } catch (const std::exception& e) {
+    LOG("[WARNING]", e.what());
+    return nullptr;
+  }
+
+  const uint8_t* data = mesh->file->getData();
+  MeshCacheHeader header;
+  std::memcpy(&header, data, std::min(sizeof(header), mesh->file->getSize()));
+  if (!isValid(header, key, mesh->file->getSize())) {
+    LOG("Mesh cache", cachePath.string(), "is stale");
+    return nullptr;
+  }
+
+  mesh->vertices = {reinterpret_cast<const Vertex*>(data + header.vertexOffset), header.vertexCount};
+  mesh->indices = {reinterpret_cast<const uint32_t*>(data + header.indexOffset), header.indexCount};
+  mesh->lods = {reinterpret_cast<const MeshLod*>(data + header.lodOffset), header.lodCount};
+  for (const auto& lod : mesh->lods) {
+    if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > header.indexCount) {
+      LOG("Mesh cache", cachePath.string(), "is stale");
+      return nullptr;
+    }
+  }
+  mesh->bounds.box.min = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+  mesh->bounds.box.max = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+  mesh->bounds.sphere.center = {header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]};
+  mesh->bounds.sphere.radius = header.sphereRadius;
+
+  LOG("Mapped mesh cache", cachePath.string(), "with", header.vertexCount, "vertices,", header.indexCount,
+      "indices and", header.lodCount, "LODs");
+  return mesh;
+}
+
+void MeshCache::store(const std::string& modelPath, const std::string& loaderOptions, const LoadedMesh& mesh) {
+  if (!isEnabled() || mesh.vertices.empty() || mesh.indices.empty()) {
+    return;
+  }
+
+  auto sourcePath = getSourcePath(modelPath);
+  uint64_t key = computeKey(sourcePath, loaderOptions);
+  if (key == 0) {
+    return;
+  }
+
+  MeshCacheHeader header{};
+  header.magic = kMagic;
+  header.version = kFormatVersion;
+  header.key = key;
+  header.vertexStride = sizeof(Vertex);
+  header.attributeFlags = static_cast<uint32_t>(VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+  header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+  header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+  header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+  std::memcpy(header.boundsMin, &mesh.bounds.box.min, sizeof(header.boundsMin));
+  std::memcpy(header.boundsMax, &mesh.bounds.box.max, sizeof(header.boundsMax));
+  std::memcpy(header.sphereCenter, &mesh.bounds.sphere.center, sizeof(header.sphereCenter));
+  header.sphereRadius = mesh.bounds.sphere.radius;
+
+  // The LOD table shares the header's page
+  header.lodOffset = static_cast<uint32_t>(sizeof(MeshCacheHeader));
+  header.vertexOffset = alignToPage(header.lodOffset + mesh.lods.size_bytes());
+  header.indexOffset = alignToPage(header.vertexOffset + mesh.vertices.size_bytes());
+  header.fileSize = header.indexOffset + mesh.indices.size_bytes();
+
+  auto cachePath = getCachePath(sourcePath);
+  std::error_code error;
+  std::filesystem::create_directories(cachePath.parent_path(), error);
+
+  // Written under a per thread name and renamed, loaders of the same model may race
+  std::ostringstream tempName;
+  tempName << cachePath.string() << "." << std::this_thread::get_id() << ".tmp";
+  std::filesystem::path tempPath = tempName.str();
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    auto writeAt = [&file](uint64_t offset, const void* bytes, size_t size) {
+      file.seekp(static_cast<std::streamoff>(offset));
+      file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.lodOffset, mesh.lods.data(), mesh.lods.size_bytes());
+    writeAt(header.vertexOffset, mesh.vertices.data(), mesh.vertices.size_bytes());
+    writeAt(header.indexOffset, mesh.indices.data(), mesh.indices.size_bytes());
+    if (!file) {
+      LOG("[WARNING] Failed to write mesh cache", tempPath.string());
+      file.close();
+      std::filesystem::remove(tempPath, error);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return;
+  }
+  LOG("Wrote mesh cache", cachePath.string());
+}
+
+}  // namespace glint
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "core/mapped_file.h"
+#include "mesh.h"
+
+namespace glint {
+
+// Geometry ready for upload, mapped from a cache file or, when there is none, parsed into data.
+// The spans point into whichever of the two backs them.
+struct LoadedMesh {
+  std::span<const Vertex> vertices;
+  std::span<const uint32_t> indices;
+  std::span<const MeshLod> lods;
+  MeshBounds bounds;
+
+  std::unique_ptr<MappedFile> file;
+  MeshData data;
+};
+
+// Binary cache of parsed and deduplicated models, one file per source model in mesh_cache_dir.
+// A cache file is a header, holding the bounds, and the LOD table followed by the vertex and index blobs, each
+// starting on a page boundary, so once mapped the blobs are copied straight into staging memory. The header records a
+// key built from the source path, its size and write time, the loader version and options and the format version, a
+// cache with a different key is rebuilt.
+// disable_mesh_cache turns it off. Thread safe.
+class MeshCache {
+ public:
+  // Map the cache of a model, nullptr if there is none or it is stale. loaderOptions describes any loader settings
+  // that change the geometry, a cache written with other options is stale.
+  static std::unique_ptr<LoadedMesh> load(const std::string& modelPath, const std::string& loaderOptions);
+
+  // Write the cache of a model, failures are logged and otherwise ignored
+  static void store(const std::string& modelPath, const std::string& loaderOptions, const LoadedMesh& mesh);
+
+  static bool isEnabled();
+};
+
+}  // namespace glint
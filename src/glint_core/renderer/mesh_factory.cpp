@@ -1,10 +1,381 @@
 #include "mesh_factory.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include "core/logger.h"
+#include "core/parallel.h"
+#include "core/simd.h"
 #include "vk_context.h"
 
 namespace glint {
 
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+
+// Generated meshes smaller than this use a single thread, larger ones one thread per this many vertices
+constexpr uint64_t kVerticesPerThread = 1 << 16;
+
+constexpr uint32_t kTerrainOctaves = 6;
+// Noise cells across the terrain at the lowest octave
+constexpr float kTerrainFrequency = 4.0f;
+
+// Vertex attributes of one row of a generated mesh as separate arrays, so the per vertex math runs four vertices at a
+// time. Normals end up in the color.
+struct RowData {
+  std::vector<float> px, py, pz;
+  std::vector<float> nx, ny, nz;
+  std::vector<float> u, v;
+
+  explicit RowData(uint32_t count)
+      : px(count), py(count), pz(count), nx(count), ny(count), nz(count), u(count), v(count) {}
+};
+
+void normalizeNormals(RowData& row, uint32_t count) {
+  uint32_t c = 0;
+#ifdef GLINT_SSE
+  for (; c + 4 <= count; c += 4) {
+    __m128 x = _mm_loadu_ps(&row.nx[c]);
+    __m128 y = _mm_loadu_ps(&row.ny[c]);
+    __m128 z = _mm_loadu_ps(&row.nz[c]);
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    _mm_storeu_ps(&row.nx[c], _mm_div_ps(x, length));
+    _mm_storeu_ps(&row.ny[c], _mm_div_ps(y, length));
+    _mm_storeu_ps(&row.nz[c], _mm_div_ps(z, length));
+  }
+#endif
+  for (; c < count; c++) {
+    float length = std::sqrt(row.nx[c] * row.nx[c] + row.ny[c] * row.ny[c] + row.nz[c] * row.nz[c]);
+    row.nx[c] /= length;
+    row.ny[c] /= length;
+    row.nz[c] /= length;
+  }
+}
+
+// Interleave a row into Vertex, position, color and texCoord being eight consecutive floats
+void storeRow(const RowData& row, uint32_t count, Vertex* out) {
+  static_assert(sizeof(Vertex) == 8 * sizeof(float));
+  uint32_t c = 0;
+#ifdef GLINT_SSE
+  const __m128 half = _mm_set1_ps(0.5f);
+  auto dst = reinterpret_cast<float*>(out);
+  for (; c + 4 <= count; c += 4, dst += 32) {
+    // Four (px, py, pz, cx) and four (cy, cz, u, v) columns transposed into the two halves of four vertices
+    __m128 a0 = _mm_loadu_ps(&row.px[c]);
+    __m128 a1 = _mm_loadu_ps(&row.py[c]);
+    __m128 a2 = _mm_loadu_ps(&row.pz[c]);
+    __m128 a3 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&row.nx[c]), half), half);
+    __m128 b0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&row.ny[c]), half), half);
+    __m128 b1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&row.nz[c]), half), half);
+    __m128 b2 = _mm_loadu_ps(&row.u[c]);
+    __m128 b3 = _mm_loadu_ps(&row.v[c]);
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    _mm_storeu_ps(dst, a0);
+    _mm_storeu_ps(dst + 4, b0);
+    _mm_storeu_ps(dst + 8, a1);
+    _mm_storeu_ps(dst + 12, b1);
+    _mm_storeu_ps(dst + 16, a2);
+    _mm_storeu_ps(dst + 20, b2);
+    _mm_storeu_ps(dst + 24, a3);
+    _mm_storeu_ps(dst + 28, b3);
+  }
+#endif
+  for (; c < count; c++) {
+    out[c].position = {row.px[c], row.py[c], row.pz[c]};
+    out[c].color = glm::vec3(row.nx[c], row.ny[c], row.nz[c]) * 0.5f + 0.5f;
+    out[c].texCoord = {row.u[c], row.v[c]};
+  }
+}
+
+// Bounds of the rows generated by one thread. Generated meshes are centered at the origin, so is their sphere.
+struct RowBounds {
+  glm::vec3 min{FLT_MAX};
+  glm::vec3 max{-FLT_MAX};
+  float maxRadiusSquared = 0.0f;
+
+  void add(const RowData& row, uint32_t count) {
+    uint32_t c = 0;
+#ifdef GLINT_SSE
+    if (count >= 4) {
+      __m128 minX = _mm_set1_ps(min.x), minY = _mm_set1_ps(min.y), minZ = _mm_set1_ps(min.z);
+      __m128 maxX = _mm_set1_ps(max.x), maxY = _mm_set1_ps(max.y), maxZ = _mm_set1_ps(max.z);
+      __m128 radiusSquared = _mm_set1_ps(maxRadiusSquared);
+      for (; c + 4 <= count; c += 4) {
+        __m128 x = _mm_loadu_ps(&row.px[c]);
+        __m128 y = _mm_loadu_ps(&row.py[c]);
+        __m128 z = _mm_loadu_ps(&row.pz[c]);
+        minX = _mm_min_ps(minX, x);
+        minY = _mm_min_ps(minY, y);
+        minZ = _mm_min_ps(minZ, z);
+        maxX = _mm_max_ps(maxX, x);
+        maxY = _mm_max_ps(maxY, y);
+        maxZ = _mm_max_ps(maxZ, z);
+        radiusSquared =
+            _mm_max_ps(radiusSquared, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+      }
+      min = {horizontalMin(minX), horizontalMin(minY), horizontalMin(minZ)};
+      max = {horizontalMax(maxX), horizontalMax(maxY), horizontalMax(maxZ)};
+      maxRadiusSquared = horizontalMax(radiusSquared);
+    }
+#endif
+    for (; c < count; c++) {
+      glm::vec3 position(row.px[c], row.py[c], row.pz[c]);
+      min = glm::min(min, position);
+      max = glm::max(max, position);
+      maxRadiusSquared = std::max(maxRadiusSquared, glm::dot(position, position));
+    }
+  }
+
+  void add(const RowBounds& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+    maxRadiusSquared = std::max(maxRadiusSquared, other.maxRadiusSquared);
+  }
+
+  static MeshBounds merge(const std::vector<RowBounds>& threadBounds) {
+    RowBounds total;
+    for (const auto& bounds : threadBounds) {
+      total.add(bounds);
+    }
+    return {{total.min, total.max}, {glm::vec3(0.0f), std::sqrt(total.maxRadiusSquared)}};
+  }
+};
+
+uint32_t getThreadCount(uint64_t vertexCount, uint32_t maxThreads) {
+  uint64_t threads = std::clamp<uint64_t>(vertexCount / kVerticesPerThread, 1,
+                                          std::max(1u, std::thread::hardware_concurrency()));
+  return static_cast<uint32_t>(std::min<uint64_t>(threads, maxThreads));
+}
+
+void checkVertexCount(uint64_t vertexCount) {
+  if (vertexCount == 0 || vertexCount > UINT32_MAX) {
+    throw std::runtime_error("Invalid generated mesh size: " + std::to_string(vertexCount) + " vertices");
+  }
+}
+
+// Calls fn with indexData as an array of indexType
+template <typename Fn>
+void withIndices(std::span<std::byte> indexData, VkIndexType indexType, Fn&& fn) {
+  if (indexType == VK_INDEX_TYPE_UINT16) {
+    fn(reinterpret_cast<uint16_t*>(indexData.data()));
+  } else {
+    fn(reinterpret_cast<uint32_t*>(indexData.data()));
+  }
+}
+
+// Mesh generated straight into staging memory, geometry receives a copy of it when given
+std::unique_ptr<Mesh> createGeneratedMesh(VkContext* context, uint64_t vertexCount, uint64_t indexCount,
+                                          const Mesh::GenerateCallback& generate, MeshData* geometry) {
+  if (!geometry) {
+    return std::make_unique<Mesh>(context, static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(indexCount),
+                                  generate);
+  }
+
+  auto generateAndCopy = [&](std::span<Vertex> vertices, std::span<std::byte> indexData, VkIndexType indexType) {
+    MeshBounds bounds = generate(vertices, indexData, indexType);
+    geometry->vertices.assign(vertices.begin(), vertices.end());
+    withIndices(indexData, indexType, [&](auto* indices) { geometry->indices.assign(indices, indices + indexCount); });
+    return bounds;
+  };
+  return std::make_unique<Mesh>(context, static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(indexCount),
+                                generateAndCopy);
+}
+
+// Row meshes have columns + 1 vertices per row, the last one repeating the first where the mesh wraps around. The
+// band between two rows is a strip of quads, or only half of them where one of its rows sits on a pole.
+enum class Band : uint8_t {
+  Full,
+  TopPole,     // the upper row is a single point
+  BottomPole,  // the lower row is a single point
+  Seam,        // both rows are on the same line, only their attributes differ
+};
+
+uint32_t getBandTriangles(Band band, uint32_t columns) {
+  switch (band) {
+    case Band::Full:
+      return columns * 2;
+    case Band::TopPole:
+    case Band::BottomPole:
+      return columns;
+    case Band::Seam:
+      break;
+  }
+  return 0;
+}
+
+template <typename Index>
+void writeBand(Index* out, uint32_t row, uint32_t columns, Band band) {
+  uint32_t stride = columns + 1;
+  for (uint32_t c = 0; c < columns; c++) {
+    auto current = static_cast<Index>(row * stride + c);
+    auto below = static_cast<Index>(current + stride);
+    if (band == Band::Full || band == Band::BottomPole) {
+      *out++ = current;
+      *out++ = current + 1;
+      *out++ = below;
+    }
+    if (band == Band::Full || band == Band::TopPole) {
+      *out++ = current + 1;
+      *out++ = below + 1;
+      *out++ = below;
+    }
+  }
+}
+
+// Generate a row mesh with fillRow(row, data) computing each row's attributes, every thread taking a range of rows
+// along with the bands below them
+template <typename FillRow>
+std::unique_ptr<Mesh> createRowMesh(VkContext* context, uint32_t columns, const std::vector<Band>& bands,
+                                    MeshData* geometry, FillRow fillRow) {
+  uint32_t rowCount = static_cast<uint32_t>(bands.size()) + 1;
+  uint64_t vertexCount = static_cast<uint64_t>(rowCount) * (columns + 1);
+  checkVertexCount(vertexCount);
+
+  std::vector<uint64_t> firstIndex(rowCount, 0);
+  for (uint32_t row = 0; row < bands.size(); row++) {
+    firstIndex[row + 1] = firstIndex[row] + getBandTriangles(bands[row], columns) * 3;
+  }
+  if (firstIndex.back() > UINT32_MAX) {
+    throw std::runtime_error("Invalid generated mesh size: " + std::to_string(firstIndex.back()) + " indices");
+  }
+
+  auto generate = [&](std::span<Vertex> vertices, std::span<std::byte> indexData, VkIndexType indexType) {
+    uint32_t threadCount = getThreadCount(vertexCount, rowCount);
+    std::vector<RowBounds> threadBounds(threadCount);
+    parallelFor(threadCount, [&](uint32_t thread) {
+      uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(rowCount) * thread / threadCount);
+      uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(rowCount) * (thread + 1) / threadCount);
+      RowData data(columns + 1);
+      for (uint32_t row = begin; row < end; row++) {
+        fillRow(row, data);
+        threadBounds[thread].add(data, columns + 1);
+        storeRow(data, columns + 1, &vertices[static_cast<size_t>(row) * (columns + 1)]);
+      }
+      withIndices(indexData, indexType, [&](auto* indices) {
+        for (uint32_t row = begin; row < std::min<uint32_t>(end, rowCount - 1); row++) {
+          writeBand(indices + firstIndex[row], row, columns, bands[row]);
+        }
+      });
+    });
+    return RowBounds::merge(threadBounds);
+  };
+  return createGeneratedMesh(context, vertexCount, firstIndex.back(), generate, geometry);
+}
+
+// A row of a surface of revolution around the Y axis
+struct ProfilePoint {
+  float radius;
+  float y;
+  float normalRadius;
+  float normalY;
+  float v;
+};
+
+std::unique_ptr<Mesh> createRevolution(VkContext* context, uint32_t segments, const std::vector<ProfilePoint>& profile,
+                                       const std::vector<Band>& bands, MeshData* geometry) {
+  // The last column closes the seam exactly
+  std::vector<float> cosines(segments + 1);
+  std::vector<float> sines(segments + 1);
+  std::vector<float> us(segments + 1);
+  for (uint32_t c = 0; c <= segments; c++) {
+    float phi = 2.0f * kPi * (c % segments) / segments;
+    cosines[c] = std::cos(phi);
+    sines[c] = std::sin(phi);
+    us[c] = static_cast<float>(c) / segments;
+  }
+
+  return createRowMesh(context, segments, bands, geometry, [&](uint32_t row, RowData& data) {
+    const ProfilePoint& point = profile[row];
+    for (uint32_t c = 0; c <= segments; c++) {
+      data.px[c] = point.radius * cosines[c];
+      data.py[c] = point.y;
+      data.pz[c] = point.radius * sines[c];
+      data.nx[c] = point.normalRadius * cosines[c];
+      data.ny[c] = point.normalY;
+      data.nz[c] = point.normalRadius * sines[c];
+      data.u[c] = us[c];
+      data.v[c] = point.v;
+    }
+  });
+}
+
+// Lattice values in [-1, 1]
+float latticeValue(int32_t x, int32_t y) {
+  uint32_t hash = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u;
+  hash = (hash ^ (hash >> 15)) * 0x2c1b3c6du;
+  hash ^= hash >> 12;
+  return static_cast<float>(hash & 0xffffff) * (2.0f / 0xffffff) - 1.0f;
+}
+
+float valueNoise(float x, float y) {
+  float cellX = std::floor(x);
+  float cellY = std::floor(y);
+  auto ix = static_cast<int32_t>(cellX);
+  auto iy = static_cast<int32_t>(cellY);
+  float tx = x - cellX;
+  float ty = y - cellY;
+  tx = tx * tx * (3.0f - 2.0f * tx);
+  ty = ty * ty * (3.0f - 2.0f * ty);
+
+  float top = latticeValue(ix, iy) + (latticeValue(ix + 1, iy) - latticeValue(ix, iy)) * tx;
+  float bottom = latticeValue(ix, iy + 1) + (latticeValue(ix + 1, iy + 1) - latticeValue(ix, iy + 1)) * tx;
+  return top + (bottom - top) * ty;
+}
+
+// Octaves of value noise, each twice the frequency and half the amplitude of the previous, in [-1, 1]
+float fractalNoise(float x, float y) {
+  float sum = 0.0f;
+  float amplitude = 1.0f;
+  float totalAmplitude = 0.0f;
+  for (uint32_t octave = 0; octave < kTerrainOctaves; octave++) {
+    sum += valueNoise(x, y) * amplitude;
+    totalAmplitude += amplitude;
+    x *= 2.0f;
+    y *= 2.0f;
+    amplitude *= 0.5f;
+  }
+  return sum / totalAmplitude;
+}
+
+// Vertices of the regular icosahedron and its faces, counter clockwise seen from outside
+constexpr float kGoldenRatio = 1.61803398875f;
+constexpr float kIcosahedronVertices[12][3] = {
+    {-1.0f, kGoldenRatio, 0.0f}, {1.0f, kGoldenRatio, 0.0f}, {-1.0f, -kGoldenRatio, 0.0f},
+    {1.0f, -kGoldenRatio, 0.0f}, {0.0f, -1.0f, kGoldenRatio}, {0.0f, 1.0f, kGoldenRatio},
+    {0.0f, -1.0f, -kGoldenRatio}, {0.0f, 1.0f, -kGoldenRatio}, {kGoldenRatio, 0.0f, -1.0f},
+    {kGoldenRatio, 0.0f, 1.0f}, {-kGoldenRatio, 0.0f, -1.0f}, {-kGoldenRatio, 0.0f, 1.0f}};
+constexpr uint32_t kIcosahedronFaces[20][3] = {{0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+                                               {1, 5, 9},  {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                                               {3, 9, 4},  {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+                                               {4, 9, 5},  {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1}};
+
+// Triangles of one icosahedron face patch, vertex (row, column) being at row * (row + 1) / 2 + column
+template <typename Index>
+void writePatch(Index* out, uint32_t firstVertex, uint32_t subdivisions) {
+  for (uint32_t row = 0; row < subdivisions; row++) {
+    auto current = static_cast<Index>(firstVertex + row * (row + 1) / 2);
+    auto below = static_cast<Index>(current + row + 1);
+    for (uint32_t c = 0; c <= row; c++) {
+      *out++ = current + c;
+      *out++ = below + c;
+      *out++ = below + c + 1;
+      if (c < row) {
+        *out++ = current + c;
+        *out++ = below + c + 1;
+        *out++ = current + c + 1;
+      }
+    }
+  }
+}
+
+}  // namespace
+
 std::unique_ptr<Mesh> MeshFactory::createTriangle(VkContext* context) {
   LOGFN;
 
@@ -38,7 +409,7 @@ std::unique_ptr<Mesh> MeshFactory::createQuad(VkContext* context, bool textured)
   return std::make_unique<Mesh>(context, vertices, indices);
 }
 
-std::unique_ptr<Mesh> MeshFactory::createCube(VkContext* context) {
+std::unique_ptr<Mesh> MeshFactory::createCube(VkContext* context, VertexAttributeFlags flags) {
   LOGFN;
 
   std::vector<Vertex> vertices = {
@@ -73,10 +444,10 @@ std::unique_ptr<Mesh> MeshFactory::createCube(VkContext* context) {
                                    // Bottom face
                                    4, 5, 1, 1, 0, 4};
 
-  return std::make_unique<Mesh>(context, vertices, indices);
+  return std::make_unique<Mesh>(context, vertices, indices, flags);
 }
 
-std::unique_ptr<Mesh> MeshFactory::createTexturedCube(VkContext* context) {
+std::unique_ptr<Mesh> MeshFactory::createTexturedCube(VkContext* context, VertexAttributeFlags flags) {
   LOGFN;
 
   // For a proper textured cube, we need separate vertices for each face
@@ -138,7 +509,187 @@ std::unique_ptr<Mesh> MeshFactory::createTexturedCube(VkContext* context) {
                                    // Bottom face
                                    20, 21, 22, 22, 23, 20};
 
-  return std::make_unique<Mesh>(context, vertices, indices, VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+  return std::make_unique<Mesh>(context, vertices, indices, flags);
+}
+
+std::unique_ptr<Mesh> MeshFactory::createGrid(VkContext* context, uint32_t columns, uint32_t rows, float size,
+                                              float heightScale, MeshData* geometry) {
+  LOGFN;
+  if (columns == 0 || rows == 0) {
+    throw std::runtime_error("A grid needs at least one column and row");
+  }
+  float stepX = size / columns;
+  float stepZ = size / rows;
+
+  // Heights with a border of one vertex for the central differences, zero for a flat grid
+  uint32_t heightStride = columns + 3;
+  std::vector<float> heights;
+  if (heightScale > 0.0f) {
+    checkVertexCount(static_cast<uint64_t>(heightStride) * (rows + 3));
+    heights.resize(static_cast<size_t>(heightStride) * (rows + 3));
+    uint32_t threadCount = getThreadCount(heights.size(), rows + 3);
+    parallelFor(threadCount, [&](uint32_t thread) {
+      for (uint32_t row = thread; row < rows + 3; row += threadCount) {
+        float z = (static_cast<float>(row) - 1.0f) / rows * kTerrainFrequency;
+        for (uint32_t c = 0; c < heightStride; c++) {
+          float x = (static_cast<float>(c) - 1.0f) / columns * kTerrainFrequency;
+          heights[static_cast<size_t>(row) * heightStride + c] = fractalNoise(x, z) * heightScale;
+        }
+      }
+    });
+  }
+  auto height = [&](uint32_t row, uint32_t c) {
+    return heights.empty() ? 0.0f : heights[static_cast<size_t>(row) * heightStride + c];
+  };
+
+  // Rows go towards -Z so the quads face +Y
+  std::vector<Band> bands(rows, Band::Full);
+  return createRowMesh(context, columns, bands, geometry, [&](uint32_t row, RowData& data) {
+    float z = size * 0.5f - row * stepZ;
+    for (uint32_t c = 0; c <= columns; c++) {
+      data.px[c] = c * stepX - size * 0.5f;
+      data.py[c] = height(row + 1, c + 1);
+      data.pz[c] = z;
+      data.nx[c] = (height(row + 1, c) - height(row + 1, c + 2)) / (2.0f * stepX);
+      data.ny[c] = 1.0f;
+      data.nz[c] = (height(row + 2, c + 1) - height(row, c + 1)) / (2.0f * stepZ);
+      data.u[c] = static_cast<float>(c) / columns;
+      data.v[c] = static_cast<float>(row) / rows;
+    }
+    normalizeNormals(data, columns + 1);
+  });
+}
+
+std::unique_ptr<Mesh> MeshFactory::createUvSphere(VkContext* context, uint32_t segments, uint32_t rings, float radius,
+                                                  MeshData* geometry) {
+  LOGFN;
+  if (segments < 3 || rings < 2) {
+    throw std::runtime_error("A UV sphere needs at least 3 segments and 2 rings");
+  }
+
+  std::vector<ProfilePoint> profile(rings + 1);
+  for (uint32_t ring = 0; ring <= rings; ring++) {
+    float theta = kPi * ring / rings;
+    float normalRadius = ring == 0 || ring == rings ? 0.0f : std::sin(theta);
+    float normalY = ring == 0 ? 1.0f : (ring == rings ? -1.0f : std::cos(theta));
+    profile[ring] = {normalRadius * radius, normalY * radius, normalRadius, normalY, static_cast<float>(ring) / rings};
+  }
+
+  // The first and last ring would only add degenerate triangles at the poles
+  std::vector<Band> bands(rings, Band::Full);
+  bands.front() = Band::TopPole;
+  bands.back() = Band::BottomPole;
+  return createRevolution(context, segments, profile, bands, geometry);
+}
+
+std::unique_ptr<Mesh> MeshFactory::createIcosphere(VkContext* context, uint32_t subdivisions, float radius,
+                                                   MeshData* geometry) {
+  LOGFN;
+  if (subdivisions == 0) {
+    throw std::runtime_error("An icosphere needs at least one subdivision");
+  }
+
+  // Every face is a patch of its own, shared edge vertices are computed the same way on both of their faces
+  uint32_t n = subdivisions;
+  uint64_t patchVertices = static_cast<uint64_t>(n + 1) * (n + 2) / 2;
+  uint64_t vertexCount = patchVertices * 20;
+  uint64_t indexCount = static_cast<uint64_t>(n) * n * 3 * 20;
+  checkVertexCount(vertexCount);
+  if (indexCount > UINT32_MAX) {
+    throw std::runtime_error("Invalid generated mesh size: " + std::to_string(indexCount) + " indices");
+  }
+
+  auto generate = [&](std::span<Vertex> vertices, std::span<std::byte> indexData, VkIndexType indexType) {
+    uint32_t threadCount = getThreadCount(vertexCount, 20);
+    std::vector<RowBounds> threadBounds(threadCount);
+    parallelFor(threadCount, [&](uint32_t thread) {
+      RowData data(n + 1);
+      for (uint32_t face = thread; face < 20; face += threadCount) {
+        const float* a = kIcosahedronVertices[kIcosahedronFaces[face][0]];
+        const float* b = kIcosahedronVertices[kIcosahedronFaces[face][1]];
+        const float* c = kIcosahedronVertices[kIcosahedronFaces[face][2]];
+        uint64_t firstVertex = patchVertices * face;
+
+        for (uint32_t row = 0; row <= n; row++) {
+          uint32_t count = row + 1;
+          for (uint32_t column = 0; column < count; column++) {
+            // (wa * a + wb * b) + wc * c gives an edge vertex the same value from either face
+            auto wa = static_cast<float>(n - row);
+            auto wb = static_cast<float>(row - column);
+            auto wc = static_cast<float>(column);
+            data.nx[column] = (wa * a[0] + wb * b[0]) + wc * c[0];
+            data.ny[column] = (wa * a[1] + wb * b[1]) + wc * c[1];
+            data.nz[column] = (wa * a[2] + wb * b[2]) + wc * c[2];
+          }
+          normalizeNormals(data, count);
+          for (uint32_t column = 0; column < count; column++) {
+            data.px[column] = data.nx[column] * radius;
+            data.py[column] = data.ny[column] * radius;
+            data.pz[column] = data.nz[column] * radius;
+            data.u[column] = 0.5f + std::atan2(data.nz[column], data.nx[column]) / (2.0f * kPi);
+            data.v[column] = std::acos(std::clamp(data.ny[column], -1.0f, 1.0f)) / kPi;
+          }
+          threadBounds[thread].add(data, count);
+          storeRow(data, count, &vertices[firstVertex + static_cast<uint64_t>(row) * (row + 1) / 2]);
+        }
+
+        withIndices(indexData, indexType, [&](auto* indices) {
+          writePatch(indices + static_cast<uint64_t>(n) * n * 3 * face, static_cast<uint32_t>(firstVertex), n);
+        });
+      }
+    });
+    return RowBounds::merge(threadBounds);
+  };
+  return createGeneratedMesh(context, vertexCount, indexCount, generate, geometry);
+}
+
+std::unique_ptr<Mesh> MeshFactory::createTorus(VkContext* context, uint32_t segments, uint32_t sides, float radius,
+                                               float tubeRadius, MeshData* geometry) {
+  LOGFN;
+  if (segments < 3 || sides < 3) {
+    throw std::runtime_error("A torus needs at least 3 segments and sides");
+  }
+
+  // Around the tube starting from its outside, going down first
+  std::vector<ProfilePoint> profile(sides + 1);
+  for (uint32_t side = 0; side <= sides; side++) {
+    float angle = 2.0f * kPi * (side % sides) / sides;
+    float normalRadius = std::cos(angle);
+    float normalY = -std::sin(angle);
+    profile[side] = {radius + normalRadius * tubeRadius, normalY * tubeRadius, normalRadius, normalY,
+                     static_cast<float>(side) / sides};
+  }
+
+  std::vector<Band> bands(sides, Band::Full);
+  return createRevolution(context, segments, profile, bands, geometry);
+}
+
+std::unique_ptr<Mesh> MeshFactory::createCylinder(VkContext* context, uint32_t segments, uint32_t rows, float radius,
+                                                  float height, MeshData* geometry) {
+  LOGFN;
+  if (segments < 3 || rows == 0) {
+    throw std::runtime_error("A cylinder needs at least 3 segments and one row");
+  }
+
+  // Top cap, side and bottom cap, each with its own normals. The rows at the rims repeat positions, the bands
+  // between them stay empty.
+  float top = height * 0.5f;
+  std::vector<ProfilePoint> profile;
+  profile.push_back({0.0f, top, 0.0f, 1.0f, 0.0f});
+  profile.push_back({radius, top, 0.0f, 1.0f, 0.0f});
+  for (uint32_t row = 0; row <= rows; row++) {
+    float v = static_cast<float>(row) / rows;
+    profile.push_back({radius, top - height * v, 1.0f, 0.0f, v});
+  }
+  profile.push_back({radius, -top, 0.0f, -1.0f, 1.0f});
+  profile.push_back({0.0f, -top, 0.0f, -1.0f, 1.0f});
+
+  std::vector<Band> bands(profile.size() - 1, Band::Full);
+  bands[0] = Band::TopPole;
+  bands[1] = Band::Seam;
+  bands[bands.size() - 2] = Band::Seam;
+  bands.back() = Band::BottomPole;
+  return createRevolution(context, segments, profile, bands, geometry);
 }
 
-}  // namespace glint
\ No newline at end of file
+}  // namespace glint
@@ -12,8 +12,31 @@ class MeshFactory {
  public:
   static std::unique_ptr<Mesh> createTriangle(VkContext* context);
   static std::unique_ptr<Mesh> createQuad(VkContext* context, bool textured = false);
-  static std::unique_ptr<Mesh> createCube(VkContext* context);
-  static std::unique_ptr<Mesh> createTexturedCube(VkContext* context);
+  static std::unique_ptr<Mesh> createCube(VkContext* context,
+                                          VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+  static std::unique_ptr<Mesh> createTexturedCube(
+      VkContext* context, VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+
+  // Parametric meshes, generated on several threads straight into staging memory. Vertices have no normal attribute,
+  // their color is the normal mapped to [0, 1]. All of them are centered at the origin, counter clockwise seen from
+  // outside. geometry, when given, receives a copy of the generated vertices and indices for processing on the CPU such
+  // as building meshlets.
+
+  // columns x rows quads in the XZ plane facing +Y, size wide. A heightScale above 0 displaces the vertices up to
+  // that far along Y with fractal noise, giving a terrain.
+  static std::unique_ptr<Mesh> createGrid(VkContext* context, uint32_t columns, uint32_t rows, float size = 1.0f,
+                                          float heightScale = 0.0f, MeshData* geometry = nullptr);
+  static std::unique_ptr<Mesh> createUvSphere(VkContext* context, uint32_t segments, uint32_t rings,
+                                              float radius = 0.5f, MeshData* geometry = nullptr);
+  // Icosahedron with every face split into subdivisions^2 triangles, projected onto the sphere
+  static std::unique_ptr<Mesh> createIcosphere(VkContext* context, uint32_t subdivisions, float radius = 0.5f,
+                                               MeshData* geometry = nullptr);
+  // Around the Y axis, radius being the distance to the center of the tube
+  static std::unique_ptr<Mesh> createTorus(VkContext* context, uint32_t segments, uint32_t sides, float radius = 0.35f,
+                                           float tubeRadius = 0.15f, MeshData* geometry = nullptr);
+  // Capped, along the Y axis, with rows quads from top to bottom
+  static std::unique_ptr<Mesh> createCylinder(VkContext* context, uint32_t segments, uint32_t rows = 1,
+                                              float radius = 0.5f, float height = 1.0f, MeshData* geometry = nullptr);
 };
 
 }  // namespace glint
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "core/logger.h"
+#include "mesh.h"
+
+namespace glint {
+
+namespace {
+
+constexpr uint32_t kNoTriangle = UINT32_MAX;
+
+// Forsyth's tuning, "Linear-Speed Vertex Cache Optimisation"
+constexpr uint32_t kLruCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+// Higher for vertices recently used and vertices with few triangles left, finishing those avoids re-transforming
+// them later
+float vertexScore(int32_t cachePosition, uint32_t liveTriangles) {
+  if (liveTriangles == 0) {
+    return -1.0f;
+  }
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    // The last triangle's vertices get a fixed score so its neighbours aren't favoured over each other
+    score = cachePosition < 3 ? kLastTriangleScore
+                              : std::pow(1.0f - float(cachePosition - 3) / (kLruCacheSize - 3), kCacheDecayPower);
+  }
+  return score + kValenceBoostScale * std::pow(float(liveTriangles), -kValenceBoostPower);
+}
+
+// FIFO cache simulation with timestamps, a vertex is cached while fewer than size misses happened since its own
+class FifoCache {
+ public:
+  FifoCache(uint32_t vertexCount, uint32_t size) : m_Timestamps(vertexCount, 0), m_Size(size), m_Time(size + 1) {}
+
+  // 1 on a miss
+  uint32_t access(uint32_t vertex) {
+    if (m_Time - m_Timestamps[vertex] > m_Size) {
+      m_Timestamps[vertex] = m_Time++;
+      return 1;
+    }
+    return 0;
+  }
+
+  void reset() { m_Time += m_Size + 1; }
+
+ private:
+  std::vector<uint32_t> m_Timestamps;
+  uint32_t m_Size;
+  uint32_t m_Time;
+};
+
+}  // namespace
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount,
+                                                            uint32_t cacheSize) {
+  CacheStats stats;
+  if (indices.empty() || vertexCount == 0) {
+    return stats;
+  }
+
+  FifoCache cache(vertexCount, cacheSize);
+  uint32_t misses = 0;
+  for (uint32_t index : indices) {
+    misses += cache.access(index);
+  }
+
+  stats.acmr = float(misses) / float(indices.size() / 3);
+  stats.atvr = float(misses) / float(vertexCount);
+  return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+  uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles of each vertex, the first liveTriangles[v] entries of its list are not emitted yet
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (uint32_t index : indices) {
+    liveTriangles[index]++;
+  }
+  std::vector<uint32_t> adjacencyOffsets(vertexCount, 0);
+  std::exclusive_scan(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin(), 0u);
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill = adjacencyOffsets;
+    for (uint32_t i = 0; i < indices.size(); i++) {
+      adjacency[fill[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<int32_t> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+  }
+
+  std::vector<float> triangleScores(triangleCount);
+  uint32_t bestTriangle = 0;
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+    if (triangleScores[t] > triangleScores[bestTriangle]) {
+      bestTriangle = t;
+    }
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> newCache;
+  cache.reserve(kLruCacheSize + 3);
+  newCache.reserve(kLruCacheSize + 3);
+  uint32_t scanCursor = 0;
+
+  for (uint32_t i = 0; i < triangleCount; i++) {
+    // Nothing in the cache touches a live triangle, continue with the next one in the input order
+    if (bestTriangle == kNoTriangle) {
+      while (emitted[scanCursor]) {
+        scanCursor++;
+      }
+      bestTriangle = scanCursor;
+    }
+
+    const uint32_t* triangle = &indices[bestTriangle * 3];
+    emitted[bestTriangle] = true;
+    output.insert(output.end(), triangle, triangle + 3);
+
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = triangle[k];
+      uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+      uint32_t* end = begin + liveTriangles[v];
+      std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+      liveTriangles[v]--;
+    }
+
+    // Most recently used first, entries past the cache size fall out
+    newCache.assign(triangle, triangle + 3);
+    for (uint32_t v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache.push_back(v);
+      }
+    }
+    std::swap(cache, newCache);
+
+    for (uint32_t position = 0; position < cache.size(); position++) {
+      uint32_t v = cache[position];
+      cachePositions[v] = position < kLruCacheSize ? static_cast<int32_t>(position) : -1;
+
+      float score = vertexScore(cachePositions[v], liveTriangles[v]);
+      float delta = score - vertexScores[v];
+      vertexScores[v] = score;
+      for (uint32_t a = 0; a < liveTriangles[v]; a++) {
+        triangleScores[adjacency[adjacencyOffsets[v] + a]] += delta;
+      }
+    }
+    if (cache.size() > kLruCacheSize) {
+      cache.resize(kLruCacheSize);
+    }
+
+    // Only triangles of cached vertices changed score enough to matter
+    bestTriangle = kNoTriangle;
+    float bestScore = -1.0f;
+    for (uint32_t v : cache) {
+      for (uint32_t a = 0; a < liveTriangles[v]; a++) {
+        uint32_t t = adjacency[adjacencyOffsets[v] + a];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          bestTriangle = t;
+        }
+      }
+    }
+  }
+
+  indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices,
+                                     float threshold) {
+  uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (triangleCount <= 1) {
+    return;
+  }
+
+  FifoCache cache(static_cast<uint32_t>(vertices.size()), kFifoCacheSize);
+  auto triangleMisses = [&](uint32_t t) {
+    return cache.access(indices[t * 3]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+  };
+
+  // Hard boundaries, the cache optimizer restarted from cold there so cutting costs nothing
+  std::vector<uint32_t> hardClusters;
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    if (triangleMisses(t) == 3) {
+      hardClusters.push_back(t);
+    }
+  }
+  hardClusters.push_back(triangleCount);
+
+  // Soft boundaries, cut as soon as the piece so far is within threshold of its hard cluster's ACMR
+  std::vector<uint32_t> clusters;
+  for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+    uint32_t start = hardClusters[c];
+    uint32_t end = hardClusters[c + 1];
+
+    cache.reset();
+    uint32_t clusterMisses = 0;
+    for (uint32_t t = start; t < end; t++) {
+      clusterMisses += triangleMisses(t);
+    }
+    float maxAcmr = float(clusterMisses) / float(end - start) * threshold;
+
+    cache.reset();
+    clusters.push_back(start);
+    uint32_t misses = 0;
+    uint32_t pieceStart = start;
+    for (uint32_t t = start; t < end; t++) {
+      misses += triangleMisses(t);
+      if (t + 1 < end && float(misses) / float(t + 1 - pieceStart) <= maxAcmr) {
+        clusters.push_back(t + 1);
+        cache.reset();
+        misses = 0;
+        pieceStart = t + 1;
+      }
+    }
+  }
+  uint32_t clusterCount = static_cast<uint32_t>(clusters.size());
+  clusters.push_back(triangleCount);
+
+  // Area weighted centroid and normal per cluster
+  std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+  std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+  std::vector<float> areas(clusterCount, 0.0f);
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  for (uint32_t c = 0; c < clusterCount; c++) {
+    for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      const glm::vec3& p0 = vertices[indices[t * 3]].position;
+      const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(normal);
+
+      centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+      normals[c] += normal;
+      areas[c] += area;
+    }
+    meshCentroid += centroids[c];
+    meshArea += areas[c];
+  }
+  if (meshArea > 0.0f) {
+    meshCentroid /= meshArea;
+  }
+
+  // Clusters facing away from the center are likely in front, draw them first
+  std::vector<float> sortKeys(clusterCount, 0.0f);
+  for (uint32_t c = 0; c < clusterCount; c++) {
+    float normalLength = glm::length(normals[c]);
+    if (areas[c] > 0.0f && normalLength > 0.0f) {
+      sortKeys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+    }
+  }
+
+  std::vector<uint32_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (uint32_t c : order) {
+    output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+  }
+  indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<Vertex> output;
+  output.reserve(vertices.size());
+
+  for (uint32_t& index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = static_cast<uint32_t>(output.size());
+      output.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = std::move(output);
+}
+
+void MeshOptimizer::optimize(MeshData& data, float overdrawThreshold) {
+  LOGFN;
+  uint32_t vertexCount = static_cast<uint32_t>(data.vertices.size());
+  CacheStats before = analyzeVertexCache(data.indices, vertexCount);
+
+  optimizeVertexCache(data.indices, vertexCount);
+  CacheStats cacheOptimized = analyzeVertexCache(data.indices, vertexCount);
+
+  if (overdrawThreshold > 0.0f) {
+    optimizeOverdraw(data.indices, data.vertices, overdrawThreshold);
+  }
+  optimizeVertexFetch(data.vertices, data.indices);
+  CacheStats after = analyzeVertexCache(data.indices, static_cast<uint32_t>(data.vertices.size()));
+
+  LOG("ACMR", before.acmr, "->", cacheOptimized.acmr, "-> after overdraw", after.acmr);
+  LOG("ATVR", before.atvr, "->", cacheOptimized.atvr, "-> after overdraw", after.atvr);
+}
+
+}  // namespace glint
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "vertex.h"
+
+namespace glint {
+
+struct MeshData;
+
+// Reorders indexed triangle lists for the GPU, in the order optimize() runs them:
+//  - vertex cache: triangles are emitted greedily by Forsyth's scoring over a simulated LRU cache
+//  - overdraw: the cache optimized order is cut into clusters that keep the cache efficiency within a threshold,
+//    clusters facing outwards from the mesh center are drawn first so they occlude the rest
+//  - vertex fetch: vertices are renumbered in order of first use, so fetches walk the vertex buffer linearly
+// None of the steps change the triangles themselves, only their order and the vertex numbering. CPU only.
+class MeshOptimizer {
+ public:
+  // Post transform cache efficiency of an index list against a FIFO cache
+  struct CacheStats {
+    // Average cache miss ratio, transformed vertices per triangle. 0.5 is the ideal for large regular meshes, 3 the
+    // worst case.
+    float acmr = 0.0f;
+    // Average transform to vertex ratio, transformed vertices per unique vertex. 1 is ideal.
+    float atvr = 0.0f;
+  };
+
+  static CacheStats analyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount,
+                                       uint32_t cacheSize = kFifoCacheSize);
+
+  static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+  // threshold is the ACMR a cluster may lose relative to the cache optimized order, 1.05 allows 5%
+  static void optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const Vertex> vertices, float threshold);
+
+  // Drops vertices no triangle references
+  static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+  // All three steps, logs the ACMR / ATVR before and after
+  static void optimize(MeshData& data, float overdrawThreshold);
+
+  // Typical post transform cache size of current GPUs, used for the statistics and the overdraw clusters
+  static constexpr uint32_t kFifoCacheSize = 16;
+};
+
+}  // namespace glint
@@ -0,0 +1,286 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "bounds.h"
+#include "core/logger.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+namespace glint {
+
+namespace {
+
+// LOD chain limits, see MeshSimplifier::buildLods
+constexpr float kMaxLodError = 0.1f;
+constexpr float kMinLodReduction = 0.25f;
+
+// A collapse is rejected when it turns a surrounding triangle's normal by more than about 75 degrees
+constexpr float kMinNormalDot = 0.25f;
+
+// Sum of squared distances to a set of planes, area weighted. Evaluates p^T A p + 2 b.p + c.
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0;
+  double c = 0;
+  double weight = 0;
+
+  void addPlane(const glm::vec3& normal, float distance, float planeWeight) {
+    double x = normal.x, y = normal.y, z = normal.z, d = distance, w = planeWeight;
+    a00 += w * x * x;
+    a01 += w * x * y;
+    a02 += w * x * z;
+    a11 += w * y * y;
+    a12 += w * y * z;
+    a22 += w * z * z;
+    b0 += w * x * d;
+    b1 += w * y * d;
+    b2 += w * z * d;
+    c += w * d * d;
+    weight += w;
+  }
+
+  Quadric& operator+=(const Quadric& other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+  }
+
+  double evaluate(const glm::vec3& p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double quadratic = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z);
+    return quadratic + 2 * (b0 * x + b1 * y + b2 * z) + c;
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  float cost;  // mean squared distance of the merged planes to the target position
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+// Vertices on an open or non-manifold edge
+std::vector<uint8_t> findLockedVertices(size_t vertexCount, std::span<const uint32_t> indices) {
+  std::vector<uint64_t> edges;
+  edges.reserve(indices.size());
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (size_t corner = 0; corner < 3; corner++) {
+      edges.push_back(edgeKey(indices[i + corner], indices[i + (corner + 1) % 3]));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  std::vector<uint8_t> locked(vertexCount, 0);
+  for (size_t begin = 0; begin < edges.size();) {
+    size_t end = begin + 1;
+    while (end < edges.size() && edges[end] == edges[begin]) {
+      end++;
+    }
+    if (end - begin != 2) {
+      locked[edges[begin] >> 32] = 1;
+      locked[edges[begin] & 0xffffffff] = 1;
+    }
+    begin = end;
+  }
+  return locked;
+}
+
+}  // namespace
+
+std::vector<uint32_t> MeshSimplifier::simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                               size_t targetIndexCount, float maxError, float* error) {
+  LOGFN;
+  std::vector<uint32_t> result(indices.begin(), indices.end());
+  size_t vertexCount = vertices.size();
+  auto position = [&](uint32_t vertex) { return vertices[vertex].position; };
+
+  std::vector<uint8_t> locked = findLockedVertices(vertexCount, indices);
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < result.size(); i += 3) {
+    glm::vec3 p0 = position(result[i]);
+    glm::vec3 normal = glm::cross(position(result[i + 1]) - p0, position(result[i + 2]) - p0);
+    float length = glm::length(normal);
+    if (length > 0.0f) {
+      normal /= length;
+      float distance = -glm::dot(normal, p0);
+      for (size_t corner = 0; corner < 3; corner++) {
+        quadrics[result[i + corner]].addPlane(normal, distance, length * 0.5f);
+      }
+    }
+  }
+
+  auto collapseCost = [&](uint32_t from, uint32_t to) {
+    Quadric merged = quadrics[from];
+    merged += quadrics[to];
+    return merged.weight > 0 ? static_cast<float>(std::max(0.0, merged.evaluate(position(to)) / merged.weight))
+                             : 0.0f;
+  };
+
+  std::vector<uint32_t> remap(vertexCount);
+  std::iota(remap.begin(), remap.end(), 0);
+  std::vector<uint32_t> triangleStart(vertexCount + 1);
+  std::vector<uint32_t> vertexTriangles;
+  std::vector<uint8_t> touched(vertexCount);
+  std::vector<Collapse> collapses;
+
+  float maxCost = maxError * maxError;
+  float worstCost = 0.0f;
+
+  while (result.size() > targetIndexCount) {
+    // Triangles around each vertex
+    std::fill(triangleStart.begin(), triangleStart.end(), 0);
+    for (uint32_t index : result) {
+      triangleStart[index + 1]++;
+    }
+    std::partial_sum(triangleStart.begin(), triangleStart.end(), triangleStart.begin());
+    vertexTriangles.resize(result.size());
+    std::vector<uint32_t> cursor(triangleStart.begin(), triangleStart.end() - 1);
+    for (size_t i = 0; i < result.size(); i++) {
+      vertexTriangles[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // Interior edges are shared by two triangles in opposite directions, a < b keeps one of them. Of the two
+    // directions the cheaper one is tried.
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; corner++) {
+        uint32_t a = result[i + corner];
+        uint32_t b = result[i + (corner + 1) % 3];
+        if (a > b || (locked[a] && locked[b])) {
+          continue;
+        }
+        float costAB = locked[a] ? INFINITY : collapseCost(a, b);
+        float costBA = locked[b] ? INFINITY : collapseCost(b, a);
+        collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB} : Collapse{b, a, costBA});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+    // Collapses of one pass must not share triangles, so each sees the triangles as they were when the pass started
+    std::fill(touched.begin(), touched.end(), 0);
+    size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+    size_t removedTriangles = 0;
+    size_t appliedCollapses = 0;
+    for (const auto& collapse : collapses) {
+      if (collapse.cost > maxCost || removedTriangles >= trianglesToRemove) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+
+      // Reject collapses that flip or squash a triangle that survives them
+      glm::vec3 fromPosition = position(collapse.from);
+      glm::vec3 toPosition = position(collapse.to);
+      bool flips = false;
+      for (uint32_t t = triangleStart[collapse.from]; t < triangleStart[collapse.from + 1] && !flips; t++) {
+        const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+          continue;
+        }
+        uint32_t corner = triangle[0] == collapse.from ? 0 : (triangle[1] == collapse.from ? 1 : 2);
+        glm::vec3 p1 = position(triangle[(corner + 1) % 3]);
+        glm::vec3 p2 = position(triangle[(corner + 2) % 3]);
+        glm::vec3 before = glm::cross(p1 - fromPosition, p2 - fromPosition);
+        glm::vec3 after = glm::cross(p1 - toPosition, p2 - toPosition);
+        flips = glm::dot(before, after) <= kMinNormalDot * glm::length(before) * glm::length(after);
+      }
+      if (flips) {
+        continue;
+      }
+
+      for (uint32_t t = triangleStart[collapse.from]; t < triangleStart[collapse.from + 1]; t++) {
+        const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+          removedTriangles++;
+        }
+      }
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to] += quadrics[collapse.from];
+      worstCost = std::max(worstCost, collapse.cost);
+      appliedCollapses++;
+    }
+
+    if (appliedCollapses == 0) {
+      break;
+    }
+
+    // Targets never move in the pass they are collapsed into, so one lookup resolves every index
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+      if (a != b && b != c && a != c) {
+        result[write++] = a;
+        result[write++] = b;
+        result[write++] = c;
+      }
+    }
+    result.resize(write);
+  }
+
+  if (error) {
+    *error = std::sqrt(worstCost);
+  }
+  return result;
+}
+
+void MeshSimplifier::buildLods(MeshData& data, bool optimizeVertexCache, uint32_t maxLods) {
+  LOGFN;
+  data.lods.clear();
+  if (data.indices.empty()) {
+    return;
+  }
+
+  BoundingBox box = Bounds::computeBox(data.vertices);
+  float errorBudget = glm::length(box.getExtent()) * kMaxLodError;
+
+  // Each level is simplified from the previous one, its error adds to theirs
+  std::vector<std::vector<uint32_t>> levels;
+  std::vector<float> errors = {0.0f};
+  levels.push_back(data.indices);
+  while (levels.size() < maxLods) {
+    const auto& previous = levels.back();
+    size_t target = previous.size() / 6 * 3;
+    float levelError = 0.0f;
+    auto level = simplify(data.vertices, previous, target, errorBudget - errors.back(), &levelError);
+    if (level.empty() || level.size() > previous.size() * (1.0f - kMinLodReduction)) {
+      break;
+    }
+
+    if (optimizeVertexCache) {
+      MeshOptimizer::optimizeVertexCache(level, static_cast<uint32_t>(data.vertices.size()));
+    }
+    errors.push_back(errors.back() + levelError);
+    levels.push_back(std::move(level));
+  }
+
+  data.indices.clear();
+  for (size_t i = 0; i < levels.size(); i++) {
+    data.lods.push_back({static_cast<uint32_t>(data.indices.size()), static_cast<uint32_t>(levels[i].size()),
+                         errors[i]});
+    data.indices.insert(data.indices.end(), levels[i].begin(), levels[i].end());
+    LOG("LOD", i, ":", levels[i].size() / 3, "triangles, error", errors[i]);
+  }
+}
+
+}  // namespace glint
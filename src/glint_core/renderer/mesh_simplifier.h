@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "vertex.h"
+
+namespace glint {
+
+struct MeshData;
+
+// Quadric error edge collapse on indexed triangle lists. Only the index list changes, the simplified triangles keep
+// using the input vertices, so every LOD of a mesh shares one vertex buffer. Vertices on open edges, which includes
+// the texture seams of deduplicated meshes, are never moved, keeping borders and seams intact. CPU only.
+class MeshSimplifier {
+ public:
+  // Collapse edges in order of increasing quadric error until at most targetIndexCount indices remain or the next
+  // collapse would exceed maxError, in model units. error receives the largest error introduced.
+  static std::vector<uint32_t> simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                        size_t targetIndexCount, float maxError, float* error = nullptr);
+
+  // Append a chain of LODs to data.indices and fill data.lods, LOD 0 being the current indices. Each level halves the
+  // triangles of the previous one, the chain ends after maxLods levels, once a level no longer shrinks by a quarter or
+  // once the accumulated error would exceed a tenth of the mesh's bounding radius. optimizeVertexCache reorders each
+  // new level like MeshOptimizer::optimizeVertexCache.
+  static void buildLods(MeshData& data, bool optimizeVertexCache, uint32_t maxLods = kMaxLods);
+
+  static constexpr uint32_t kMaxLods = 8;
+};
+
+}  // namespace glint
@@ -0,0 +1,161 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "core/logger.h"
+
+namespace glint {
+
+namespace {
+
+// Local indices are stored in a byte
+constexpr uint32_t kMaxLocalVertices = 256;
+constexpr uint16_t kUnused = 0xffff;
+
+// Cones whose normals are spread wider than this, about 84 degrees from the axis, never pass the culling test
+constexpr float kMinConeDot = 0.1f;
+
+}  // namespace
+
+MeshletData MeshletBuilder::build(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                  uint32_t maxVertices, uint32_t maxTriangles) {
+  LOGFN;
+  if (maxVertices < 3 || maxVertices > kMaxLocalVertices || maxTriangles == 0) {
+    throw std::runtime_error("Meshlet limits out of range!");
+  }
+
+  MeshletData data;
+  size_t triangleCount = indices.size() / 3;
+  size_t estimatedMeshlets = triangleCount / maxTriangles + 1;
+  data.meshlets.reserve(estimatedMeshlets);
+  data.vertices.reserve(estimatedMeshlets * maxVertices);
+  data.triangles.reserve(triangleCount * 3);
+
+  // Local index of each mesh vertex in the open meshlet
+  std::vector<uint16_t> localIndices(vertices.size(), kUnused);
+  Meshlet meshlet;
+
+  auto close = [&]() {
+    if (meshlet.triangleCount == 0) {
+      return;
+    }
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+      localIndices[data.vertices[meshlet.vertexOffset + i]] = kUnused;
+    }
+    data.meshlets.push_back(meshlet);
+
+    meshlet = {};
+    meshlet.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+    meshlet.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+  };
+
+  for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+    const uint32_t* corners = &indices[triangle * 3];
+    uint32_t a = corners[0];
+    uint32_t b = corners[1];
+    uint32_t c = corners[2];
+
+    uint32_t newVertices = (localIndices[a] == kUnused) + (localIndices[b] == kUnused && b != a) +
+                           (localIndices[c] == kUnused && c != a && c != b);
+    if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount == maxTriangles) {
+      close();
+    }
+
+    for (uint32_t corner = 0; corner < 3; corner++) {
+      uint32_t vertex = corners[corner];
+      if (localIndices[vertex] == kUnused) {
+        localIndices[vertex] = static_cast<uint16_t>(meshlet.vertexCount++);
+        data.vertices.push_back(vertex);
+      }
+      data.triangles.push_back(static_cast<uint8_t>(localIndices[vertex]));
+    }
+    meshlet.triangleCount++;
+  }
+  close();
+
+  data.bounds.reserve(data.meshlets.size());
+  for (const auto& built : data.meshlets) {
+    data.bounds.push_back(computeBounds(data, built, vertices));
+  }
+
+  LOG("Built", data.meshlets.size(), "meshlets from", triangleCount, "triangles,",
+      data.meshlets.empty() ? 0.0f : static_cast<float>(data.vertices.size()) / data.meshlets.size(),
+      "vertices per meshlet");
+  return data;
+}
+
+MeshletBounds MeshletBuilder::computeBounds(const MeshletData& data, const Meshlet& meshlet,
+                                            std::span<const Vertex> vertices) {
+  MeshletBounds bounds;
+  if (meshlet.vertexCount == 0) {
+    return bounds;
+  }
+
+  auto position = [&](uint32_t localIndex) {
+    return vertices[data.vertices[meshlet.vertexOffset + localIndex]].position;
+  };
+  auto farthestFrom = [&](const glm::vec3& point) {
+    glm::vec3 farthest = point;
+    float farthestDistance = -1.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+      glm::vec3 delta = position(i) - point;
+      float distance = glm::dot(delta, delta);
+      if (distance > farthestDistance) {
+        farthestDistance = distance;
+        farthest = position(i);
+      }
+    }
+    return farthest;
+  };
+
+  // Ritter: start with the sphere over an approximate diameter, then grow it just enough for each point outside
+  glm::vec3 a = farthestFrom(position(0));
+  glm::vec3 b = farthestFrom(a);
+  bounds.center = (a + b) * 0.5f;
+  bounds.radius = glm::length(b - a) * 0.5f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    glm::vec3 delta = position(i) - bounds.center;
+    float distance = glm::length(delta);
+    if (distance > bounds.radius) {
+      float radius = (bounds.radius + distance) * 0.5f;
+      bounds.center += delta * ((radius - bounds.radius) / distance);
+      bounds.radius = radius;
+    }
+  }
+
+  // Normal cone around the average of the unit triangle normals, degenerate triangles don't face anywhere
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangleCount);
+  glm::vec3 normalSum(0.0f);
+  const uint8_t* triangles = &data.triangles[static_cast<size_t>(meshlet.triangleOffset) * 3];
+  for (uint32_t triangle = 0; triangle < meshlet.triangleCount; triangle++) {
+    glm::vec3 p0 = position(triangles[triangle * 3 + 0]);
+    glm::vec3 p1 = position(triangles[triangle * 3 + 1]);
+    glm::vec3 p2 = position(triangles[triangle * 3 + 2]);
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(normal);
+    if (length > 0.0f) {
+      normals.push_back(normal / length);
+      normalSum += normals.back();
+    }
+  }
+
+  float axisLength = glm::length(normalSum);
+  if (axisLength <= 0.0f) {
+    return bounds;
+  }
+  bounds.coneAxis = normalSum / axisLength;
+
+  float minDot = 1.0f;
+  for (const auto& normal : normals) {
+    minDot = std::min(minDot, glm::dot(normal, bounds.coneAxis));
+  }
+  if (minDot > kMinConeDot) {
+    bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  }
+  return bounds;
+}
+
+}  // namespace glint
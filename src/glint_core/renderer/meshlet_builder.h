@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "vertex.h"
+
+namespace glint {
+
+// A cluster of up to maxVertices vertices and maxTriangles triangles. Its triangles index its own vertex list, which
+// in turn holds indices into the mesh's vertices.
+struct Meshlet {
+  uint32_t vertexOffset = 0;    // into MeshletData::vertices
+  uint32_t triangleOffset = 0;  // into MeshletData::triangles, in triangles
+  uint32_t vertexCount = 0;
+  uint32_t triangleCount = 0;
+};
+
+// Culling data of a meshlet, in the mesh's model space
+struct MeshletBounds {
+  glm::vec3 center{0.0f};
+  float radius = 0.0f;
+
+  // Average normal and sine of the widest angle between it and a triangle normal. The whole meshlet faces away from a
+  // camera at p when dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius.
+  // coneCutoff is 1 when the normals spread too wide to ever cull.
+  glm::vec3 coneAxis{0.0f};
+  float coneCutoff = 1.0f;
+};
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshletBounds> bounds;
+
+  // Mesh vertex index of every meshlet vertex
+  std::vector<uint32_t> vertices;
+  // Three local vertex indices per triangle
+  std::vector<uint8_t> triangles;
+};
+
+// Splits an indexed triangle list into meshlets. Triangles are taken in index order and a meshlet is closed once the
+// next triangle would exceed either limit, so a vertex cache optimized order (MeshOptimizer) gives the tightest
+// clusters. CPU only.
+class MeshletBuilder {
+ public:
+  static MeshletData build(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                           uint32_t maxVertices = kMaxVertices, uint32_t maxTriangles = kMaxTriangles);
+
+  // Bounding sphere (Ritter) and normal cone of one meshlet
+  static MeshletBounds computeBounds(const MeshletData& data, const Meshlet& meshlet, std::span<const Vertex> vertices);
+
+  // Common mesh shader limits, also small enough for local indices to fit in a byte
+  static constexpr uint32_t kMaxVertices = 64;
+  static constexpr uint32_t kMaxTriangles = 124;
+};
+
+}  // namespace glint
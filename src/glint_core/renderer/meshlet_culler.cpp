@@ -0,0 +1,225 @@
+#include "meshlet_culler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/config.h"
+#include "core/logger.h"
+#include "mesh.h"
+#include "staging_pool.h"
+#include "transfer_manager.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+namespace {
+
+// Matches meshlet_cull.comp
+struct GpuMeshlet {
+  glm::vec4 sphere;  // center, radius
+  glm::vec4 cone;    // axis, cutoff
+  uint32_t vertexOffset;
+  uint32_t triangleOffset;
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+};
+
+struct CullParams {
+  glm::vec4 frustumPlanes[6];
+  glm::vec4 cameraPosition;
+  uint32_t meshletCount;
+  uint32_t coneCulling;
+  uint32_t padding[2];
+};
+
+// Frustum planes of a clip space transform with 0..1 depth, normalized so plane distances are in model units
+void extractFrustumPlanes(const glm::mat4& transform, glm::vec4 planes[6]) {
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(transform[0][i], transform[1][i], transform[2][i], transform[3][i]);
+  }
+
+  planes[0] = rows[3] + rows[0];  // left
+  planes[1] = rows[3] - rows[0];  // right
+  planes[2] = rows[3] + rows[1];  // bottom
+  planes[3] = rows[3] - rows[1];  // top
+  planes[4] = rows[2];            // near
+  planes[5] = rows[3] - rows[2];  // far
+  for (int i = 0; i < 6; i++) {
+    float length = glm::length(glm::vec3(planes[i]));
+    if (length > 0.0f) {
+      planes[i] /= length;
+    }
+  }
+}
+
+// Stage a blob and queue its upload into buffer, for the culling pass to read
+void upload(VkContext* context, const Buffer& buffer, const void* data, VkDeviceSize size) {
+  Buffer* staging = context->getStagingPool()->acquire(size);
+  staging->write(data, size);
+  context->getTransferManager()->uploadBuffer(staging, buffer.getBuffer(), size, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                              VK_ACCESS_SHADER_READ_BIT);
+}
+
+}  // namespace
+
+MeshletCuller::MeshletCuller(VkContext* context, Mesh* mesh, const MeshletData& meshlets, uint32_t framesInFlight)
+    : m_Context(context), m_Mesh(mesh) {
+  LOGFN;
+  m_MeshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+  m_TriangleCount = static_cast<uint32_t>(meshlets.triangles.size() / 3);
+  if (m_MeshletCount == 0) {
+    throw std::runtime_error("Meshlet culler needs at least one meshlet!");
+  }
+
+  std::vector<GpuMeshlet> gpuMeshlets(m_MeshletCount);
+  for (uint32_t i = 0; i < m_MeshletCount; i++) {
+    const auto& meshlet = meshlets.meshlets[i];
+    const auto& bounds = meshlets.bounds[i];
+    gpuMeshlets[i].sphere = glm::vec4(bounds.center, bounds.radius);
+    gpuMeshlets[i].cone = glm::vec4(bounds.coneAxis, bounds.coneCutoff);
+    gpuMeshlets[i].vertexOffset = meshlet.vertexOffset;
+    gpuMeshlets[i].triangleOffset = meshlet.triangleOffset;
+    gpuMeshlets[i].vertexCount = meshlet.vertexCount;
+    gpuMeshlets[i].triangleCount = meshlet.triangleCount;
+  }
+
+  // Local indices packed one triangle per word, the shader has no byte loads
+  std::vector<uint32_t> packedTriangles(m_TriangleCount);
+  for (uint32_t i = 0; i < m_TriangleCount; i++) {
+    packedTriangles[i] = meshlets.triangles[i * 3 + 0] | (meshlets.triangles[i * 3 + 1] << 8) |
+                         (meshlets.triangles[i * 3 + 2] << 16);
+  }
+
+  VkDeviceSize meshletBytes = gpuMeshlets.size() * sizeof(GpuMeshlet);
+  VkDeviceSize vertexBytes = meshlets.vertices.size() * sizeof(uint32_t);
+  VkDeviceSize triangleBytes = packedTriangles.size() * sizeof(uint32_t);
+  m_Meshlets = Buffer(context, BufferUsage::Storage, meshletBytes, MemoryTag::Mesh);
+  m_MeshletVertices = Buffer(context, BufferUsage::Storage, vertexBytes, MemoryTag::Mesh);
+  m_MeshletTriangles = Buffer(context, BufferUsage::Storage, triangleBytes, MemoryTag::Mesh);
+  VkUtils::setObjectName(m_Meshlets.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Meshlets");
+  VkUtils::setObjectName(m_MeshletVertices.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Meshlet Vertices");
+  VkUtils::setObjectName(m_MeshletTriangles.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Meshlet Triangles");
+
+  auto transferManager = m_Context->getTransferManager();
+  transferManager->beginBatch();
+  upload(m_Context, m_Meshlets, gpuMeshlets.data(), meshletBytes);
+  upload(m_Context, m_MeshletVertices, meshlets.vertices.data(), vertexBytes);
+  upload(m_Context, m_MeshletTriangles, packedTriangles.data(), triangleBytes);
+  m_UploadId = transferManager->endBatch();
+
+  // Sized for every triangle passing, the draw command is reset by the transfer at the start of each cull
+  m_Frames.resize(framesInFlight);
+  for (auto& frame : m_Frames) {
+    frame.params = std::make_unique<UniformBuffer>(m_Context, sizeof(CullParams));
+    frame.indices = Buffer(m_Context, static_cast<VkDeviceSize>(m_TriangleCount) * 3 * sizeof(uint32_t),
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryTag::Mesh);
+    frame.drawCommand = Buffer(m_Context, sizeof(VkDrawIndexedIndirectCommand),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryTag::Mesh);
+    VkUtils::setObjectName(frame.indices.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Culled Meshlet Indices");
+    VkUtils::setObjectName(frame.drawCommand.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Culled Meshlet Draw");
+  }
+
+  createDescriptors();
+
+  LOG("Meshlet culler created for", m_MeshletCount, "meshlets and", m_TriangleCount, "triangles");
+}
+
+MeshletCuller::~MeshletCuller() {
+  LOGFN;
+  // The meshlet buffers must not be freed while the upload is writing them
+  m_Context->getTransferManager()->wait(m_UploadId);
+}
+
+void MeshletCuller::createDescriptors() {
+  m_DescriptorSetLayout = DescriptorSetLayout::Builder(m_Context)
+                              .addUniformBuffer(0, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageBuffer(1, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageBuffer(2, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageBuffer(3, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageBuffer(4, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageBuffer(5, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .build();
+
+  uint32_t frameCount = static_cast<uint32_t>(m_Frames.size());
+  m_DescriptorPool = std::make_unique<DescriptorPool>(m_Context, m_DescriptorSetLayout.get(), frameCount);
+  m_Descriptor =
+      std::make_unique<Descriptor>(m_Context, m_DescriptorSetLayout.get(), m_DescriptorPool.get(), frameCount);
+
+  for (uint32_t i = 0; i < frameCount; i++) {
+    m_Descriptor->updateUniformBuffer(0, m_Frames[i].params->getBuffer(), sizeof(CullParams), 0, i);
+    m_Descriptor->updateStorageBuffer(1, m_Meshlets.getBuffer(), VK_WHOLE_SIZE, 0, i);
+    m_Descriptor->updateStorageBuffer(2, m_MeshletVertices.getBuffer(), VK_WHOLE_SIZE, 0, i);
+    m_Descriptor->updateStorageBuffer(3, m_MeshletTriangles.getBuffer(), VK_WHOLE_SIZE, 0, i);
+    m_Descriptor->updateStorageBuffer(4, m_Frames[i].indices.getBuffer(), VK_WHOLE_SIZE, 0, i);
+    m_Descriptor->updateStorageBuffer(5, m_Frames[i].drawCommand.getBuffer(), VK_WHOLE_SIZE, 0, i);
+  }
+
+  ComputePipelineConfig config;
+  config.shaderPath = Config::getShaderFile("meshlet_cull.comp");
+  config.descriptorSetLayout = m_DescriptorSetLayout->getLayout();
+  m_Pipeline = std::make_unique<ComputePipeline>(m_Context, config);
+}
+
+void MeshletCuller::update(uint32_t frame, const glm::mat4& model, const glm::mat4& viewProjection,
+                           const glm::vec3& cameraPosition) {
+  CullParams params{};
+  extractFrustumPlanes(viewProjection * model, params.frustumPlanes);
+  params.cameraPosition = glm::inverse(model) * glm::vec4(cameraPosition, 1.0f);
+  params.meshletCount = m_MeshletCount;
+  params.coneCulling = m_ConeCulling ? 1 : 0;
+  m_Frames[frame].params->update(&params);
+}
+
+void MeshletCuller::cull(VkCommandBuffer commandBuffer, uint32_t frame) {
+  LOGFN_ONCE;
+  const auto& resources = m_Frames[frame];
+
+  // The pass accumulates indexCount, the rest of the command is fixed
+  VkDrawIndexedIndirectCommand drawCommand{};
+  drawCommand.instanceCount = 1;
+  drawCommand.vertexOffset = static_cast<int32_t>(m_Mesh->getRange().vertexOffset);
+  vkCmdUpdateBuffer(commandBuffer, resources.drawCommand.getBuffer(), 0, sizeof(drawCommand), &drawCommand);
+
+  VkMemoryBarrier resetBarrier{};
+  resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &resetBarrier, 0, nullptr, 0, nullptr);
+
+  m_Pipeline->bind(commandBuffer);
+  m_Descriptor->bind(commandBuffer, m_Pipeline->getPipelineLayout(), frame, 0, nullptr,
+                     VK_PIPELINE_BIND_POINT_COMPUTE);
+
+  // One workgroup per meshlet, wrapped into rows when there are more than a dispatch dimension allows
+  uint32_t maxGroups = m_Context->getPhysicalDeviceProperties().limits.maxComputeWorkGroupCount[0];
+  uint32_t groupsX = std::min(m_MeshletCount, maxGroups);
+  uint32_t groupsY = (m_MeshletCount + groupsX - 1) / groupsX;
+  vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+  VkMemoryBarrier cullBarrier{};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &cullBarrier,
+                       0, nullptr, 0, nullptr);
+}
+
+void MeshletCuller::draw(VkCommandBuffer commandBuffer, uint32_t frame) {
+  LOGFN_ONCE;
+  const auto& resources = m_Frames[frame];
+
+  // The mesh's vertices with the culled indices in place of its own
+  m_Mesh->bind(commandBuffer);
+  vkCmdBindIndexBuffer(commandBuffer, resources.indices.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+  vkCmdDrawIndexedIndirect(commandBuffer, resources.drawCommand.getBuffer(), 0, 1,
+                           sizeof(VkDrawIndexedIndirectCommand));
+}
+
+}  // namespace glint
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "buffer.h"
+#include "descriptor.h"
+#include "meshlet_builder.h"
+#include "pipeline.h"
+
+namespace glint {
+
+class VkContext;
+class Mesh;
+
+// GPU culling of a mesh's meshlets. Every frame a compute pass tests each meshlet's bounding sphere against the
+// frustum and its normal cone against the camera, and appends the triangles of the survivors to a per frame index
+// buffer. The mesh is then drawn by one indexed indirect draw whose index count the pass accumulated.
+// All tests run in the mesh's model space, exact for any model matrix with a positive determinant.
+class MeshletCuller {
+ public:
+  // The mesh must outlive the culler. meshlets are built from the mesh's unquantized vertices and indices.
+  MeshletCuller(VkContext* context, Mesh* mesh, const MeshletData& meshlets, uint32_t framesInFlight);
+  ~MeshletCuller();
+
+  // Prevent copying
+  MeshletCuller(const MeshletCuller&) = delete;
+  MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+  // Camera of the next cull in a frame slot, call after Renderer::beginFrame. model excludes the dequantize matrix.
+  void update(uint32_t frame, const glm::mat4& model, const glm::mat4& viewProjection,
+              const glm::vec3& cameraPosition);
+
+  // Record the culling pass, outside of the render pass and before draw
+  void cull(VkCommandBuffer commandBuffer, uint32_t frame);
+
+  // Draw the surviving triangles with the bound graphics pipeline, binds the mesh's vertices
+  void draw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+  // Backface culling by normal cone, turn off for double sided geometry
+  void setConeCullingEnabled(bool enabled) { m_ConeCulling = enabled; }
+
+  uint32_t getMeshletCount() const { return m_MeshletCount; }
+  uint32_t getTriangleCount() const { return m_TriangleCount; }
+
+ private:
+  void createDescriptors();
+
+  struct FrameResources {
+    std::unique_ptr<UniformBuffer> params;
+    // Compacted triangles of the visible meshlets
+    Buffer indices;
+    // A single VkDrawIndexedIndirectCommand
+    Buffer drawCommand;
+  };
+
+ private:
+  VkContext* m_Context;
+  Mesh* m_Mesh;
+
+  uint32_t m_MeshletCount = 0;
+  uint32_t m_TriangleCount = 0;
+  bool m_ConeCulling = true;
+
+  Buffer m_Meshlets;
+  Buffer m_MeshletVertices;
+  Buffer m_MeshletTriangles;
+  std::vector<FrameResources> m_Frames;
+
+  std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
+  std::unique_ptr<DescriptorPool> m_DescriptorPool;
+  std::unique_ptr<Descriptor> m_Descriptor;
+  std::unique_ptr<ComputePipeline> m_Pipeline;
+
+  // Pending TransferManager upload of the meshlet buffers
+  uint64_t m_UploadId = 0;
+};
+
+}  // namespace glint
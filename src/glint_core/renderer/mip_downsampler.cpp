@@ -0,0 +1,318 @@
+#include "mip_downsampler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/config.h"
+#include "core/logger.h"
+#include "descriptor.h"
+#include "gpu_timer.h"
+#include "pipeline.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+namespace {
+
+// Matches mip_downsample.glsl
+constexpr uint32_t kTileSize = 32;
+constexpr uint32_t kReduceAverage = 0;
+constexpr uint32_t kReduceMin = 1;
+constexpr uint32_t kReduceMax = 2;
+
+struct DownsampleParams {
+  float fill[4];
+  int32_t sourceSize[2];
+  uint32_t destinationSize[2];
+  uint32_t levelCount;
+  uint32_t reduction;
+  uint32_t srgb;
+  uint32_t padded;
+};
+
+// Format of the storage views, sRGB formats can't be written by shaders so their UNORM alias is
+VkFormat getStorageFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_R32_SFLOAT:
+      return VK_FORMAT_R32_SFLOAT;
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
+uint32_t getReduction(MipReduction reduction) {
+  switch (reduction) {
+    case MipReduction::Min:
+      return kReduceMin;
+    case MipReduction::Max:
+      return kReduceMax;
+    default:
+      return kReduceAverage;
+  }
+}
+
+void logStats(const char* path, uint32_t textureCount, uint64_t texelCount, double milliseconds) {
+  if (textureCount > 0) {
+    LOG("Mips of", textureCount, "textures", path, "in", milliseconds, "ms on the GPU,",
+        milliseconds * 1e6 / static_cast<double>(texelCount), "ns per texel");
+  }
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// MipDownsampler
+
+MipDownsampler::MipDownsampler(VkContext* context, bool textureMips, bool timing)
+    : m_Context(context), m_TextureMips(textureMips), m_Timing(timing) {
+  LOGFN;
+  if (m_Timing) {
+    m_Timer = std::make_unique<GpuTimer>(m_Context, kTimerRanges);
+    for (uint32_t range = kTimerRanges; range > 0; range--) {
+      m_FreeTimerRanges.push_back(range - 1);
+    }
+  }
+
+  // The dispatch is recorded with the upload's graphics commands and with the frame's
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(m_Context->getPhysicalDevice(), &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_Context->getPhysicalDevice(), &familyCount, families.data());
+  uint32_t graphicsFamily = m_Context->getQueueFamilyIndices().graphicsFamily.value();
+  m_ComputeOnGraphicsQueue = (families[graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+  if (!m_ComputeOnGraphicsQueue) {
+    LOG("[WARNING] The graphics queue can't dispatch compute, mips are blitted");
+    return;
+  }
+
+  // Texels are fetched, the sampler only has to be valid
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(m_Context->getDevice(), &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create mip downsampler sampler!");
+  }
+
+  createPipelines();
+}
+
+MipDownsampler::~MipDownsampler() {
+  LOGFN;
+  logStats("built by compute", m_ComputeStats.textureCount, m_ComputeStats.texelCount, m_ComputeStats.milliseconds);
+  logStats("blitted", m_BlitStats.textureCount, m_BlitStats.texelCount, m_BlitStats.milliseconds);
+
+  m_IdleTargets.clear();
+  if (m_Sampler != VK_NULL_HANDLE) {
+    vkDestroySampler(m_Context->getDevice(), m_Sampler, nullptr);
+  }
+}
+
+void MipDownsampler::createPipelines() {
+  m_DescriptorSetLayout = DescriptorSetLayout::Builder(m_Context)
+                              .addTextureSampler(0, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addStorageImage(1, VK_SHADER_STAGE_COMPUTE_BIT, kMaxLevels)
+                              .addStorageBuffer(2, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .build();
+
+  ComputePipelineConfig config;
+  config.descriptorSetLayout = m_DescriptorSetLayout->getLayout();
+  config.pushConstantRanges = {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsampleParams)}};
+
+  config.shaderPath = Config::getShaderFile("mip_downsample_rgba8.comp");
+  m_ColorPipeline = std::make_unique<ComputePipeline>(m_Context, config);
+  config.shaderPath = Config::getShaderFile("mip_downsample_r32f.comp");
+  m_FloatPipeline = std::make_unique<ComputePipeline>(m_Context, config);
+  config.shaderPath = Config::getShaderFile("mip_downsample_r32f_ms.comp");
+  m_MultisampledPipeline = std::make_unique<ComputePipeline>(m_Context, config);
+}
+
+bool MipDownsampler::isSupported(VkFormat format, VkExtent2D destinationExtent, uint32_t levelCount) const {
+  VkFormat storageFormat = getStorageFormat(format);
+  return m_ComputeOnGraphicsQueue && storageFormat != VK_FORMAT_UNDEFINED && levelCount > 0 &&
+         levelCount <= kMaxLevels && destinationExtent.width <= kMaxExtent &&
+         destinationExtent.height <= kMaxExtent &&
+         m_Context->isFormatSupported(storageFormat, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+void MipDownsampler::addTextureTime(bool compute, uint32_t width, uint32_t height, double milliseconds) {
+  if (milliseconds < 0.0) {
+    return;
+  }
+  LOG("Mips of a", width, "x", height, "texture", compute ? "built by compute" : "blitted", "in", milliseconds,
+      "ms on the GPU");
+
+  std::lock_guard<std::mutex> lock(m_StatsMutex);
+  TimingStats& stats = compute ? m_ComputeStats : m_BlitStats;
+  stats.textureCount++;
+  stats.texelCount += static_cast<uint64_t>(width) * height;
+  stats.milliseconds += milliseconds;
+}
+
+std::unique_ptr<MipDownsampler::Target> MipDownsampler::acquireTarget(const MipDownsampleConfig& config) {
+  std::unique_ptr<Target> target;
+  {
+    std::lock_guard<std::mutex> lock(m_PoolMutex);
+    if (!m_IdleTargets.empty()) {
+      target = std::move(m_IdleTargets.back());
+      m_IdleTargets.pop_back();
+    }
+  }
+
+  if (!target) {
+    return std::make_unique<Target>(this, config);
+  }
+  target->setConfig(config);
+  return target;
+}
+
+void MipDownsampler::releaseTarget(std::unique_ptr<Target> target) {
+  std::lock_guard<std::mutex> lock(m_PoolMutex);
+  if (target && m_IdleTargets.size() < kMaxIdleTargets) {
+    m_IdleTargets.push_back(std::move(target));
+  }
+}
+
+uint32_t MipDownsampler::acquireTimerRange() {
+  std::lock_guard<std::mutex> lock(m_PoolMutex);
+  if (m_FreeTimerRanges.empty()) {
+    return kNoTimerRange;
+  }
+  uint32_t range = m_FreeTimerRanges.back();
+  m_FreeTimerRanges.pop_back();
+  return range;
+}
+
+void MipDownsampler::releaseTimerRange(uint32_t range) {
+  std::lock_guard<std::mutex> lock(m_PoolMutex);
+  if (range != kNoTimerRange) {
+    m_FreeTimerRanges.push_back(range);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MipDownsampler::Target
+
+MipDownsampler::Target::Target(MipDownsampler* downsampler, const MipDownsampleConfig& config)
+    : m_Downsampler(downsampler) {
+  setConfig(config);
+}
+
+MipDownsampler::Target::~Target() { destroyViews(); }
+
+void MipDownsampler::Target::setConfig(const MipDownsampleConfig& config) {
+  VkContext* context = m_Downsampler->m_Context;
+  if (!m_Downsampler->isSupported(config.destinationFormat, config.destinationExtent, config.levelCount)) {
+    throw std::runtime_error("Mip downsampling of format " + std::to_string(config.destinationFormat) +
+                             " is not supported!");
+  }
+  bool floatDestination = config.destinationFormat == VK_FORMAT_R32_SFLOAT;
+  if (!floatDestination && config.reduction != MipReduction::Average) {
+    throw std::runtime_error("Min and max mip reductions need an R32_SFLOAT destination!");
+  }
+  bool multisampled = config.sourceSamples != VK_SAMPLE_COUNT_1_BIT;
+  if (!floatDestination && multisampled) {
+    throw std::runtime_error("Multisampled mip sources need an R32_SFLOAT destination!");
+  }
+  if (multisampled) {
+    m_Pipeline = m_Downsampler->m_MultisampledPipeline.get();
+  } else {
+    m_Pipeline = floatDestination ? m_Downsampler->m_FloatPipeline.get() : m_Downsampler->m_ColorPipeline.get();
+  }
+
+  destroyViews();
+  m_Config = config;
+  m_SourceView = VkUtils::createImageView(config.source, config.sourceFormat, config.sourceAspect, 1,
+                                          config.sourceLevel);
+
+  // Unused array elements alias the last level, every element the shader can reach must be valid
+  VkFormat storageFormat = getStorageFormat(config.destinationFormat);
+  for (uint32_t level = 0; level < config.levelCount; level++) {
+    m_LevelViews.push_back(VkUtils::createImageView(config.destination, storageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+                                                    config.baseLevel + level));
+  }
+  std::vector<VkImageView> views = m_LevelViews;
+  views.resize(kMaxLevels, m_LevelViews.back());
+
+  // One workgroup per 32x32 texels of the first level
+  m_GroupsX = (config.destinationExtent.width + kTileSize - 1) / kTileSize;
+  m_GroupsY = (config.destinationExtent.height + kTileSize - 1) / kTileSize;
+
+  // Kept while large enough for the destination
+  VkDeviceSize resultsSize = 4 * sizeof(float) * (1 + static_cast<VkDeviceSize>(m_GroupsX) * m_GroupsY);
+  if (m_GroupResults.getSize() < resultsSize) {
+    m_GroupResults = Buffer(context, resultsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryTag::Texture);
+    VkUtils::setObjectName(m_GroupResults.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Mip Downsample Groups");
+  }
+
+  if (!m_Descriptor) {
+    DescriptorSetLayout* layout = m_Downsampler->m_DescriptorSetLayout.get();
+    m_DescriptorPool = std::make_unique<DescriptorPool>(context, layout, 1);
+    m_Descriptor = std::make_unique<Descriptor>(context, layout, m_DescriptorPool.get());
+  }
+  m_Descriptor->updateTextureSampler(0, m_SourceView, m_Downsampler->m_Sampler);
+  m_Descriptor->updateStorageImages(1, views);
+  m_Descriptor->updateStorageBuffer(2, m_GroupResults.getBuffer());
+}
+
+void MipDownsampler::Target::destroyViews() {
+  VkDevice device = m_Downsampler->m_Context->getDevice();
+  for (VkImageView view : m_LevelViews) {
+    vkDestroyImageView(device, view, nullptr);
+  }
+  m_LevelViews.clear();
+  if (m_SourceView != VK_NULL_HANDLE) {
+    vkDestroyImageView(device, m_SourceView, nullptr);
+    m_SourceView = VK_NULL_HANDLE;
+  }
+}
+
+void MipDownsampler::Target::record(VkCommandBuffer commandBuffer) {
+  LOGFN_ONCE;
+  // The counter is reset once the previous dispatch is done with it, then counts the finished workgroups
+  VkMemoryBarrier reuseBarrier{};
+  reuseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  reuseBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  reuseBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                       &reuseBarrier, 0, nullptr, 0, nullptr);
+
+  vkCmdFillBuffer(commandBuffer, m_GroupResults.getBuffer(), 0, sizeof(uint32_t), 0);
+
+  VkMemoryBarrier resetBarrier{};
+  resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &resetBarrier, 0, nullptr, 0, nullptr);
+
+  DownsampleParams params{};
+  for (int i = 0; i < 4; i++) {
+    params.fill[i] = m_Config.fill.float32[i];
+  }
+  params.sourceSize[0] = static_cast<int32_t>(m_Config.sourceExtent.width);
+  params.sourceSize[1] = static_cast<int32_t>(m_Config.sourceExtent.height);
+  params.destinationSize[0] = m_Config.destinationExtent.width;
+  params.destinationSize[1] = m_Config.destinationExtent.height;
+  params.levelCount = m_Config.levelCount;
+  params.reduction = getReduction(m_Config.reduction);
+  params.srgb = m_Config.destinationFormat == VK_FORMAT_R8G8B8A8_SRGB ? 1 : 0;
+  params.padded = m_Config.padded ? 1 : 0;
+
+  m_Pipeline->bind(commandBuffer);
+  m_Descriptor->bind(commandBuffer, m_Pipeline->getPipelineLayout(), 0, 0, nullptr, VK_PIPELINE_BIND_POINT_COMPUTE);
+  vkCmdPushConstants(commandBuffer, m_Pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params),
+                     &params);
+  vkCmdDispatch(commandBuffer, m_GroupsX, m_GroupsY, 1);
+}
+
+}  // namespace glint
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.h"
+
+namespace glint {
+
+class VkContext;
+class ComputePipeline;
+class DescriptorSetLayout;
+class DescriptorPool;
+class Descriptor;
+class GpuTimer;
+
+// How a destination texel combines the 2x2 texels below it
+enum class MipReduction {
+  // 2x2 box filter with each level floor-halved, odd sized levels drop their last row / column unlike a linear blit
+  Average,
+  // Nearest / farthest depth of a hierarchical depth buffer, single channel float destinations only
+  Min,
+  Max,
+};
+
+struct MipDownsampleConfig {
+  // Mip sourceLevel of source is read in SHADER_READ_ONLY_OPTIMAL layout
+  VkImage source = VK_NULL_HANDLE;
+  VkFormat sourceFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  VkImageAspectFlags sourceAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  uint32_t sourceLevel = 0;
+  VkExtent2D sourceExtent = {0, 0};
+  // The samples of a multisampled source, e.g. an MSAA depth buffer, are reduced like the 2x2 texels. R32_SFLOAT
+  // destinations only.
+  VkSampleCountFlagBits sourceSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  // Levels [baseLevel, baseLevel + levelCount) of destination are written in GENERAL layout, level baseLevel has
+  // destinationExtent and each further level half the previous one. destinationFormat is R8G8B8A8 or R32_SFLOAT.
+  // sRGB can't be a storage format, sRGB destinations are created R8G8B8A8_UNORM with
+  // VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT and viewed as sRGB, the texels are encoded by the shader.
+  VkImage destination = VK_NULL_HANDLE;
+  VkFormat destinationFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  VkExtent2D destinationExtent = {0, 0};
+  uint32_t baseLevel = 0;
+  uint32_t levelCount = 0;
+
+  MipReduction reduction = MipReduction::Average;
+  // Source texels past sourceExtent read as fill instead of the edge texel, for destinations covering more than the
+  // source such as a power of two depth pyramid
+  bool padded = false;
+  VkClearColorValue fill{};
+};
+
+// Builds a whole mip chain with one compute dispatch, see mip_downsample.glsl, instead of a blit and two barriers per
+// level. Workgroups reduce 64x64 texel tiles through six levels in shared memory and the last one to finish reduces
+// the rest, so a destination level 0 is at most kMaxExtent texels. Used for texture uploads, see Texture, and for
+// per frame chains such as the DepthPyramid. Owned by the VkContext.
+class MipDownsampler {
+ public:
+  static constexpr uint32_t kMaxLevels = 12;
+  static constexpr uint32_t kMaxExtent = 1u << (kMaxLevels - 1);
+
+  // Storage views, descriptors and workgroup counter of one destination. Can be recorded again, e.g. every frame, but
+  // must not be destroyed or reconfigured while a dispatch is in flight.
+  class Target {
+   public:
+    Target(MipDownsampler* downsampler, const MipDownsampleConfig& config);
+    ~Target();
+
+    // Prevent copying
+    Target(const Target&) = delete;
+    Target& operator=(const Target&) = delete;
+
+    // Point the target at another destination, the descriptors and the counter buffer are kept
+    void setConfig(const MipDownsampleConfig& config);
+
+    // Record the dispatch outside of a render pass, the caller transitions the images before and makes the compute
+    // shader writes visible after
+    void record(VkCommandBuffer commandBuffer);
+
+   private:
+    void destroyViews();
+
+   private:
+    MipDownsampler* m_Downsampler;
+    ComputePipeline* m_Pipeline = nullptr;
+
+    VkImageView m_SourceView = VK_NULL_HANDLE;
+    std::vector<VkImageView> m_LevelViews;
+    // Workgroup counter followed by one texel per workgroup
+    Buffer m_GroupResults;
+    std::unique_ptr<DescriptorPool> m_DescriptorPool;
+    std::unique_ptr<Descriptor> m_Descriptor;
+
+    MipDownsampleConfig m_Config;
+    uint32_t m_GroupsX = 0;
+    uint32_t m_GroupsY = 0;
+  };
+
+  // textureMips lets Texture build its mips with the downsampler, otherwise they are blitted. timing measures the GPU
+  // time of every texture's mip generation, logged per texture and summed up on destruction.
+  MipDownsampler(VkContext* context, bool textureMips, bool timing);
+  ~MipDownsampler();
+
+  // Prevent copying
+  MipDownsampler(const MipDownsampler&) = delete;
+  MipDownsampler& operator=(const MipDownsampler&) = delete;
+
+  // Whether a destination of format and extent can be built, compute must run on the graphics queue and the format,
+  // or its UNORM alias for sRGB, must support storage
+  bool isSupported(VkFormat format, VkExtent2D destinationExtent, uint32_t levelCount) const;
+
+  bool isTextureMipsEnabled() const { return m_TextureMips; }
+  bool isTimingEnabled() const { return m_Timing; }
+  // Record the measured mip generation time of a texture, compute or blitted
+  void addTextureTime(bool compute, uint32_t width, uint32_t height, double milliseconds);
+
+  // Texture uploads borrow a pooled Target while their mips are built, instead of creating descriptors and a counter
+  // buffer per texture. Give it back once the dispatch has completed. Thread safe.
+  std::unique_ptr<Target> acquireTarget(const MipDownsampleConfig& config);
+  void releaseTarget(std::unique_ptr<Target> target);
+
+  // A range of the shared texture timer, kNoTimerRange when timing is off or every range is being measured. Give it
+  // back once the timed commands have completed. Thread safe.
+  static constexpr uint32_t kNoTimerRange = UINT32_MAX;
+  uint32_t acquireTimerRange();
+  void releaseTimerRange(uint32_t range);
+  GpuTimer* getTimer() const { return m_Timer.get(); }
+
+ private:
+  void createPipelines();
+
+  // Idle targets kept for the next uploads, and texture mip generations timed at once
+  static constexpr size_t kMaxIdleTargets = 4;
+  static constexpr uint32_t kTimerRanges = 64;
+
+  struct TimingStats {
+    uint32_t textureCount = 0;
+    uint64_t texelCount = 0;
+    double milliseconds = 0.0;
+  };
+
+ private:
+  VkContext* m_Context;
+  bool m_TextureMips = true;
+  bool m_Timing = false;
+  bool m_ComputeOnGraphicsQueue = false;
+
+  VkSampler m_Sampler = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
+  // One pipeline per destination format, R8G8B8A8 and R32_SFLOAT, and one for multisampled sources
+  std::unique_ptr<ComputePipeline> m_ColorPipeline;
+  std::unique_ptr<ComputePipeline> m_FloatPipeline;
+  std::unique_ptr<ComputePipeline> m_MultisampledPipeline;
+
+  std::mutex m_PoolMutex;
+  std::vector<std::unique_ptr<Target>> m_IdleTargets;
+  std::unique_ptr<GpuTimer> m_Timer;
+  std::vector<uint32_t> m_FreeTimerRanges;
+
+  std::mutex m_StatsMutex;
+  TimingStats m_ComputeStats;
+  TimingStats m_BlitStats;
+};
+
+}  // namespace glint
@@ -0,0 +1,289 @@
+#include "mip_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "core/logger.h"
+#include "core/parallel.h"
+#include "core/simd.h"
+
+namespace glint {
+
+namespace {
+
+// Destination texels per thread, smaller levels are filtered on fewer threads
+constexpr uint64_t kTexelsPerThread = 1 << 16;
+
+constexpr float kPi = 3.14159265358979f;
+constexpr uint32_t kMaxTaps = 6;
+constexpr float kKaiserAlpha = 4.0f;
+// Half width of the Kaiser window in destination texels, covering 6 source texels
+constexpr float kKaiserRadius = 1.5f;
+
+// Entries of the table giving a first guess of the sRGB encoding of a linear value
+constexpr uint32_t kEncodeGuesses = 4096;
+
+#ifdef GLINT_SSE
+// The four channels of a texel, wrapped so it can be stored in containers
+struct Pixel {
+  __m128 channels;
+};
+
+Pixel makePixel(float r, float g, float b, float a) { return {_mm_setr_ps(r, g, b, a)}; }
+Pixel zeroPixel() { return {_mm_setzero_ps()}; }
+Pixel multiplyAdd(Pixel sum, Pixel value, float weight) {
+  return {_mm_add_ps(sum.channels, _mm_mul_ps(value.channels, _mm_set1_ps(weight)))};
+}
+void storePixel(Pixel value, float* out) {
+  _mm_storeu_ps(out, _mm_min_ps(_mm_max_ps(value.channels, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+}
+#else
+struct Pixel {
+  float channels[4];
+};
+
+Pixel makePixel(float r, float g, float b, float a) { return {{r, g, b, a}}; }
+Pixel zeroPixel() { return {}; }
+Pixel multiplyAdd(Pixel sum, Pixel value, float weight) {
+  for (uint32_t c = 0; c < 4; c++) {
+    sum.channels[c] += value.channels[c] * weight;
+  }
+  return sum;
+}
+void storePixel(Pixel value, float* out) {
+  for (uint32_t c = 0; c < 4; c++) {
+    out[c] = std::clamp(value.channels[c], 0.0f, 1.0f);
+  }
+}
+#endif
+
+// Separable 2x downsampling, destination texel x weighs source texels 2x + firstTap + [0, taps)
+struct Kernel {
+  uint32_t taps;
+  int32_t firstTap;
+  float weights[kMaxTaps];
+};
+
+float besselI0(float x) {
+  float sum = 1.0f;
+  float term = 1.0f;
+  for (uint32_t k = 1; k < 20; k++) {
+    term *= (x * 0.5f / k) * (x * 0.5f / k);
+    sum += term;
+  }
+  return sum;
+}
+
+const Kernel& getKernel(MipFilter filter) {
+  static const Kernel box = {2, 0, {0.5f, 0.5f}};
+  static const Kernel kaiser = []() {
+    Kernel kernel = {kMaxTaps, -2, {}};
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < kMaxTaps; k++) {
+      // Distance of the source texel center to the destination texel center, in destination texels
+      float distance = (static_cast<float>(k) - 2.5f) * 0.5f;
+      float x = distance * kPi;
+      float sinc = std::sin(x) / x;
+      float t = distance / kKaiserRadius;
+      kernel.weights[k] = sinc * besselI0(kKaiserAlpha * std::sqrt(1.0f - t * t)) / besselI0(kKaiserAlpha);
+      sum += kernel.weights[k];
+    }
+    for (uint32_t k = 0; k < kMaxTaps; k++) {
+      kernel.weights[k] /= sum;
+    }
+    return kernel;
+  }();
+  return filter == MipFilter::Kaiser ? kaiser : box;
+}
+
+struct SrgbTables {
+  std::array<float, 256> toLinear;
+  // Smallest linear value encoding to each byte
+  std::array<float, 256> thresholds;
+  std::array<uint8_t, kEncodeGuesses> guesses;
+};
+
+float srgbToLinear(float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+
+const SrgbTables& getSrgbTables() {
+  static const SrgbTables tables = []() {
+    SrgbTables t;
+    for (uint32_t i = 0; i < 256; i++) {
+      t.toLinear[i] = srgbToLinear(i / 255.0f);
+      t.thresholds[i] = i == 0 ? -INFINITY : srgbToLinear((i - 0.5f) / 255.0f);
+    }
+    for (uint32_t i = 0; i < kEncodeGuesses; i++) {
+      float value = static_cast<float>(i) / (kEncodeGuesses - 1);
+      auto upper = std::upper_bound(t.thresholds.begin(), t.thresholds.end(), value);
+      t.guesses[i] = static_cast<uint8_t>(upper - t.thresholds.begin() - 1);
+    }
+    return t;
+  }();
+  return tables;
+}
+
+// Rounds to the nearest sRGB byte like the encoding in the sampler's inverse, value in [0, 1]
+uint8_t encodeSrgb(float value, const SrgbTables& tables) {
+  uint32_t encoded = tables.guesses[static_cast<uint32_t>(value * (kEncodeGuesses - 1))];
+  while (encoded < 255 && value >= tables.thresholds[encoded + 1]) {
+    encoded++;
+  }
+  while (value < tables.thresholds[encoded]) {
+    encoded--;
+  }
+  return static_cast<uint8_t>(encoded);
+}
+
+// One level of the chain, filtered from the byte texels of level 0 or the float texels of the level before
+class LevelFilter {
+ public:
+  LevelFilter(const ImageData& image, uint32_t level, const Kernel& kernel, const std::vector<Pixel>& source)
+      : m_Image(image),
+        m_Kernel(kernel),
+        m_Source(source),
+        m_SourceWidth(image.getMipWidth(level - 1)),
+        m_SourceHeight(image.getMipHeight(level - 1)),
+        m_Width(image.getMipWidth(level)),
+        m_Srgb(image.format == VK_FORMAT_R8G8B8A8_SRGB) {}
+
+  // Filter destination rows [begin, end) into out and, when not null, next as the source of the following level
+  void filterRows(uint32_t begin, uint32_t end, uint8_t* out, Pixel* next) const {
+    const SrgbTables& tables = getSrgbTables();
+    // A local copy, texel stores may alias the member
+    const Kernel kernel = m_Kernel;
+    // Horizontally filtered source rows, the window slides down two rows per destination row
+    std::vector<Pixel> rows(static_cast<size_t>(m_Kernel.taps) * m_Width);
+    std::vector<int64_t> rowKeys(m_Kernel.taps, INT64_MIN);
+    std::vector<Pixel> converted(m_Source.empty() ? m_SourceWidth : 0);
+    const Pixel* window[kMaxTaps];
+
+    for (uint32_t y = begin; y < end; y++) {
+      for (uint32_t k = 0; k < kernel.taps; k++) {
+        int64_t row = 2 * static_cast<int64_t>(y) + kernel.firstTap + k;
+        size_t slot = static_cast<size_t>(row + 2 * kernel.taps) % kernel.taps;
+        Pixel* filtered = rows.data() + slot * m_Width;
+        if (rowKeys[slot] != row) {
+          rowKeys[slot] = row;
+          filterRow(getSourceRow(row, converted, tables), filtered);
+        }
+        window[k] = filtered;
+      }
+
+      uint8_t* outRow = out + static_cast<size_t>(y) * m_Width * 4;
+      for (uint32_t x = 0; x < m_Width; x++) {
+        Pixel sum = zeroPixel();
+        for (uint32_t k = 0; k < kernel.taps; k++) {
+          sum = multiplyAdd(sum, window[k][x], kernel.weights[k]);
+        }
+        alignas(16) float texel[4];
+        storePixel(sum, texel);
+        if (next) {
+          next[static_cast<size_t>(y) * m_Width + x] = makePixel(texel[0], texel[1], texel[2], texel[3]);
+        }
+        for (uint32_t c = 0; c < 4; c++) {
+          // Alpha and the channels of UNORM images are linear
+          outRow[x * 4 + c] = m_Srgb && c < 3 ? encodeSrgb(texel[c], tables)
+                                              : static_cast<uint8_t>(texel[c] * 255.0f + 0.5f);
+        }
+      }
+    }
+  }
+
+ private:
+  const Pixel* getSourceRow(int64_t row, std::vector<Pixel>& converted, const SrgbTables& tables) const {
+    // Clamped so odd sizes and 1 pixel high mips reuse the edge rows
+    size_t y = static_cast<size_t>(std::clamp<int64_t>(row, 0, m_SourceHeight - 1));
+    if (!m_Source.empty()) {
+      return m_Source.data() + y * m_SourceWidth;
+    }
+
+    const uint8_t* texels = m_Image.pixels.get() + y * m_SourceWidth * 4;
+    const float* toLinear = m_Srgb ? tables.toLinear.data() : nullptr;
+    for (uint32_t x = 0; x < m_SourceWidth; x++) {
+      const uint8_t* texel = texels + x * 4;
+      float alpha = texel[3] / 255.0f;
+      converted[x] = toLinear ? makePixel(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], alpha)
+                              : makePixel(texel[0] / 255.0f, texel[1] / 255.0f, texel[2] / 255.0f, alpha);
+    }
+    return converted.data();
+  }
+
+  void filterRow(const Pixel* source, Pixel* out) const {
+    const Kernel kernel = m_Kernel;
+    int64_t lastColumn = m_SourceWidth - 1;
+    for (uint32_t x = 0; x < m_Width; x++) {
+      int64_t first = 2 * static_cast<int64_t>(x) + kernel.firstTap;
+      Pixel sum = zeroPixel();
+      if (first >= 0 && first + kernel.taps - 1 <= lastColumn) {
+        for (uint32_t k = 0; k < kernel.taps; k++) {
+          sum = multiplyAdd(sum, source[first + k], kernel.weights[k]);
+        }
+      } else {
+        for (uint32_t k = 0; k < kernel.taps; k++) {
+          sum = multiplyAdd(sum, source[std::clamp<int64_t>(first + k, 0, lastColumn)], kernel.weights[k]);
+        }
+      }
+      out[x] = sum;
+    }
+  }
+
+ private:
+  const ImageData& m_Image;
+  const Kernel& m_Kernel;
+  // Float texels of the previous level, empty for level 0
+  const std::vector<Pixel>& m_Source;
+  int64_t m_SourceWidth;
+  int64_t m_SourceHeight;
+  uint32_t m_Width;
+  bool m_Srgb;
+};
+
+}  // namespace
+
+void MipGenerator::generate(ImageData& image, MipFilter filter, uint32_t threadCount) {
+  if (image.format != VK_FORMAT_R8G8B8A8_SRGB && image.format != VK_FORMAT_R8G8B8A8_UNORM) {
+    throw std::runtime_error("Mips can only be generated for RGBA8 images");
+  }
+  uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(std::max(image.width, image.height)))) + 1;
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  image.mipOffsets.clear();
+  size_t totalSize = 0;
+  for (uint32_t level = 1; level < levels; level++) {
+    image.mipOffsets.push_back(totalSize);
+    totalSize += static_cast<size_t>(image.getMipSize(level));
+  }
+  image.mipPixels.resize(totalSize);
+
+  const Kernel& kernel = getKernel(filter);
+  std::vector<Pixel> source;
+  std::vector<Pixel> next;
+  for (uint32_t level = 1; level < levels; level++) {
+    uint32_t width = image.getMipWidth(level);
+    uint32_t height = image.getMipHeight(level);
+    // The last level isn't filtered any further
+    next.resize(level + 1 < levels ? static_cast<size_t>(width) * height : 0);
+
+    LevelFilter levelFilter(image, level, kernel, source);
+    uint8_t* out = image.mipPixels.data() + image.mipOffsets[level - 1];
+    uint32_t levelThreads = static_cast<uint32_t>(std::clamp<uint64_t>(
+        static_cast<uint64_t>(width) * height / kTexelsPerThread, 1, std::min(threadCount, height)));
+    parallelFor(levelThreads, [&](uint32_t thread) {
+      uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(height) * thread / levelThreads);
+      uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(height) * (thread + 1) / levelThreads);
+      levelFilter.filterRows(begin, end, out, next.empty() ? nullptr : next.data());
+    });
+    std::swap(source, next);
+  }
+
+  LOG("Generated", levels - 1, "mips of", image.width, "x", image.height, "image with the",
+      filter == MipFilter::Kaiser ? "Kaiser" : "box", "filter");
+}
+
+}  // namespace glint
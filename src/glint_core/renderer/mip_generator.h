@@ -0,0 +1,17 @@
+#pragma once
+
+#include "texture.h"
+
+namespace glint {
+
+// CPU mip chains of RGBA8 images, filtered in linear space for sRGB images. Every level is filtered from the previous
+// one kept in float precision, the rows of a level are split over threads and the four channels of a texel are
+// filtered together with SSE. Thread safe, no Vulkan calls.
+class MipGenerator {
+ public:
+  // Replace the image's mips with the full chain down to 1x1. threadCount 0 uses one thread per core, small levels use
+  // fewer. Throws for images that aren't R8G8B8A8.
+  static void generate(ImageData& image, MipFilter filter = MipFilter::Box, uint32_t threadCount = 0);
+};
+
+}  // namespace glint
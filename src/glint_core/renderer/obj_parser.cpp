@@ -0,0 +1,363 @@
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include "core/logger.h"
+#include "core/mapped_file.h"
+#include "core/parallel.h"
+#include "mesh.h"
+#include "vertex_dedup.h"
+
+namespace glint {
+
+namespace {
+
+// Absolute face references are final when parsed. Relative ones become an index into the parsing chunk's own
+// attributes, negative when they reach into earlier chunks, offset by -kRelative until the chunk's base is known.
+constexpr int64_t kRelative = int64_t(1) << 62;
+constexpr int64_t kNoTexCoord = INT64_MIN;
+
+struct Corner {
+  int64_t position;
+  int64_t texCoord;
+};
+
+struct ShapeStart {
+  // Chunk corner while parsing, stream position once the window is expanded
+  size_t corner;
+  std::string name;
+};
+
+struct Chunk {
+  const char* begin = nullptr;
+  const char* end = nullptr;
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texCoords;
+  // Three per triangle
+  std::vector<Corner> corners;
+  std::vector<ShapeStart> shapes;
+
+  std::string error;
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char* skipSpaces(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+bool parseFloat(const char*& p, const char* end, float& value) {
+  p = skipSpaces(p, end);
+  if (p < end && *p == '+') {
+    p++;
+  }
+  auto [next, ec] = std::from_chars(p, end, value);
+  if (ec == std::errc::invalid_argument) {
+    return false;
+  }
+  // Denormals and overflows read as 0
+  if (ec == std::errc::result_out_of_range) {
+    value = 0.0f;
+  }
+  p = next;
+  return true;
+}
+
+bool parseIndex(const char*& p, const char* end, int64_t& value) {
+  auto [next, ec] = std::from_chars(p, end, value);
+  if (ec != std::errc() || value == 0) {
+    return false;
+  }
+  p = next;
+  return true;
+}
+
+int64_t toReference(int64_t index, size_t count) {
+  return index > 0 ? index - 1 : static_cast<int64_t>(count) + index - kRelative;
+}
+
+// Index into the model's attributes, base is the attribute count before the chunk
+int64_t resolve(int64_t reference, size_t base) {
+  return reference >= 0 ? reference : reference + kRelative + static_cast<int64_t>(base);
+}
+
+// v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char*& p, const char* end, const Chunk& chunk, Corner& corner) {
+  int64_t index = 0;
+  if (!parseIndex(p, end, index)) {
+    return false;
+  }
+  corner.position = toReference(index, chunk.positions.size());
+  corner.texCoord = kNoTexCoord;
+
+  if (p < end && *p == '/') {
+    p++;
+    if (p < end && *p != '/') {
+      if (!parseIndex(p, end, index)) {
+        return false;
+      }
+      corner.texCoord = toReference(index, chunk.texCoords.size());
+    }
+    // Normals are not used
+    if (p < end && *p == '/') {
+      p++;
+      if (!parseIndex(p, end, index)) {
+        return false;
+      }
+    }
+  }
+  return p == end || isSpace(*p);
+}
+
+bool parseLine(const char* p, const char* end, Chunk& chunk, std::vector<Corner>& polygon) {
+  p = skipSpaces(p, end);
+  if (p == end || *p == '#') {
+    return true;
+  }
+
+  const char* keywordEnd = p;
+  while (keywordEnd < end && !isSpace(*keywordEnd)) {
+    keywordEnd++;
+  }
+  std::string_view keyword(p, keywordEnd - p);
+  p = keywordEnd;
+
+  if (keyword == "v") {
+    glm::vec3& position = chunk.positions.emplace_back();
+    return parseFloat(p, end, position.x) && parseFloat(p, end, position.y) && parseFloat(p, end, position.z);
+  }
+
+  if (keyword == "vt") {
+    glm::vec2& texCoord = chunk.texCoords.emplace_back(0.0f);
+    if (!parseFloat(p, end, texCoord.x)) {
+      return false;
+    }
+    // v is optional
+    const char* next = p;
+    if (parseFloat(next, end, texCoord.y)) {
+      p = next;
+    }
+    return true;
+  }
+
+  if (keyword == "f") {
+    polygon.clear();
+    for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end)) {
+      if (!parseCorner(p, end, chunk, polygon.emplace_back())) {
+        return false;
+      }
+    }
+    if (polygon.size() < 3) {
+      return false;
+    }
+    for (size_t i = 1; i + 1 < polygon.size(); i++) {
+      chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[i], polygon[i + 1]});
+    }
+    return true;
+  }
+
+  if (keyword == "o" || keyword == "g") {
+    p = skipSpaces(p, end);
+    const char* nameEnd = end;
+    while (nameEnd > p && isSpace(nameEnd[-1])) {
+      nameEnd--;
+    }
+    chunk.shapes.push_back({chunk.corners.size(), std::string(p, nameEnd)});
+  }
+
+  // vn, usemtl, mtllib, s, l, p, ...
+  return true;
+}
+
+void parseChunk(Chunk& chunk) {
+  std::vector<Corner> polygon;
+  for (const char* line = chunk.begin; line < chunk.end;) {
+    auto lineEnd = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+    if (!lineEnd) {
+      lineEnd = chunk.end;
+    }
+    if (!parseLine(line, lineEnd, chunk, polygon)) {
+      chunk.error = "Malformed line \"" + std::string(line, std::min<size_t>(lineEnd - line, 80)) + "\"";
+      return;
+    }
+    line = lineEnd + 1;
+  }
+}
+
+// Reads a mapped OBJ file a window of chunks at a time and keeps the attributes its faces may refer to
+class ObjReader {
+ public:
+  ObjReader(const std::string& path, uint32_t threadCount)
+      : m_Path(path),
+        m_File(path),
+        m_Cursor(reinterpret_cast<const char*>(m_File.getData())),
+        m_End(m_Cursor + m_File.getSize()),
+        m_ThreadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())) {}
+
+  // Parse the next window, append a vertex per face corner to stream and the window's shape statements, with their
+  // stream position, to shapes. False once the whole file has been read.
+  bool readWindow(std::vector<Vertex>& stream, std::vector<ShapeStart>& shapes) {
+    if (m_Cursor >= m_End) {
+      return false;
+    }
+
+    std::vector<Chunk> chunks;
+    while (m_Cursor < m_End && chunks.size() < m_ThreadCount) {
+      Chunk& chunk = chunks.emplace_back();
+      chunk.begin = m_Cursor;
+      chunk.end = m_Cursor + std::min<size_t>(ObjParser::kChunkSize, m_End - m_Cursor);
+      if (chunk.end < m_End) {
+        auto lineBreak = static_cast<const char*>(std::memchr(chunk.end - 1, '\n', m_End - chunk.end + 1));
+        chunk.end = lineBreak ? lineBreak + 1 : m_End;
+      }
+      m_Cursor = chunk.end;
+    }
+
+    uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+    parallelFor(chunkCount, [&](uint32_t i) { parseChunk(chunks[i]); });
+    for (const auto& chunk : chunks) {
+      if (!chunk.error.empty()) {
+        throw std::runtime_error("Failed to parse " + m_Path + ": " + chunk.error);
+      }
+    }
+
+    // Faces may refer to any attribute of the window, so all of them are appended before resolving
+    std::vector<size_t> positionBases(chunkCount);
+    std::vector<size_t> texCoordBases(chunkCount);
+    std::vector<size_t> streamOffsets(chunkCount);
+    size_t streamSize = stream.size();
+    for (uint32_t i = 0; i < chunkCount; i++) {
+      Chunk& chunk = chunks[i];
+      positionBases[i] = m_Positions.size();
+      texCoordBases[i] = m_TexCoords.size();
+      streamOffsets[i] = streamSize;
+      m_Positions.insert(m_Positions.end(), chunk.positions.begin(), chunk.positions.end());
+      m_TexCoords.insert(m_TexCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+      for (auto& shape : chunk.shapes) {
+        shapes.push_back({streamSize + shape.corner, std::move(shape.name)});
+      }
+      streamSize += chunk.corners.size();
+      chunk.positions = {};
+      chunk.texCoords = {};
+    }
+    stream.resize(streamSize);
+
+    std::vector<uint8_t> invalid(chunkCount, 0);
+    parallelFor(chunkCount, [&](uint32_t i) {
+      Vertex* vertex = stream.data() + streamOffsets[i];
+      for (const Corner& corner : chunks[i].corners) {
+        int64_t position = resolve(corner.position, positionBases[i]);
+        if (position < 0 || position >= static_cast<int64_t>(m_Positions.size())) {
+          invalid[i] = 1;
+          return;
+        }
+        vertex->position = m_Positions[position];
+        vertex->color = {1.0f, 1.0f, 1.0f};
+        vertex->texCoord = {0.0f, 0.0f};
+        if (corner.texCoord != kNoTexCoord) {
+          int64_t texCoord = resolve(corner.texCoord, texCoordBases[i]);
+          if (texCoord < 0 || texCoord >= static_cast<int64_t>(m_TexCoords.size())) {
+            invalid[i] = 1;
+            return;
+          }
+          vertex->texCoord = {m_TexCoords[texCoord].x, 1.0f - m_TexCoords[texCoord].y};
+        }
+        vertex++;
+      }
+    });
+    if (std::find(invalid.begin(), invalid.end(), 1) != invalid.end()) {
+      throw std::runtime_error("Failed to parse " + m_Path + ": a face refers to a missing vertex");
+    }
+    return true;
+  }
+
+  size_t getPositionCount() const { return m_Positions.size(); }
+
+ private:
+  std::string m_Path;
+  MappedFile m_File;
+  const char* m_Cursor;
+  const char* m_End;
+  uint32_t m_ThreadCount;
+
+  std::vector<glm::vec3> m_Positions;
+  std::vector<glm::vec2> m_TexCoords;
+};
+
+}  // namespace
+
+std::vector<Vertex> ObjParser::parse(const std::string& path, uint32_t threadCount) {
+  LOGFN;
+  ObjReader reader(path, threadCount);
+  std::vector<Vertex> stream;
+  std::vector<ShapeStart> shapes;
+  while (reader.readWindow(stream, shapes)) {
+    shapes.clear();
+  }
+
+  LOG("Parsed", reader.getPositionCount(), "positions and", stream.size() / 3, "triangles from", path);
+  return stream;
+}
+
+void ObjParser::parseShapes(const std::string& path, const ShapeCallback& onShape, uint32_t threadCount) {
+  LOGFN;
+  ObjReader reader(path, threadCount);
+  uint32_t dedupThreads = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+  // Faces of the shape being built, and of the shapes completed by the last window
+  std::vector<Vertex> stream;
+  std::vector<ShapeStart> shapes;
+  std::string name;
+  uint32_t shapeCount = 0;
+
+  auto emit = [&](size_t begin, size_t end) {
+    if (begin == end) {
+      return true;
+    }
+    std::vector<Vertex> shapeStream(stream.begin() + begin, stream.begin() + end);
+    MeshData shape;
+    VertexDeduplicator::deduplicate(shapeStream, shape.vertices, shape.indices,
+                                    shapeStream.size() >= VertexDeduplicator::kParallelThreshold ? dedupThreads : 1);
+    shapeCount++;
+    return onShape(std::move(shape), name);
+  };
+
+  while (reader.readWindow(stream, shapes)) {
+    size_t shapeBegin = 0;
+    for (auto& start : shapes) {
+      if (!emit(shapeBegin, start.corner)) {
+        return;
+      }
+      shapeBegin = start.corner;
+      name = std::move(start.name);
+    }
+    shapes.clear();
+
+    // Hand out the unfinished shape in parts so a model that is one huge shape does not build up in memory. Parts
+    // are whole triangles, every face is a fan of them.
+    while (stream.size() - shapeBegin >= kMaxShapeCorners) {
+      if (!emit(shapeBegin, shapeBegin + kMaxShapeCorners)) {
+        return;
+      }
+      shapeBegin += kMaxShapeCorners;
+    }
+
+    // Only the rest of the unfinished shape stays
+    stream.erase(stream.begin(), stream.begin() + shapeBegin);
+  }
+
+  if (emit(0, stream.size())) {
+    LOG("Streamed", shapeCount, "shapes from", path);
+  }
+}
+
+}  // namespace glint
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vertex.h"
+
+namespace glint {
+
+struct MeshData;
+
+// OBJ parser for very large models. The file is memory mapped and split at line breaks into chunks that are parsed on
+// all threads at once, a window of one chunk per thread at a time. The positions and texture coordinates of each
+// window are appended to the model's attribute arrays and only the faces of the window are expanded into vertices, so
+// apart from the mapping a streamed parse holds the attributes, one window of faces and at most kMaxShapeCorners face
+// corners of the shape being built.
+// Reads v, vt, f, o and g statements and triangulates polygons as fans, normals, materials and everything else are
+// skipped. Thread safe, no Vulkan calls.
+class ObjParser {
+ public:
+  // Receives every shape with its deduplicated geometry, in file order on the thread calling parseShapes. Returning
+  // false stops the parse.
+  using ShapeCallback = std::function<bool(MeshData&& shape, const std::string& name)>;
+
+  // The whole model as one vertex per face corner, ready for VertexDeduplicator. threadCount 0 uses every hardware
+  // thread. Throws on failure.
+  static std::vector<Vertex> parse(const std::string& path, uint32_t threadCount = 0);
+
+  // Hand out each o / g shape once the window holding its last face is parsed, without keeping the model's faces.
+  // Shapes of more than kMaxShapeCorners face corners are handed out in parts of that size under the shape's name.
+  // Throws on failure.
+  static void parseShapes(const std::string& path, const ShapeCallback& onShape, uint32_t threadCount = 0);
+
+  static constexpr size_t kChunkSize = 8 << 20;
+  // 1M triangles, 96 MB of face corners
+  static constexpr size_t kMaxShapeCorners = 3 << 20;
+};
+
+}  // namespace glint
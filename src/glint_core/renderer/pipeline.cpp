@@ -13,6 +13,45 @@
 
 namespace glint {
 
+namespace {
+
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code) {
+  LOGFN;
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+
+  return shaderModule;
+}
+
+std::vector<char> readFile(const std::string& filename) {
+  LOGFN;
+  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file: " + filename);
+  }
+
+  size_t fileSize = (size_t)file.tellg();
+  std::vector<char> buffer(fileSize);
+
+  LOG("Loading filename:", filename, "fileSize:", fileSize, "bytes");
+
+  file.seekg(0);
+  file.read(buffer.data(), fileSize);
+
+  file.close();
+  return buffer;
+}
+
+}  // namespace
+
 Pipeline::Pipeline(VkContext* context, RenderPass* renderPass, const PipelineConfig* config)
     : m_Context(context), m_RenderPass(renderPass), m_PipelineLayout(VK_NULL_HANDLE), m_Pipeline(VK_NULL_HANDLE) {
   LOGFN;
@@ -37,8 +76,8 @@ void Pipeline::createGraphicsPipeline(const PipelineConfig& config) {
   auto fragShaderCode = readFile(config.fragmentShaderPath);
 
   // shaders
-  VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+  VkShaderModule vertShaderModule = createShaderModule(m_Context->getDevice(), vertShaderCode);
+  VkShaderModule fragShaderModule = createShaderModule(m_Context->getDevice(), fragShaderCode);
 
   VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
   vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -59,11 +98,11 @@ void Pipeline::createGraphicsPipeline(const PipelineConfig& config) {
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-  auto bindingDescription = Vertex::getBindingDescription();
+  auto bindingDescriptions = Vertex::getBindingDescriptions(config.vertexFormat);
   auto attributeDescriptions = Vertex::getAttributeDescriptions(config.vertexFormat);
 
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
   vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -112,7 +151,9 @@ void Pipeline::createGraphicsPipeline(const PipelineConfig& config) {
   // Color Blending
   VkPipelineColorBlendAttachmentState colorBlendAttachment{};
   colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+      config.colorWriteEnable
+          ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+          : 0;
   colorBlendAttachment.blendEnable = VK_FALSE;
 
   VkPipelineColorBlendStateCreateInfo colorBlending{};
@@ -166,39 +207,50 @@ void Pipeline::createGraphicsPipeline(const PipelineConfig& config) {
   LOGCALL(vkDestroyShaderModule(m_Context->getDevice(), vertShaderModule, nullptr));
 }
 
-VkShaderModule Pipeline::createShaderModule(const std::vector<char>& code) {
+///////////////////////////////////////////////////////////////////////////
+// ComputePipeline
+
+ComputePipeline::ComputePipeline(VkContext* context, const ComputePipelineConfig& config) : m_Context(context) {
   LOGFN;
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+  VkDevice device = m_Context->getDevice();
+  VkShaderModule shaderModule = createShaderModule(device, readFile(config.shaderPath));
 
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(m_Context->getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create shader module!");
-  }
+  VkPipelineShaderStageCreateInfo shaderStageInfo{};
+  shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  shaderStageInfo.module = shaderModule;
+  shaderStageInfo.pName = "main";
 
-  return shaderModule;
-}
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  if (config.descriptorSetLayout != VK_NULL_HANDLE) {
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &config.descriptorSetLayout;
+  }
+  pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(config.pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges = config.pushConstantRanges.data();
 
-std::vector<char> Pipeline::readFile(const std::string& filename) {
-  LOGFN;
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
 
-  if (!file.is_open()) {
-    throw std::runtime_error("failed to open file: " + filename);
-  }
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = shaderStageInfo;
+  pipelineInfo.layout = m_PipelineLayout;
 
-  size_t fileSize = (size_t)file.tellg();
-  std::vector<char> buffer(fileSize);
+  VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline));
 
-  LOG("Loading filename:", filename, "fileSize:", fileSize, "bytes");
+  LOGCALL(vkDestroyShaderModule(device, shaderModule, nullptr));
+}
 
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
+ComputePipeline::~ComputePipeline() {
+  LOGFN;
+  VkDevice device = m_Context->getDevice();
+  LOGCALL(vkDestroyPipeline(device, m_Pipeline, nullptr));
+  LOGCALL(vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr));
+}
 
-  file.close();
-  return buffer;
+void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
 }
 
-}  // namespace glint
\ No newline at end of file
+}  // namespace glint
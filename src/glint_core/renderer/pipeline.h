@@ -20,7 +20,8 @@ struct PipelineConfig {
   std::string vertexShaderPath;  // add default shaders
   std::string fragmentShaderPath;
 
-  // Vertex input
+  // Vertex input. With VertexAttributeFlags::SplitStreams the attributes listed here select the bindings the pipeline
+  // reads, VertexAttributeFlags::SPLIT_POSITION only fetches the position stream.
   VertexAttributeFlags vertexFormat = VertexAttributeFlags::POSITION_COLOR_TEXCOORD;
 
   // Descriptors
@@ -41,6 +42,9 @@ struct PipelineConfig {
   // This works with both transformed and untransformed geometry with proper setup
   VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
+  // Depth only passes disable the color writes
+  bool colorWriteEnable = true;
+
   // VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
   // float lineWidth = 1.0f;
 
@@ -57,6 +61,16 @@ struct PipelineConfig {
   // std::vector<VkPushConstantRange> pushConstantRanges;
 };
 
+struct ComputePipelineConfig {
+  std::string shaderPath;
+
+  // Descriptors
+  VkDescriptorSetLayout descriptorSetLayout = {VK_NULL_HANDLE};
+
+  // Push constants
+  std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
 class Pipeline {
  public:
   Pipeline(VkContext* context, RenderPass* renderPass, const PipelineConfig* config);
@@ -75,9 +89,6 @@ class Pipeline {
  private:
   void createGraphicsPipeline(const PipelineConfig& config);
 
-  VkShaderModule createShaderModule(const std::vector<char>& code);
-  std::vector<char> readFile(const std::string& filename);
-
  private:
   VkContext* m_Context;
   RenderPass* m_RenderPass;
@@ -85,4 +96,26 @@ class Pipeline {
   VkPipeline m_Pipeline;
 };
 
+// Single compute shader pipeline, independent of the render pass
+class ComputePipeline {
+ public:
+  ComputePipeline(VkContext* context, const ComputePipelineConfig& config);
+  ~ComputePipeline();
+
+  // Prevent copying
+  ComputePipeline(const ComputePipeline&) = delete;
+  ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+  // Getters
+  VkPipeline getPipeline() const { return m_Pipeline; }
+  VkPipelineLayout getPipelineLayout() const { return m_PipelineLayout; }
+
+  void bind(VkCommandBuffer commandBuffer);
+
+ private:
+  VkContext* m_Context;
+  VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+  VkPipeline m_Pipeline = VK_NULL_HANDLE;
+};
+
 }  // namespace glint
\ No newline at end of file
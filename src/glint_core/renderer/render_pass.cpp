@@ -29,7 +29,8 @@ void RenderPass::createRenderPass() {
   colorAttachment.format = m_SwapChain->getImageFormat();
   colorAttachment.samples = m_Context->getMsaaSamples();
   colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  // Multisampled color is resolved in the subpass and never read back, lets it stay in transient memory
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -45,6 +46,12 @@ void RenderPass::createRenderPass() {
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  // A sampled depth buffer is kept for the compute passes after the render pass, e.g. the depth pyramid
+  bool sampledDepth = m_SwapChain->isDepthSampled();
+  if (sampledDepth) {
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
 
   // Subpasses
   VkAttachmentReference colorAttachmentRef{};
@@ -87,6 +94,22 @@ void RenderPass::createRenderPass() {
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+  // A sampled depth buffer is read by compute after the pass, and last frame's reads finish before it is cleared
+  VkSubpassDependency depthReadDependency{};
+  depthReadDependency.srcSubpass = 0;
+  depthReadDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  depthReadDependency.srcStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  depthReadDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthReadDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  depthReadDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  // The MSAA color also aliases the depth pyramid, written by compute after last frame's pass
+  if (sampledDepth) {
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependency.srcAccessMask |= VK_ACCESS_SHADER_WRITE_BIT;
+  }
+  std::array<VkSubpassDependency, 2> dependencies = {dependency, depthReadDependency};
+
   // Combine attachments
   std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
 
@@ -97,8 +120,8 @@ void RenderPass::createRenderPass() {
   renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = sampledDepth ? 2 : 1;
+  renderPassInfo.pDependencies = dependencies.data();
 
   VK_CHECK_RESULT(vkCreateRenderPass(m_Context->getDevice(), &renderPassInfo, nullptr, &m_RenderPass));
 }
@@ -2,13 +2,22 @@
 
 #include <numeric>
 
+#include "asset_loader.h"
 #include "command_manager.h"
+#include "core/config.h"
 #include "core/logger.h"
 #include "core/window.h"
+#include "defragmenter.h"
+#include "deletion_queue.h"
+#include "depth_pyramid.h"
+#include "descriptor.h"
+#include "geometry_pool.h"
 #include "pipeline.h"
 #include "render_pass.h"
 #include "swapchain.h"
 #include "synchronization_manager.h"
+#include "texture_streamer.h"
+#include "transfer_manager.h"
 #include "vk_context.h"
 #include "vk_utils.h"
 
@@ -19,6 +28,7 @@ Renderer::Renderer(Window* window, uint32_t maxFramesInFlight)
   LOGFN;
 
   m_enableCommandBufferCaching = Config::isOptionSet("enable_command_buffer_caching");
+  m_DepthPyramidEnabled = Config::isOptionSet("depth_pyramid");
 }
 
 Renderer::~Renderer() {
@@ -44,7 +54,8 @@ void Renderer::init() {
   m_CommandManager = std::make_unique<CommandManager>(m_Context.get());
 
   // Create SwapChain
-  m_SwapChain = std::make_unique<SwapChain>(m_Context.get());
+  // The depth pyramid reads the depth buffer after the render pass
+  m_SwapChain = std::make_unique<SwapChain>(m_Context.get(), m_DepthPyramidEnabled);
   uint32_t imageCount = m_SwapChain->getImageCount();
 
   // TODO: Important to map command buffers to swap chain images as we have one command buffer per swap chain image
@@ -62,9 +73,15 @@ void Renderer::init() {
   // Create Framebuffers
   m_SwapChain->createFramebuffers(m_RenderPass->getRenderPass());
 
+  createDepthPyramid();
+
   // Create Synchronization Manager
   m_SyncManager = std::make_unique<SynchronizationManager>(m_Context.get(), m_MaxFramesInFlight, imageCount);
 
+  // Per-frame uniform data, one segment per frame in flight
+  VkDeviceSize uniformRingSize = std::stoul(Config::getCustomeOption("uniform_ring_kb", "256")) * 1024;
+  m_UniformRing = std::make_unique<UniformRingBuffer>(m_Context.get(), uniformRingSize, m_MaxFramesInFlight);
+
   // Initialize images in flight
   // m_ImagesInFlight.resize(m_MaxFramesInFlight, VK_NULL_HANDLE);
   m_ImageIndices.resize(m_MaxFramesInFlight);
@@ -98,8 +115,11 @@ void Renderer::handleResize() {
   }
 
   m_Window->waitIfMinimized();
+  // The pyramid views an image owned by the swap chain
+  m_DepthPyramid.reset();
   m_SwapChain->recreateSwapchain(m_RenderPass->getRenderPass());
   m_Window->resetResizedFlag();
+  createDepthPyramid();
 
   // Reset any frames in flight tracking
   //   m_ImageIndices.resize(m_MaxFramesInFlight);
@@ -109,8 +129,66 @@ void Renderer::handleResize() {
   std::fill(m_CommandBufferRecorded.begin(), m_CommandBufferRecorded.end(), false);
 }
 
+void Renderer::createDepthPyramid() {
+  m_DepthPyramid.reset();
+  if (!m_DepthPyramidEnabled) {
+    return;
+  }
+
+  try {
+    m_DepthPyramid = std::make_unique<DepthPyramid>(m_Context.get(), m_SwapChain->getDepthImage(),
+                                                    m_SwapChain->getDepthFormat(), m_SwapChain->getExtent(),
+                                                    m_Context->getMsaaSamples(), MipReduction::Max,
+                                                    m_SwapChain->getDepthPyramidImage());
+  } catch (const std::exception& e) {
+    LOG("[WARNING] Depth pyramid disabled:", e.what());
+  }
+}
+
+void Renderer::recordCommands(const std::function<void(VkCommandBuffer, uint32_t)>& recordCommandsFunc,
+                              uint32_t imageIndex) {
+  VkCommandBuffer commandBuffer = m_CommandManager->getCommandBuffer(imageIndex);
+  recordCommandsFunc(commandBuffer, imageIndex);
+
+  // The render pass left the depth buffer in shader read layout
+  if (m_DepthPyramid) {
+    m_DepthPyramid->build(commandBuffer);
+  }
+}
+
+void Renderer::beginFrame() {
+  // Wait for the previous use of this frame slot to finish
+  m_SyncManager->waitForFence(m_ImageIndices[m_CurrentFrame]);
+
+  m_UniformRing->beginFrame(m_CurrentFrame);
+
+  // Retire finished uploads, this is where uploaded resources become movable
+  m_Context->getTransferManager()->collect();
+
+  // Geometry freed by meshes is reused once no frame in flight can read it
+  m_Context->getGeometryPool()->update(m_MaxFramesInFlight);
+
+  // Same for image views and resources replaced by the streamer and the defragmenter
+  m_Context->getDeletionQueue()->update(m_MaxFramesInFlight);
+
+  // Streamed mips that landed widen their texture's view
+  if (m_Context->getTextureStreamer()->update()) {
+    markCommandBuffersDirty();
+  }
+
+  // Create resources for assets decoded in the background, cached command buffers do not draw them yet
+  if (m_Context->getAssetLoader()->update()) {
+    markCommandBuffersDirty();
+  }
+
+  // Cached command buffers may bind resources the defragmenter just moved
+  if (m_Context->getDefragmenter()->update()) {
+    markCommandBuffersDirty();
+  }
+}
+
 void Renderer::drawFrame(std::function<void(VkCommandBuffer, uint32_t)> recordCommandsFunc) {
-  // Wait for the previous frame to finish
+  // Wait for the previous frame to finish, a no-op if beginFrame already waited
   // m_SyncManager->waitForFence(m_CurrentFrame);
   m_SyncManager->waitForFence(m_ImageIndices[m_CurrentFrame]);
 
@@ -130,12 +208,18 @@ void Renderer::drawFrame(std::function<void(VkCommandBuffer, uint32_t)> recordCo
   // Save the image index for this frame
   m_ImageIndices[m_CurrentFrame] = imageIndex;
 
+  // Ring offsets are baked into the command buffers as dynamic offsets and point into this frame slot's segment, a
+  // buffer cached per swapchain image would keep reading the segment of another slot
+  if (m_enableCommandBufferCaching && m_UniformRing->getFrameUsage() > 0) {
+    markCommandBuffersDirty();
+  }
+
   if (m_enableCommandBufferCaching) {
     // Check if command buffers need recording
     if (m_CommandBuffersDirty || !m_CommandBufferRecorded[imageIndex]) {
       m_CommandManager->resetCommandBuffer(imageIndex);
       m_CommandManager->beginSingleTimeCommands(imageIndex);
-      recordCommandsFunc(m_CommandManager->getCommandBuffer(imageIndex), imageIndex);
+      recordCommands(recordCommandsFunc, imageIndex);
       m_CommandManager->endSingleTimeCommands(imageIndex);
 
       // m_CommandBufferRecorded[m_CurrentFrame] = true;
@@ -151,7 +235,7 @@ void Renderer::drawFrame(std::function<void(VkCommandBuffer, uint32_t)> recordCo
   } else {
     m_CommandManager->resetCommandBuffer(imageIndex);
     m_CommandManager->beginSingleTimeCommands(imageIndex);
-    recordCommandsFunc(m_CommandManager->getCommandBuffer(imageIndex), imageIndex);
+    recordCommands(recordCommandsFunc, imageIndex);
     m_CommandManager->endSingleTimeCommands(imageIndex);
   }
 
@@ -177,6 +261,12 @@ void Renderer::drawFrame(std::function<void(VkCommandBuffer, uint32_t)> recordCo
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
+  // Make uniform data written this frame visible to the device
+  m_UniformRing->flush();
+
+  // Uploads recorded so far are acquired on the graphics queue ahead of this frame
+  m_Context->getTransferManager()->submitPending();
+
   // Submit to queue
   m_SyncManager->resetFence(m_ImageIndices[m_CurrentFrame]);
   VK_CHECK_RESULT(vkQueueSubmit(m_Context->getGraphicsQueue(), 1, &submitInfo,
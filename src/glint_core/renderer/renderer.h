@@ -17,6 +17,8 @@ struct PipelineConfig;
 class CommandManager;
 class SynchronizationManager;
 class DescriptorSetLayout;
+class UniformRingBuffer;
+class DepthPyramid;
 
 class Renderer {
  public:
@@ -28,6 +30,10 @@ class Renderer {
   Renderer& operator=(const Renderer&) = delete;
 
   void init();
+
+  // Wait until the GPU is done with the current frame slot, so its per-frame resources can be rewritten.
+  // Call before updating anything that is consumed by the next drawFrame.
+  void beginFrame();
   void drawFrame(std::function<void(VkCommandBuffer, uint32_t)> recordCommandsFunc);
   void waitIdle();
 
@@ -39,6 +45,10 @@ class Renderer {
   RenderPass* getRenderPass() const { return m_RenderPass.get(); }
   Pipeline* getPipeline() const { return m_Pipeline.get(); }
   SwapChain* getSwapChain() const { return m_SwapChain.get(); }
+  UniformRingBuffer* getUniformRing() const { return m_UniformRing.get(); }
+  // Hierarchical depth of the last frame, rebuilt after the render pass when depth_pyramid is set, otherwise null.
+  // Its levels share memory with the MSAA color, so they are only readable until the next render pass begins.
+  DepthPyramid* getDepthPyramid() const { return m_DepthPyramid.get(); }
 
   uint32_t getFramesInFlight() const { return m_MaxFramesInFlight; }
   uint32_t getCurrentFrame() const { return m_CurrentFrame; }
@@ -50,6 +60,11 @@ class Renderer {
     std::fill(m_CommandBufferRecorded.begin(), m_CommandBufferRecorded.end(), false);
   }
 
+ private:
+  void createDepthPyramid();
+  // The sample's commands followed by the passes the renderer appends after its render pass
+  void recordCommands(const std::function<void(VkCommandBuffer, uint32_t)>& recordCommandsFunc, uint32_t imageIndex);
+
  private:
   Window* m_Window;
   std::unique_ptr<VkContext> m_Context;
@@ -58,6 +73,8 @@ class Renderer {
   std::unique_ptr<Pipeline> m_Pipeline;
   std::unique_ptr<CommandManager> m_CommandManager;
   std::unique_ptr<SynchronizationManager> m_SyncManager;
+  std::unique_ptr<UniformRingBuffer> m_UniformRing;
+  std::unique_ptr<DepthPyramid> m_DepthPyramid;
 
   DescriptorSetLayout* m_DescriptorSetLayout = nullptr;
 
@@ -69,6 +86,7 @@ class Renderer {
   std::vector<uint32_t> m_ImageIndices;
 
   bool m_enableCommandBufferCaching = false;
+  bool m_DepthPyramidEnabled = false;
 
   // maybe move this in Cmmand manager ?
   bool m_CommandBuffersDirty = true;
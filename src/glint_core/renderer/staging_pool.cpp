@@ -0,0 +1,192 @@
+#include "staging_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "core/logger.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+namespace {
+
+// Smallest size class, small uploads share buffers of this size
+constexpr VkDeviceSize kMinClassSize = 64ull * 1024;
+
+}  // namespace
+
+StagingPool::StagingPool(VkContext* context, VkDeviceSize budget) : m_Context(context), m_Budget(budget) {
+  LOGFN;
+  LOG("Staging budget:", m_Budget, "bytes");
+}
+
+StagingPool::~StagingPool() {
+  LOGFN;
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  // Transfers may still be reading from the buffers
+  for (auto& entry : m_Entries) {
+    if (entry->state == State::InFlight) {
+      vkWaitForFences(m_Context->getDevice(), 1, &entry->fence, VK_TRUE, UINT64_MAX);
+    }
+  }
+
+  while (!m_Entries.empty()) {
+    destroyEntry(m_Entries.back().get());
+  }
+}
+
+Buffer* StagingPool::acquire(VkDeviceSize size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  collectLocked();
+
+  VkDeviceSize classSize = getClassSize(size);
+  if (Entry* entry = findFree(classSize)) {
+    entry->state = State::InUse;
+    return &entry->staging;
+  }
+
+  // Waiting on transfers while making room can free a buffer of the right class
+  if (!makeRoom(classSize)) {
+    if (Entry* entry = findFree(classSize)) {
+      entry->state = State::InUse;
+      return &entry->staging;
+    }
+  }
+
+  if (m_TotalBytes + classSize > m_Budget) {
+    LOG("[WARNING] Staging budget exceeded, allocating", classSize, "bytes with", m_TotalBytes, "in use");
+  }
+
+  Entry* entry = createEntry(classSize);
+  entry->state = State::InUse;
+  return &entry->staging;
+}
+
+void StagingPool::release(Buffer* buffer, VkFence fence) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Entry* entry = findEntry(buffer);
+  if (!entry || entry->state != State::InUse) {
+    throw std::runtime_error("Releasing a staging buffer that was not acquired from this pool!");
+  }
+
+  if (fence != VK_NULL_HANDLE) {
+    entry->state = State::InFlight;
+    entry->fence = fence;
+    entry->releaseIndex = ++m_ReleaseCounter;
+  } else {
+    entry->state = State::Free;
+  }
+}
+
+void StagingPool::collect() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  collectLocked();
+}
+
+StagingPool::Stats StagingPool::getStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Stats stats;
+  stats.bufferCount = static_cast<uint32_t>(m_Entries.size());
+  stats.totalBytes = m_TotalBytes;
+  stats.budgetBytes = m_Budget;
+  for (const auto& entry : m_Entries) {
+    if (entry->state == State::InUse) stats.inUseCount++;
+    if (entry->state == State::InFlight) stats.inFlightCount++;
+  }
+  return stats;
+}
+
+VkDeviceSize StagingPool::getClassSize(VkDeviceSize size) const {
+  VkDeviceSize classSize = kMinClassSize;
+  while (classSize < size) {
+    classSize <<= 1;
+  }
+
+  // Don't round huge uploads past the budget, give them a buffer of (nearly) their own size
+  if (classSize > m_Budget) {
+    classSize = std::max(kMinClassSize, (size + kMinClassSize - 1) / kMinClassSize * kMinClassSize);
+  }
+  return classSize;
+}
+
+StagingPool::Entry* StagingPool::findEntry(const Buffer* buffer) {
+  for (auto& entry : m_Entries) {
+    if (&entry->staging == buffer) {
+      return entry.get();
+    }
+  }
+  return nullptr;
+}
+
+StagingPool::Entry* StagingPool::findFree(VkDeviceSize classSize) {
+  for (auto& entry : m_Entries) {
+    if (entry->state == State::Free && entry->staging.getSize() == classSize) {
+      return entry.get();
+    }
+  }
+  return nullptr;
+}
+
+StagingPool::Entry* StagingPool::createEntry(VkDeviceSize size) {
+  auto entry = std::make_unique<Entry>();
+  entry->staging = Buffer(m_Context, BufferUsage::Staging, size, MemoryTag::Staging);
+  VkUtils::setObjectName(entry->staging.getBuffer(), VK_OBJECT_TYPE_BUFFER, "Staging Buffer");
+
+  m_TotalBytes += size;
+  m_Entries.push_back(std::move(entry));
+  return m_Entries.back().get();
+}
+
+void StagingPool::destroyEntry(Entry* entry) {
+  m_TotalBytes -= entry->staging.getSize();
+
+  auto it = std::find_if(m_Entries.begin(), m_Entries.end(), [entry](const auto& e) { return e.get() == entry; });
+  m_Entries.erase(it);
+}
+
+void StagingPool::collectLocked() {
+  for (auto& entry : m_Entries) {
+    if (entry->state == State::InFlight && vkGetFenceStatus(m_Context->getDevice(), entry->fence) == VK_SUCCESS) {
+      entry->fence = VK_NULL_HANDLE;
+      entry->state = State::Free;
+    }
+  }
+}
+
+bool StagingPool::makeRoom(VkDeviceSize size) {
+  while (m_TotalBytes + size > m_Budget) {
+    // Evict idle buffers first
+    auto idle = std::find_if(m_Entries.begin(), m_Entries.end(),
+                             [](const auto& entry) { return entry->state == State::Free; });
+    if (idle != m_Entries.end()) {
+      destroyEntry(idle->get());
+      continue;
+    }
+
+    // Then wait for the oldest transfer to complete
+    Entry* oldest = nullptr;
+    for (auto& entry : m_Entries) {
+      if (entry->state == State::InFlight && (!oldest || entry->releaseIndex < oldest->releaseIndex)) {
+        oldest = entry.get();
+      }
+    }
+    if (!oldest) {
+      // Everything is held by callers
+      return false;
+    }
+
+    vkWaitForFences(m_Context->getDevice(), 1, &oldest->fence, VK_TRUE, UINT64_MAX);
+    collectLocked();
+
+    if (findFree(size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace glint
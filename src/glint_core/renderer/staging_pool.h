@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.h"
+
+namespace glint {
+
+class VkContext;
+
+// Pool of staging buffers shared by all upload paths. Buffers are bucketed in power of two size classes and
+// recycled once the transfer that read them has completed, so uploads don't allocate and free memory each time.
+// Total staging memory is capped by a budget, when it is reached the pool evicts idle buffers and waits for the oldest
+// submitted transfer before allocating new ones. Buffers still held by callers can't be waited on, the budget is only
+// exceeded, with a warning, when they alone fill it.
+class StagingPool {
+ public:
+  struct Stats {
+    uint32_t bufferCount = 0;
+    uint32_t inUseCount = 0;
+    uint32_t inFlightCount = 0;
+    VkDeviceSize totalBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+  };
+
+  StagingPool(VkContext* context, VkDeviceSize budget);
+  ~StagingPool();
+
+  // Prevent copying
+  StagingPool(const StagingPool&) = delete;
+  StagingPool& operator=(const StagingPool&) = delete;
+
+  // Get a host visible, persistently mapped buffer of at least size bytes. The buffer stays reserved until released.
+  Buffer* acquire(VkDeviceSize size);
+
+  // Return a buffer to the pool. If fence is set the buffer is only reused after it signals, pass VK_NULL_HANDLE if
+  // the transfer has already completed. The fence stays owned by the caller, who must keep it alive until it has
+  // signalled and collect() has run, several buffers may share it.
+  void release(Buffer* buffer, VkFence fence = VK_NULL_HANDLE);
+
+  // Recycle buffers whose transfers have completed
+  void collect();
+
+  Stats getStats() const;
+
+ private:
+  enum class State { Free, InUse, InFlight };
+
+  struct Entry {
+    Buffer staging;
+    State state = State::Free;
+    VkFence fence = VK_NULL_HANDLE;
+    uint64_t releaseIndex = 0;
+  };
+
+  VkDeviceSize getClassSize(VkDeviceSize size) const;
+  Entry* findEntry(const Buffer* buffer);
+  Entry* findFree(VkDeviceSize classSize);
+  Entry* createEntry(VkDeviceSize size);
+  void destroyEntry(Entry* entry);
+  void collectLocked();
+
+  // Evict idle buffers and wait on transfers until size fits in the budget. Returns true if it fits, false if
+  // everything is held by callers or a free buffer of this size turned up while waiting.
+  bool makeRoom(VkDeviceSize size);
+
+ private:
+  VkContext* m_Context;
+  VkDeviceSize m_Budget;
+  VkDeviceSize m_TotalBytes = 0;
+  uint64_t m_ReleaseCounter = 0;
+
+  std::vector<std::unique_ptr<Entry>> m_Entries;
+  mutable std::mutex m_Mutex;
+};
+
+}  // namespace glint
@@ -6,12 +6,22 @@
 
 #include "core/logger.h"
 #include "core/window.h"
+#include "depth_pyramid.h"
 #include "vk_context.h"
 #include "vk_utils.h"
 
 namespace glint {
 
-SwapChain::SwapChain(VkContext* context) : m_Context(context), m_SwapChain(VK_NULL_HANDLE) {
+namespace {
+
+// The allocator falls back to plain device local memory where lazily allocated memory isn't available
+constexpr VkMemoryPropertyFlags kTransientMemoryProperties =
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+}  // namespace
+
+SwapChain::SwapChain(VkContext* context, bool sampledDepth)
+    : m_Context(context), m_SwapChain(VK_NULL_HANDLE), m_SampledDepth(sampledDepth) {
   LOGFN;
   createSwapChain();
   createImageViews();
@@ -32,8 +42,10 @@ void SwapChain::cleanup() {
   if (m_Msaa.image != VK_NULL_HANDLE) {
     LOG("Destroying MSAA resources");
     vkDestroyImageView(device, m_Msaa.view, nullptr);
-    vkDestroyImage(device, m_Msaa.image, nullptr);
-    vkFreeMemory(device, m_Msaa.memory, nullptr);
+    if (m_Msaa.depthPyramid != VK_NULL_HANDLE) {
+      vkDestroyImage(device, m_Msaa.depthPyramid, nullptr);
+    }
+    VkUtils::destroyImage(m_Msaa.image, m_Msaa.allocation);
     m_Msaa = {};
   }
 
@@ -61,15 +73,7 @@ void SwapChain::cleanupDepthResources() {
     m_DepthImageView = VK_NULL_HANDLE;
   }
 
-  if (m_DepthImage != VK_NULL_HANDLE) {
-    vkDestroyImage(m_Context->getDevice(), m_DepthImage, nullptr);
-    m_DepthImage = VK_NULL_HANDLE;
-  }
-
-  if (m_DepthImageMemory != VK_NULL_HANDLE) {
-    vkFreeMemory(m_Context->getDevice(), m_DepthImageMemory, nullptr);
-    m_DepthImageMemory = VK_NULL_HANDLE;
-  }
+  VkUtils::destroyImage(m_DepthImage, m_DepthImageAllocation);
 }
 
 void SwapChain::recreateSwapchain(VkRenderPass renderPass) {
@@ -277,14 +281,49 @@ void SwapChain::createColorResources() {
   extent.width = std::max<uint32_t>(1u, extent.width);
   extent.height = std::max<uint32_t>(1u, extent.height);
 
-  VkUtils::createImage(extent.width, extent.height, 1, m_Context->getMsaaSamples(), m_ImageFormat,
-                       VK_IMAGE_TILING_OPTIMAL,
-                       VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Msaa.image, m_Msaa.memory);
+  if (m_SampledDepth) {
+    createAliasedDepthPyramid(extent);
+  }
+  // Only the resolved image is stored, so the MSAA target can live in lazily allocated (tile) memory
+  if (m_Msaa.image == VK_NULL_HANDLE) {
+    VkUtils::createImage(extent.width, extent.height, 1, m_Context->getMsaaSamples(), m_ImageFormat,
+                         VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                         kTransientMemoryProperties, m_Msaa.image, m_Msaa.allocation, MemoryTag::SwapChain);
+  }
   m_Msaa.view = VkUtils::createImageView(m_Msaa.image, m_ImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
   VkUtils::setObjectName(m_Msaa.image, VK_OBJECT_TYPE_IMAGE, "MSAA Image");
-  VkUtils::setObjectName(m_Msaa.memory, VK_OBJECT_TYPE_DEVICE_MEMORY, "MSAA Memory");
+}
+
+void SwapChain::createAliasedDepthPyramid(VkExtent2D extent) {
+  // The depth pyramid is built after the render pass and read before the next one begins, while the MSAA color is
+  // only live inside the pass. A storage image can't live in lazily allocated memory, so both get device local memory.
+  VkImageCreateInfo colorInfo{};
+  colorInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  colorInfo.imageType = VK_IMAGE_TYPE_2D;
+  colorInfo.format = m_ImageFormat;
+  colorInfo.extent = {extent.width, extent.height, 1};
+  colorInfo.mipLevels = 1;
+  colorInfo.arrayLayers = 1;
+  colorInfo.samples = m_Context->getMsaaSamples();
+  colorInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  colorInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  colorInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  colorInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  std::vector<VkImage> images;
+  try {
+    VkUtils::createAliasedImages({colorInfo, DepthPyramid::getImageInfo(extent)},
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images, m_Msaa.allocation,
+                                 MemoryTag::SwapChain);
+  } catch (const std::exception& e) {
+    LOG("[WARNING] Depth pyramid not aliased with the MSAA color:", e.what());
+    return;
+  }
+  m_Msaa.image = images[0];
+  m_Msaa.depthPyramid = images[1];
+  VkUtils::setObjectName(m_Msaa.depthPyramid, VK_OBJECT_TYPE_IMAGE, "Depth Pyramid");
 }
 
 VkFormat SwapChain::findSupportedFormats(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
@@ -305,8 +344,12 @@ VkFormat SwapChain::findSupportedFormats(const std::vector<VkFormat>& candidates
 }
 
 VkFormat SwapChain::findDepthFormat() {
+  VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (m_SampledDepth) {
+    features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  }
   return findSupportedFormats({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-                              VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+                              VK_IMAGE_TILING_OPTIMAL, features);
 }
 
 bool SwapChain::hasStencilComponent(VkFormat format) {
@@ -316,19 +359,26 @@ bool SwapChain::hasStencilComponent(VkFormat format) {
 void SwapChain::createDepthResources() {
   LOGFN;
   m_DepthFormat = findDepthFormat();
+  // Depth is cleared on load and never stored, same as the MSAA target, unless shaders read it after the pass
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (m_SampledDepth) {
+    usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  } else {
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    properties = kTransientMemoryProperties;
+  }
   VkUtils::createImage(m_Extent.width, m_Extent.height, 1, m_Context->getMsaaSamples(), m_DepthFormat,
-                       VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_DepthImage, m_DepthImageMemory);
+                       VK_IMAGE_TILING_OPTIMAL, usage, properties, m_DepthImage, m_DepthImageAllocation,
+                       MemoryTag::SwapChain);
   // Set debug names
   // TODO: Create macro.
   VkUtils::setObjectName(m_DepthImage, VK_OBJECT_TYPE_IMAGE, "Depth Image");
-  VkUtils::setObjectName(m_DepthImageMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "Depth Image Memory");
 
   m_DepthImageView = VkUtils::createImageView(m_DepthImage, m_DepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
   VkUtils::setObjectName(m_DepthImageView, VK_OBJECT_TYPE_IMAGE_VIEW, "Depth Image View");
 
-  VkUtils::transitionImageLayout(m_DepthImage, m_DepthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+  // No layout transition needed, the render pass takes the depth attachment from UNDEFINED every frame
 }
 
 }  // namespace glint
\ No newline at end of file
@@ -4,13 +4,17 @@
 
 #include <vector>
 
+#include "memory_allocator.h"
+
 namespace glint {
 
 class VkContext;
 
 class SwapChain {
  public:
-  SwapChain(VkContext* context);
+  // sampledDepth keeps the depth buffer after the render pass for shaders to read, and creates the image of its
+  // DepthPyramid aliased with the MSAA color attachment, which is only live inside the render pass
+  SwapChain(VkContext* context, bool sampledDepth = false);
   ~SwapChain();
 
   // Prevent copying
@@ -30,7 +34,12 @@ class SwapChain {
   void cleanup();
   void recreateSwapchain(VkRenderPass renderPass);
 
+  VkImage getDepthImage() const { return m_DepthImage; }
   VkFormat getDepthFormat() const { return m_DepthFormat; }
+  bool isDepthSampled() const { return m_SampledDepth; }
+  // Levels of the DepthPyramid, sharing memory with the MSAA color attachment. Null without sampledDepth or when the
+  // two images can't share memory.
+  VkImage getDepthPyramidImage() const { return m_Msaa.depthPyramid; }
 
  private:
   struct SwapChainSupportDetails {
@@ -54,6 +63,7 @@ class SwapChain {
 
   // msaa color resources
   void createColorResources();
+  void createAliasedDepthPyramid(VkExtent2D extent);
 
   VkFormat findSupportedFormats(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
                                 VkFormatFeatureFlags features);
@@ -71,16 +81,19 @@ class SwapChain {
 
   // Depth resources
   VkImage m_DepthImage = VK_NULL_HANDLE;
-  VkDeviceMemory m_DepthImageMemory = VK_NULL_HANDLE;
+  Allocation m_DepthImageAllocation;
   VkImageView m_DepthImageView = VK_NULL_HANDLE;
   VkFormat m_DepthFormat = VK_FORMAT_UNDEFINED;
+  bool m_SampledDepth = false;
 
   // msaa
   // TODO: Make configurable
   struct {
     VkImage image = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    Allocation allocation;
     VkImageView view = VK_NULL_HANDLE;
+    // Aliased in allocation
+    VkImage depthPyramid = VK_NULL_HANDLE;
   } m_Msaa;
 };
 
@@ -3,23 +3,118 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-// #include "buffer.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "buffer.h"
 #include "command_manager.h"
 #include "core/logger.h"
+#include "defragmenter.h"
+#include "deletion_queue.h"
+#include "gpu_timer.h"
+#include "ktx2.h"
+#include "mip_generator.h"
+#include "staging_pool.h"
+#include "texture_streamer.h"
+#include "transfer_manager.h"
 #include "vk_context.h"
 #include "vk_utils.h"
 
 namespace glint {
 
-Texture::Texture(VkContext* context, const std::string& filepath) : m_Context(context) {
+namespace {
+
+// Mips up to this size are uploaded with a streamed texture, larger ones follow one at a time
+constexpr uint32_t kResidentTailSize = 128;
+
+constexpr VkImageUsageFlags kTextureUsage =
+    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+// Write a source mip into the staging buffer at offset, returns the region copying it into mipLevel of the image
+VkBufferImageCopy stageMip(const ImageData& image, uint32_t sourceLevel, Buffer* staging, VkDeviceSize offset,
+                           uint32_t mipLevel) {
+  staging->write(image.getMipPixels(sourceLevel), image.getMipSize(sourceLevel), offset);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = offset;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = mipLevel;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {image.getMipWidth(sourceLevel), image.getMipHeight(sourceLevel), 1};
+  return region;
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageData
+
+void ImageData::generateMips(MipFilter filter, uint32_t threadCount) {
+  MipGenerator::generate(*this, filter, threadCount);
+}
+
+uint32_t ImageData::getBlockBytes(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+      return 8;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Texture
+
+Texture::Texture(VkContext* context, const std::string& filepath) : Texture(context, loadImage(filepath)) {}
+
+Texture::Texture(VkContext* context, const ImageData& image) : m_Context(context) {
   LOGFN;
-  createTextureImage(filepath);
+  createTextureImage(image);
+  createTextureImageView();
+  createTextureSampler();
+}
+
+Texture::Texture(VkContext* context, std::shared_ptr<const ImageData> image) : m_Context(context) {
+  LOGFN;
+  if (image->hasMips()) {
+    m_StreamSource = std::move(image);
+    createStreamedImage();
+  } else {
+    // Nothing to stream without CPU mips
+    createTextureImage(*image);
+  }
   createTextureImageView();
   createTextureSampler();
 }
 
 Texture::~Texture() {
   LOGFN;
+  m_Context->getTextureStreamer()->remove(this);
+
+  // The image must not be destroyed while the upload is writing it
+  m_Context->getTransferManager()->wait(m_UploadId);
+  m_Context->getDefragmenter()->unregister(m_DefragId);
+  onMipmapsGenerated();
+
   VkDevice device = m_Context->getDevice();
 
   if (m_Sampler != VK_NULL_HANDLE) {
@@ -32,25 +127,20 @@ Texture::~Texture() {
     m_ImageView = VK_NULL_HANDLE;
   }
 
-  if (m_Image != VK_NULL_HANDLE) {
-    vkDestroyImage(device, m_Image, nullptr);
-    m_Image = VK_NULL_HANDLE;
-  }
-
-  if (m_ImageMemory != VK_NULL_HANDLE) {
-    vkFreeMemory(device, m_ImageMemory, nullptr);
-    m_ImageMemory = VK_NULL_HANDLE;
-  }
+  VkUtils::destroyImage(m_Image, m_ImageAllocation);
 }
 
-void Texture::createTextureImage(const std::string& filepath) {
+ImageData Texture::loadImage(const std::string& filepath) {
   LOGFN;
   LOG("Loading texture from", filepath);
 
+  if (std::filesystem::path(filepath).extension() == ".ktx2") {
+    return Ktx2::load(filepath);
+  }
+
   // Load image with STB
   int texWidth, texHeight, texChannels;
   stbi_uc* pixels = stbi_load(filepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;  // 4 bytes per RGBA pixel
 
   if (!pixels) {
     LOG("[ERROR] Failed to load texture image from", filepath);
@@ -58,50 +148,278 @@ void Texture::createTextureImage(const std::string& filepath) {
   }
 
   LOG("Texture loaded:", texWidth, "x", texHeight, "pixels,", texChannels, "channels");
-  m_Width = texWidth;
-  m_Height = texHeight;
-
-  m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max<int>(texWidth, texHeight)))) + 1;
-
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  VkUtils::createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                        stagingBufferMemory);
-  VkUtils::setObjectName((uint64_t)stagingBuffer, VK_OBJECT_TYPE_BUFFER, "Texture Staging Buffer");
-  VkUtils::setObjectName((uint64_t)stagingBufferMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "Texture Staging Buffer Memory");
-
-  // Copy data to staging buffer
-  void* data;
-  vkMapMemory(m_Context->getDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
-  vkUnmapMemory(m_Context->getDevice(), stagingBufferMemory);
-
-  // Free the pixel data
-  stbi_image_free(pixels);
-
-  VkUtils::createImage(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), m_mipLevels,
-                       VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                       VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Image, m_ImageMemory);
+
+  ImageData image;
+  image.width = static_cast<uint32_t>(texWidth);
+  image.height = static_cast<uint32_t>(texHeight);
+  image.pixels = {pixels, stbi_image_free};
+  return image;
+}
+
+void Texture::checkFormatSupport(const ImageData& image) const {
+  // Sampled with linear filtering, see createTextureSampler
+  if (!m_Context->isFormatSupported(image.format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+    throw std::runtime_error("Texture format " + std::to_string(image.format) + " is not supported by the device");
+  }
+}
+
+void Texture::createTextureImage(const ImageData& image) {
+  LOGFN;
+  checkFormatSupport(image);
+  m_Width = image.width;
+  m_Height = image.height;
+  m_Format = image.format;
+  m_ImageFormat = m_Format;
+  m_Usage = kTextureUsage;
+
+  // Compressed images can't be blitted, they only have the mips they were stored with
+  bool gpuMips = !image.hasMips() && !image.isCompressed();
+  if (gpuMips) {
+    m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(m_Width, m_Height)))) + 1;
+  } else {
+    m_mipLevels = image.getMipLevels();
+  }
+
+  // Mips built by compute are written through storage views, sRGB can't be one so the image is UNORM viewed as sRGB
+  bool computeMips = gpuMips && canComputeMips();
+  if (computeMips) {
+    m_Usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    if (m_Format == VK_FORMAT_R8G8B8A8_SRGB) {
+      m_ImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+      m_ImageFlags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+    }
+  }
+
+  VkUtils::createImage(m_Width, m_Height, m_mipLevels, VK_SAMPLE_COUNT_1_BIT, m_ImageFormat,
+                       VK_IMAGE_TILING_OPTIMAL, m_Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Image,
+                       m_ImageAllocation, MemoryTag::Texture, m_ImageFlags);
   VkUtils::setObjectName((uint64_t)m_Image, VK_OBJECT_TYPE_IMAGE, "Texture Buffer");
-  VkUtils::setObjectName((uint64_t)m_ImageMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "Texture Buffer Memory");
 
-  // Transition image layout and copy data
-  VkUtils::transitionImageLayout(m_Image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
-  VkUtils::copyBufferToImage(stagingBuffer, m_Image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+  if (!gpuMips) {
+    uploadMips(image);
+    return;
+  }
+
+  if (!computeMips && !canBlitMips()) {
+    LOG("[WARNING] Format", m_Format, "can't be blitted with linear filtering, generating mips on the CPU");
+    ImageData mipped;
+    mipped.width = image.width;
+    mipped.height = image.height;
+    mipped.format = image.format;
+    mipped.pixels = {static_cast<uint8_t*>(std::malloc(image.getSize())), std::free};
+    std::memcpy(mipped.pixels.get(), image.pixels.get(), image.getSize());
+    mipped.generateMips();
+    uploadMips(mipped);
+    return;
+  }
+
+  auto stagingPool = m_Context->getStagingPool();
+  auto transferManager = m_Context->getTransferManager();
+
+  // Copy data to the persistently mapped staging buffer
+  VkDeviceSize imageSize = image.getSize();
+  Buffer* staging = stagingPool->acquire(imageSize);
+  staging->write(image.pixels.get(), imageSize);
+
+  if (computeMips) {
+    MipDownsampleConfig config;
+    config.source = m_Image;
+    config.sourceFormat = m_Format;
+    config.sourceExtent = {m_Width, m_Height};
+    config.destination = m_Image;
+    config.destinationFormat = m_Format;
+    config.destinationExtent = {std::max(1u, m_Width / 2), std::max(1u, m_Height / 2)};
+    config.baseLevel = 1;
+    config.levelCount = m_mipLevels - 1;
+    m_MipTarget = m_Context->getMipDownsampler()->acquireTarget(config);
+  }
+  m_MipTimerRange = m_Context->getMipDownsampler()->acquireTimerRange();
+
+  // Copy on the transfer queue, mips are generated on the graphics queue once ownership has been transferred
+  m_UploadId = transferManager->uploadImage(
+      staging, m_Image, m_Width, m_Height, m_mipLevels,
+      [this](VkCommandBuffer commandBuffer) { generateMipmaps(commandBuffer); },
+      [this]() {
+        onMipmapsGenerated();
+        registerDefragmentation();
+      });
+}
+
+void Texture::uploadMips(const ImageData& image) {
+  // The whole CPU mip chain in one staging buffer, nothing left to do on the graphics queue
+  VkDeviceSize stagingSize = 0;
+  for (uint32_t level = 0; level < m_mipLevels; level++) {
+    stagingSize += image.getMipSize(level);
+  }
+  Buffer* staging = m_Context->getStagingPool()->acquire(stagingSize);
+
+  std::vector<VkBufferImageCopy> regions;
+  VkDeviceSize offset = 0;
+  for (uint32_t level = 0; level < m_mipLevels; level++) {
+    regions.push_back(stageMip(image, level, staging, offset, level));
+    offset += image.getMipSize(level);
+  }
+
+  m_UploadId = m_Context->getTransferManager()->uploadImage(staging, m_Image, regions, 0, m_mipLevels, nullptr,
+                                                            [this]() { registerDefragmentation(); });
+}
+
+void Texture::createStreamedImage() {
+  LOGFN;
+  const ImageData& image = *m_StreamSource;
+  checkFormatSupport(image);
+  m_Format = image.format;
+  m_ImageFormat = m_Format;
+  m_Usage = kTextureUsage;
+
+  m_SourceFirstMip = chooseFirstSourceMip(image);
+  m_Width = image.getMipWidth(m_SourceFirstMip);
+  m_Height = image.getMipHeight(m_SourceFirstMip);
+  m_mipLevels = image.getMipLevels() - m_SourceFirstMip;
+
+  // The whole chain is allocated up front, only the small tail is uploaded now
+  m_ResidentMip = 0;
+  while (m_ResidentMip + 1 < m_mipLevels &&
+         std::max(image.getMipWidth(m_ResidentMip + m_SourceFirstMip),
+                  image.getMipHeight(m_ResidentMip + m_SourceFirstMip)) > kResidentTailSize) {
+    m_ResidentMip++;
+  }
+  m_LandedMip = m_ResidentMip;
+
+  VkUtils::createImage(m_Width, m_Height, m_mipLevels, VK_SAMPLE_COUNT_1_BIT, m_Format, VK_IMAGE_TILING_OPTIMAL,
+                       m_Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Image, m_ImageAllocation,
+                       MemoryTag::Texture);
+  VkUtils::setObjectName((uint64_t)m_Image, VK_OBJECT_TYPE_IMAGE, "Streamed Texture");
+
+  VkDeviceSize stagingSize = 0;
+  for (uint32_t level = m_ResidentMip; level < m_mipLevels; level++) {
+    stagingSize += image.getMipSize(level + m_SourceFirstMip);
+  }
+  Buffer* staging = m_Context->getStagingPool()->acquire(stagingSize);
+
+  std::vector<VkBufferImageCopy> regions;
+  VkDeviceSize offset = 0;
+  for (uint32_t level = m_ResidentMip; level < m_mipLevels; level++) {
+    regions.push_back(stageMip(image, level + m_SourceFirstMip, staging, offset, level));
+    offset += image.getMipSize(level + m_SourceFirstMip);
+  }
+
+  LOG("Streaming", m_Width, "x", m_Height, "texture,", m_mipLevels - m_ResidentMip, "of", m_mipLevels,
+      "mips resident");
+
+  if (isFullyResident()) {
+    m_StreamSource.reset();
+    m_UploadId = m_Context->getTransferManager()->uploadImage(staging, m_Image, regions, 0, m_mipLevels, nullptr,
+                                                              [this]() { registerDefragmentation(); });
+    return;
+  }
+
+  m_UploadId = m_Context->getTransferManager()->uploadImage(staging, m_Image, regions, m_ResidentMip,
+                                                            m_mipLevels - m_ResidentMip);
+  m_Context->getTextureStreamer()->add(this);
+}
+
+uint32_t Texture::chooseFirstSourceMip(const ImageData& image) const {
+  uint32_t maxSize = m_Context->getTextureStreamer()->getMaxTextureSize();
+  VkDeviceSize headroom = m_Context->getAllocator()->getHeadroom();
+
+  uint32_t firstMip = 0;
+  for (; firstMip + 1 < image.getMipLevels(); firstMip++) {
+    VkDeviceSize chainSize = 0;
+    for (uint32_t level = firstMip; level < image.getMipLevels(); level++) {
+      chainSize += image.getMipSize(level);
+    }
+
+    bool tooLarge = maxSize != 0 && std::max(image.getMipWidth(firstMip), image.getMipHeight(firstMip)) > maxSize;
+    if (!tooLarge && chainSize <= headroom) {
+      break;
+    }
+  }
+
+  if (firstMip > 0) {
+    LOG("[WARNING] Dropping", firstMip, "top mips of a", image.width, "x", image.height, "texture");
+  }
+  return firstMip;
+}
+
+bool Texture::canStreamNextMip() const {
+  // One mip in flight at a time, each upload depends on the previous one being committed
+  return m_StreamSource && m_ResidentMip > 0 && !hasLandedMip() &&
+         m_Context->getTransferManager()->isComplete(m_UploadId);
+}
+
+VkDeviceSize Texture::getNextMipSize() const {
+  return m_StreamSource->getMipSize(m_ResidentMip - 1 + m_SourceFirstMip);
+}
+
+void Texture::streamNextMip() {
+  uint32_t level = m_ResidentMip - 1;
+  uint32_t sourceLevel = level + m_SourceFirstMip;
+
+  Buffer* staging = m_Context->getStagingPool()->acquire(m_StreamSource->getMipSize(sourceLevel));
+  VkBufferImageCopy region = stageMip(*m_StreamSource, sourceLevel, staging, 0, level);
+
+  // The view must not include the mip until it has landed, the streamer commits it at a frame boundary
+  m_UploadId = m_Context->getTransferManager()->uploadImage(staging, m_Image, {region}, level, 1, nullptr,
+                                                            [this, level]() { m_LandedMip = level; });
+}
+
+void Texture::commitLandedMip() {
+  m_ResidentMip = m_LandedMip;
+  recreateTextureImageView();
+
+  if (isFullyResident()) {
+    // Every mip is in shader read layout now, the CPU copy is no longer needed
+    m_StreamSource.reset();
+    registerDefragmentation();
+  }
+
+  if (m_OnViewChanged) {
+    m_OnViewChanged();
+  }
+}
 
-  // mipmaps
-  generateMipmaps();
+void Texture::registerDefragmentation() {
+  // Let the defragmenter relocate the image, it is left in shader read layout by generateMipmaps
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.flags = m_ImageFlags;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {m_Width, m_Height, 1};
+  imageInfo.mipLevels = m_mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = m_ImageFormat;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = m_Usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  m_DefragId = m_Context->getDefragmenter()->registerImage(&m_Image, &m_ImageAllocation, imageInfo,
+                                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                           VK_IMAGE_ASPECT_COLOR_BIT, [this]() { onImageMoved(); });
+}
 
-  // cleanup
-  vkDestroyBuffer(m_Context->getDevice(), stagingBuffer, nullptr);
-  vkFreeMemory(m_Context->getDevice(), stagingBufferMemory, nullptr);
+void Texture::onImageMoved() {
+  recreateTextureImageView();
+
+  if (m_OnViewChanged) {
+    m_OnViewChanged();
+  }
 }
 
 void Texture::createTextureImageView() {
-  m_ImageView = VkUtils::createImageView(m_Image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+  // Streamed textures only expose their resident mips, which also keeps the sampled LOD within them
+  m_ImageView = VkUtils::createImageView(m_Image, m_Format, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels - m_ResidentMip,
+                                         m_ResidentMip);
+}
+
+void Texture::recreateTextureImageView() {
+  // Frames in flight may still sample through the old view
+  VkDevice device = m_Context->getDevice();
+  VkImageView oldView = m_ImageView;
+  m_Context->getDeletionQueue()->retire([device, oldView]() { vkDestroyImageView(device, oldView, nullptr); });
+
+  createTextureImageView();
 }
 
 void Texture::createTextureSampler() {
@@ -133,23 +451,86 @@ void Texture::createTextureSampler() {
   }
 }
 
-void Texture::generateMipmaps() {
+bool Texture::canComputeMips() const {
+  MipDownsampler* downsampler = m_Context->getMipDownsampler();
+  VkExtent2D extent = {std::max(1u, m_Width / 2), std::max(1u, m_Height / 2)};
+  return downsampler->isTextureMipsEnabled() && downsampler->isSupported(m_Format, extent, m_mipLevels - 1);
+}
+
+bool Texture::canBlitMips() const {
+  return m_Context->isFormatSupported(m_Format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+void Texture::generateMipmaps(VkCommandBuffer commandBuffer) {
   LOGFN;
+  GpuTimer* timer = m_Context->getMipDownsampler()->getTimer();
+  if (m_MipTimerRange != MipDownsampler::kNoTimerRange) {
+    timer->begin(commandBuffer, m_MipTimerRange);
+  }
 
-  VkFormatProperties formatProperties;
-  auto physicalDevice = m_Context->getPhysicalDevice();
-  vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
-  if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-    // throw std::runtime_error("texture image format does not support linear blitting!");
-    LOG("WARNING: Device doesn't support linear blitting - falling back to generating mipmaps on CPU");
+  if (m_MipTarget) {
+    computeMipmaps(commandBuffer);
+  } else {
+    blitMipmaps(commandBuffer);
+  }
 
-    // Simple fallback - just use the base mip level
-    VkUtils::transitionImageLayout(m_Image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+  if (m_MipTimerRange != MipDownsampler::kNoTimerRange) {
+    timer->end(commandBuffer, m_MipTimerRange);
   }
+}
 
-  VkCommandBuffer commandBuffer = VkUtils::beginSingleTimeCommands();
+void Texture::computeMipmaps(VkCommandBuffer commandBuffer) {
+  // Mip 0 is sampled by the dispatch, the other mips are written as storage images
+  VkImageMemoryBarrier barriers[2]{};
+  for (auto& barrier : barriers) {
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = m_Image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  }
+  barriers[0].subresourceRange.baseMipLevel = 0;
+  barriers[0].subresourceRange.levelCount = 1;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[1].subresourceRange.baseMipLevel = 1;
+  barriers[1].subresourceRange.levelCount = m_mipLevels - 1;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, barriers);
+
+  m_MipTarget->record(commandBuffer);
+
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barriers[1]);
+}
+
+void Texture::onMipmapsGenerated() {
+  MipDownsampler* downsampler = m_Context->getMipDownsampler();
+  if (m_MipTimerRange != MipDownsampler::kNoTimerRange) {
+    downsampler->addTextureTime(m_MipTarget != nullptr, m_Width, m_Height,
+                                downsampler->getTimer()->getMilliseconds(m_MipTimerRange));
+    downsampler->releaseTimerRange(m_MipTimerRange);
+    m_MipTimerRange = MipDownsampler::kNoTimerRange;
+  }
+  if (m_MipTarget) {
+    downsampler->releaseTarget(std::move(m_MipTarget));
+  }
+}
 
+void Texture::blitMipmaps(VkCommandBuffer commandBuffer) {
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   barrier.image = m_Image;
@@ -210,8 +591,6 @@ void Texture::generateMipmaps() {
 
   LOGCALL(vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
                                0, nullptr, 0, nullptr, 1, &barrier));
-
-  VkUtils::endSingleTimeCommands(commandBuffer);
 }
 
 }  // namespace glint
\ No newline at end of file
@@ -2,16 +2,79 @@
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "memory_allocator.h"
+#include "mip_downsampler.h"
 
 namespace glint {
 
 class VkContext;
 class CommandManager;
 
+// Downsampling filter of CPU generated mips
+enum class MipFilter {
+  // 2x2 average of the level above kept in float precision. Nothing is rounded to 8 bits between levels, so from
+  // level 2 down the mips differ slightly from a GPU blit or a chain filtered from the stored bytes of each level.
+  Box,
+  // Kaiser windowed sinc over 6x6 texels, sharper mips with less aliasing, for offline conversion
+  Kaiser,
+};
+
+// Decoded RGBA8 pixels or the blocks of a block compressed KTX2 file, independent of Vulkan so images can be decoded
+// on any thread
+struct ImageData {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // R8G8B8A8 or one of the BC formats, whose mips are rows of 4x4 texel blocks
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  std::unique_ptr<uint8_t, void (*)(void*)> pixels{nullptr, nullptr};
+
+  // Mips 1 and up, filled by generateMips() or loaded with the image. Mip i starts at mipOffsets[i - 1] in mipPixels.
+  std::vector<uint8_t> mipPixels;
+  std::vector<size_t> mipOffsets;
+
+  VkDeviceSize getSize() const { return getMipSize(0); }
+
+  bool isCompressed() const { return getBlockBytes(format) != 0; }
+  bool hasMips() const { return !mipOffsets.empty(); }
+  uint32_t getMipLevels() const { return 1 + static_cast<uint32_t>(mipOffsets.size()); }
+  uint32_t getMipWidth(uint32_t level) const { return std::max(1u, width >> level); }
+  uint32_t getMipHeight(uint32_t level) const { return std::max(1u, height >> level); }
+  VkDeviceSize getMipSize(uint32_t level) const {
+    if (uint32_t blockBytes = getBlockBytes(format)) {
+      return static_cast<VkDeviceSize>((getMipWidth(level) + 3) / 4) * ((getMipHeight(level) + 3) / 4) * blockBytes;
+    }
+    return static_cast<VkDeviceSize>(getMipWidth(level)) * getMipHeight(level) * 4;
+  }
+  const uint8_t* getMipPixels(uint32_t level) const {
+    return level == 0 ? pixels.get() : mipPixels.data() + mipOffsets[level - 1];
+  }
+
+  // Build the full mip chain on the CPU, in linear space for sRGB images, see MipGenerator. Lets the mips be uploaded
+  // one at a time, see the streaming Texture constructor, or without the GPU blit. Only for R8G8B8A8 images.
+  void generateMips(MipFilter filter = MipFilter::Box, uint32_t threadCount = 0);
+
+  // Bytes per 4x4 block of the BC formats, 0 for uncompressed formats
+  static uint32_t getBlockBytes(VkFormat format);
+};
+
 class Texture {
  public:
+  // KTX2 files are uploaded as stored, with their mips, anything else is decoded to RGBA8
   Texture(VkContext* context, const std::string& filepath);
+  // Uploads everything at once, CPU mips if the image has them. Otherwise mips are built on the GPU, by one
+  // MipDownsampler dispatch or with mip_generation blit a blit per level, or on the CPU when neither handles the format
+  Texture(VkContext* context, const ImageData& image);
+  // Progressive residency for an image with CPU mips. The small mips are uploaded right away so the texture can be
+  // sampled in the frame it is created, the TextureStreamer then uploads the larger mips one per frame and widens the
+  // image view as they land. Top mips are skipped when over texture_max_size or the device local memory headroom.
+  Texture(VkContext* context, std::shared_ptr<const ImageData> image);
   ~Texture();
 
   // Prevent copying
@@ -22,12 +85,53 @@ class Texture {
   VkSampler getSampler() const { return m_Sampler; }
   bool isValid() const { return m_Image != VK_NULL_HANDLE; }
 
+  uint32_t getMipLevels() const { return m_mipLevels; }
+  // Largest mip visible through the image view, 0 once fully resident
+  uint32_t getResidentMip() const { return m_ResidentMip; }
+  bool isFullyResident() const { return m_ResidentMip == 0; }
+
+  // Called after the image view changed, when the defragmenter moved the image or a streamed mip became resident.
+  // Descriptors using the view need rewriting. The old view stays valid until the frames in flight have completed, so
+  // owners rewrite each frame's descriptors when that frame comes up again rather than all of them at once.
+  void setOnViewChanged(std::function<void()> onViewChanged) { m_OnViewChanged = std::move(onViewChanged); }
+
+  // Decode an image file, or read a KTX2 file, throws on failure. Thread safe, no Vulkan calls.
+  static ImageData loadImage(const std::string& filepath);
+
+  // Streaming steps, driven by the TextureStreamer on the render thread
+  bool canStreamNextMip() const;
+  VkDeviceSize getNextMipSize() const;
+  void streamNextMip();
+  bool hasLandedMip() const { return m_LandedMip < m_ResidentMip; }
+  // Widen the view to the landed mip, the GPU must not be using the old view
+  void commitLandedMip();
+
  private:
-  void createTextureImage(const std::string& filepath);
+  // Throws when the device can't sample the image's format
+  void checkFormatSupport(const ImageData& image) const;
+  void createTextureImage(const ImageData& image);
+  // Stage every mip of the image in one buffer and upload them with a single copy
+  void uploadMips(const ImageData& image);
+  void createStreamedImage();
   void createTextureImageView();
+  // Replace the view, the old one is retired to the deletion queue
+  void recreateTextureImageView();
   void createTextureSampler();
 
-  void generateMipmaps();
+  // Mip of the source image that becomes mip 0, skipping top mips that are too large or do not fit in memory
+  uint32_t chooseFirstSourceMip(const ImageData& image) const;
+
+  // Whether the GPU can build the mips of the image's format, see generateMipmaps
+  bool canComputeMips() const;
+  bool canBlitMips() const;
+  // Recorded on the graphics queue after the upload, leaves all mips in shader read layout
+  void generateMipmaps(VkCommandBuffer commandBuffer);
+  void computeMipmaps(VkCommandBuffer commandBuffer);
+  void blitMipmaps(VkCommandBuffer commandBuffer);
+  // Returns the downsampler resources and reports the GPU time once the upload completed
+  void onMipmapsGenerated();
+  void registerDefragmentation();
+  void onImageMoved();
 
  private:
   VkContext* m_Context;
@@ -35,13 +139,33 @@ class Texture {
   uint32_t m_mipLevels = 1;
   uint32_t m_Width = 0;
   uint32_t m_Height = 0;
+  VkFormat m_Format = VK_FORMAT_R8G8B8A8_SRGB;
+  // How the image was created, a mutable UNORM storage image viewed as sRGB when compute builds the mips
+  VkFormat m_ImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  VkImageCreateFlags m_ImageFlags = 0;
+  VkImageUsageFlags m_Usage = 0;
 
   // TODO: Wrap Buffer and Buffer Memory together?
   VkImage m_Image = VK_NULL_HANDLE;
-  VkDeviceMemory m_ImageMemory = VK_NULL_HANDLE;
+  Allocation m_ImageAllocation;
 
   VkImageView m_ImageView = VK_NULL_HANDLE;
   VkSampler m_Sampler = VK_NULL_HANDLE;
+
+  // Streaming state. The source holds the CPU mips until every mip is resident, image mip i is source mip
+  // i + m_SourceFirstMip. Mips [m_ResidentMip, m_mipLevels) are in the view, m_LandedMip is the smallest uploaded one.
+  std::shared_ptr<const ImageData> m_StreamSource;
+  uint32_t m_SourceFirstMip = 0;
+  uint32_t m_ResidentMip = 0;
+  uint32_t m_LandedMip = 0;
+
+  // Borrowed from the MipDownsampler until the upload with the mip generation completed
+  std::unique_ptr<MipDownsampler::Target> m_MipTarget;
+  uint32_t m_MipTimerRange = MipDownsampler::kNoTimerRange;
+
+  uint64_t m_UploadId = 0;
+  uint32_t m_DefragId = 0;
+  std::function<void()> m_OnViewChanged;
 };
 
-}  // namespace glint
\ No newline at end of file
+}  // namespace glint
@@ -0,0 +1,85 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+
+#include "core/logger.h"
+#include "texture.h"
+#include "vk_context.h"
+#include "vk_utils.h"
+
+namespace glint {
+
+TextureStreamer::TextureStreamer(VkContext* context, VkDeviceSize bytesPerFrame, uint32_t maxTextureSize)
+    : m_Context(context), m_BytesPerFrame(bytesPerFrame), m_MaxTextureSize(maxTextureSize) {
+  LOGFN;
+  LOG("Texture streaming budget", bytesPerFrame / 1024, "KB per frame");
+  if (maxTextureSize != 0) {
+    LOG("Streamed textures are capped at", maxTextureSize, "pixels");
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  LOGFN;
+  if (!m_Textures.empty()) {
+    LOG("[WARNING] TextureStreamer destroyed with", m_Textures.size(), "streaming textures");
+  }
+}
+
+void TextureStreamer::add(Texture* texture) { m_Textures.push_back(texture); }
+
+void TextureStreamer::remove(Texture* texture) {
+  m_Textures.erase(std::remove(m_Textures.begin(), m_Textures.end(), texture), m_Textures.end());
+}
+
+bool TextureStreamer::update() {
+  if (m_Textures.empty()) {
+    return false;
+  }
+
+  bool landed = std::any_of(m_Textures.begin(), m_Textures.end(),
+                            [](const Texture* texture) { return texture->hasLandedMip(); });
+  if (landed) {
+    // Owners rewrite descriptors in the view callback and may drop textures meanwhile
+    std::vector<Texture*> textures = m_Textures;
+    for (auto* texture : textures) {
+      if (texture->hasLandedMip()) {
+        texture->commitLandedMip();
+        m_Stats.streamedMips++;
+      }
+    }
+
+    m_Textures.erase(std::remove_if(m_Textures.begin(), m_Textures.end(),
+                                    [](const Texture* texture) { return texture->isFullyResident(); }),
+                     m_Textures.end());
+  }
+
+  // Upload the next mips in one batch. The first one always goes so mips larger than the budget still make progress.
+  UploadBatch uploads(m_Context);
+  VkDeviceSize budget = m_BytesPerFrame;
+  bool streamed = false;
+  for (auto* texture : m_Textures) {
+    if (!texture->canStreamNextMip()) {
+      continue;
+    }
+
+    VkDeviceSize size = texture->getNextMipSize();
+    if (streamed && size > budget) {
+      break;
+    }
+
+    texture->streamNextMip();
+    m_Stats.streamedBytes += size;
+    budget -= std::min(size, budget);
+    streamed = true;
+  }
+
+  return landed;
+}
+
+TextureStreamer::Stats TextureStreamer::getStats() const {
+  Stats stats = m_Stats;
+  stats.streamingCount = static_cast<uint32_t>(m_Textures.size());
+  return stats;
+}
+
+}  // namespace glint
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace glint {
+
+class VkContext;
+class Texture;
+
+// Streams the large mips of progressively resident textures, see the streaming Texture constructor.
+// Each frame the next mip of every streaming texture is uploaded, within a bytes-per-frame budget, and mips that
+// have landed are committed. Committing replaces image views, the old ones are retired to the DeletionQueue until the
+// frames in flight sampling through them have completed. Render thread only.
+class TextureStreamer {
+ public:
+  struct Stats {
+    uint32_t streamingCount = 0;
+    uint32_t streamedMips = 0;
+    VkDeviceSize streamedBytes = 0;
+  };
+
+  // maxTextureSize 0 keeps every mip
+  TextureStreamer(VkContext* context, VkDeviceSize bytesPerFrame, uint32_t maxTextureSize);
+  ~TextureStreamer();
+
+  // Prevent copying
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  void add(Texture* texture);
+  void remove(Texture* texture);
+
+  // Called once per frame after TransferManager::collect(). Returns true if image views changed, recorded command
+  // buffers referencing the old views are stale then.
+  bool update();
+
+  // Mips larger than this are dropped when a streamed texture is created
+  uint32_t getMaxTextureSize() const { return m_MaxTextureSize; }
+
+  Stats getStats() const;
+
+ private:
+  VkContext* m_Context;
+  VkDeviceSize m_BytesPerFrame;
+  uint32_t m_MaxTextureSize;
+
+  std::vector<Texture*> m_Textures;
+  Stats m_Stats;
+};
+
+}  // namespace glint
@@ -0,0 +1,465 @@
+#include "transfer_manager.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "buffer.h"
+#include "core/logger.h"
+#include "staging_pool.h"
+#include "vk_context.h"
+#include "vk_tools.h"
+
+namespace glint {
+
+namespace {
+
+VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                    VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, uint32_t srcFamily,
+                                    uint32_t dstFamily) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  return barrier;
+}
+
+VkImageMemoryBarrier imageBarrier(VkImage image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageLayout oldLayout,
+                                  VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                                  uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED,
+                                  uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = srcFamily;
+  barrier.dstQueueFamilyIndex = dstFamily;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = baseMipLevel;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  return barrier;
+}
+
+void beginCommands(VkCommandBuffer commandBuffer) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+}
+
+}  // namespace
+
+TransferManager::TransferManager(VkContext* context)
+    : m_Context(context), m_RenderThread(std::this_thread::get_id()) {
+  LOGFN;
+  m_Dedicated = m_Context->hasDedicatedTransferQueue();
+  m_TransferFamily = m_Context->getTransferQueueFamily();
+  m_GraphicsFamily = m_Context->getQueueFamilyIndices().graphicsFamily.value();
+  LOG("Uploads use", m_Dedicated ? "the dedicated transfer queue" : "the graphics queue");
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = m_GraphicsFamily;
+  VK_CHECK_RESULT(vkCreateCommandPool(m_Context->getDevice(), &poolInfo, nullptr, &m_GraphicsPool));
+
+  if (m_Dedicated) {
+    poolInfo.queueFamilyIndex = m_TransferFamily;
+    VK_CHECK_RESULT(vkCreateCommandPool(m_Context->getDevice(), &poolInfo, nullptr, &m_TransferPool));
+  }
+}
+
+TransferManager::~TransferManager() {
+  LOGFN;
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto device = m_Context->getDevice();
+
+  // Uploads that never reached the graphics queue still have a transfer submission reading their staging buffers
+  if (m_Dedicated) {
+    vkQueueWaitIdle(m_Context->getTransferQueue());
+  }
+  for (auto& upload : m_Uploads) {
+    if (upload->submitted) {
+      vkWaitForFences(device, 1, &upload->fence, VK_TRUE, UINT64_MAX);
+    }
+  }
+  if (!m_Uploads.empty()) {
+    LOG("[WARNING] TransferManager destroyed with", m_Uploads.size(), "uploads pending");
+  }
+
+  // Let the staging pool see the fences signalled before they are destroyed
+  m_Context->getStagingPool()->collect();
+
+  while (!m_Uploads.empty()) {
+    destroyUpload(m_Uploads.back().get());
+  }
+
+  vkDestroyCommandPool(device, m_GraphicsPool, nullptr);
+  if (m_TransferPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, m_TransferPool, nullptr);
+  }
+}
+
+uint64_t TransferManager::uploadBuffer(Buffer* staging, VkBuffer buffer, VkDeviceSize size,
+                                       VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+                                       CompletionCallback onComplete, VkDeviceSize dstOffset) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Upload* upload = beginUpload(staging, size, std::move(onComplete));
+
+  VkBufferCopy copyRegion{};
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+
+  if (m_Dedicated) {
+    // Release on the transfer queue ...
+    vkCmdCopyBuffer(upload->transferCommands, staging->getBuffer(), buffer, 1, &copyRegion);
+    auto release =
+        bufferBarrier(buffer, dstOffset, size, VK_ACCESS_TRANSFER_WRITE_BIT, 0, m_TransferFamily, m_GraphicsFamily);
+    vkCmdPipelineBarrier(upload->transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+
+    // ... and acquire on the graphics queue, chained to the semaphore wait through dstStage
+    auto acquire = bufferBarrier(buffer, dstOffset, size, 0, dstAccess, m_TransferFamily, m_GraphicsFamily);
+    vkCmdPipelineBarrier(upload->graphicsCommands, dstStage, dstStage, 0, 0, nullptr, 1, &acquire, 0, nullptr);
+    upload->waitStage |= dstStage;
+  } else {
+    vkCmdCopyBuffer(upload->graphicsCommands, staging->getBuffer(), buffer, 1, &copyRegion);
+    auto barrier = bufferBarrier(buffer, dstOffset, size, VK_ACCESS_TRANSFER_WRITE_BIT, dstAccess,
+                                 VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    vkCmdPipelineBarrier(upload->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+  }
+
+  finishUpload(upload);
+  return upload->id;
+}
+
+uint64_t TransferManager::uploadImage(Buffer* staging, VkImage image, uint32_t width, uint32_t height,
+                                      uint32_t mipLevels, RecordCallback finalize, CompletionCallback onComplete) {
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {width, height, 1};
+  return uploadImage(staging, image, {region}, 0, mipLevels, std::move(finalize), std::move(onComplete));
+}
+
+uint64_t TransferManager::uploadImage(Buffer* staging, VkImage image, const std::vector<VkBufferImageCopy>& regions,
+                                      uint32_t baseMipLevel, uint32_t levelCount, RecordCallback finalize,
+                                      CompletionCallback onComplete) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Upload* upload = beginUpload(staging, staging->getSize(), std::move(onComplete));
+
+  VkCommandBuffer copyCommands = m_Dedicated ? upload->transferCommands : upload->graphicsCommands;
+
+  auto toTransferDst = imageBarrier(image, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+  vkCmdPipelineBarrier(copyCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &toTransferDst);
+
+  vkCmdCopyBufferToImage(copyCommands, staging->getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()), regions.data());
+
+  // The graphics side starts with the image in TRANSFER_DST_OPTIMAL and the copy visible to transfer operations
+  VkAccessFlags graphicsAccess = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  if (m_Dedicated) {
+    auto release = imageBarrier(image, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                                m_TransferFamily, m_GraphicsFamily);
+    vkCmdPipelineBarrier(upload->transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+
+    auto acquire = imageBarrier(image, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, graphicsAccess, m_TransferFamily,
+                                m_GraphicsFamily);
+    vkCmdPipelineBarrier(upload->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &acquire);
+    upload->waitStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+  } else {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = graphicsAccess;
+    vkCmdPipelineBarrier(upload->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  if (finalize) {
+    finalize(upload->graphicsCommands);
+  } else {
+    auto toShaderRead = imageBarrier(image, baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                     VK_ACCESS_SHADER_READ_BIT);
+    vkCmdPipelineBarrier(upload->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShaderRead);
+  }
+
+  finishUpload(upload);
+  return upload->id;
+}
+
+void TransferManager::beginBatch() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_OpenBatches[std::this_thread::get_id()].depth++;
+}
+
+uint64_t TransferManager::endBatch() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto it = m_OpenBatches.find(std::this_thread::get_id());
+  if (it == m_OpenBatches.end()) {
+    throw std::runtime_error("endBatch called without a matching beginBatch!");
+  }
+  if (--it->second.depth > 0) {
+    return it->second.upload ? it->second.upload->id : 0;
+  }
+
+  Upload* upload = it->second.upload;
+  m_OpenBatches.erase(it);
+  if (!upload) {
+    return 0;
+  }
+
+  submitTransfer(upload);
+  return upload->id;
+}
+
+void TransferManager::submitPending() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (auto& upload : m_Uploads) {
+    if (!upload->recording && !upload->submitted) {
+      submitGraphics(upload.get());
+    }
+  }
+}
+
+void TransferManager::collect() {
+  std::vector<CompletionCallback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto device = m_Context->getDevice();
+
+    std::vector<Upload*> completed;
+    for (auto& upload : m_Uploads) {
+      if (upload->submitted && vkGetFenceStatus(device, upload->fence) == VK_SUCCESS) {
+        completed.push_back(upload.get());
+      }
+    }
+    if (completed.empty()) {
+      return;
+    }
+
+    // Staging buffers released with the fences go back to the pool before the fences are destroyed
+    m_Context->getStagingPool()->collect();
+
+    for (Upload* upload : completed) {
+      for (auto& onComplete : upload->onComplete) {
+        if (onComplete) {
+          callbacks.push_back(std::move(onComplete));
+        }
+      }
+
+      m_Stats.completedCount += static_cast<uint32_t>(upload->stagings.size());
+      m_Stats.completedSubmissions++;
+      m_Stats.uploadedBytes += upload->size;
+      destroyUpload(upload);
+    }
+  }
+
+  // Owners may touch other systems (the defragmenter, descriptors), don't hold the lock
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
+bool TransferManager::isComplete(uint64_t id) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Upload* upload = findUpload(id);
+  return !upload || (upload->submitted && vkGetFenceStatus(m_Context->getDevice(), upload->fence) == VK_SUCCESS);
+}
+
+void TransferManager::wait(uint64_t id) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Upload* upload = findUpload(id);
+    if (!upload) {
+      return;
+    }
+
+    // Close a batch that is still recording, its remaining uploads go into a new one. Only the thread recording it
+    // knows that no upload is half recorded.
+    if (upload->recording) {
+      auto batch = m_OpenBatches.find(std::this_thread::get_id());
+      if (batch == m_OpenBatches.end() || batch->second.upload != upload) {
+        throw std::runtime_error("Waiting on an upload that another thread is still recording!");
+      }
+      batch->second.upload = nullptr;
+      submitTransfer(upload);
+    }
+
+    // The graphics queue is only submitted to from the render thread, in order with its frames
+    if (!upload->submitted) {
+      if (std::this_thread::get_id() != m_RenderThread) {
+        throw std::runtime_error("Waiting on an upload that was not submitted yet off the render thread!");
+      }
+      submitGraphics(upload);
+    }
+    vkWaitForFences(m_Context->getDevice(), 1, &upload->fence, VK_TRUE, UINT64_MAX);
+  }
+
+  collect();
+}
+
+TransferManager::Stats TransferManager::getStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Stats stats = m_Stats;
+  for (const auto& upload : m_Uploads) {
+    stats.pendingCount += static_cast<uint32_t>(upload->stagings.size());
+  }
+  return stats;
+}
+
+VkCommandBuffer TransferManager::allocateCommandBuffer(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = pool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  VK_CHECK_RESULT(vkAllocateCommandBuffers(m_Context->getDevice(), &allocInfo, &commandBuffer));
+  beginCommands(commandBuffer);
+  return commandBuffer;
+}
+
+TransferManager::Upload* TransferManager::createUpload() {
+  auto device = m_Context->getDevice();
+
+  auto upload = std::make_unique<Upload>();
+  upload->id = m_NextId++;
+  upload->graphicsCommands = allocateCommandBuffer(m_GraphicsPool);
+  if (m_Dedicated) {
+    upload->transferCommands = allocateCommandBuffer(m_TransferPool);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &upload->transferDone));
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &upload->fence));
+
+  m_Uploads.push_back(std::move(upload));
+  return m_Uploads.back().get();
+}
+
+TransferManager::Upload* TransferManager::beginUpload(Buffer* staging, VkDeviceSize size,
+                                                      CompletionCallback onComplete) {
+  Upload* upload = nullptr;
+  auto batch = m_OpenBatches.find(std::this_thread::get_id());
+  if (batch != m_OpenBatches.end()) {
+    if (!batch->second.upload) {
+      batch->second.upload = createUpload();
+    }
+    upload = batch->second.upload;
+  } else {
+    upload = createUpload();
+  }
+
+  // Make the host writes to the staging buffer visible before the copy
+  staging->flush();
+
+  upload->stagings.push_back(staging);
+  upload->size += size;
+  upload->onComplete.push_back(std::move(onComplete));
+  return upload;
+}
+
+void TransferManager::finishUpload(Upload* upload) {
+  // Batched uploads are submitted by endBatch
+  if (m_OpenBatches.find(std::this_thread::get_id()) == m_OpenBatches.end()) {
+    submitTransfer(upload);
+  }
+}
+
+void TransferManager::submitTransfer(Upload* upload) {
+  upload->recording = false;
+  VK_CHECK_RESULT(vkEndCommandBuffer(upload->graphicsCommands));
+  if (!m_Dedicated) {
+    // Everything runs on the graphics queue, submitted with the next frame
+    return;
+  }
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(upload->transferCommands));
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &upload->transferCommands;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &upload->transferDone;
+  VK_CHECK_RESULT(vkQueueSubmit(m_Context->getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+void TransferManager::submitGraphics(Upload* upload) {
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &upload->graphicsCommands;
+  if (upload->transferDone != VK_NULL_HANDLE) {
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &upload->transferDone;
+    submitInfo.pWaitDstStageMask = &upload->waitStage;
+  }
+
+  VK_CHECK_RESULT(vkQueueSubmit(m_Context->getGraphicsQueue(), 1, &submitInfo, upload->fence));
+  upload->submitted = true;
+
+  // The fence signals after the transfer side too, so the pool can wait on it when the staging budget is reached
+  for (Buffer* staging : upload->stagings) {
+    m_Context->getStagingPool()->release(staging, upload->fence);
+  }
+}
+
+void TransferManager::destroyUpload(Upload* upload) {
+  auto device = m_Context->getDevice();
+
+  // Submitted uploads released their staging buffers with the fence
+  if (!upload->submitted) {
+    for (Buffer* staging : upload->stagings) {
+      m_Context->getStagingPool()->release(staging);
+    }
+  }
+  if (upload->transferCommands != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(device, m_TransferPool, 1, &upload->transferCommands);
+  }
+  if (upload->transferDone != VK_NULL_HANDLE) {
+    vkDestroySemaphore(device, upload->transferDone, nullptr);
+  }
+  vkFreeCommandBuffers(device, m_GraphicsPool, 1, &upload->graphicsCommands);
+  vkDestroyFence(device, upload->fence, nullptr);
+
+  auto it = std::find_if(m_Uploads.begin(), m_Uploads.end(), [upload](const auto& u) { return u.get() == upload; });
+  m_Uploads.erase(it);
+}
+
+TransferManager::Upload* TransferManager::findUpload(uint64_t id) const {
+  for (const auto& upload : m_Uploads) {
+    if (upload->id == id) {
+      return upload.get();
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace glint
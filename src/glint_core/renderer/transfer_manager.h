@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace glint {
+
+class VkContext;
+class Buffer;
+
+// Asynchronous uploads from staging buffers into device local resources.
+// Copies are recorded on the dedicated transfer queue when the device has one, and ownership of the destination is
+// released to the graphics family. The matching acquire (plus any graphics-only work such as mip generation) is
+// submitted on the graphics queue by submitPending(), waiting on a semaphore so the render loop never blocks.
+// Without a transfer family the whole upload is a single graphics submission and no ownership transfer is needed.
+// Frames submitted after submitPending() are ordered after the uploads by the acquire barriers, completion is
+// reported by collect() once the GPU is done. Staging buffers are handed back to the pool with the fence of the
+// graphics submission, so the pool can wait for the oldest transfer when its budget is reached.
+// Uploads recorded on a thread between beginBatch() and endBatch() share their command buffers, submissions and fence,
+// see UploadBatch in vk_utils.h.
+class TransferManager {
+ public:
+  using RecordCallback = std::function<void(VkCommandBuffer)>;
+  using CompletionCallback = std::function<void()>;
+
+  struct Stats {
+    uint32_t pendingCount = 0;
+    uint32_t completedCount = 0;
+    // Batches completed, one GPU sync point each
+    uint32_t completedSubmissions = 0;
+    VkDeviceSize uploadedBytes = 0;
+  };
+
+  TransferManager(VkContext* context);
+  ~TransferManager();
+
+  // Prevent copying
+  TransferManager(const TransferManager&) = delete;
+  TransferManager& operator=(const TransferManager&) = delete;
+
+  // Copy size bytes from a staging buffer into buffer at dstOffset. dstStage / dstAccess describe the first use of the
+  // range on the graphics queue. The staging buffer must come from the context's StagingPool and is released on
+  // completion. Returns an id for isComplete / wait, shared by all uploads of a batch.
+  uint64_t uploadBuffer(Buffer* staging, VkBuffer buffer, VkDeviceSize size, VkPipelineStageFlags dstStage,
+                        VkAccessFlags dstAccess, CompletionCallback onComplete = nullptr, VkDeviceSize dstOffset = 0);
+
+  // Copy a staging buffer into mip 0 of a color image. The image reaches the graphics queue with all mips in
+  // TRANSFER_DST_OPTIMAL, finalize records the rest there (mip generation, transition to the sampled layout).
+  uint64_t uploadImage(Buffer* staging, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels,
+                       RecordCallback finalize, CompletionCallback onComplete = nullptr);
+
+  // Copy a staging buffer into mips [baseMipLevel, baseMipLevel + levelCount) of a color image, one region per mip.
+  // Only those mips change layout, the rest of the image may be sampled meanwhile. Without finalize the mips end in
+  // SHADER_READ_ONLY_OPTIMAL.
+  uint64_t uploadImage(Buffer* staging, VkImage image, const std::vector<VkBufferImageCopy>& regions,
+                       uint32_t baseMipLevel, uint32_t levelCount, RecordCallback finalize = nullptr,
+                       CompletionCallback onComplete = nullptr);
+
+  // Record following uploads from this thread into one batch. Batches nest, the outermost endBatch() submits the
+  // transfer side and returns the batch id, 0 if nothing was recorded.
+  void beginBatch();
+  uint64_t endBatch();
+
+  // Submit the graphics side of recorded uploads, call on the render thread before submitting a frame
+  void submitPending();
+
+  // Retire completed uploads, releasing their staging buffers and calling completion callbacks
+  void collect();
+
+  bool isComplete(uint64_t id) const;
+
+  // Block until an upload has completed, submitting it first if needed. Only the render thread, the one that created
+  // the TransferManager, can submit it to the graphics queue, and a batch still recording only gets closed by the
+  // thread recording it. Throws otherwise.
+  void wait(uint64_t id);
+
+  Stats getStats() const;
+
+ private:
+  // One submission, holding one or more uploads
+  struct Upload {
+    uint64_t id = 0;
+    std::vector<Buffer*> stagings;
+    VkDeviceSize size = 0;
+
+    // Copy on the transfer queue, null when everything runs on the graphics queue
+    VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+    VkSemaphore transferDone = VK_NULL_HANDLE;
+    // Union of the stages the acquire barriers of the batch chain from
+    VkPipelineStageFlags waitStage = 0;
+
+    // Acquire and graphics work, or the whole upload without a transfer queue
+    VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    bool recording = true;
+    bool submitted = false;
+
+    std::vector<CompletionCallback> onComplete;
+  };
+
+  struct OpenBatch {
+    Upload* upload = nullptr;
+    uint32_t depth = 0;
+  };
+
+  VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+  Upload* createUpload();
+  // The open batch of this thread, or a new upload that is submitted by finishUpload
+  Upload* beginUpload(Buffer* staging, VkDeviceSize size, CompletionCallback onComplete);
+  void finishUpload(Upload* upload);
+  void submitTransfer(Upload* upload);
+  void submitGraphics(Upload* upload);
+  void destroyUpload(Upload* upload);
+  Upload* findUpload(uint64_t id) const;
+
+ private:
+  VkContext* m_Context;
+  std::thread::id m_RenderThread;
+  bool m_Dedicated = false;
+  uint32_t m_TransferFamily = 0;
+  uint32_t m_GraphicsFamily = 0;
+
+  VkCommandPool m_TransferPool = VK_NULL_HANDLE;
+  VkCommandPool m_GraphicsPool = VK_NULL_HANDLE;
+
+  // In submission order
+  std::vector<std::unique_ptr<Upload>> m_Uploads;
+  std::unordered_map<std::thread::id, OpenBatch> m_OpenBatches;
+  uint64_t m_NextId = 1;
+
+  Stats m_Stats;
+  mutable std::mutex m_Mutex;
+};
+
+}  // namespace glint
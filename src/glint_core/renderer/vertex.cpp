@@ -1,48 +1,168 @@
 #include "vertex.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include "core/logger.h"
 
 namespace glint {
 
-VkVertexInputBindingDescription Vertex::getBindingDescription() {
+namespace {
+
+// Round to nearest, out of range values become infinity
+uint16_t toHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent == 0xff) {
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  }
+
+  int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+  if (halfExponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00);
+  }
+  if (halfExponent <= 0) {
+    // Subnormal half, or zero when even the top mantissa bit is shifted out
+    if (halfExponent < -10) {
+      return static_cast<uint16_t>(sign);
+    }
+    mantissa |= 0x800000;
+    uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+    uint32_t half = (mantissa >> shift) + ((mantissa >> (shift - 1)) & 1);
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  // A rounding carry out of the mantissa correctly bumps the exponent
+  uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+  return static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
+}
+
+int16_t toSnorm16(float value) { return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f)); }
+
+uint8_t toUnorm8(float value) { return static_cast<uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f)); }
+
+}  // namespace
+
+std::vector<VkVertexInputBindingDescription> Vertex::getBindingDescriptions(VertexAttributeFlags flags) {
   LOGFN;
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+
   VkVertexInputBindingDescription bindingDescription{};
-  bindingDescription.binding = 0;
-  bindingDescription.stride = sizeof(Vertex);
+  bindingDescription.binding = kPositionBinding;
+  bindingDescription.stride = getStride(flags);
   bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  return bindingDescription;
+  if (!hasAttribute(flags, VertexAttributeFlags::SplitStreams)) {
+    bindingDescriptions.push_back(bindingDescription);
+    return bindingDescriptions;
+  }
+
+  bindingDescription.stride = getPositionStride(flags);
+  bindingDescriptions.push_back(bindingDescription);
+
+  // Depth only pipelines leave the attribute stream unbound, so it is never fetched
+  if (hasAttribute(flags, VertexAttributeFlags::Color) || hasAttribute(flags, VertexAttributeFlags::TexCoord)) {
+    bindingDescription.binding = kAttributeBinding;
+    bindingDescription.stride = getStride(flags) - getPositionStride(flags);
+    bindingDescriptions.push_back(bindingDescription);
+  }
+
+  return bindingDescriptions;
 }
 
 std::vector<VkVertexInputAttributeDescription> Vertex::getAttributeDescriptions(VertexAttributeFlags flags) {
   LOGFN;
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+  bool quantized = hasAttribute(flags, VertexAttributeFlags::Quantized);
+
+  // Split streams keep the interleaved layout minus the position, which comes first
+  bool split = hasAttribute(flags, VertexAttributeFlags::SplitStreams);
+  uint32_t attributeBinding = split ? kAttributeBinding : kPositionBinding;
+  uint32_t attributeOffset = split ? getPositionStride(flags) : 0;
 
   VkVertexInputAttributeDescription positionAttributeDescription{};
-  positionAttributeDescription.binding = 0;
+  positionAttributeDescription.binding = kPositionBinding;
   positionAttributeDescription.location = 0;
-  positionAttributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-  positionAttributeDescription.offset = offsetof(Vertex, position);
+  positionAttributeDescription.format = quantized ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+  positionAttributeDescription.offset = quantized ? offsetof(QuantizedVertex, position) : offsetof(Vertex, position);
   attributeDescriptions.push_back(positionAttributeDescription);
 
   if (hasAttribute(flags, VertexAttributeFlags::Color)) {
     VkVertexInputAttributeDescription colorAttributeDescription{};
-    colorAttributeDescription.binding = 0;
+    colorAttributeDescription.binding = attributeBinding;
     colorAttributeDescription.location = 1;
-    colorAttributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-    colorAttributeDescription.offset = offsetof(Vertex, color);
+    colorAttributeDescription.format = quantized ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    colorAttributeDescription.offset =
+        (quantized ? offsetof(QuantizedVertex, color) : offsetof(Vertex, color)) - attributeOffset;
     attributeDescriptions.push_back(colorAttributeDescription);
   }
 
   if (hasAttribute(flags, VertexAttributeFlags::TexCoord)) {
     VkVertexInputAttributeDescription texCoordAttributeDescription{};
-    texCoordAttributeDescription.binding = 0;
+    texCoordAttributeDescription.binding = attributeBinding;
     texCoordAttributeDescription.location = 2;
-    texCoordAttributeDescription.format = VK_FORMAT_R32G32_SFLOAT;
-    texCoordAttributeDescription.offset = offsetof(Vertex, texCoord);
+    texCoordAttributeDescription.format = quantized ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+    texCoordAttributeDescription.offset =
+        (quantized ? offsetof(QuantizedVertex, texCoord) : offsetof(Vertex, texCoord)) - attributeOffset;
     attributeDescriptions.push_back(texCoordAttributeDescription);
   }
 
   return attributeDescriptions;
 }
-}  // namespace glint
\ No newline at end of file
+
+uint32_t Vertex::getStride(VertexAttributeFlags flags) {
+  return hasAttribute(flags, VertexAttributeFlags::Quantized) ? sizeof(QuantizedVertex) : sizeof(Vertex);
+}
+
+uint32_t Vertex::getPositionStride(VertexAttributeFlags flags) {
+  return hasAttribute(flags, VertexAttributeFlags::Quantized) ? sizeof(QuantizedVertex::position)
+                                                              : sizeof(Vertex::position);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// VertexQuantization
+
+VertexQuantization VertexQuantization::fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+  VertexQuantization quantization;
+  quantization.offset = (boundsMin + boundsMax) * 0.5f;
+  quantization.scale = (boundsMax - boundsMin) * 0.5f;
+  for (int axis = 0; axis < 3; axis++) {
+    // Flat along this axis, any scale decodes to the offset
+    if (quantization.scale[axis] <= 0.0f) {
+      quantization.scale[axis] = 1.0f;
+    }
+  }
+  return quantization;
+}
+
+QuantizedVertex VertexQuantization::encode(const Vertex& vertex) const {
+  glm::vec3 position = (vertex.position - offset) / scale;
+
+  QuantizedVertex quantized{};
+  quantized.position[0] = toSnorm16(position.x);
+  quantized.position[1] = toSnorm16(position.y);
+  quantized.position[2] = toSnorm16(position.z);
+  quantized.color[0] = toUnorm8(vertex.color.x);
+  quantized.color[1] = toUnorm8(vertex.color.y);
+  quantized.color[2] = toUnorm8(vertex.color.z);
+  quantized.color[3] = 255;
+  quantized.texCoord[0] = toHalf(vertex.texCoord.x);
+  quantized.texCoord[1] = toHalf(vertex.texCoord.y);
+  return quantized;
+}
+
+glm::mat4 VertexQuantization::getMatrix() const {
+  glm::mat4 matrix(1.0f);
+  matrix[0][0] = scale.x;
+  matrix[1][1] = scale.y;
+  matrix[2][2] = scale.z;
+  matrix[3] = glm::vec4(offset, 1.0f);
+  return matrix;
+}
+
+}  // namespace glint
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstdint>
 #include <vector>
 
 #include "glm/glm.hpp"
@@ -13,11 +14,21 @@ enum class VertexAttributeFlags {
   Position = 1 << 0,
   Color = 1 << 1,
   TexCoord = 1 << 2,
+  // Attributes are stored as QuantizedVertex instead of Vertex
+  Quantized = 1 << 3,
+  // Positions live in a stream of their own in binding 0, the other attributes in binding 1. A pipeline without
+  // Color and TexCoord only describes binding 0 and fetches nothing but positions.
+  SplitStreams = 1 << 4,
 
   // Common Combinations
   POSITION_COLOR = Position | Color,
   POSITION_TEXCOORD = Position | TexCoord,
   POSITION_COLOR_TEXCOORD = Position | Color | TexCoord,
+  QUANTIZED_POSITION_COLOR = POSITION_COLOR | Quantized,
+  QUANTIZED_POSITION_COLOR_TEXCOORD = POSITION_COLOR_TEXCOORD | Quantized,
+  SPLIT_POSITION = Position | SplitStreams,
+  SPLIT_POSITION_COLOR = POSITION_COLOR | SplitStreams,
+  SPLIT_POSITION_COLOR_TEXCOORD = POSITION_COLOR_TEXCOORD | SplitStreams,
 };
 
 inline VertexAttributeFlags operator|(VertexAttributeFlags a, VertexAttributeFlags b) {
@@ -37,11 +48,46 @@ struct Vertex {
     return position == other.position && color == other.color && texCoord == other.texCoord;
   }
 
-  static VkVertexInputBindingDescription getBindingDescription();
+  // One interleaved binding, or with SplitStreams the position binding and the attribute binding if any attribute
+  // besides the position is enabled
+  static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(
+      VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
 
   // static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
   static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
       VertexAttributeFlags flags = VertexAttributeFlags::POSITION_COLOR_TEXCOORD);
+
+  // Size of a whole vertex and of its leading position in the storage format the flags select. Split streams cut each
+  // vertex after the position, the attribute stream's stride is the difference.
+  static uint32_t getStride(VertexAttributeFlags flags);
+  static uint32_t getPositionStride(VertexAttributeFlags flags);
+
+  static constexpr uint32_t kPositionBinding = 0;
+  static constexpr uint32_t kAttributeBinding = 1;
+};
+
+// Half the size of Vertex. The vertex input converts every attribute back to float, so shaders are unchanged.
+struct QuantizedVertex {
+  // snorm16 of the position inside the mesh bounds, VertexQuantization maps it back. w is padding.
+  int16_t position[4];
+  // unorm8, alpha is padding
+  uint8_t color[4];
+  // half floats
+  uint16_t texCoord[2];
+};
+
+// Per mesh mapping between model space positions and the snorm16 range of QuantizedVertex
+struct VertexQuantization {
+  glm::vec3 offset{0.0f};
+  glm::vec3 scale{1.0f};
+
+  // Maps the bounds onto [-1, 1] on every axis
+  static VertexQuantization fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+  QuantizedVertex encode(const Vertex& vertex) const;
+
+  // Turns decoded positions back into model space, fold it into the model matrix
+  glm::mat4 getMatrix() const;
 };
 
 }  // namespace glint
\ No newline at end of file
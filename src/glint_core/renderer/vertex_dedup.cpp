@@ -0,0 +1,206 @@
+#include "vertex_dedup.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#include "core/logger.h"
+#include "core/parallel.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// The hash loadObj used with std::unordered_map, kept for the benchmark
+namespace std {
+template <>
+struct hash<glint::Vertex> {
+  size_t operator()(glint::Vertex const& vertex) const {
+    return ((hash<glm::vec3>()(vertex.position) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+           (hash<glm::vec2>()(vertex.texCoord) << 1);
+  }
+};
+}  // namespace std
+
+namespace glint {
+
+namespace {
+
+static_assert(sizeof(Vertex) % sizeof(uint64_t) == 0, "Vertex is hashed as raw words and must not have padding");
+
+constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+constexpr uint64_t kSeed = 0x27d4eb2f165667c5ull;
+constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+
+// Final avalanche of MurmurHash3, every input bit affects every output bit
+uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+// Shards take the top bits, slot positions the bottom ones, so a shard's table still spreads evenly
+uint32_t shardOf(uint64_t hash, uint32_t shardCount) {
+  return static_cast<uint32_t>(((hash >> 32) * shardCount) >> 32);
+}
+
+// indices[i] holds the first stream position of an equal vertex, never past i. Walking in order, first positions are
+// rewritten to output indices before any later position reads them.
+void compact(const std::vector<Vertex>& stream, size_t uniqueCount, std::vector<Vertex>& vertices,
+             std::vector<uint32_t>& indices) {
+  vertices.reserve(uniqueCount);
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    if (indices[i] == i) {
+      indices[i] = static_cast<uint32_t>(vertices.size());
+      vertices.push_back(stream[i]);
+    } else {
+      indices[i] = indices[indices[i]];
+    }
+  }
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// VertexHashTable
+
+VertexHashTable::VertexHashTable(size_t maxCount) {
+  size_t capacity = std::bit_ceil(std::max<size_t>(maxCount * 2, 16));
+  m_Slots.assign(capacity, {0, kEmptySlot});
+  m_Mask = capacity - 1;
+}
+
+uint64_t VertexHashTable::hash(const Vertex& vertex) {
+  uint64_t words[sizeof(Vertex) / sizeof(uint64_t)];
+  std::memcpy(words, &vertex, sizeof(Vertex));
+
+  uint64_t h = kSeed;
+  for (uint64_t word : words) {
+    h = std::rotl(h ^ (word * kPrime1), 31) * kPrime2;
+  }
+  return mix(h);
+}
+
+uint32_t VertexHashTable::findOrInsert(const Vertex& vertex, uint64_t hash, uint32_t index, const Vertex* keys) {
+  uint32_t tag = static_cast<uint32_t>(hash >> 32);
+  for (size_t i = hash & m_Mask;; i = (i + 1) & m_Mask) {
+    Slot& slot = m_Slots[i];
+    if (slot.index == kEmptySlot) {
+      slot = {tag, index};
+      m_Count++;
+      return index;
+    }
+    if (slot.tag == tag && std::memcmp(&keys[slot.index], &vertex, sizeof(Vertex)) == 0) {
+      return slot.index;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// VertexDeduplicator
+
+void VertexDeduplicator::deduplicate(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices,
+                                     std::vector<uint32_t>& indices, uint32_t threadCount) {
+  size_t count = stream.size();
+  vertices.clear();
+  indices.resize(count);
+
+  // First pass maps every position to the first position of an equal vertex, keys are the stream itself
+  size_t uniqueCount = 0;
+  if (threadCount <= 1) {
+    VertexHashTable table(count);
+    for (uint32_t i = 0; i < count; i++) {
+      indices[i] = table.findOrInsert(stream[i], VertexHashTable::hash(stream[i]), i, stream.data());
+    }
+    uniqueCount = table.getCount();
+  } else {
+    // Hash in chunks and bucket positions by shard, bucket [chunk][shard] is in stream order
+    std::vector<uint64_t> hashes(count);
+    std::vector<std::vector<uint32_t>> buckets(threadCount * threadCount);
+    size_t chunkSize = (count + threadCount - 1) / threadCount;
+    parallelFor(threadCount, [&](uint32_t chunk) {
+      size_t begin = std::min(count, chunk * chunkSize);
+      size_t end = std::min(count, begin + chunkSize);
+      for (size_t i = begin; i < end; i++) {
+        hashes[i] = VertexHashTable::hash(stream[i]);
+        buckets[chunk * threadCount + shardOf(hashes[i], threadCount)].push_back(static_cast<uint32_t>(i));
+      }
+    });
+
+    // Equal vertices always land in the same shard, each shard visits its positions in stream order
+    std::vector<size_t> shardUniqueCounts(threadCount);
+    parallelFor(threadCount, [&](uint32_t shard) {
+      size_t shardCount = 0;
+      for (uint32_t chunk = 0; chunk < threadCount; chunk++) {
+        shardCount += buckets[chunk * threadCount + shard].size();
+      }
+
+      VertexHashTable table(shardCount);
+      for (uint32_t chunk = 0; chunk < threadCount; chunk++) {
+        for (uint32_t i : buckets[chunk * threadCount + shard]) {
+          indices[i] = table.findOrInsert(stream[i], hashes[i], i, stream.data());
+        }
+      }
+      shardUniqueCounts[shard] = table.getCount();
+    });
+
+    for (size_t shardUniqueCount : shardUniqueCounts) {
+      uniqueCount += shardUniqueCount;
+    }
+  }
+
+  compact(stream, uniqueCount, vertices, indices);
+}
+
+void VertexDeduplicator::benchmark(const std::vector<Vertex>& stream) {
+  LOGFN;
+  auto measure = [](auto&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  std::vector<Vertex> mapVertices;
+  std::vector<uint32_t> mapIndices;
+  double mapTime = measure([&]() {
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    for (const auto& vertex : stream) {
+      if (uniqueVertices.count(vertex) == 0) {
+        uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+        mapVertices.push_back(vertex);
+      }
+      mapIndices.push_back(uniqueVertices[vertex]);
+    }
+  });
+
+  std::vector<Vertex> serialVertices;
+  std::vector<uint32_t> serialIndices;
+  double serialTime = measure([&]() { deduplicate(stream, serialVertices, serialIndices, 1); });
+
+  uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+  std::vector<Vertex> parallelVertices;
+  std::vector<uint32_t> parallelIndices;
+  double parallelTime = measure([&]() { deduplicate(stream, parallelVertices, parallelIndices, threadCount); });
+
+  LOG("Deduplicated", stream.size(), "vertices to", serialVertices.size());
+  LOG("std::unordered_map:", mapTime, "ms");
+  LOG("Hash table:", serialTime, "ms");
+  LOG("Hash table,", threadCount, "threads:", parallelTime, "ms");
+
+  // Byte compares keep 0.0 and -0.0 apart where operator== merged them, counts may differ for such models
+  if (serialIndices != parallelIndices || serialVertices.size() != parallelVertices.size()) {
+    LOG("[WARNING] Sharded deduplication does not match the serial result");
+  }
+  if (serialVertices.size() != mapVertices.size()) {
+    LOG("[WARNING] Hash table found", serialVertices.size(), "unique vertices, std::unordered_map", mapVertices.size());
+  }
+}
+
+}  // namespace glint
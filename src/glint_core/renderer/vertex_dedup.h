@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vertex.h"
+
+namespace glint {
+
+// Open addressing hash table from vertices to indices into a caller owned key array.
+// Linear probing over a power of two slot array sized up front for at most maxCount entries at half load, so it never
+// rehashes. Vertices are hashed and compared as raw bytes, each slot caches the upper hash bits to skip most compares.
+// Lookup and insert are a single probe sequence.
+class VertexHashTable {
+ public:
+  explicit VertexHashTable(size_t maxCount);
+
+  static uint64_t hash(const Vertex& vertex);
+
+  // Index of an equal vertex already in the table, otherwise stores index and returns it.
+  // Stored indices are looked up in keys, the caller must make keys[index] equal to vertex before the next call.
+  uint32_t findOrInsert(const Vertex& vertex, uint64_t hash, uint32_t index, const Vertex* keys);
+
+  size_t getCount() const { return m_Count; }
+
+ private:
+  struct Slot {
+    uint32_t tag;
+    uint32_t index;
+  };
+
+  std::vector<Slot> m_Slots;
+  size_t m_Mask = 0;
+  size_t m_Count = 0;
+};
+
+class VertexDeduplicator {
+ public:
+  // Turn a stream of one vertex per index into unique vertices and an index buffer. Unique vertices keep the order of
+  // their first occurrence, so the result is the same for any threadCount. With more than one thread the hashing is
+  // split into chunks and the lookups into shards by hash, one table per shard.
+  static void deduplicate(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices,
+                          std::vector<uint32_t>& indices, uint32_t threadCount = 1);
+
+  // Time the std::unordered_map path loadObj used before against the hash table, serial and sharded, and log it
+  static void benchmark(const std::vector<Vertex>& stream);
+
+  // Streams from this size up are worth deduplicating on more than one thread
+  static constexpr size_t kParallelThreshold = 1 << 20;
+};
+
+}  // namespace glint
@@ -6,6 +6,15 @@
 #include "core/config.h"
 #include "core/logger.h"
 #include "core/window.h"
+#include "renderer/asset_loader.h"
+#include "renderer/defragmenter.h"
+#include "renderer/deletion_queue.h"
+#include "renderer/geometry_pool.h"
+#include "renderer/memory_allocator.h"
+#include "renderer/mip_downsampler.h"
+#include "renderer/staging_pool.h"
+#include "renderer/texture_streamer.h"
+#include "renderer/transfer_manager.h"
 #include "renderer/vk_utils.h"
 
 namespace glint {
@@ -67,10 +76,58 @@ void VkContext::init() {
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
+
+  m_Allocator = std::make_unique<MemoryAllocator>(this);
+  m_DeletionQueue = std::make_unique<DeletionQueue>();
+
+  // Shared by all upload paths, capped by staging_budget_mb
+  VkDeviceSize stagingBudget = std::stoull(Config::getCustomeOption("staging_budget_mb", "64")) * 1024 * 1024;
+  m_StagingPool = std::make_unique<StagingPool>(this, stagingBudget);
+
+  m_TransferManager = std::make_unique<TransferManager>(this);
+
+  // Texture mips are built by one compute dispatch, or with mip_generation blit by a blit per level. mip_timing logs
+  // the GPU time of each texture's mips.
+  bool computeTextureMips = Config::getCustomeOption("mip_generation", "compute") != "blit";
+  m_MipDownsampler = std::make_unique<MipDownsampler>(this, computeTextureMips, Config::isOptionSet("mip_timing"));
+
+  // Moves at most defrag_mb_per_frame of resources per frame
+  VkDeviceSize defragBytesPerFrame = std::stoull(Config::getCustomeOption("defrag_mb_per_frame", "8")) * 1024 * 1024;
+  m_Defragmenter = std::make_unique<Defragmenter>(this, defragBytesPerFrame);
+
+  // Vertex blocks of geometry_pool_mb, index blocks half that
+  VkDeviceSize geometryBlockSize = std::stoull(Config::getCustomeOption("geometry_pool_mb", "32")) * 1024 * 1024;
+  m_GeometryPool = std::make_unique<GeometryPool>(this, geometryBlockSize, geometryBlockSize / 2);
+
+  // Streams texture mips, texture_stream_kb_per_frame per frame, top mips over texture_max_size pixels are dropped
+  VkDeviceSize streamBytesPerFrame =
+      std::stoull(Config::getCustomeOption("texture_stream_kb_per_frame", "4096")) * 1024;
+  uint32_t maxTextureSize = std::stoul(Config::getCustomeOption("texture_max_size", "0"));
+  m_TextureStreamer = std::make_unique<TextureStreamer>(this, streamBytesPerFrame, maxTextureSize);
+
+  // Decodes assets on asset_threads workers, 0 leaves one hardware thread for rendering and uses the rest
+  uint32_t assetThreads = std::stoul(Config::getCustomeOption("asset_threads", "0"));
+  m_AssetLoader = std::make_unique<AssetLoader>(this, assetThreads);
 }
 
 void VkContext::cleanup() {
   LOGFN;
+  // Retired resources first, their deleters may still call into the other managers
+  m_DeletionQueue.reset();
+  m_AssetLoader.reset();
+  m_TextureStreamer.reset();
+  m_GeometryPool.reset();
+  m_Defragmenter.reset();
+  m_TransferManager.reset();
+  // After the transfer manager, whose pending uploads may still use its pipelines
+  m_MipDownsampler.reset();
+  m_StagingPool.reset();
+
+  if (m_Allocator) {
+    m_Allocator->logStats();
+    m_Allocator.reset();
+  }
+
   vkDestroyDevice(m_Device, nullptr);
 
   if (m_EnableValidationLayers) {
@@ -201,10 +258,15 @@ void VkContext::pickPhysicalDevice() {
 void VkContext::createLogicalDevice() {
   LOGFN;
   m_QueueFamilyIndices = findQueueFamilies(m_PhysicalDevice);
+  if (!Config::isOptionSet("disable_transfer_queue")) {
+    m_QueueFamilyIndices.transferFamily = findTransferFamily(m_PhysicalDevice);
+  }
+  LOG("Dedicated transfer queue family:",
+      m_QueueFamilyIndices.transferFamily ? std::to_string(*m_QueueFamilyIndices.transferFamily) : "none");
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {m_QueueFamilyIndices.graphicsFamily.value(),
-                                            m_QueueFamilyIndices.presentFamily.value()};
+                                            m_QueueFamilyIndices.presentFamily.value(), getTransferQueueFamily()};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -216,17 +278,34 @@ void VkContext::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.sampleRateShading = VK_TRUE;
+  // Block compressed textures, see Texture
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  m_TextureCompressionBCSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+  LOG("BC texture compression supported:", m_TextureCompressionBCSupported);
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
+
+  // Enable optional extensions the device supports
+  m_EnabledDeviceExtensions = m_DeviceExtensions;
+  if (m_PhysicalDeviceProperties2Enabled &&
+      isDeviceExtensionAvailable(m_PhysicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    m_EnabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    m_MemoryBudgetSupported = true;
+  }
+  LOG("Memory budget extension supported:", m_MemoryBudgetSupported);
+
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(m_EnabledDeviceExtensions.size());
+  createInfo.ppEnabledExtensionNames = m_EnabledDeviceExtensions.data();
 
   if (LOGCALL(vkCreateDevice(m_PhysicalDevice, &createInfo, nullptr, &m_Device)) != VK_SUCCESS) {
     throw std::runtime_error("failed to create logical device!");
@@ -235,6 +314,7 @@ void VkContext::createLogicalDevice() {
   // Get device queue handles
   vkGetDeviceQueue(m_Device, m_QueueFamilyIndices.graphicsFamily.value(), 0, &m_GraphicsQueue);
   vkGetDeviceQueue(m_Device, m_QueueFamilyIndices.presentFamily.value(), 0, &m_PresentQueue);
+  vkGetDeviceQueue(m_Device, getTransferQueueFamily(), 0, &m_TransferQueue);
 }
 
 bool VkContext::checkValidationLayerSupport() {
@@ -272,6 +352,12 @@ std::vector<const char*> VkContext::getRequiredExtensions() {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
   }
 
+  // Optional, needed to query VK_EXT_memory_budget on a 1.0 instance
+  if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    m_PhysicalDeviceProperties2Enabled = true;
+  }
+
   LOG("Required Extensions: ", extensions.size());
   for (const auto& extension : extensions) {
     LOG("  ", extension);
@@ -321,6 +407,36 @@ bool VkContext::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool VkContext::isInstanceExtensionAvailable(const char* extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool VkContext::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 VkContext::QueueFamilyIndices VkContext::findQueueFamilies(VkPhysicalDevice device) {
   LOGFN;
   QueueFamilyIndices indices;
@@ -353,6 +469,30 @@ VkContext::QueueFamilyIndices VkContext::findQueueFamilies(VkPhysicalDevice devi
   return indices;
 }
 
+std::optional<uint32_t> VkContext::findTransferFamily(VkPhysicalDevice device) {
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+  // Prefer a pure transfer family (the copy engine), then any transfer capable family without graphics
+  std::optional<uint32_t> transferFamily;
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    VkQueueFlags flags = queueFamilies[i].queueFlags;
+    if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+      return i;
+    }
+    if (!transferFamily) {
+      transferFamily = i;
+    }
+  }
+  return transferFamily;
+}
+
 uint32_t VkContext::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
   VkPhysicalDeviceMemoryProperties memProperties;
   vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
@@ -400,4 +540,15 @@ VkPhysicalDeviceProperties VkContext::getPhysicalDeviceProperties() const {
   return properties;
 }
 
-}  // namespace glint
\ No newline at end of file
+bool VkContext::isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const {
+  if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK &&
+      !m_TextureCompressionBCSupported) {
+    return false;
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &properties);
+  return (properties.optimalTilingFeatures & features) == features;
+}
+
+}  // namespace glint
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -12,6 +13,15 @@
 namespace glint {
 
 class Window;
+class MemoryAllocator;
+class StagingPool;
+class Defragmenter;
+class TransferManager;
+class AssetLoader;
+class TextureStreamer;
+class GeometryPool;
+class MipDownsampler;
+class DeletionQueue;
 
 // handles instance, debug messenger, surface, and device creation, and manages the lifecycle of these objects
 class VkContext {
@@ -30,10 +40,21 @@ class VkContext {
   VkDevice getDevice() const { return m_Device; }
   VkQueue getGraphicsQueue() const { return m_GraphicsQueue; }
   VkQueue getPresentQueue() const { return m_PresentQueue; }
+  // Same as the graphics queue when there is no dedicated transfer family
+  VkQueue getTransferQueue() const { return m_TransferQueue; }
   VkSurfaceKHR getSurface() const { return m_Surface; }
   VkPhysicalDeviceProperties getPhysicalDeviceProperties() const;
 
   Window* getWindow() const { return m_Window; }
+  MemoryAllocator* getAllocator() const { return m_Allocator.get(); }
+  StagingPool* getStagingPool() const { return m_StagingPool.get(); }
+  Defragmenter* getDefragmenter() const { return m_Defragmenter.get(); }
+  TransferManager* getTransferManager() const { return m_TransferManager.get(); }
+  AssetLoader* getAssetLoader() const { return m_AssetLoader.get(); }
+  TextureStreamer* getTextureStreamer() const { return m_TextureStreamer.get(); }
+  GeometryPool* getGeometryPool() const { return m_GeometryPool.get(); }
+  MipDownsampler* getMipDownsampler() const { return m_MipDownsampler.get(); }
+  DeletionQueue* getDeletionQueue() const { return m_DeletionQueue.get(); }
 
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
@@ -43,13 +64,26 @@ class VkContext {
 
   VkSampleCountFlagBits getMsaaSamples() const { return m_MsaaSamples; }
 
+  // Optional features, enabled when the instance / device supports them
+  bool isMemoryBudgetSupported() const { return m_MemoryBudgetSupported; }
+  bool isTextureCompressionBCSupported() const { return m_TextureCompressionBCSupported; }
+
+  // Optimal tiling images of the format have every one of features. BC formats also need the BC feature.
+  bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const;
+
   struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Transfer only family (no graphics), copies there run alongside rendering
+    std::optional<uint32_t> transferFamily;
     bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
   };
 
   QueueFamilyIndices getQueueFamilyIndices() const { return m_QueueFamilyIndices; }
+  bool hasDedicatedTransferQueue() const { return m_QueueFamilyIndices.transferFamily.has_value(); }
+  uint32_t getTransferQueueFamily() const {
+    return m_QueueFamilyIndices.transferFamily.value_or(m_QueueFamilyIndices.graphicsFamily.value());
+  }
 
   void init();
   void cleanup();
@@ -71,7 +105,10 @@ class VkContext {
   std::vector<const char*> getRequiredExtensions();
   bool isDeviceSuitable(VkPhysicalDevice device);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isInstanceExtensionAvailable(const char* extensionName);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+  std::optional<uint32_t> findTransferFamily(VkPhysicalDevice device);
 
  private:
   Window* m_Window;
@@ -82,12 +119,29 @@ class VkContext {
   VkDevice m_Device;
   VkQueue m_GraphicsQueue;
   VkQueue m_PresentQueue;
+  VkQueue m_TransferQueue = VK_NULL_HANDLE;
   QueueFamilyIndices m_QueueFamilyIndices;
 
+  std::unique_ptr<MemoryAllocator> m_Allocator;
+  std::unique_ptr<DeletionQueue> m_DeletionQueue;
+  std::unique_ptr<StagingPool> m_StagingPool;
+  std::unique_ptr<TransferManager> m_TransferManager;
+  std::unique_ptr<MipDownsampler> m_MipDownsampler;
+  std::unique_ptr<Defragmenter> m_Defragmenter;
+  std::unique_ptr<GeometryPool> m_GeometryPool;
+  std::unique_ptr<TextureStreamer> m_TextureStreamer;
+  std::unique_ptr<AssetLoader> m_AssetLoader;
+
   VkSampleCountFlagBits m_MsaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
   VkCommandPool m_CommandPool;
 
+  // Required plus supported optional extensions
+  std::vector<const char*> m_EnabledDeviceExtensions;
+  bool m_PhysicalDeviceProperties2Enabled = false;
+  bool m_MemoryBudgetSupported = false;
+  bool m_TextureCompressionBCSupported = false;
+
   // Constants
   const std::vector<const char*> m_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char*> m_DeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -3,6 +3,7 @@
 #include <assert.h>
 
 #include "core/logger.h"
+#include "transfer_manager.h"
 #include "vk_context.h"
 
 namespace glint {
@@ -61,14 +62,21 @@ void VkUtils::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(s_Context->getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(s_Context->getGraphicsQueue());
+  // Wait on a fence for just this submission instead of idling the whole queue
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  VK_CHECK_RESULT(vkCreateFence(s_Context->getDevice(), &fenceInfo, nullptr, &fence));
+
+  VK_CHECK_RESULT(vkQueueSubmit(s_Context->getGraphicsQueue(), 1, &submitInfo, fence));
+  VK_CHECK_RESULT(vkWaitForFences(s_Context->getDevice(), 1, &fence, VK_TRUE, UINT64_MAX));
+  vkDestroyFence(s_Context->getDevice(), fence, nullptr);
 
   vkFreeCommandBuffers(s_Context->getDevice(), s_Context->getCommandPool(), 1, &commandBuffer);
 }
 
 VkResult VkUtils::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                               VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+                               VkBuffer& buffer, Allocation& allocation, MemoryTag tag) {
   assert(s_Context != nullptr);
 
   auto logicalDevice = s_Context->getDevice();
@@ -83,34 +91,23 @@ VkResult VkUtils::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMe
     throw std::runtime_error("Failed to create buffer!");
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(logicalDevice, buffer, &memRequirements);
+  // If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during
+  // allocation, which the allocator doesn't support yet.
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = s_Context->findMemoryType(memRequirements.memoryTypeBits, properties);
+  // Sub-allocates from a shared block and binds the buffer at the allocation offset
+  allocation = s_Context->getAllocator()->allocateForBuffer(buffer, properties, tag);
 
-  // If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during
-  // allocation
-  // VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-  // if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-  //   allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-  //   allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-  //   allocInfo.pNext = &allocFlagsInfo;
-  // }
-
-  VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &bufferMemory));
-
-  // optionally pass in the data to be mapped and copied to the buffer
-  // if (data != nullptr) {
-  //   void* mappedData;
-  //   vkMapMemory(logicalDevice, bufferMemory, 0, size, 0, &mappedData);
-  //   memcpy(mappedData, data, size);
-  //   vkUnmapMemory(logicalDevice, bufferMemory);
-  // }
-
-  return vkBindBufferMemory(logicalDevice, buffer, bufferMemory, 0);
+  return VK_SUCCESS;
+}
+
+void VkUtils::destroyBuffer(VkBuffer& buffer, Allocation& allocation) {
+  assert(s_Context != nullptr);
+
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(s_Context->getDevice(), buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+  }
+  s_Context->getAllocator()->free(allocation);
 }
 
 void VkUtils::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -125,11 +122,13 @@ void VkUtils::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize si
 
 void VkUtils::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
                           VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                          VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+                          VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation,
+                          MemoryTag tag, VkImageCreateFlags flags) {
   assert(s_Context != nullptr);
 
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.flags = flags;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
@@ -147,19 +146,47 @@ void VkUtils::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, V
     throw std::runtime_error("Failed to create image!");
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(s_Context->getDevice(), image, &memRequirements);
+  allocation = s_Context->getAllocator()->allocateForImage(image, properties, tiling, tag);
+}
+
+void VkUtils::destroyImage(VkImage& image, Allocation& allocation) {
+  assert(s_Context != nullptr);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = s_Context->findMemoryType(memRequirements.memoryTypeBits, properties);
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(s_Context->getDevice(), image, nullptr);
+    image = VK_NULL_HANDLE;
+  }
+  s_Context->getAllocator()->free(allocation);
+}
 
-  if (vkAllocateMemory(s_Context->getDevice(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to allocate image memory!");
+void VkUtils::createAliasedImages(const std::vector<VkImageCreateInfo>& imageInfos, VkMemoryPropertyFlags properties,
+                                  std::vector<VkImage>& images, Allocation& allocation, MemoryTag tag) {
+  assert(s_Context != nullptr);
+  VkDevice device = s_Context->getDevice();
+
+  auto destroyImages = [&]() {
+    for (VkImage image : images) {
+      vkDestroyImage(device, image, nullptr);
+    }
+    images.clear();
+  };
+
+  images.clear();
+  for (const auto& imageInfo : imageInfos) {
+    VkImage image = VK_NULL_HANDLE;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+      destroyImages();
+      throw std::runtime_error("Failed to create aliased image!");
+    }
+    images.push_back(image);
   }
 
-  vkBindImageMemory(s_Context->getDevice(), image, imageMemory, 0);
+  try {
+    allocation = s_Context->getAllocator()->allocateAliased(images, properties, tag);
+  } catch (...) {
+    destroyImages();
+    throw;
+  }
 }
 
 void VkUtils::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
@@ -233,7 +260,7 @@ void VkUtils::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
 }
 
 VkImageView VkUtils::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
-                                     uint32_t mipLevels) {
+                                     uint32_t mipLevels, uint32_t baseMipLevel) {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
@@ -246,7 +273,7 @@ VkImageView VkUtils::createImageView(VkImage image, VkFormat format, VkImageAspe
   viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
   viewInfo.subresourceRange.aspectMask = aspectFlags;
-  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
   viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
@@ -258,4 +285,21 @@ VkImageView VkUtils::createImageView(VkImage image, VkFormat format, VkImageAspe
   return imageView;
 }
 
-}  // namespace glint
\ No newline at end of file
+///////////////////////////////////////////////////////////////////////////
+// UploadBatch
+
+UploadBatch::UploadBatch(VkContext* context) : m_Context(context) { m_Context->getTransferManager()->beginBatch(); }
+
+UploadBatch::~UploadBatch() { submit(); }
+
+uint64_t UploadBatch::submit() {
+  if (m_Open) {
+    m_Id = m_Context->getTransferManager()->endBatch();
+    m_Open = false;
+  }
+  return m_Id;
+}
+
+void UploadBatch::wait() { m_Context->getTransferManager()->wait(submit()); }
+
+}  // namespace glint
@@ -3,7 +3,9 @@
 #include <vulkan/vulkan.h>
 
 #include <string>
+#include <vector>
 
+#include "memory_allocator.h"
 #include "vk_tools.h"
 
 namespace glint {
@@ -24,27 +26,37 @@ class VkUtils {
   }
 
   // Buffer operations
-  // TODO: Move into Buffer class
+  // Raw helpers, prefer the RAII Buffer class (buffer.h) which is built on these
+  // Memory is sub-allocated from the context's MemoryAllocator
   static VkResult createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                               VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+                               VkBuffer& buffer, Allocation& allocation, MemoryTag tag = MemoryTag::Unknown);
+  static void destroyBuffer(VkBuffer& buffer, Allocation& allocation);
 
   static void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
-  // Image operations
+  // Image operations, flags e.g. VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT for views of another format
   static void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
                           VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                          VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+                          VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation,
+                          MemoryTag tag = MemoryTag::Unknown, VkImageCreateFlags flags = 0);
+  static void destroyImage(VkImage& image, Allocation& allocation);
+
+  // Images with non-overlapping lifetimes sharing one aliased allocation, see MemoryAllocator::allocateAliased.
+  // Destroy the images, then free the allocation once.
+  static void createAliasedImages(const std::vector<VkImageCreateInfo>& imageInfos, VkMemoryPropertyFlags properties,
+                                  std::vector<VkImage>& images, Allocation& allocation,
+                                  MemoryTag tag = MemoryTag::Unknown);
 
   static void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
                                     VkImageAspectFlags aspectMask, uint32_t mipLevels);
 
   static void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
-  // Image view creation
+  // Image view creation, the view covers mips [baseMipLevel, baseMipLevel + mipLevels)
   static VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
-                                     uint32_t mipLevels);
+                                     uint32_t mipLevels, uint32_t baseMipLevel = 0);
 
-  // Helper for command buffer management
+  // Helper for command buffer management, each use is a GPU round trip, batch uploads with UploadBatch instead
   static VkCommandBuffer beginSingleTimeCommands();
   static void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
@@ -52,4 +64,28 @@ class VkUtils {
   static VkContext* s_Context;
 };
 
+// Scope that batches the uploads recorded on this thread, e.g. every Mesh and Texture of a scene, into one transfer
+// submit, one graphics submit and one fence instead of one of each per resource. Batches nest, the outermost one
+// submits when it goes out of scope or on submit().
+class UploadBatch {
+ public:
+  UploadBatch(VkContext* context);
+  ~UploadBatch();
+
+  // Prevent copying
+  UploadBatch(const UploadBatch&) = delete;
+  UploadBatch& operator=(const UploadBatch&) = delete;
+
+  // Close the batch, returns the TransferManager id of its uploads (0 if nothing was recorded)
+  uint64_t submit();
+
+  // Close the batch and block until its uploads have completed
+  void wait();
+
+ private:
+  VkContext* m_Context;
+  bool m_Open = true;
+  uint64_t m_Id = 0;
+};
+
 }  // namespace glint
\ No newline at end of file
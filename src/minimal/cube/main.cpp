@@ -111,6 +111,9 @@ class App {
       m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), i);
     }
 
+    // The image view changes when the defragmenter moves the texture
+    m_Texture->setOnViewChanged([this, framesInFlight]() { m_StaleTextureDescriptors.assign(framesInFlight, true); });
+
     // Set initial transformation matrices
     VkExtent2D extent = renderer->getSwapChain()->getExtent();
     float aspect = extent.width / (float)extent.height;
@@ -137,6 +140,7 @@ class App {
       float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastFrameTime).count();
       lastFrameTime = currentTime;
 
+      renderer->beginFrame();
       update(deltaTime);
 
       // renderer->markCommandBuffersDirty();
@@ -182,6 +186,12 @@ class App {
     // Get current frame index
     uint32_t currentFrame = renderer->getCurrentFrame();
 
+    // The frame slot is idle again, point its descriptor at the current view
+    if (!m_StaleTextureDescriptors.empty() && m_StaleTextureDescriptors[currentFrame]) {
+      m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), currentFrame);
+      m_StaleTextureDescriptors[currentFrame] = false;
+    }
+
     // Update the uniform buffer with new transformation
     updateUniformBuffer(currentFrame);
   }
@@ -212,6 +222,8 @@ class App {
   std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout = nullptr;
   std::unique_ptr<DescriptorPool> m_DescriptorPool = nullptr;
   std::unique_ptr<Descriptor> m_Descriptor = nullptr;
+  // Frames whose descriptor still references the texture's previous view
+  std::vector<bool> m_StaleTextureDescriptors;
   std::vector<std::unique_ptr<UniformBuffer>> m_UniformBuffers;
 
   std::unique_ptr<glint::ImGuiManager> imguiManager = nullptr;
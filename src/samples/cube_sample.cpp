@@ -11,6 +11,7 @@
 #include "renderer/renderer.h"
 #include "renderer/swapchain.h"
 #include "renderer/texture.h"
+#include "renderer/vk_context.h"
 #include "renderer/vk_utils.h"
 
 namespace glint {
@@ -26,8 +27,13 @@ void CubeSample::initSample(Window* window, Renderer* renderer) {
   uint32_t framesInFlight = renderer->getFramesInFlight();
   LOG("Creating resources for", framesInFlight, "frames in flight");
 
-  m_Mesh = MeshFactory::createTexturedCube(renderer->getContext());
-  m_Texture = std::make_unique<Texture>(renderer->getContext(), Config::getResourceFile("texture.jpg"));
+  // quantize_vertices halves the vertex size, the pipeline below uses the same format
+  VertexAttributeFlags vertexFormat = Config::isOptionSet("quantize_vertices")
+                                          ? VertexAttributeFlags::QUANTIZED_POSITION_COLOR_TEXCOORD
+                                          : VertexAttributeFlags::POSITION_COLOR_TEXCOORD;
+  m_Mesh = MeshFactory::createTexturedCube(renderer->getContext(), vertexFormat);
+  m_Texture = renderer->getContext()->getAssetLoader()->loadTexture(Config::getResourceFile("texture.jpg"),
+                                                                    [this]() { updateTextureDescriptors(); });
   initCamera();
   m_Camera->setPosition(2.0f, 0.2f, 2.0f);
 
@@ -45,7 +51,7 @@ void CubeSample::initSample(Window* window, Renderer* renderer) {
   config.descriptorSetLayout = m_DescriptorSetLayout->getLayout();
   config.vertexShaderPath = Config::getShaderFile("basic_tex.vert");
   config.fragmentShaderPath = Config::getShaderFile("basic_tex.frag");
-  config.vertexFormat = VertexAttributeFlags::POSITION_COLOR_TEXCOORD;
+  config.vertexFormat = m_Mesh->getFormat();
   config.depthTestEnable = true;
   config.depthWriteEnable = true;
   // config.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -68,13 +74,9 @@ void CubeSample::initSample(Window* window, Renderer* renderer) {
   m_Descriptor = std::make_unique<Descriptor>(renderer->getContext(), m_DescriptorSetLayout.get(),
                                               m_DescriptorPool.get(), framesInFlight);
 
-  // Update descriptor with uniform buffer and texture
+  // Update descriptor with uniform buffer, the texture sampler is written once the texture is ready
   for (uint32_t i = 0; i < framesInFlight; i++) {
-    // Update uniform buffer
     m_Descriptor->updateUniformBuffer(0, m_UniformBuffers[i]->getBuffer(), sizeof(UniformBufferObject), 0, i);
-
-    // Update texture sampler
-    m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), i);
   }
 
   // Set initial transformation matrices
@@ -105,6 +107,13 @@ void CubeSample::update(float deltaTime) {
   // Get current frame index
   uint32_t currentFrame = m_Renderer->getCurrentFrame();
 
+  // Frames in flight sample the texture's previous view until this frame's descriptor is rewritten, now that its
+  // fence has passed
+  if (!m_StaleTextureDescriptors.empty() && m_StaleTextureDescriptors[currentFrame]) {
+    m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), currentFrame);
+    m_StaleTextureDescriptors[currentFrame] = false;
+  }
+
   // Update the uniform buffer with new transformation
   updateUniformBuffer(currentFrame);
 }
@@ -115,6 +124,7 @@ void CubeSample::updateUniformBuffer(uint32_t currentImage) {
   // Create model matrix with rotation around z-axis
   ubo.model = glm::translate(glm::mat4(1.0f), m_ModelPosition);
   ubo.model = glm::rotate(ubo.model, glm::radians(m_RotationAngle), m_RotationAxis);
+  ubo.model = ubo.model * m_Mesh->getDequantizeMatrix();
 
   // View matrix - slight distance from the quad
   ubo.view = m_Camera->getViewMatrix();
@@ -124,7 +134,21 @@ void CubeSample::updateUniformBuffer(uint32_t currentImage) {
   m_UniformBuffers[currentImage]->update(&ubo);
 }
 
+void CubeSample::updateTextureDescriptors() {
+  for (uint32_t i = 0; i < m_Renderer->getFramesInFlight(); i++) {
+    m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), i);
+  }
+
+  // The image view changes as streamed mips land and when the defragmenter moves the texture
+  m_Texture->setOnViewChanged([this]() { m_StaleTextureDescriptors.assign(m_Renderer->getFramesInFlight(), true); });
+}
+
 void CubeSample::render(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  // Nothing to draw until the texture has been loaded, the renderer records again once it is ready
+  if (!m_Texture.isReady()) {
+    return;
+  }
+
   auto pipeline = m_Renderer->getPipeline();
   uint32_t currentFrame = m_Renderer->getCurrentFrame();
 
@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 
+#include "renderer/asset_loader.h"
 #include "renderer/descriptor.h"
 #include "renderer/texture.h"
 #include "sample.h"
@@ -21,17 +22,21 @@ class CubeSample : public Sample {
 
  private:
   void updateUniformBuffer(uint32_t currentImage);
+  void updateTextureDescriptors();
 
  private:
   std::unique_ptr<Mesh> m_Mesh;
 
-  std::unique_ptr<Texture> m_Texture;
+  // Loaded in the background, the cube is drawn once it is ready
+  TextureHandle m_Texture;
 
   // Descriptor resources
   std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
   std::unique_ptr<DescriptorPool> m_DescriptorPool;
   std::unique_ptr<Descriptor> m_Descriptor;
   std::vector<std::unique_ptr<UniformBuffer>> m_UniformBuffers;
+  // Frames whose descriptor still references the texture's previous view
+  std::vector<bool> m_StaleTextureDescriptors;
 
   // Transformation state
   float m_RotationAngle = 0.0f;
@@ -65,17 +65,7 @@ void DynamicUniformBuffer::prepareUniformBuffers() {
   LOG("dynamicAlignment = ", dynamicAlignment);
   LOG("bufferSize = ", bufferSize);
 
-  // Create the uniform buffer for the view and projection matrices
-  m_viewUBO =
-      std::make_unique<UniformBuffer>(m_Renderer->getContext(), sizeof(uboVS),
-                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  // Create the uniform buffer for the dynamic model matrix
-  m_dynamicUBO =
-      std::make_unique<UniformBuffer>(m_Renderer->getContext(), bufferSize, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-  // Override descriptor range from bufferSize to dynamicAlignment
-  m_dynamicUBO->descriptor().range = dynamicAlignment;
+  // View and model matrices are pushed into the renderer's uniform ring every frame, so no buffers are created here
 
   // Prepare per-object matrices with offsets and random rotations
   std::default_random_engine rndEngine((unsigned)time(nullptr));
@@ -85,51 +75,45 @@ void DynamicUniformBuffer::prepareUniformBuffers() {
     rotationSpeeds[i] = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
   }
 
-  // updateUniformBuffers(0);
-  updateUniformBuffers();
-  updateDynamicUniformBuffer();
 }
 
 void DynamicUniformBuffer::setupDescriptors() {
   assert(m_Renderer && m_Renderer->getContext());
-  auto device = m_Renderer->getContext()->getDevice();
 
-  // layout
+  // layout, both bindings live in the uniform ring and are addressed with dynamic offsets
   m_DescriptorSetLayout = DescriptorSetLayout::Builder(m_Renderer->getContext())
-                              .addUniformBuffer(0, VK_SHADER_STAGE_VERTEX_BIT)
-                              .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
+                              .addDynamicUniformBuffer(0, VK_SHADER_STAGE_VERTEX_BIT)
+                              .addDynamicUniformBuffer(1, VK_SHADER_STAGE_VERTEX_BIT)
                               .build();
   // pool
-  m_DescriptorPool = std::make_unique<DescriptorPool>(m_Renderer->getContext(), m_DescriptorSetLayout.get(), 2);
+  m_DescriptorPool = std::make_unique<DescriptorPool>(m_Renderer->getContext(), m_DescriptorSetLayout.get(), 1);
 
   // descriptor
   m_Descriptor =
       std::make_unique<Descriptor>(m_Renderer->getContext(), m_DescriptorSetLayout.get(), m_DescriptorPool.get(), 1);
 
-  // TODO: Here instead of usinf m_Descriptor->updateUniformBuffer, we are directly building the writeDescriptorSets
-  //  and calling vkUpdateDescriptorSets. This is because we need to update the dynamic uniform buffer with offsets
-  // This is in contrast to previous samples, and with the builder pattern we used for the descriptor set layout
-  //  Should refactor either this, or remove the builder pattern and use the same method as here for the layout
-  auto& descriptorSet = m_Descriptor->getDescriptorSets()[0];
-  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-      // Binding 0 : Projection/View matrix as uniform buffer
-      glint::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
-                                              &m_viewUBO->descriptor()),
-      // Binding 1 : Instance matrix as dynamic uniform buffer
-      glint::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
-                                              &m_dynamicUBO->descriptor())};
-
-  vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0,
-                         nullptr);
-
-  // Update descriptor sets
+  auto uniformRing = m_Renderer->getUniformRing();
+  // Binding 0 : Projection/View matrix
+  m_Descriptor->updateDynamicUniformBuffer(0, uniformRing->getBuffer(), sizeof(uboVS));
+  // Binding 1 : Instance matrix, range covers a single object
+  m_Descriptor->updateDynamicUniformBuffer(1, uniformRing->getBuffer(), dynamicAlignment);
 }
 
 void DynamicUniformBuffer::initSample(Window* window, Renderer* renderer) {
   uint32_t framesInFlight = renderer->getFramesInFlight();
   LOG("Creating resources for", framesInFlight, "frames in flight");
 
-  m_Mesh = MeshFactory::createCube(renderer->getContext());
+  // The depth prepass needs the positions in a stream of their own
+  bool depthPrepass = Config::isOptionSet("depth_prepass");
+  VertexAttributeFlags vertexFormat =
+      depthPrepass ? VertexAttributeFlags::SPLIT_POSITION_COLOR : VertexAttributeFlags::POSITION_COLOR;
+
+  // lod_model=<path> draws a model instead, each instance at the LOD its screen size allows
+  if (Config::isOptionSet("lod_model")) {
+    m_Mesh = Mesh::loadModel(renderer->getContext(), Config::getCustomeOption("lod_model", ""), vertexFormat);
+  } else {
+    m_Mesh = MeshFactory::createCube(renderer->getContext(), vertexFormat);
+  }
 
   initCamera(1, 60, 0.1, 256);
   m_Camera->setPosition(0.0f, 0.0f, -30.0f);
@@ -142,18 +126,28 @@ void DynamicUniformBuffer::initSample(Window* window, Renderer* renderer) {
   config.descriptorSetLayout = m_DescriptorSetLayout->getLayout();
   config.vertexShaderPath = Config::getShaderFile("dynamic_uniform_buffer.vert");
   config.fragmentShaderPath = Config::getShaderFile("base.frag");
-  config.vertexFormat = VertexAttributeFlags::POSITION_COLOR;
+  config.vertexFormat = vertexFormat;
   config.depthTestEnable = true;
   config.depthWriteEnable = true;
   config.cullMode = VK_CULL_MODE_NONE;
 
-  renderer->createPipeline(&config);
+  if (depthPrepass) {
+    PipelineConfig depthConfig = config;
+    depthConfig.vertexShaderPath = Config::getShaderFile("dynamic_uniform_buffer_depth.vert");
+    depthConfig.fragmentShaderPath = Config::getShaderFile("depth_only.frag");
+    depthConfig.vertexFormat = VertexAttributeFlags::SPLIT_POSITION;
+    depthConfig.colorWriteEnable = false;
+    m_DepthPipeline = std::make_unique<Pipeline>(renderer->getContext(), renderer->getRenderPass(), &depthConfig);
+
+    // The depth buffer is complete, only the nearest surface passes
+    config.depthWriteEnable = false;
+    config.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  }
 
-  auto bufferSize = OBJECT_INSTANCES * dynamicAlignment;
+  renderer->createPipeline(&config);
 
-  // Initial transformations will be set in updateUniformBuffer
-  updateUniformBuffers();
-  updateDynamicUniformBuffer();
+  // Force the first update to fill in all model matrices
+  animationTimer = 1.0f;
 }
 
 void DynamicUniformBuffer::update(float deltaTime) {
@@ -174,9 +168,6 @@ void DynamicUniformBuffer::update(float deltaTime) {
   processCameraInput();
   updateCamera(deltaTime);
 
-  // Get current frame index
-  uint32_t currentFrame = m_Renderer->getCurrentFrame();
-
   animationTimer += deltaTime;
 
   // Update the uniform buffer with new transformation
@@ -189,81 +180,79 @@ void DynamicUniformBuffer::updateUniformBuffers() {
   // Fixed ubo with projection and view matrices
   uboVS.projection = m_Camera->getProjectionMatrix();
   uboVS.view = m_Camera->getViewMatrix();
-  m_viewUBO->update(&uboVS);
+  m_ViewOffset = m_Renderer->getUniformRing()->push(&uboVS, sizeof(uboVS));
 }
 
 void DynamicUniformBuffer::updateDynamicUniformBuffer() {
   assert(m_Renderer->getContext());
-  auto device = m_Renderer->getContext()->getDevice();
 
   // Update at max. 60 fps
   // animationTimer += frameTimer;
-  if (animationTimer <= 1.0f / 60.0f) {
-    return;
-  }
-
-  // Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
-  uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
-  glm::vec3 offset(5.0f);
-
-  for (uint32_t x = 0; x < dim; x++) {
-    for (uint32_t y = 0; y < dim; y++) {
-      for (uint32_t z = 0; z < dim; z++) {
-        uint32_t index = x * dim * dim + y * dim + z;
-
-        // Aligned offset
-        glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
-
-        // Update rotations
-        rotations[index] += animationTimer * rotationSpeeds[index];
-
-        // Update matrices
-        glm::vec3 pos = glm::vec3(-((dim * offset.x) / 2.0f) + offset.x / 2.0f + x * offset.x,
-                                  -((dim * offset.y) / 2.0f) + offset.y / 2.0f + y * offset.y,
-                                  -((dim * offset.z) / 2.0f) + offset.z / 2.0f + z * offset.z);
-        *modelMat = glm::translate(glm::mat4(1.0f), pos);
-        *modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
-        *modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
-        *modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+  if (animationTimer > 1.0f / 60.0f) {
+    // Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
+    uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
+    glm::vec3 offset(5.0f);
+
+    for (uint32_t x = 0; x < dim; x++) {
+      for (uint32_t y = 0; y < dim; y++) {
+        for (uint32_t z = 0; z < dim; z++) {
+          uint32_t index = x * dim * dim + y * dim + z;
+
+          // Aligned offset
+          glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
+
+          // Update rotations
+          rotations[index] += animationTimer * rotationSpeeds[index];
+
+          // Update matrices
+          glm::vec3 pos = glm::vec3(-((dim * offset.x) / 2.0f) + offset.x / 2.0f + x * offset.x,
+                                    -((dim * offset.y) / 2.0f) + offset.y / 2.0f + y * offset.y,
+                                    -((dim * offset.z) / 2.0f) + offset.z / 2.0f + z * offset.z);
+          *modelMat = glm::translate(glm::mat4(1.0f), pos);
+          *modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
+          *modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
+          *modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
       }
     }
-  }
 
-  animationTimer = 0.0f;
-
-  // memcpy(uniformBuffers.dynamic.mapped, uboDataDynamic.model, uniformBuffers.dynamic.size);
-  m_dynamicUBO->update(uboDataDynamic.model);
+    animationTimer = 0.0f;
+  }
 
-  // Flush to make changes visible to the host
-  // TODO: m_dynamicUBO->flush() instead.
-  VkMappedMemoryRange memoryRange = glint::initializers::mappedMemoryRange();
-  memoryRange.memory = m_dynamicUBO->getMemory();
-  memoryRange.size = m_dynamicUBO->getSize();
-  vkFlushMappedMemoryRanges(device, 1, &memoryRange);
+  // The matrices are pushed every frame, since the ring segment written last frame may still be in use by the GPU
+  m_ModelOffset = m_Renderer->getUniformRing()->push(uboDataDynamic.model, OBJECT_INSTANCES * dynamicAlignment);
 }
 
 void DynamicUniformBuffer::render(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-  auto pipeline = m_Renderer->getPipeline();
-  uint32_t currentFrame = m_Renderer->getCurrentFrame();
-
-  // Bind pipeline and descriptor sets
-  pipeline->bind(commandBuffer);
-
   m_Mesh->bind(commandBuffer);
 
   // Set viewport and scissor
   setupDefaultVieportAndScissor(commandBuffer, m_Renderer);
 
+  if (m_DepthPipeline) {
+    drawInstances(commandBuffer, m_DepthPipeline.get());
+  }
+  drawInstances(commandBuffer, m_Renderer->getPipeline());
+}
+
+void DynamicUniformBuffer::drawInstances(VkCommandBuffer commandBuffer, Pipeline* pipeline) {
+  // Bind pipeline and descriptor sets
+  pipeline->bind(commandBuffer);
+
+  float viewportHeight = static_cast<float>(m_Renderer->getSwapChain()->getExtent().height);
+
   for (uint32_t j = 0; j < OBJECT_INSTANCES; j++) {
-    // One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-    uint32_t dynamicOffset = j * static_cast<uint32_t>(dynamicAlignment);
+    // One dynamic offset per dynamic descriptor, view matrices first, then the model matrix of this object
+    uint32_t dynamicOffsets[2] = {m_ViewOffset, m_ModelOffset + j * static_cast<uint32_t>(dynamicAlignment)};
     // Bind the descriptor set for rendering a mesh using the dynamic offset
     // vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 0, 1,
     //                         &descriptorSet, 1, &dynamicOffset);
 
-    m_Descriptor->bind(commandBuffer, pipeline->getPipelineLayout(), 0, 1, &dynamicOffset);
+    m_Descriptor->bind(commandBuffer, pipeline->getPipelineLayout(), 0, 2, dynamicOffsets);
 
-    m_Mesh->draw(commandBuffer);
+    // Both passes pick the same LOD, so the color pass matches the prepass depth
+    const glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (j * dynamicAlignment)));
+    m_Mesh->draw(commandBuffer, m_Mesh->selectLod(*m_Camera, *modelMat, viewportHeight));
   }
 }
 
@@ -271,12 +260,10 @@ void DynamicUniformBuffer::cleanup() {
   LOGFN;
 
   // m_Descriptor.reset();
+  m_DepthPipeline.reset();
   m_DescriptorSetLayout.reset();
   m_DescriptorPool.reset();
 
-  m_viewUBO.reset();
-  m_dynamicUBO.reset();
-
   if (uboDataDynamic.model) {
     alignedFree(uboDataDynamic.model);
     // free(uboDataDynamic.model);
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "renderer/descriptor.h"
+#include "renderer/pipeline.h"
 #include "renderer/texture.h"
 #include "sample.h"
 
@@ -26,9 +27,13 @@ class DynamicUniformBuffer : public Sample {
  private:
   void prepareUniformBuffers();
   void setupDescriptors();
+  void drawInstances(VkCommandBuffer commandBuffer, Pipeline* pipeline);
 
   std::unique_ptr<Mesh> m_Mesh;
 
+  // depth_prepass lays down depth from the position stream first, the color pass then only shades visible pixels
+  std::unique_ptr<Pipeline> m_DepthPipeline;
+
   // Descriptor resources
   std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
   std::unique_ptr<DescriptorPool> m_DescriptorPool;
@@ -45,8 +50,9 @@ class DynamicUniformBuffer : public Sample {
 
   ////////
 
-  std::unique_ptr<UniformBuffer> m_viewUBO;
-  std::unique_ptr<UniformBuffer> m_dynamicUBO;
+  // Offsets of this frame's data in the renderer's uniform ring
+  uint32_t m_ViewOffset = 0;
+  uint32_t m_ModelOffset = 0;
 
   // Transformation state
   float m_RotationAngle = 0.0f;
@@ -0,0 +1,133 @@
+#include "meshlet_sample.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/config.h"
+#include "core/logger.h"
+#include "renderer/mesh_cache.h"
+#include "renderer/mesh_factory.h"
+#include "renderer/meshlet_builder.h"
+#include "renderer/pipeline.h"
+#include "renderer/renderer.h"
+#include "renderer/vk_context.h"
+
+namespace glint {
+
+namespace {
+
+struct MeshletUniforms {
+  alignas(16) glm::mat4 model;
+  alignas(16) glm::mat4 view;
+  alignas(16) glm::mat4 proj;
+};
+
+constexpr uint32_t kSphereSegments = 512;
+constexpr uint32_t kSphereRings = 256;
+
+}  // namespace
+
+MeshletSample::MeshletSample() : Sample("MeshletSample") { LOGFN; }
+
+void MeshletSample::initSample(Window* window, Renderer* renderer) {
+  uint32_t framesInFlight = renderer->getFramesInFlight();
+  auto context = renderer->getContext();
+
+  // The culler reads the unquantized geometry, the mesh only supplies the vertex buffer
+  MeshletData meshlets;
+  if (Config::isOptionSet("meshlet_model")) {
+    auto geometry = Mesh::loadGeometry(Config::getCustomeOption("meshlet_model", ""));
+
+    // Only the full detail level is split into meshlets
+    auto indices = geometry->indices;
+    if (!geometry->lods.empty()) {
+      indices = indices.subspan(geometry->lods[0].firstIndex, geometry->lods[0].indexCount);
+    }
+    m_Mesh = std::make_unique<Mesh>(context, geometry->vertices, indices);
+    meshlets = MeshletBuilder::build(geometry->vertices, indices);
+  } else {
+    MeshData sphere;
+    m_Mesh = MeshFactory::createUvSphere(context, kSphereSegments, kSphereRings, 0.5f, &sphere);
+    meshlets = MeshletBuilder::build(sphere.vertices, sphere.indices);
+  }
+  m_Culler = std::make_unique<MeshletCuller>(context, m_Mesh.get(), meshlets, framesInFlight);
+
+  initCamera();
+  m_Camera->setPosition(0.0f, 0.0f, 1.5f);
+
+  m_DescriptorSetLayout =
+      DescriptorSetLayout::Builder(context).addUniformBuffer(0, VK_SHADER_STAGE_VERTEX_BIT).build();
+
+  PipelineConfig config;
+  config.descriptorSetLayout = m_DescriptorSetLayout->getLayout();
+  config.vertexShaderPath = Config::getShaderFile("baseMVP.vert");
+  config.fragmentShaderPath = Config::getShaderFile("base.frag");
+  config.vertexFormat = VertexAttributeFlags::POSITION_COLOR;
+  config.depthTestEnable = true;
+  config.depthWriteEnable = true;
+  config.cullMode = VK_CULL_MODE_NONE;
+
+  renderer->createPipeline(&config);
+
+  m_DescriptorPool = std::make_unique<DescriptorPool>(context, m_DescriptorSetLayout.get(), framesInFlight);
+  m_Descriptor =
+      std::make_unique<Descriptor>(context, m_DescriptorSetLayout.get(), m_DescriptorPool.get(), framesInFlight);
+
+  m_UniformBuffers.resize(framesInFlight);
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    m_UniformBuffers[i] = std::make_unique<UniformBuffer>(context, sizeof(MeshletUniforms));
+    m_Descriptor->updateUniformBuffer(0, m_UniformBuffers[i]->getBuffer(), sizeof(MeshletUniforms), 0, i);
+  }
+}
+
+void MeshletSample::update(float deltaTime) {
+  m_RotationAngle += deltaTime * 20.0f;
+  if (m_RotationAngle > 360.0f) {
+    m_RotationAngle -= 360.0f;
+  }
+
+  processCameraInput();
+  updateCamera(deltaTime);
+
+  updateUniformBuffer(m_Renderer->getCurrentFrame());
+}
+
+void MeshletSample::updateUniformBuffer(uint32_t currentImage) {
+  MeshletUniforms ubo{};
+  ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(m_RotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+  ubo.view = m_Camera->getViewMatrix();
+  ubo.proj = m_Camera->getProjectionMatrix();
+  m_UniformBuffers[currentImage]->update(&ubo);
+
+  m_Culler->update(currentImage, ubo.model, ubo.proj * ubo.view, m_Camera->getPosition());
+}
+
+void MeshletSample::prepareRender(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  m_Culler->cull(commandBuffer, m_Renderer->getCurrentFrame());
+}
+
+void MeshletSample::render(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  auto pipeline = m_Renderer->getPipeline();
+  uint32_t currentFrame = m_Renderer->getCurrentFrame();
+
+  pipeline->bind(commandBuffer);
+  m_Descriptor->bind(commandBuffer, pipeline->getPipelineLayout(), currentFrame);
+  setupDefaultVieportAndScissor(commandBuffer, m_Renderer);
+
+  m_Culler->draw(commandBuffer, currentFrame);
+}
+
+void MeshletSample::cleanup() {
+  LOGFN;
+  m_Descriptor.reset();
+  m_DescriptorPool.reset();
+  m_DescriptorSetLayout.reset();
+  m_UniformBuffers.clear();
+
+  // The culler draws from the mesh's vertex buffer
+  m_Culler.reset();
+  m_Mesh.reset();
+}
+
+REGISTER_SAMPLE(MeshletSample);
+
+}  // namespace glint
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "renderer/descriptor.h"
+#include "renderer/meshlet_culler.h"
+#include "sample.h"
+
+namespace glint {
+
+// Draws a dense mesh through the MeshletCuller, meshlets facing away or outside the view are dropped on the GPU.
+// meshlet_model=<path> loads an OBJ model, otherwise a finely tessellated sphere is generated.
+class MeshletSample : public Sample {
+ public:
+  MeshletSample();
+
+  void initSample(Window* window, Renderer* renderer) override;
+  void update(float deltaTime) override;
+  void prepareRender(VkCommandBuffer commandBuffer, uint32_t imageIndex) override;
+  void render(VkCommandBuffer commandBuffer, uint32_t imageIndex) override;
+  void cleanup() override;
+
+ private:
+  void updateUniformBuffer(uint32_t currentImage);
+
+ private:
+  std::unique_ptr<Mesh> m_Mesh;
+  std::unique_ptr<MeshletCuller> m_Culler;
+
+  // Descriptor resources
+  std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
+  std::unique_ptr<DescriptorPool> m_DescriptorPool;
+  std::unique_ptr<Descriptor> m_Descriptor;
+  std::vector<std::unique_ptr<UniformBuffer>> m_UniformBuffers;
+
+  // Transformation state
+  float m_RotationAngle = 0.0f;
+};
+
+}  // namespace glint
@@ -11,6 +11,7 @@
 #include "renderer/render_pass.h"
 #include "renderer/renderer.h"
 #include "renderer/swapchain.h"
+#include "renderer/vk_context.h"
 
 namespace glint {
 
@@ -25,11 +26,18 @@ void RotatingSample::initSample(Window* window, Renderer* renderer) {
 
   // Create a cube mesh
   //   m_Mesh = MeshFactory::createCube(renderer->getContext());
-  m_Mesh = MeshFactory::createTriangle(renderer->getContext());
+  if (Config::isOptionSet("stream_model")) {
+    m_ModelStream = renderer->getContext()->getAssetLoader()->streamModel(
+        Config::getCustomeOption("stream_model", ""),
+        [this](std::unique_ptr<Mesh> shape, const std::string& name) { m_Shapes.push_back(std::move(shape)); },
+        VertexAttributeFlags::POSITION_COLOR);
+  } else {
+    m_Mesh = MeshFactory::createTriangle(renderer->getContext());
+  }
 
-  // Create descriptor set layout
+  // Create descriptor set layout, the UBO lives in the renderer's uniform ring and is bound with a dynamic offset
   m_DescriptorSetLayout = DescriptorSetLayout::Builder(renderer->getContext())
-                              .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                              .addDynamicUniformBuffer(0, VK_SHADER_STAGE_VERTEX_BIT)
                               .build();
 
   PipelineConfig config;
@@ -42,24 +50,15 @@ void RotatingSample::initSample(Window* window, Renderer* renderer) {
   renderer->createPipeline(&config);
 
   // Create descriptor pool
-  m_DescriptorPool =
-      std::make_unique<DescriptorPool>(renderer->getContext(), m_DescriptorSetLayout.get(), framesInFlight);
-
-  // Create uniform buffer
-  m_UniformBuffers.resize(framesInFlight);
-  for (auto& ubo : m_UniformBuffers) {
-    ubo = std::make_unique<UniformBuffer>(renderer->getContext(), sizeof(UniformBufferObject));
-  }
+  m_DescriptorPool = std::make_unique<DescriptorPool>(renderer->getContext(), m_DescriptorSetLayout.get(), 1);
 
-  // Create descriptor
-  m_Descriptor = std::make_unique<Descriptor>(renderer->getContext(), m_DescriptorSetLayout.get(),
-                                              m_DescriptorPool.get(), framesInFlight);
+  // Create descriptor, a single set serves every frame in flight since only the dynamic offset changes
+  m_Descriptor =
+      std::make_unique<Descriptor>(renderer->getContext(), m_DescriptorSetLayout.get(), m_DescriptorPool.get(), 1);
 
-  // Update descriptor with uniform buffer
-  //   m_Descriptor->updateUniformBuffer(0, m_UniformBuffer->getBuffer(), sizeof(UniformBufferObject));
-  for (uint32_t i = 0; i < framesInFlight; i++) {
-    m_Descriptor->updateUniformBuffer(0, m_UniformBuffers[i]->getBuffer(), sizeof(UniformBufferObject), 0, i);
-  }
+  // Update descriptor with the uniform ring
+  auto uniformRing = renderer->getUniformRing();
+  m_Descriptor->updateDynamicUniformBuffer(0, uniformRing->getBuffer(), sizeof(UniformBufferObject));
 
   // Set initial transformation matrices
   VkExtent2D extent = renderer->getSwapChain()->getExtent();
@@ -75,10 +74,6 @@ void RotatingSample::initSample(Window* window, Renderer* renderer) {
   // Vulkan's Y coordinate is inverted compared to OpenGL
   m_UBOData.proj[1][1] *= -1;
 
-  // Update the uniform buffer with initial data
-  for (size_t i = 0; i < framesInFlight; i++) {
-    m_UniformBuffers[i]->update(&m_UBOData);
-  }
 }
 
 void RotatingSample::update(float deltaTime) {
@@ -91,10 +86,8 @@ void RotatingSample::update(float deltaTime) {
   // Update model matrix with rotation
   m_UBOData.model = glm::rotate(glm::mat4(1.0f), glm::radians(m_RotationAngle), m_RotationAxis);
 
-  uint32_t currentFrame = m_Renderer->getCurrentFrame();
-
-  // Update uniform buffer with new matrices
-  m_UniformBuffers[currentFrame]->update(&m_UBOData);
+  // Push new matrices into this frame's segment of the uniform ring
+  m_UniformOffset = m_Renderer->getUniformRing()->push(&m_UBOData, sizeof(UniformBufferObject));
 }
 
 void RotatingSample::render(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -102,21 +95,25 @@ void RotatingSample::render(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 
   // Get components from renderer
   auto pipeline = m_Renderer->getPipeline();
-  auto currentFrame = m_Renderer->getCurrentFrame();
 
   // Bind pipeline
   pipeline->bind(commandBuffer);
 
-  // Bind descriptor set
-  m_Descriptor->bind(commandBuffer, pipeline->getPipelineLayout(), currentFrame);
-
-  // Bind mesh
-  m_Mesh->bind(commandBuffer);
+  // Bind descriptor set at this frame's UBO data
+  m_Descriptor->bind(commandBuffer, pipeline->getPipelineLayout(), 0, 1, &m_UniformOffset);
 
   setupDefaultVieportAndScissor(commandBuffer, m_Renderer);
 
-  // Draw mesh
-  m_Mesh->draw(commandBuffer);
+  // Bind and draw mesh
+  if (m_Mesh) {
+    m_Mesh->bind(commandBuffer);
+    m_Mesh->draw(commandBuffer);
+  }
+
+  for (const auto& shape : m_Shapes) {
+    shape->bind(commandBuffer);
+    shape->draw(commandBuffer);
+  }
 }
 
 void RotatingSample::cleanup() {
@@ -127,13 +124,13 @@ void RotatingSample::cleanup() {
   //   }
 
   m_Descriptor.reset();
-  //   m_UniformBuffer.reset();
-  for (auto& ubo : m_UniformBuffers) {
-    ubo.reset();
-  }
   m_DescriptorPool.reset();
   m_DescriptorSetLayout.reset();
   m_Mesh.reset();
+
+  // Shapes still being parsed are dropped with the stream
+  m_ModelStream.reset();
+  m_Shapes.clear();
 }
 
 REGISTER_SAMPLE(RotatingSample);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include "renderer/asset_loader.h"
 #include "renderer/descriptor.h"
 #include "sample.h"
 
@@ -26,13 +30,17 @@ class RotatingSample : public Sample {
   Renderer* m_Renderer = nullptr;
   std::unique_ptr<Mesh> m_Mesh = nullptr;
 
+  // stream_model=<path> draws the shapes of an OBJ model as they are parsed instead
+  ModelStreamHandle m_ModelStream;
+  std::vector<std::unique_ptr<Mesh>> m_Shapes;
+
   // Uniform buffer resources
   std::unique_ptr<DescriptorSetLayout> m_DescriptorSetLayout;
   std::unique_ptr<DescriptorPool> m_DescriptorPool;
   std::unique_ptr<Descriptor> m_Descriptor;
 
-  // std::unique_ptr<UniformBuffer> m_UniformBuffer;
-  std::vector<std::unique_ptr<UniformBuffer>> m_UniformBuffers;
+  // Offset of this frame's UBO data in the renderer's uniform ring
+  uint32_t m_UniformOffset = 0;
 
   // Transform state
   float m_RotationAngle = 0.0f;
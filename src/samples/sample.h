@@ -24,6 +24,8 @@ class Sample {
 
   virtual void initSample(Window* window, Renderer* renderer) = 0;
   virtual void update(float deltaTime) = 0;
+  // Recorded before the render pass begins, for compute work the draws depend on
+  virtual void prepareRender(VkCommandBuffer commandBuffer, uint32_t imageIndex) {}
   virtual void render(VkCommandBuffer commandBuffer, uint32_t imageIndex) = 0;
   virtual void cleanup() = 0;
 
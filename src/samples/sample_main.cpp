@@ -12,14 +12,21 @@
 #include "core/config.h"
 #include "core/logger.h"
 #include "core/window.h"
+#include "renderer/asset_loader.h"
 #include "renderer/command_manager.h"
+#include "renderer/defragmenter.h"
+#include "renderer/geometry_pool.h"
+#include "renderer/memory_allocator.h"
 #include "renderer/mesh.h"
 #include "renderer/mesh_factory.h"
 #include "renderer/pipeline.h"
 #include "renderer/render_pass.h"
 #include "renderer/renderer.h"
+#include "renderer/staging_pool.h"
 #include "renderer/swapchain.h"
 #include "renderer/synchronization_manager.h"
+#include "renderer/texture_streamer.h"
+#include "renderer/transfer_manager.h"
 #include "renderer/vk_context.h"
 #include "ui/imgui_manager.h"
 
@@ -97,6 +104,9 @@ class App {
       frameTime = deltaTime;
       fps = 1.0f / deltaTime;
 
+      // Wait for the GPU to release this frame's resources before the sample writes them
+      renderer->beginFrame();
+
       // Update active sample
       glint::SampleManager::update(deltaTime);
 
@@ -111,8 +121,35 @@ class App {
       } else {
         ImGui::Text("Active Sample: None");
       }
+      auto memoryStats = renderer->getContext()->getAllocator()->getStats();
+      ImGui::Text("Device Memory Allocations: %u (%u blocks, %u dedicated)", memoryStats.deviceMemoryCount(),
+                  memoryStats.blockCount, memoryStats.dedicatedCount);
+      ImGui::Text("Resources: %u, %.1f MB used", memoryStats.allocationCount,
+                  memoryStats.usedBytes / (1024.0f * 1024.0f));
+      auto stagingStats = renderer->getContext()->getStagingPool()->getStats();
+      ImGui::Text("Staging Buffers: %u, %.1f / %.1f MB", stagingStats.bufferCount,
+                  stagingStats.totalBytes / (1024.0f * 1024.0f), stagingStats.budgetBytes / (1024.0f * 1024.0f));
+      auto transferStats = renderer->getContext()->getTransferManager()->getStats();
+      ImGui::Text("Uploads: %u pending, %u done in %u submits, %.1f MB (%s queue)", transferStats.pendingCount,
+                  transferStats.completedCount, transferStats.completedSubmissions,
+                  transferStats.uploadedBytes / (1024.0f * 1024.0f),
+                  renderer->getContext()->hasDedicatedTransferQueue() ? "transfer" : "graphics");
+      auto assetStats = renderer->getContext()->getAssetLoader()->getStats();
+      ImGui::Text("Assets: %u loading, %u loaded, %u failed (%u threads)", assetStats.loadingCount,
+                  assetStats.loadedCount, assetStats.failedCount,
+                  renderer->getContext()->getAssetLoader()->getThreadCount());
+      auto geometryStats = renderer->getContext()->getGeometryPool()->getStats();
+      ImGui::Text("Geometry Pool: %u meshes in %u blocks, %.1f / %.1f MB", geometryStats.rangeCount,
+                  geometryStats.blockCount,
+                  (geometryStats.usedVertexBytes + geometryStats.usedIndexBytes) / (1024.0f * 1024.0f),
+                  geometryStats.capacityBytes / (1024.0f * 1024.0f));
+      auto streamStats = renderer->getContext()->getTextureStreamer()->getStats();
+      ImGui::Text("Texture Streaming: %u textures, %u mips, %.1f MB", streamStats.streamingCount,
+                  streamStats.streamedMips, streamStats.streamedBytes / (1024.0f * 1024.0f));
       ImGui::End();
 
+      drawMemoryWindow();
+
       renderer->drawFrame([this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
         glint::SampleManager::render(commandBuffer, imageIndex);
       });
@@ -123,6 +160,42 @@ class App {
     renderer->waitIdle();
   }
 
+  void drawMemoryWindow() {
+    constexpr float MB = 1024.0f * 1024.0f;
+    auto allocator = renderer->getContext()->getAllocator();
+
+    ImGui::Begin("Glint Memory");
+    ImGui::Text("Budget: %s", allocator->hasDriverBudget() ? "VK_EXT_memory_budget" : "estimated from heap size");
+    ImGui::Text("Transient attachments: %s",
+                allocator->isLazyAllocationSupported() ? "lazily allocated" : "device local");
+
+    auto heaps = allocator->getHeapStats();
+    for (uint32_t i = 0; i < heaps.size(); i++) {
+      const auto& heap = heaps[i];
+      ImGui::Separator();
+      ImGui::Text("Heap %u (%s): %.1f / %.1f MB", i, heap.isDeviceLocal() ? "device local" : "host", heap.usage / MB,
+                  heap.budget / MB);
+      ImGui::ProgressBar(heap.budget > 0 ? static_cast<float>(heap.usage) / heap.budget : 0.0f);
+      ImGui::Text("Glint: %.1f MB reserved, %.1f MB buffers, %.1f MB images", heap.reservedBytes / MB,
+                  heap.bufferBytes / MB, heap.imageBytes / MB);
+    }
+
+    ImGui::Separator();
+    auto stats = allocator->getStats();
+    for (size_t i = 0; i < glint::kMemoryTagCount; i++) {
+      if (stats.tagCounts[i] > 0) {
+        ImGui::Text("%-10s %4u  %.2f MB", glint::memoryTagName(static_cast<glint::MemoryTag>(i)), stats.tagCounts[i],
+                    stats.tagBytes[i] / MB);
+      }
+    }
+
+    ImGui::Separator();
+    auto defragStats = renderer->getContext()->getDefragmenter()->getStats();
+    ImGui::Text("Defragmentation: %u moved (%.1f MB), %u blocks released", defragStats.movedResources,
+                defragStats.movedBytes / MB, defragStats.releasedBlocks);
+    ImGui::End();
+  }
+
   void cleanup() {
     LOGFN;
     glint::SampleManager::cleanup();
@@ -5,6 +5,7 @@
 #include "core/logger.h"
 #include "renderer/render_pass.h"
 #include "renderer/renderer.h"
+#include "renderer/vk_utils.h"
 #include "ui/imgui_manager.h"
 
 // samples
@@ -86,8 +87,9 @@ void SampleManager::setActiveSample(const std::string& name) {
   m_ActiveSample = sampleItr->second();
   LOG("Active sample set to:", name);
 
-  // Initialize the new sample
+  // Initialize the new sample, its assets are uploaded in a single submission
   if (m_Window && m_Renderer && m_ActiveSample) {
+    UploadBatch uploads(m_Renderer->getContext());
     m_ActiveSample->init(m_Window, m_Renderer);
   }
 }
@@ -118,6 +120,10 @@ void SampleManager::renderSample(VkCommandBuffer commandBuffer, uint32_t imageIn
   }
   ImGui::End();
 
+  if (m_ActiveSample) {
+    m_ActiveSample->prepareRender(commandBuffer, imageIndex);
+  }
+
   VkClearColorValue clearColor = {0.f, 0.f, 0.f, 1.0f};  // black
   // VkClearColorValue clearColor = {0.1f, 0.1f, 0.2f, 1.0f};  // blue
   renderPass->begin(commandBuffer, imageIndex, clearColor);
@@ -33,8 +33,6 @@ void TexturedRotatingSample::initSample(Window* window, Renderer* renderer) {
   // Create a textured quad mesh
   m_Mesh = MeshFactory::createQuad(renderer->getContext(), true);
 
-  VkUtils::setObjectName((uint64_t)m_Mesh->getVertexBuffer(), VK_OBJECT_TYPE_BUFFER, "TexturedQuad Vertex Buffer");
-
   // Load texture
   m_Texture = std::make_unique<Texture>(renderer->getContext(), Config::getResourceFile("texture.jpg"));
 
@@ -78,6 +76,9 @@ void TexturedRotatingSample::initSample(Window* window, Renderer* renderer) {
     m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), i);
   }
 
+  // The image view changes when the defragmenter moves the texture
+  m_Texture->setOnViewChanged([this, framesInFlight]() { m_StaleTextureDescriptors.assign(framesInFlight, true); });
+
   // Set initial transformation matrices
   VkExtent2D extent = renderer->getSwapChain()->getExtent();
   float aspect = extent.width / (float)extent.height;
@@ -97,6 +98,12 @@ void TexturedRotatingSample::update(float deltaTime) {
   // Get current frame index
   uint32_t currentFrame = m_Renderer->getCurrentFrame();
 
+  // Rewrite this frame's texture descriptor now that nothing in flight uses it
+  if (!m_StaleTextureDescriptors.empty() && m_StaleTextureDescriptors[currentFrame]) {
+    m_Descriptor->updateTextureSampler(1, m_Texture->getImageView(), m_Texture->getSampler(), currentFrame);
+    m_StaleTextureDescriptors[currentFrame] = false;
+  }
+
   // Update the uniform buffer with new transformation
   updateUniformBuffer(currentFrame);
 }
@@ -33,6 +33,8 @@ class TexturedRotatingSample : public Sample {
   std::unique_ptr<DescriptorPool> m_DescriptorPool;
   std::unique_ptr<Descriptor> m_Descriptor;
   std::vector<std::unique_ptr<UniformBuffer>> m_UniformBuffers;
+  // Frames whose descriptor still references the texture's previous view
+  std::vector<bool> m_StaleTextureDescriptors;
 
   // Transformation state
   float m_RotationAngle = 0.0f;
@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only passes write no color
+void main() {
+}
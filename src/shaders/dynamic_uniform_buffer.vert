@@ -16,9 +16,11 @@ layout (binding = 1) uniform UboInstance
 
 layout (location = 0) out vec3 outColor;
 
+// Invariant in both this and the depth prepass shader, so the depth the color pass tests with LESS_OR_EQUAL
+// matches the prepass bit for bit
 out gl_PerVertex 
 {
-	vec4 gl_Position;   
+	invariant vec4 gl_Position;   
 };
 
 void main() 
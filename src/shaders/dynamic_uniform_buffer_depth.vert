@@ -0,0 +1,29 @@
+#version 450
+
+// Depth prepass variant of dynamic_uniform_buffer.vert, reads nothing but the position stream
+layout (location = 0) in vec3 inPos;
+
+layout (binding = 0) uniform UboView 
+{
+	mat4 projection;
+	mat4 view;
+} uboView;
+
+layout (binding = 1) uniform UboInstance 
+{
+	mat4 model; 
+} uboInstance;
+
+// Invariant in both this and the color pass shader, so the depth the color pass tests with LESS_OR_EQUAL
+// matches the prepass bit for bit
+out gl_PerVertex 
+{
+	invariant vec4 gl_Position;   
+};
+
+void main() 
+{
+	// Same expression as the color pass, so both passes produce the same depth
+	mat4 modelView = uboView.view * uboInstance.model;
+	gl_Position = uboView.projection * modelView * vec4(inPos.xyz, 1.0);
+}
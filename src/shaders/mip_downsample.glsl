@@ -0,0 +1,224 @@
+// Single pass mip chain downsampling, see MipDownsampler. Every workgroup reduces a 64x64 texel tile of the source to
+// the 32x32 ... 1x1 texels it covers in destination levels 0 to 5, the levels in between stay in shared memory. The
+// last workgroup to finish, found with an atomic counter, reduces the level 5 texels of all workgroups into levels 6
+// to 11. Included by a shader per destination format, which defines DESTINATION_FORMAT and, for four channels,
+// PACKED_TILE to keep the tile in half precision. MULTISAMPLED_SOURCE reads a multisampled source such as an MSAA
+// depth buffer.
+layout(local_size_x = 256) in;
+
+const uint kMaxLevels = 12u;
+// Texels of the first level of a tile per side, and the levels a tile covers
+const uint kTileSize = 32u;
+const uint kTileLevels = 6u;
+
+const uint REDUCE_AVERAGE = 0u;
+const uint REDUCE_MIN = 1u;
+const uint REDUCE_MAX = 2u;
+
+layout(push_constant) uniform DownsampleParams {
+    vec4 fill;              // value of source texels outside sourceSize when padded
+    ivec2 sourceSize;
+    uvec2 destinationSize;  // of destination level 0
+    uint levelCount;
+    uint reduction;
+    uint srgb;              // the destination views are UNORM aliases of an sRGB image
+    uint padded;            // destination level 0 covers more than half the source, e.g. a power of two pyramid
+} params;
+
+#ifdef MULTISAMPLED_SOURCE
+layout(binding = 0) uniform sampler2DMS source;
+#else
+layout(binding = 0) uniform sampler2D source;
+#endif
+
+// Unused elements alias the last level, they are never written
+layout(binding = 1, DESTINATION_FORMAT) uniform writeonly image2D destination[kMaxLevels];
+
+// Workgroups finished so far, reset before the dispatch, and the level 5 texel of every workgroup
+layout(std430, binding = 2) coherent buffer GroupResults {
+    uint finishedGroups;
+    uint padding[3];
+    vec4 groupTexels[];
+} results;
+
+#ifdef PACKED_TILE
+shared uvec2 tile[kTileSize * kTileSize];
+
+void storeTile(uint index, vec4 value) {
+    tile[index] = uvec2(packHalf2x16(value.xy), packHalf2x16(value.zw));
+}
+
+vec4 loadTile(uint index) {
+    return vec4(unpackHalf2x16(tile[index].x), unpackHalf2x16(tile[index].y));
+}
+#else
+shared float tile[kTileSize * kTileSize];
+
+void storeTile(uint index, vec4 value) {
+    tile[index] = value.x;
+}
+
+vec4 loadTile(uint index) {
+    return vec4(tile[index]);
+}
+#endif
+
+shared bool isLastGroup;
+
+uvec2 levelSize(uint level) {
+    return max(params.destinationSize >> level, uvec2(1));
+}
+
+vec4 reduce(vec4 a, vec4 b, vec4 c, vec4 d) {
+    if (params.reduction == REDUCE_MIN) {
+        return min(min(a, b), min(c, d));
+    }
+    if (params.reduction == REDUCE_MAX) {
+        return max(max(a, b), max(c, d));
+    }
+    return (a + b + c + d) * 0.25;
+}
+
+vec4 linearToSrgb(vec4 color) {
+    vec3 low = color.rgb * 12.92;
+    vec3 high = 1.055 * pow(color.rgb, vec3(1.0 / 2.4)) - 0.055;
+    return vec4(mix(high, low, lessThanEqual(color.rgb, vec3(0.0031308))), color.a);
+}
+
+// Image arrays are only indexed with constants, dynamic indexing is an optional feature
+void storeLevel(uint level, uvec2 texel, vec4 value) {
+    if (any(greaterThanEqual(texel, levelSize(level)))) {
+        return;
+    }
+    if (params.srgb != 0) {
+        value = linearToSrgb(value);
+    }
+    ivec2 coord = ivec2(texel);
+    switch (level) {
+        case 0u: imageStore(destination[0], coord, value); break;
+        case 1u: imageStore(destination[1], coord, value); break;
+        case 2u: imageStore(destination[2], coord, value); break;
+        case 3u: imageStore(destination[3], coord, value); break;
+        case 4u: imageStore(destination[4], coord, value); break;
+        case 5u: imageStore(destination[5], coord, value); break;
+        case 6u: imageStore(destination[6], coord, value); break;
+        case 7u: imageStore(destination[7], coord, value); break;
+        case 8u: imageStore(destination[8], coord, value); break;
+        case 9u: imageStore(destination[9], coord, value); break;
+        case 10u: imageStore(destination[10], coord, value); break;
+        case 11u: imageStore(destination[11], coord, value); break;
+    }
+}
+
+vec4 loadSource(ivec2 texel) {
+    if (params.padded != 0) {
+        if (any(greaterThanEqual(texel, params.sourceSize))) {
+            return params.fill;
+        }
+    } else {
+        texel = min(texel, params.sourceSize - 1);
+    }
+#ifdef MULTISAMPLED_SOURCE
+    // The samples of a texel are reduced like the texels of a level
+    int sampleCount = textureSamples(source);
+    vec4 value = texelFetch(source, texel, 0);
+    for (int i = 1; i < sampleCount; i++) {
+        vec4 sampleValue = texelFetch(source, texel, i);
+        if (params.reduction == REDUCE_MIN) {
+            value = min(value, sampleValue);
+        } else if (params.reduction == REDUCE_MAX) {
+            value = max(value, sampleValue);
+        } else {
+            value += sampleValue;
+        }
+    }
+    return params.reduction == REDUCE_AVERAGE ? value / float(sampleCount) : value;
+#else
+    return texelFetch(source, texel, 0);
+#endif
+}
+
+vec4 loadGroupTexel(ivec2 texel) {
+    texel = min(texel, ivec2(levelSize(kTileLevels - 1)) - 1);
+    return results.groupTexels[texel.y * int(gl_NumWorkGroups.x) + texel.x];
+}
+
+// Texel of the first level of a tile, reduced from the source or, past the first tile levels, from the group texels
+vec4 reduceFirstLevel(uint firstLevel, uvec2 texel) {
+    ivec2 corner = ivec2(texel * 2);
+    if (firstLevel == 0) {
+        return reduce(loadSource(corner), loadSource(corner + ivec2(1, 0)), loadSource(corner + ivec2(0, 1)),
+                      loadSource(corner + ivec2(1, 1)));
+    }
+    return reduce(loadGroupTexel(corner), loadGroupTexel(corner + ivec2(1, 0)), loadGroupTexel(corner + ivec2(0, 1)),
+                  loadGroupTexel(corner + ivec2(1, 1)));
+}
+
+// Texel of the previous level in the tile, reads past the level's edge are clamped to it like the source reads
+vec4 loadPrevious(uvec2 origin, uint size, uint level, ivec2 texel) {
+    ivec2 clamped = min(ivec2(origin) + texel, ivec2(levelSize(level)) - 1);
+    ivec2 local = max(clamped - ivec2(origin), ivec2(0));
+    return loadTile(uint(local.y) * size + uint(local.x));
+}
+
+// Reduce tile into levels firstLevel up to firstLevel + kTileLevels, each level from the previous one in shared memory
+void downsampleTile(uvec2 tileIndex, uint firstLevel) {
+    uint lastLevel = min(firstLevel + kTileLevels, params.levelCount);
+
+    for (uint i = 0; i < 4; i++) {
+        uint index = gl_LocalInvocationIndex + i * gl_WorkGroupSize.x;
+        uvec2 texel = tileIndex * kTileSize + uvec2(index % kTileSize, index / kTileSize);
+        vec4 value = reduceFirstLevel(firstLevel, texel);
+        storeLevel(firstLevel, texel, value);
+        storeTile(index, value);
+    }
+
+    uint size = kTileSize;
+    for (uint level = firstLevel + 1; level < lastLevel; level++) {
+        uvec2 previousOrigin = tileIndex * size;
+        uint previousSize = size;
+        size /= 2;
+
+        bool active = gl_LocalInvocationIndex < size * size;
+        uvec2 local = uvec2(gl_LocalInvocationIndex % size, gl_LocalInvocationIndex / size);
+        ivec2 corner = ivec2(local * 2);
+        vec4 value = vec4(0.0);
+
+        barrier();
+        if (active) {
+            value = reduce(loadPrevious(previousOrigin, previousSize, level - 1, corner),
+                           loadPrevious(previousOrigin, previousSize, level - 1, corner + ivec2(1, 0)),
+                           loadPrevious(previousOrigin, previousSize, level - 1, corner + ivec2(0, 1)),
+                           loadPrevious(previousOrigin, previousSize, level - 1, corner + ivec2(1, 1)));
+        }
+        barrier();
+        if (active) {
+            storeTile(local.y * size + local.x, value);
+            storeLevel(level, tileIndex * size + local, value);
+        }
+    }
+}
+
+void main() {
+    downsampleTile(gl_WorkGroupID.xy, 0);
+    if (params.levelCount <= kTileLevels) {
+        return;
+    }
+
+    // The tile's level 5 texel is in the first shared slot, written by this invocation
+    if (gl_LocalInvocationIndex == 0) {
+        if (all(lessThan(gl_WorkGroupID.xy, levelSize(kTileLevels - 1)))) {
+            results.groupTexels[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = loadTile(0);
+        }
+        memoryBarrierBuffer();
+        uint groupCount = gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+        isLastGroup = atomicAdd(results.finishedGroups, 1u) == groupCount - 1u;
+    }
+    barrier();
+    if (!isLastGroup) {
+        return;
+    }
+
+    memoryBarrierBuffer();
+    downsampleTile(uvec2(0), kTileLevels);
+}
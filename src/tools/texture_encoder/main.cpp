@@ -0,0 +1,142 @@
+// Converts images into block compressed KTX2 files with their full mip chain, which Texture uploads as stored.
+//
+//   texture_encoder [--input <file or directory>] [--output <directory>] [--format bc1|bc3|bc4|bc5|bc7]
+//                   [--color-space srgb|linear] [--mip-filter box|kaiser] [--threads <count>]
+//
+// Without an input every image under the resource directory is converted. The KTX2 files are written next to their
+// images unless an output directory is given. Color formats default to sRGB, BC4 and BC5 are always linear. Mips
+// default to the Kaiser filter.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "core/config.h"
+#include "core/logger.h"
+#include "renderer/bc_encoder.h"
+#include "renderer/ktx2.h"
+#include "renderer/texture.h"
+
+using namespace glint;
+
+std::unordered_set<std::string> glint::OneTimeLogger::loggedFunctions;
+
+namespace {
+
+struct EncoderFormat {
+  VkFormat srgb;
+  VkFormat linear;
+};
+
+const std::unordered_map<std::string, EncoderFormat> kFormats = {
+    {"bc1", {VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGB_UNORM_BLOCK}},
+    {"bc3", {VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK}},
+    {"bc4", {VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK}},
+    {"bc5", {VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK}},
+    {"bc7", {VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK}},
+};
+
+bool isImage(const std::filesystem::path& path) {
+  static const std::unordered_set<std::string> extensions = {".png", ".jpg", ".jpeg", ".tga", ".bmp"};
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extensions.count(extension) > 0;
+}
+
+std::vector<std::filesystem::path> findImages(const std::filesystem::path& input) {
+  if (!std::filesystem::is_directory(input)) {
+    return {input};
+  }
+  std::vector<std::filesystem::path> images;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+    if (entry.is_regular_file() && isImage(entry.path())) {
+      images.push_back(entry.path());
+    }
+  }
+  std::sort(images.begin(), images.end());
+  return images;
+}
+
+void convert(const std::filesystem::path& input, const std::filesystem::path& output, VkFormat format, bool srgb,
+             MipFilter filter, uint32_t threadCount) {
+  auto start = std::chrono::steady_clock::now();
+
+  // Mips are built from the decoded values, in linear space for sRGB images
+  ImageData image = Texture::loadImage(input.string());
+  image.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  image.generateMips(filter, threadCount);
+
+  ImageData encoded = BcEncoder::encode(image, format, threadCount);
+  Ktx2::write(output.string(), encoded);
+
+  VkDeviceSize sourceSize = 0;
+  VkDeviceSize encodedSize = 0;
+  for (uint32_t level = 0; level < encoded.getMipLevels(); level++) {
+    sourceSize += image.getMipSize(level);
+    encodedSize += encoded.getMipSize(level);
+  }
+  auto milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  std::cout << input.string() << " -> " << output.string() << ": " << image.width << "x" << image.height << ", "
+            << encoded.getMipLevels() << " mips, " << sourceSize / 1024 << " KiB -> " << encodedSize / 1024
+            << " KiB in " << milliseconds << " ms" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config::initialize(argc, argv);
+
+  std::string formatName = Config::getCustomeOption("format", "bc7");
+  std::string colorSpace = Config::getCustomeOption("color-space", "srgb");
+  std::string mipFilter = Config::getCustomeOption("mip-filter", "kaiser");
+  auto format = kFormats.find(formatName);
+  if (format == kFormats.end() || (colorSpace != "srgb" && colorSpace != "linear") ||
+      (mipFilter != "box" && mipFilter != "kaiser")) {
+    std::cerr << "Usage: texture_encoder [--input <file or directory>] [--output <directory>] "
+                 "[--format bc1|bc3|bc4|bc5|bc7] [--color-space srgb|linear] [--mip-filter box|kaiser] "
+                 "[--threads <count>]"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  // BC4 and BC5 hold data, not colors
+  bool srgb = colorSpace == "srgb" && format->second.srgb != format->second.linear;
+  VkFormat vkFormat = srgb ? format->second.srgb : format->second.linear;
+  MipFilter filter = mipFilter == "box" ? MipFilter::Box : MipFilter::Kaiser;
+  auto threadCount = static_cast<uint32_t>(std::strtoul(Config::getCustomeOption("threads", "0").c_str(), nullptr, 10));
+
+  std::filesystem::path input = Config::getCustomeOption("input", Config::getResourcePath());
+  std::filesystem::path outputDirectory = Config::getCustomeOption("output");
+  if (!outputDirectory.empty()) {
+    std::filesystem::create_directories(outputDirectory);
+  }
+
+  std::vector<std::filesystem::path> images = findImages(input);
+  if (images.empty()) {
+    std::cerr << "No images found in " << input.string() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int failures = 0;
+  for (const auto& image : images) {
+    std::filesystem::path output = image;
+    output.replace_extension(".ktx2");
+    if (!outputDirectory.empty()) {
+      output = outputDirectory / output.filename();
+    }
+    try {
+      convert(image, output, vkFormat, srgb, filter, threadCount);
+    } catch (const std::exception& e) {
+      std::cerr << "Failed to convert " << image.string() << ": " << e.what() << std::endl;
+      failures++;
+    }
+  }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}